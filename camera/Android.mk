@@ -7,6 +7,7 @@ LOCAL_PATH := $(CAMERA_CLIENT_LOCAL_PATH)
 LOCAL_SRC_FILES:= \
 	Camera.cpp \
 	CameraMetadata.cpp \
+	CameraMetadataPool.cpp \
 	CameraParameters.cpp \
 	CameraParameters2.cpp \
 	ICamera.cpp \
@@ -21,6 +21,7 @@
 #include <utils/Errors.h>
 
 #include <camera/CameraMetadata.h>
+#include <camera/CameraMetadataPool.h>
 #include <binder/Parcel.h>
 
 namespace android {
@@ -445,6 +446,17 @@ status_t CameraMetadata::readFromParcel(const Parcel& data,
         return OK;
     }
 
+    // arg1.. = reference to a shared memory slot
+    if (metadataSizeTmp == CameraMetadataPool::kPooledMetadata) {
+        err = CameraMetadataPool::readFromParcel(data, &metadata);
+        if (out) {
+            *out = metadata;
+        } else if (metadata != NULL) {
+            free_camera_metadata(metadata);
+        }
+        return err;
+    }
+
     // NOTE: this doesn't make sense to me. shouldnt the blob
     // know how big it is? why do we have to specify the size
     // to Parcel::readBlob ?
@@ -482,7 +494,8 @@ status_t CameraMetadata::readFromParcel(const Parcel& data,
 }
 
 status_t CameraMetadata::writeToParcel(Parcel& data,
-                                       const camera_metadata_t* metadata) {
+                                       const camera_metadata_t* metadata,
+                                       CameraMetadataPool *pool) {
     status_t res = OK;
 
     // arg0 = metadataSize (int32)
@@ -492,6 +505,15 @@ status_t CameraMetadata::writeToParcel(Parcel& data,
     }
 
     const size_t metadataSize = get_camera_metadata_compact_size(metadata);
+
+    if (pool != NULL) {
+        res = pool->writeToParcel(data, metadata, metadataSize);
+        if (res != NO_MEMORY) {
+            return res;
+        }
+        // Too big for a slot, or no slot free; send it inline
+    }
+
     res = data.writeInt32(static_cast<int32_t>(metadataSize));
     if (res != OK) {
         return res;
@@ -563,7 +585,8 @@ status_t CameraMetadata::readFromParcel(Parcel *parcel) {
     return OK;
 }
 
-status_t CameraMetadata::writeToParcel(Parcel *parcel) const {
+status_t CameraMetadata::writeToParcel(Parcel *parcel,
+                                       CameraMetadataPool *pool) const {
 
     ALOGV("%s: parcel = %p", __FUNCTION__, parcel);
 
@@ -572,7 +595,7 @@ status_t CameraMetadata::writeToParcel(Parcel *parcel) const {
         return BAD_VALUE;
     }
 
-    return CameraMetadata::writeToParcel(*parcel, mBuffer);
+    return CameraMetadata::writeToParcel(*parcel, mBuffer, pool);
 }
 
 void CameraMetadata::swap(CameraMetadata& other) {
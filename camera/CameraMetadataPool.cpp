@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Camera2-MetadataPool"
+//#define LOG_NDEBUG 0
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/Vector.h>
+#include <cutils/ashmem.h>
+#include <cutils/atomic.h>
+#include <binder/IPCThreadState.h>
+#include <binder/MemoryHeapBase.h>
+#include <binder/Parcel.h>
+#include <camera/CameraMetadataPool.h>
+
+namespace android {
+
+/**
+ * Shared memory layout: a header page with the pool header followed by one
+ * SlotHeader per slot, then the slots, each SLOT_SIZE bytes.
+ *
+ * A slot goes FREE -> WRITING -> READY on the sender, and back to FREE once
+ * the receiver has copied it out. Only the receiver frees a READY slot. The
+ * slot's state word also holds the generation of its contents, which
+ * changes on every write, so the receiver's READY -> FREE exchange fails if
+ * the slot it was sent has since been freed and written again.
+ */
+
+static const uint32_t kPoolMagic = 0x434d4450; // 'CMDP'
+
+struct PoolHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    int64_t  poolId;
+};
+
+struct SlotHeader {
+    // Generation in the upper bits, one of the states below in the lowest two
+    volatile int32_t state;
+};
+
+enum {
+    SLOT_FREE = 0,
+    SLOT_WRITING,
+    SLOT_READY,
+};
+
+static const int32_t kSlotStateMask = 0x3;
+static const int32_t kMaxGeneration = 0x1fffffff;
+
+static int32_t slotState(int32_t generation, int32_t state) {
+    return (generation << 2) | state;
+}
+
+// Bounds on what a receiver will map
+static const int32_t kMaxSlotCount = 64;
+static const int32_t kMaxSlotSize = 1024 * 1024;
+
+// Receiver-side cache of mapped pools. Entries are looked up by pool ID
+// only among the ones sent by the same uid, so that an app can't name
+// another app's pool to reach its slots, or replace its mapping. The
+// calling pid can't narrow this down further: it is 0 in oneway
+// transactions, which is how results are sent. Pool IDs are random, so
+// senders sharing a uid can't guess each other's either.
+struct MappedPool {
+    int64_t poolId;
+    uid_t   senderUid;
+    sp<MemoryHeapBase> heap;
+};
+
+static const size_t kMaxMappedPools = 8;
+static Mutex sMappedPoolsLock;
+static Vector<MappedPool> sMappedPools;
+
+static bool randomPoolId(int64_t *id) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) return false;
+    ssize_t count = TEMP_FAILURE_RETRY(read(fd, id, sizeof(*id)));
+    close(fd);
+    return count == static_cast<ssize_t>(sizeof(*id));
+}
+
+static size_t slotsOffset(size_t slotCount) {
+    size_t pageSize = getpagesize();
+    size_t headerSize = sizeof(PoolHeader) + slotCount * sizeof(SlotHeader);
+    return (headerSize + pageSize - 1) & ~(pageSize - 1);
+}
+
+static SlotHeader* slotHeader(void *base, size_t slot) {
+    return reinterpret_cast<SlotHeader*>(
+            static_cast<uint8_t*>(base) + sizeof(PoolHeader)) + slot;
+}
+
+CameraMetadataPool::CameraMetadataPool() :
+        mAllocFailed(false),
+        mId(0),
+        mNextSlot(0) {
+    for (size_t i = 0; i < SLOT_COUNT; i++) {
+        mGenerations[i] = 0;
+    }
+}
+
+CameraMetadataPool::~CameraMetadataPool() {
+}
+
+status_t CameraMetadataPool::allocateLocked() {
+    size_t poolSize = slotsOffset(SLOT_COUNT) + SLOT_COUNT * SLOT_SIZE;
+    sp<MemoryHeapBase> heap =
+            new MemoryHeapBase(poolSize, 0, "CameraMetadataPool");
+    if (heap->getHeapID() < 0 || heap->getBase() == MAP_FAILED) {
+        ALOGE("%s: Unable to allocate %d bytes of shared memory; metadata "
+                "will be sent inline", __FUNCTION__, poolSize);
+        mAllocFailed = true;
+        return NO_MEMORY;
+    }
+
+    // Receivers cache their mappings by this, so it must be unique and
+    // hard to guess for other senders
+    if (!randomPoolId(&mId)) {
+        ALOGW("%s: No random pool ID; metadata will be sent inline",
+                __FUNCTION__);
+        mAllocFailed = true;
+        return NO_MEMORY;
+    }
+
+    // ashmem starts zeroed, so all slots are SLOT_FREE
+    PoolHeader *header = static_cast<PoolHeader*>(heap->getBase());
+    header->poolId = mId;
+    header->magic = kPoolMagic;
+
+    mHeap = heap;
+    return OK;
+}
+
+ssize_t CameraMetadataPool::acquireSlotLocked() {
+    void *base = mHeap->getBase();
+    for (size_t i = 0; i < SLOT_COUNT; i++) {
+        size_t slot = (mNextSlot + i) % SLOT_COUNT;
+        SlotHeader *header = slotHeader(base, slot);
+        // A READY slot is never taken back, however long it waits: its
+        // receiver may just be slow
+        int32_t state = android_atomic_acquire_load(&header->state);
+        if ((state & kSlotStateMask) == SLOT_FREE &&
+                android_atomic_acquire_cas(state,
+                        slotState(mGenerations[slot], SLOT_WRITING),
+                        &header->state) == 0) {
+            mNextSlot = (slot + 1) % SLOT_COUNT;
+            return slot;
+        }
+    }
+    return NO_MEMORY;
+}
+
+status_t CameraMetadataPool::writeToParcel(Parcel &parcel,
+        const camera_metadata_t *metadata, size_t metadataSize) {
+    if (metadata == NULL || metadataSize > SLOT_SIZE) return NO_MEMORY;
+
+    // Parcels that don't allow fds, e.g. ones bound for a Bundle, can't
+    // carry the pool
+    bool allowFds = parcel.pushAllowFds(true);
+    parcel.restoreAllowFds(allowFds);
+    if (!allowFds) return NO_MEMORY;
+
+    Mutex::Autolock l(mLock);
+    if (mHeap == 0) {
+        if (mAllocFailed || allocateLocked() != OK) return NO_MEMORY;
+    }
+
+    ssize_t slot = acquireSlotLocked();
+    if (slot < 0) {
+        ALOGV("%s: All %d slots in use", __FUNCTION__, SLOT_COUNT);
+        return NO_MEMORY;
+    }
+
+    uint8_t *base = static_cast<uint8_t*>(mHeap->getBase());
+    SlotHeader *header = slotHeader(base, slot);
+    void *data = base + slotsOffset(SLOT_COUNT) + slot * SLOT_SIZE;
+    if (copy_camera_metadata(data, SLOT_SIZE, metadata) == NULL) {
+        android_atomic_release_store(
+                slotState(mGenerations[slot], SLOT_FREE), &header->state);
+        return NO_MEMORY;
+    }
+
+    int32_t generation = mGenerations[slot] =
+            (mGenerations[slot] + 1) & kMaxGeneration;
+    android_atomic_release_store(slotState(generation, SLOT_READY),
+            &header->state);
+
+    status_t res;
+    if ((res = parcel.writeInt32(kPooledMetadata)) != OK ||
+            (res = parcel.writeInt64(mId)) != OK ||
+            (res = parcel.writeFileDescriptor(mHeap->getHeapID())) != OK ||
+            (res = parcel.writeInt32(SLOT_COUNT)) != OK ||
+            (res = parcel.writeInt32(SLOT_SIZE)) != OK ||
+            (res = parcel.writeInt32(slot)) != OK ||
+            (res = parcel.writeInt32(generation)) != OK ||
+            (res = parcel.writeInt32(metadataSize)) != OK) {
+        ALOGE("%s: Unable to write metadata reference: %s (%d)",
+                __FUNCTION__, strerror(-res), res);
+        android_atomic_release_cas(slotState(generation, SLOT_READY),
+                slotState(generation, SLOT_FREE), &header->state);
+        return res;
+    }
+    return OK;
+}
+
+/**
+ * Returns the mapping of a sender's pool, mapping it if it isn't cached yet
+ * or if the cached mapping is refreshed. Only pools of the calling uid are
+ * looked up, see MappedPool.
+ *
+ * ashmem regions all fstat() as /dev/ashmem, so the fd can't be matched
+ * against a cached mapping by inode. A cached mapping is only used if the
+ * fd is ashmem of the same size, which catches a sender mixing up its own
+ * pools; it can't reach another uid's.
+ */
+static sp<MemoryHeapBase> getMappedPool(int64_t poolId, int fd,
+        size_t poolSize, bool refresh) {
+    // Only map ashmem, and only as much as it holds: the sender can't
+    // shrink it afterwards, so reads can't fault
+    int regionSize = ashmem_get_size_region(fd);
+    if (regionSize < 0 || static_cast<size_t>(regionSize) < poolSize) {
+        ALOGE("%s: Metadata pool is not ashmem of at least %d bytes",
+                __FUNCTION__, poolSize);
+        return NULL;
+    }
+
+    uid_t senderUid = IPCThreadState::self()->getCallingUid();
+
+    Mutex::Autolock l(sMappedPoolsLock);
+
+    for (size_t i = 0; i < sMappedPools.size(); i++) {
+        const MappedPool &pool = sMappedPools[i];
+        if (pool.poolId != poolId || pool.senderUid != senderUid) {
+            continue;
+        }
+        if (!refresh &&
+                pool.heap->getSize() == static_cast<size_t>(regionSize)) {
+            return pool.heap;
+        }
+        sMappedPools.removeAt(i);
+        break;
+    }
+
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(fd, regionSize, 0, 0);
+    if (heap->getHeapID() < 0 || heap->getBase() == MAP_FAILED) {
+        ALOGE("%s: Unable to map metadata pool", __FUNCTION__);
+        return NULL;
+    }
+    const PoolHeader *header =
+            static_cast<const PoolHeader*>(heap->getBase());
+    if (header->magic != kPoolMagic || header->poolId != poolId) {
+        ALOGE("%s: Metadata pool header doesn't match", __FUNCTION__);
+        return NULL;
+    }
+
+    if (sMappedPools.size() >= kMaxMappedPools) {
+        sMappedPools.removeAt(0);
+    }
+    MappedPool pool;
+    pool.poolId = poolId;
+    pool.senderUid = senderUid;
+    pool.heap = heap;
+    sMappedPools.push_back(pool);
+    return heap;
+}
+
+// Copies metadata out of a slot, and frees the slot
+static status_t readSlot(const sp<MemoryHeapBase> &heap, int32_t slotCount,
+        int32_t slotSize, int32_t slot, int32_t generation, int32_t size,
+        camera_metadata_t **out) {
+    uint8_t *base = static_cast<uint8_t*>(heap->getBase());
+    SlotHeader *header = slotHeader(base, slot);
+    int32_t ready = slotState(generation, SLOT_READY);
+
+    if (android_atomic_acquire_load(&header->state) != ready) {
+        return NOT_ENOUGH_DATA;
+    }
+
+    // Validates the private copy, so the sender can't change it under us
+    camera_metadata_t *metadata = allocate_copy_camera_metadata_checked(
+            reinterpret_cast<const camera_metadata_t*>(
+                    base + slotsOffset(slotCount) + slot * slotSize),
+            size);
+
+    // Fails if the slot was freed and written again since the check above,
+    // e.g. because the parcel was read twice, in which case the copy may be
+    // torn
+    if (android_atomic_release_cas(ready, slotState(generation, SLOT_FREE),
+                    &header->state) != 0) {
+        if (metadata != NULL) free_camera_metadata(metadata);
+        return NOT_ENOUGH_DATA;
+    }
+
+    if (metadata == NULL) {
+        ALOGE("%s: Pooled metadata is not valid", __FUNCTION__);
+        return BAD_VALUE;
+    }
+    *out = metadata;
+    return OK;
+}
+
+status_t CameraMetadataPool::readFromParcel(const Parcel &parcel,
+        camera_metadata_t **out) {
+    *out = NULL;
+
+    int64_t poolId = parcel.readInt64();
+    int fd = parcel.readFileDescriptor();
+    int32_t slotCount = parcel.readInt32();
+    int32_t slotSize = parcel.readInt32();
+    int32_t slot = parcel.readInt32();
+    int32_t generation = parcel.readInt32();
+    int32_t size = parcel.readInt32();
+
+    if (fd < 0 ||
+            slotCount <= 0 || slotCount > kMaxSlotCount ||
+            slotSize <= 0 || slotSize > kMaxSlotSize ||
+            slot < 0 || slot >= slotCount ||
+            generation < 0 || generation > kMaxGeneration ||
+            size <= 0 || size > slotSize) {
+        ALOGE("%s: Bad metadata reference: slot %d/%d, size %d/%d",
+                __FUNCTION__, slot, slotCount, size, slotSize);
+        return BAD_VALUE;
+    }
+    size_t poolSize = slotsOffset(slotCount) + slotCount * slotSize;
+
+    sp<MemoryHeapBase> heap = getMappedPool(poolId, fd, poolSize,
+            /*refresh*/false);
+    if (heap == 0) return BAD_VALUE;
+    status_t res = readSlot(heap, slotCount, slotSize, slot, generation, size,
+            out);
+    if (res == NOT_ENOUGH_DATA) {
+        // A cached mapping can be of an old pool with the same ID; map the
+        // one we were sent
+        heap = getMappedPool(poolId, fd, poolSize, /*refresh*/true);
+        if (heap == 0) return BAD_VALUE;
+        res = readSlot(heap, slotCount, slotSize, slot, generation, size, out);
+    }
+    if (res == NOT_ENOUGH_DATA) {
+        ALOGE("%s: Slot %d was already read", __FUNCTION__, slot);
+        return BAD_VALUE;
+    }
+    return res;
+}
+
+}; // namespace android
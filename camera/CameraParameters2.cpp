@@ -88,6 +88,88 @@ void CameraParameters2::unflatten(const String8 &params)
     }
 }
 
+// Whether str holds exactly the length bytes at chars
+static bool equals(const String8 &str, const char *chars, size_t length)
+{
+    return str.length() == length && memcmp(str.string(), chars, length) == 0;
+}
+
+void CameraParameters2::unflatten(const String8 &params,
+        Vector<String8> *changedKeys)
+{
+    OrderedKeyedVector<String8,String8> map;
+    const char *a = params.string();
+    const char *b;
+
+    // Where the next key most likely is in the old map
+    size_t hint = 0;
+    // Which old entries are still there. A key that appears more than once
+    // would otherwise be counted as several kept entries.
+    Vector<uint8_t> kept;
+    kept.insertAt(0, 0, mMap.size());
+    size_t keptKeys = 0;
+
+    for (;;) {
+        // Find the bounds of the key name.
+        b = strchr(a, '=');
+        if (b == 0)
+            break;
+        size_t keyLength = b - a;
+
+        // Find the bounds of the value.
+        const char *v = b+1;
+        b = strchr(v, ';');
+        size_t valueLength = (b == 0) ? strlen(v) : (size_t)(b-v);
+
+        // Keys normally come in the same order they were flattened in, so
+        // look where the previous key was found first.
+        ssize_t idx = -1;
+        if (hint < mMap.size() && equals(mMap.keyAt(hint), a, keyLength)) {
+            idx = hint;
+        } else {
+            for (size_t i = 0; i < mMap.size(); i++) {
+                if (equals(mMap.keyAt(i), a, keyLength)) {
+                    idx = i;
+                    break;
+                }
+            }
+        }
+
+        if (idx >= 0) {
+            const String8 &k = mMap.keyAt(idx);
+            if (equals(mMap.valueAt(idx), v, valueLength)) {
+                map.add(k, mMap.valueAt(idx));
+            } else {
+                map.add(k, String8(v, valueLength));
+                changedKeys->push_back(k);
+            }
+            hint = idx + 1;
+            if (!kept[idx]) {
+                kept.editItemAt(idx) = 1;
+                keptKeys++;
+            }
+        } else {
+            String8 k(a, keyLength);
+            map.add(k, String8(v, valueLength));
+            changedKeys->push_back(k);
+        }
+
+        if (b == 0)
+            break;
+        a = b+1;
+    }
+
+    if (keptKeys < mMap.size()) {
+        // Some keys are gone
+        for (size_t i = 0; i < mMap.size(); i++) {
+            if (!kept[i] && map.indexOfKey(mMap.keyAt(i)) < 0) {
+                changedKeys->push_back(mMap.keyAt(i));
+            }
+        }
+    }
+
+    mMap = map;
+}
 
 void CameraParameters2::set(const char *key, const char *value)
 {
@@ -29,6 +29,7 @@
 #include <camera/IProCameraCallbacks.h>
 
 #include "camera/CameraMetadata.h"
+#include "camera/CameraMetadataPool.h"
 
 namespace android {
 
@@ -42,7 +43,8 @@ class BpProCameraCallbacks: public BpInterface<IProCameraCallbacks>
 {
 public:
     BpProCameraCallbacks(const sp<IBinder>& impl)
-        : BpInterface<IProCameraCallbacks>(impl)
+        : BpInterface<IProCameraCallbacks>(impl),
+          mMetadataPool(new CameraMetadataPool())
     {
     }
 
@@ -72,9 +74,13 @@ public:
         Parcel data, reply;
         data.writeInterfaceToken(IProCameraCallbacks::getInterfaceDescriptor());
         data.writeInt32(requestId);
-        CameraMetadata::writeToParcel(data, result);
+        CameraMetadata::writeToParcel(data, result, mMetadataPool.get());
         remote()->transact(RESULT_RECEIVED, data, &reply, IBinder::FLAG_ONEWAY);
     }
+
+private:
+    // Results go through shared memory private to this client
+    sp<CameraMetadataPool> mMetadataPool;
 };
 
 IMPLEMENT_META_INTERFACE(ProCameraCallbacks,
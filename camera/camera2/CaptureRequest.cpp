@@ -84,7 +84,8 @@ status_t CaptureRequest::readFromParcel(Parcel* parcel) {
     return OK;
 }
 
-status_t CaptureRequest::writeToParcel(Parcel* parcel) const {
+status_t CaptureRequest::writeToParcel(Parcel* parcel,
+        CameraMetadataPool* metadataPool) const {
     if (parcel == NULL) {
         ALOGE("%s: Null parcel", __FUNCTION__);
         return BAD_VALUE;
@@ -92,7 +93,7 @@ status_t CaptureRequest::writeToParcel(Parcel* parcel) const {
 
     status_t err;
 
-    if ((err = mMetadata.writeToParcel(parcel)) != OK) {
+    if ((err = mMetadata.writeToParcel(parcel, metadataPool)) != OK) {
         return err;
     }
 
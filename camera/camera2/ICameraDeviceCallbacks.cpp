@@ -28,6 +28,7 @@
 
 #include <camera/camera2/ICameraDeviceCallbacks.h>
 #include "camera/CameraMetadata.h"
+#include "camera/CameraMetadataPool.h"
 
 namespace android {
 
@@ -42,7 +43,8 @@ class BpCameraDeviceCallbacks: public BpInterface<ICameraDeviceCallbacks>
 {
 public:
     BpCameraDeviceCallbacks(const sp<IBinder>& impl)
-        : BpInterface<ICameraDeviceCallbacks>(impl)
+        : BpInterface<ICameraDeviceCallbacks>(impl),
+          mMetadataPool(new CameraMetadataPool())
     {
     }
 
@@ -83,10 +85,14 @@ public:
         data.writeInterfaceToken(ICameraDeviceCallbacks::getInterfaceDescriptor());
         data.writeInt32(requestId);
         data.writeInt32(1); // to mark presence of metadata object
-        result.writeToParcel(&data);
+        result.writeToParcel(&data, mMetadataPool.get());
         remote()->transact(RESULT_RECEIVED, data, &reply, IBinder::FLAG_ONEWAY);
         data.writeNoException();
     }
+
+private:
+    // Results go through shared memory private to this client
+    sp<CameraMetadataPool> mMetadataPool;
 };
 
 IMPLEMENT_META_INTERFACE(CameraDeviceCallbacks,
@@ -25,6 +25,7 @@
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/Surface.h>
 #include <camera/CameraMetadata.h>
+#include <camera/CameraMetadataPool.h>
 #include <camera/camera2/CaptureRequest.h>
 
 namespace android {
@@ -61,7 +62,8 @@ class BpCameraDeviceUser : public BpInterface<ICameraDeviceUser>
 {
 public:
     BpCameraDeviceUser(const sp<IBinder>& impl)
-        : BpInterface<ICameraDeviceUser>(impl)
+        : BpInterface<ICameraDeviceUser>(impl),
+          mMetadataPool(new CameraMetadataPool())
     {
     }
 
@@ -83,7 +85,7 @@ public:
         // arg0 = CaptureRequest
         if (request != 0) {
             data.writeInt32(1);
-            request->writeToParcel(&data);
+            request->writeToParcel(&data, mMetadataPool.get());
         } else {
             data.writeInt32(0);
         }
@@ -208,8 +210,8 @@ public:
     }
 
 private:
-
-
+    // Request settings go through shared memory private to this device
+    sp<CameraMetadataPool> mMetadataPool;
 };
 
 IMPLEMENT_META_INTERFACE(CameraDeviceUser,
@@ -33,6 +33,7 @@
 #include "include/NuCachedSource2.h"
 #include <media/stagefright/AudioPlayer.h>
 #include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
 #include <media/stagefright/JPEGSource.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
@@ -389,6 +390,20 @@ static void playSource(OMXClient *client, sp<MediaSource> &source) {
         printf("avg. %.2f KB/sec\n", totalBytes / 1024 * 1E6 / delay);
 
         printf("decoded a total of %lld bytes\n", totalBytes);
+
+        // Real-time factor: seconds of PCM produced per second of wall
+        // clock, assuming 16 bit output as produced by all our decoders.
+        sp<MetaData> outFormat = rawSource->getFormat();
+        int32_t sampleRate, numChannels;
+        if (outFormat->findInt32(kKeySampleRate, &sampleRate)
+                && outFormat->findInt32(kKeyChannelCount, &numChannels)
+                && sampleRate > 0 && numChannels > 0) {
+            double decodedSecs =
+                (double)totalBytes / (2 * numChannels * sampleRate);
+
+            printf("decoded %.2f secs of audio, real-time factor %.2fx\n",
+                   decodedSecs, decodedSecs * 1E6 / delay);
+        }
     }
 }
 
@@ -587,6 +602,59 @@ static void performSeekTest(const sp<MediaSource> &source) {
     CHECK_EQ((status_t)OK, source->stop());
 }
 
+// Instantiates the extractor and fetches all track formats, i.e. what
+// preparing a local file costs, once per FileSource read mode.
+static void profileExtractorOpen(const char *filename) {
+    static const struct {
+        const char *mName;
+        uint32_t mFlags;
+    } kModes[] = {
+        { "pread", 0 },
+        { "read-ahead", FileSource::kFlagReadAheadCache },
+        { "mmap", FileSource::kFlagMmap },
+    };
+
+    printf("%s\n", filename);
+
+    // The first pass only warms up the page cache.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < sizeof(kModes) / sizeof(kModes[0]); ++i) {
+            int64_t startUs = getNowUs();
+
+            sp<FileSource> source = new FileSource(filename, kModes[i].mFlags);
+            if (source->initCheck() != OK) {
+                fprintf(stderr, "Unable to open '%s'.\n", filename);
+                return;
+            }
+
+            sp<MediaExtractor> extractor = MediaExtractor::Create(source);
+            if (extractor == NULL) {
+                fprintf(stderr, "could not create extractor.\n");
+                return;
+            }
+
+            size_t numTracks = extractor->countTracks();
+            for (size_t j = 0; j < numTracks; ++j) {
+                extractor->getTrackMetaData(j);
+            }
+
+            int64_t delayUs = getNowUs() - startUs;
+
+            if (pass == 0) {
+                continue;
+            }
+
+            FileSource::Stats stats;
+            source->getStats(&stats);
+
+            printf("  %-10s %7.2f ms, %d tracks, %d reads (%d from cache), "
+                   "%d syscalls\n",
+                   kModes[i].mName, delayUs / 1E3, numTracks,
+                   stats.mNumReads, stats.mNumCacheHits, stats.mNumSyscalls);
+        }
+    }
+}
+
 static void usage(const char *me) {
     fprintf(stderr, "usage: %s [options] [input_filename]\n", me);
     fprintf(stderr, "       -h(elp)\n");
@@ -608,6 +676,8 @@ static void usage(const char *me) {
     fprintf(stderr, "       -T allocate buffers from a surface texture\n");
     fprintf(stderr, "       -d(ump) output_filename (raw stream data to a file)\n");
     fprintf(stderr, "       -D(ump) output_filename (decoded PCM data to a file)\n");
+    fprintf(stderr, "       -P profile extractor creation with each file "
+                    "read mode\n");
 }
 
 static void dumpCodecProfiles(const sp<IOMX>& omx, bool queryDecoders) {
@@ -666,6 +736,7 @@ int main(int argc, char **argv) {
     bool useSurfaceTexAlloc = false;
     bool dumpStream = false;
     bool dumpPCMStream = false;
+    bool profileOpen = false;
     String8 dumpStreamFilename;
     gNumRepetitions = 1;
     gMaxNumFrames = 0;
@@ -679,7 +750,7 @@ int main(int argc, char **argv) {
     sp<ALooper> looper;
 
     int res;
-    while ((res = getopt(argc, argv, "han:lm:b:ptsrow:kxSTd:D:")) >= 0) {
+    while ((res = getopt(argc, argv, "han:lm:b:ptsrow:kxSTd:D:P")) >= 0) {
         switch (res) {
             case 'a':
             {
@@ -791,6 +862,12 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'P':
+            {
+                profileOpen = true;
+                break;
+            }
+
             case '?':
             case 'h':
             default:
@@ -810,6 +887,16 @@ int main(int argc, char **argv) {
     argc -= optind;
     argv += optind;
 
+    if (profileOpen) {
+        DataSource::RegisterDefaultSniffers();
+
+        for (int k = 0; k < argc; ++k) {
+            profileExtractorOpen(argv[k]);
+        }
+
+        return 0;
+    }
+
     if (extractThumbnail) {
         sp<IServiceManager> sm = defaultServiceManager();
         sp<IBinder> binder = sm->getService(String16("media.player"));
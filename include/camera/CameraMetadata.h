@@ -22,6 +22,7 @@
 #include <utils/Vector.h>
 
 namespace android {
+class CameraMetadataPool;
 class Parcel;
 
 /**
@@ -187,7 +188,9 @@ class CameraMetadata {
 
     // Metadata object is unchanged when reading from parcel fails.
     status_t readFromParcel(Parcel *parcel);
-    status_t writeToParcel(Parcel *parcel) const;
+    // With a pool, the metadata is sent through shared memory when it fits
+    status_t writeToParcel(Parcel *parcel,
+                           CameraMetadataPool *pool = NULL) const;
 
     /**
       * Caller becomes the owner of the new metadata
@@ -202,9 +205,12 @@ class CameraMetadata {
     /**
       * Caller retains ownership of metadata
       * - Write 2 (int32 + blob) args in the current position
+      * - Or, with a pool that has room for it, a reference to a pool slot
+      *   instead; see CameraMetadataPool
       */
     static status_t writeToParcel(Parcel &parcel,
-                                  const camera_metadata_t* metadata);
+                                  const camera_metadata_t* metadata,
+                                  CameraMetadataPool *pool = NULL);
 
   private:
     camera_metadata_t *mBuffer;
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_CLIENT_CAMERA2_CAMERAMETADATAPOOL_H
+#define ANDROID_CLIENT_CAMERA2_CAMERAMETADATAPOOL_H
+
+#include "system/camera_metadata.h"
+#include <utils/Errors.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+
+namespace android {
+class MemoryHeapBase;
+class Parcel;
+
+/**
+ * A pool of ashmem slots for sending camera metadata over binder without
+ * copying it through the Parcel. The sender copies the metadata into a free
+ * slot, and the Parcel only carries the pool's file descriptor and the slot
+ * index and generation. The receiver copies the metadata out of the slot,
+ * validates its copy, and hands the slot back.
+ *
+ * A receiver can read every slot of a pool it was sent, so use one pool per
+ * receiving process, e.g. one per binder proxy. Slots are never taken back
+ * from a receiver that hasn't read them yet. Metadata that doesn't fit in a
+ * slot, or that is written while all slots are in use, should be sent
+ * inline; CameraMetadata::writeToParcel does that.
+ *
+ * Writing is thread-safe. Reading doesn't need a pool object, see
+ * readFromParcel().
+ */
+class CameraMetadataPool : public RefBase {
+  public:
+    // Written in place of the metadata size to mark pooled metadata
+    static const int32_t kPooledMetadata = -1;
+
+    CameraMetadataPool();
+
+    /**
+     * Copies the metadata into a free slot, and writes a reference to the
+     * slot at the current position of the parcel, starting with
+     * kPooledMetadata. The shared memory is allocated on first use.
+     *
+     * Returns NO_MEMORY without writing anything if the metadata can't be
+     * pooled, in which case the caller should write it inline.
+     */
+    status_t writeToParcel(Parcel &parcel, const camera_metadata_t *metadata,
+            size_t metadataSize);
+
+    /**
+     * Reads the metadata referenced by writeToParcel(), after the
+     * kPooledMetadata marker, into a new buffer owned by the caller. The slot
+     * is freed. Mappings of the senders' pools are cached per sending uid,
+     * as given by the calling binder transaction.
+     *
+     * Fails if the slot was already read, or if the metadata is not valid.
+     */
+    static status_t readFromParcel(const Parcel &parcel,
+            camera_metadata_t **out);
+
+  protected:
+    virtual ~CameraMetadataPool();
+
+  private:
+    enum {
+        SLOT_COUNT = 8,
+        // Fits the result metadata of current HAL3 devices
+        SLOT_SIZE = 64 * 1024,
+    };
+
+    Mutex                 mLock;
+    sp<MemoryHeapBase>    mHeap;
+    bool                  mAllocFailed;
+    int64_t               mId;
+    size_t                mNextSlot;
+    // Kept here rather than in the shared memory, which receivers can write
+    int32_t               mGenerations[SLOT_COUNT];
+
+    status_t allocateLocked();
+    ssize_t  acquireSlotLocked();
+};
+
+}; // namespace android
+
+#endif
@@ -638,6 +638,14 @@ public:
     // Example values: "lowlight,hdr".
     static const char KEY_LIGHTFX[];
 
+    // Minimum time between two recording frames sent to the recording client,
+    // in microseconds. The camera service drops the recording frames in
+    // between before they are delivered. Used by time lapse recording. The
+    // value is consumed by the camera service, is not passed to the HAL and is
+    // never returned by getParameters(); it is reset when recording stops.
+    // Example value: "1000000". Write only.
+    static const char KEY_RECORDING_FRAME_INTERVAL[];
+
 #ifdef HAVE_ISO
     static const char KEY_SUPPORTED_ISO_MODES[];
     static const char KEY_ISO_MODE[];
@@ -37,6 +37,12 @@ public:
 
     String8 flatten() const;
     void unflatten(const String8 &params);
+    // Same as unflatten(params), but also appends to changedKeys every key
+    // whose value differs from before, including keys that were added or
+    // removed. Entries that didn't change are kept rather than parsed again,
+    // which makes this cheap when params is a lightly edited flatten() of
+    // this object.
+    void unflatten(const String8 &params, Vector<String8> *changedKeys);
 
     void set(const char *key, const char *value);
     void set(const char *key, int value);
@@ -35,7 +35,9 @@ public:
      * Keep impl up-to-date with CaptureRequest.java in frameworks/base
      */
     status_t                readFromParcel(Parcel* parcel);
-    status_t                writeToParcel(Parcel* parcel) const;
+    status_t                writeToParcel(Parcel* parcel,
+                                    CameraMetadataPool* metadataPool = NULL)
+                                    const;
 };
 }; // namespace android
 
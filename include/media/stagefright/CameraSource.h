@@ -169,6 +169,8 @@ protected:
     int64_t  mPauseEndTimeUs;
     // Time between capture of two frames.
     int64_t mTimeBetweenFrameCaptureUs;
+    // Set by start() if media.stagefright.record-stats is enabled.
+    bool mCollectStats;
 
     CameraSource(const sp<ICamera>& camera, const sp<ICameraRecordingProxy>& proxy,
                  int32_t cameraId, const String16& clientName, uid_t clientUid,
@@ -207,7 +209,6 @@ private:
     int32_t mNumFramesDropped;
     int32_t mNumGlitches;
     int64_t mGlitchDurationThresholdUs;
-    bool mCollectStats;
     bool mIsMetaDataStoredInVideoBuffers;
 
     void releaseQueuedFrames();
@@ -46,14 +46,18 @@ public:
 
     virtual ~CameraSourceTimeLapse();
 
+    // Drops the last read frame kept for quick read returns, so that
+    // CameraSource::reset() does not wait for it, then stops the source.
+    virtual status_t stop();
+
     // If the frame capture interval is large, read will block for a long time.
     // Due to the way the mediaRecorder framework works, a stop() call from
     // mediaRecorder waits until the read returns, causing a long wait for
-    // stop() to return. To avoid this, we can make read() return a copy of the
-    // last read frame with the same time stamp frequently. This keeps the
+    // stop() to return. To avoid this, we can make read() return the last
+    // read frame again with the same time stamp frequently. This keeps the
     // read() call from blocking too long. Calling this function quickly
-    // captures another frame, keeps its copy, and enables this mode of read()
-    // returning quickly.
+    // captures another frame, keeps a reference to it, and enables this mode
+    // of read() returning quickly.
     void startQuickReadReturns();
 
 private:
@@ -92,7 +96,7 @@ private:
     Mutex mQuickStopLock;
 
     // mQuickStop is set to true if we use quick read() returns, otherwise it is set
-    // to false. Once in this mode read() return a copy of the last read frame
+    // to false. Once in this mode read() returns the last read frame again
     // with the same time stamp. See startQuickReadReturns().
     volatile bool mQuickStop;
 
@@ -101,13 +105,21 @@ private:
     // frame wakes up any blocking read.
     volatile bool mForceRead;
 
-    // Stores a copy of the MediaBuffer read in the last read() call after
-    // mQuickStop was true.
-    MediaBuffer* mLastReadBufferCopy;
+    // The MediaBuffer read in the last read() call after mQuickStop was true.
+    // An extra reference is held on it, so it wraps the original camera
+    // recording frame until stop() and is never copied.
+    MediaBuffer* mLastReadBuffer;
 
     // Status code for last read.
     status_t mLastReadStatus;
 
+    // Statistics, logged by stop() if mCollectStats is set. The callback time
+    // covers dataCallbackTimestamp() for all frames, skipped or not.
+    int32_t mNumFramesSkipped;
+    int32_t mNumCallbacks;
+    int64_t mTotalCallbackTimeUs;
+    int64_t mMaxCallbackTimeUs;
+
     CameraSourceTimeLapse(
         const sp<ICamera> &camera,
         const sp<ICameraRecordingProxy> &proxy,
@@ -120,11 +132,6 @@ private:
         int64_t timeBetweenTimeLapseFrameCaptureUs,
         bool storeMetaDataInVideoBuffers = true);
 
-    // Wrapper over CameraSource::signalBufferReturned() to implement quick stop.
-    // It only handles the case when mLastReadBufferCopy is signalled. Otherwise
-    // it calls the base class' function.
-    virtual void signalBufferReturned(MediaBuffer* buffer);
-
     // Wrapper over CameraSource::read() to implement quick stop.
     virtual status_t read(MediaBuffer **buffer, const ReadOptions *options = NULL);
 
@@ -138,15 +145,17 @@ private:
     virtual void dataCallbackTimestamp(int64_t timestampUs, int32_t msgType,
             const sp<IMemory> &data);
 
-    // Convenience function to fill mLastReadBufferCopy from the just read
-    // buffer.
-    void fillLastReadBufferCopy(MediaBuffer& sourceBuffer);
-
     // If the passed in size (width x height) is a supported video/preview size,
     // the function sets the camera's video/preview size to it and returns true.
     // Otherwise returns false.
     bool trySettingVideoSize(int32_t width, int32_t height);
 
+    // Asks the camera service to drop the recording frames that
+    // skipFrameAndModifyTimeStamp() would skip, so they are never delivered.
+    // The frames that do arrive are still checked, as the camera may not
+    // support this.
+    void setRecordingFrameInterval();
+
     // When video camera is used for time lapse capture, returns true
     // until enough time has passed for the next time lapse frame. When
     // the frame needs to be encoded, it returns false and also modifies
@@ -157,9 +166,6 @@ private:
     // Wrapper to enter threadTimeLapseEntry()
     static void *ThreadTimeLapseWrapper(void *me);
 
-    // Creates a copy of source_data into a new memory of final type MemoryBase.
-    sp<IMemory> createIMemoryCopy(const sp<IMemory> &source_data);
-
     CameraSourceTimeLapse(const CameraSourceTimeLapse &);
     CameraSourceTimeLapse &operator=(const CameraSourceTimeLapse &);
 };
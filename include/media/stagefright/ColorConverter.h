@@ -27,12 +27,22 @@
 
 namespace android {
 
+// Destination format for RGBA8888 output (byte order R, G, B, A) which the
+// OMX IL headers don't define. Only supported for the YUV420 sources.
+enum {
+    OMX_COLOR_Format32BitRGBA8888 = 0x7F00A000
+};
+
 struct ColorConverter {
     ColorConverter(OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to);
     ~ColorConverter();
 
     bool isValid() const;
 
+    // Large frames in the YUV420 formats are split into bands of rows that
+    // are converted on up to "numThreads" threads. Defaults to 1.
+    void setNumThreads(size_t numThreads);
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -59,11 +69,41 @@ private:
         size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
     };
 
+    // Source plane layout shared by the YUV420 formats, with U and V
+    // samples "mSrcUVStep" bytes apart within a chroma row.
+    struct YUV420Params {
+        const uint8_t *mSrcY;
+        const uint8_t *mSrcU;
+        const uint8_t *mSrcV;
+        size_t mSrcYStride;
+        size_t mSrcUVStride;
+        size_t mSrcUVStep;
+        bool mSwapRB;
+
+        uint8_t *mDst;
+        size_t mDstStride;
+
+        size_t mWidth, mHeight;
+    };
+
+    struct RowBand;
+
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
     uint8_t *mClip;
+    size_t mNumThreads;
 
     uint8_t *initClip();
 
+    static void *RowBandThread(void *me);
+
+    status_t convertYUV420(
+            YUV420Params &params,
+            const BitmapParams &src, const BitmapParams &dst);
+
+    void convertYUV420Rows(
+            const YUV420Params &params,
+            size_t firstRow, size_t lastRow) const;
+
     status_t convertCbYCrY(
             const BitmapParams &src, const BitmapParams &dst);
 
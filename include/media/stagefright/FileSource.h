@@ -22,6 +22,7 @@
 
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaErrors.h>
+#include <utils/String8.h>
 #include <utils/threads.h>
 #include <drm/DrmManagerClient.h>
 
@@ -29,8 +30,24 @@ namespace android {
 
 class FileSource : public DataSource {
 public:
+    enum Flags {
+        // Serve small reads from a few blocks of read-ahead.
+        kFlagReadAheadCache = 1,
+        // Map the file (or the given range of it) and copy out of the
+        // mapping instead of issuing reads. Falls back to pread if the
+        // mapping fails. Reading a mapping of a file that is being
+        // truncated raises SIGBUS, so this is not the default.
+        kFlagMmap           = 2,
+    };
+
+    // Flags default to kFlagReadAheadCache, plus kFlagMmap if the property
+    // "media.stagefright.filesource-mmap" is set to 1.
+    static uint32_t DefaultFlags();
+
     FileSource(const char *filename);
+    FileSource(const char *filename, uint32_t flags);
     FileSource(int fd, int64_t offset, int64_t length);
+    FileSource(int fd, int64_t offset, int64_t length, uint32_t flags);
 
     virtual status_t initCheck() const;
 
@@ -42,15 +59,58 @@ public:
 
     virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client);
 
+    // The path the source was opened with, empty for file descriptors.
+    virtual String8 getUri();
+
+    struct Stats {
+        int32_t mNumReads;
+        int32_t mNumCacheHits;
+        // Includes the open(), lseek64() and mmap() calls made at
+        // construction time.
+        int32_t mNumSyscalls;
+    };
+
+    void getStats(Stats *stats) const;
+
 protected:
     virtual ~FileSource();
 
 private:
+    enum {
+        kNumCacheBlocks = 4,
+        kCacheBlockSize = 32768,
+        // Larger reads bypass the cache.
+        kMaxCachedReadSize = 4096,
+    };
+
+    struct CacheBlock {
+        off64_t mOffset;
+        ssize_t mSize;
+        uint32_t mLastUsed;
+        uint8_t *mData;
+    };
+
     int mFd;
+    String8 mUri;
     int64_t mOffset;
     int64_t mLength;
+
+    // Only serializes the DRM path, plain reads use pread and need no lock.
     Mutex mLock;
 
+    void *mMapBase;
+    size_t mMapSize;
+    const uint8_t *mMapData;  // mMapBase + offset of mOffset in the page
+
+    Mutex mCacheLock;
+    bool mUseCache;
+    uint32_t mCacheClock;
+    CacheBlock mCacheBlocks[kNumCacheBlocks];
+
+    volatile int32_t mNumReads;
+    volatile int32_t mNumCacheHits;
+    volatile int32_t mNumSyscalls;
+
     /*for DRM*/
     sp<DecryptHandle> mDecryptHandle;
     DrmManagerClient *mDrmManagerClient;
@@ -58,6 +118,13 @@ private:
     int64_t mDrmBufSize;
     unsigned char *mDrmBuf;
 
+    void openFile(const char *filename);
+    void init(uint32_t flags);
+    void initMmap();
+
+    ssize_t readAtCached(off64_t offset, void *data, size_t size);
+    ssize_t preadFully(off64_t offset, void *data, size_t size);
+
     ssize_t readAtDRM(off64_t offset, void *data, size_t size);
 
     FileSource(const FileSource &);
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2013, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_BUFFER_RANGE_H_
+
+#define A_BUFFER_RANGE_H_
+
+#include <media/stagefright/foundation/ABuffer.h>
+
+namespace android {
+
+// A range of an ABuffer's memory that keeps the buffer alive, so that data
+// can be handed on without copying it. The offset is relative to the
+// buffer's base(), i.e. independent of the buffer's current range.
+struct ABufferRange {
+    ABufferRange()
+        : mOffset(0),
+          mSize(0) {
+    }
+
+    ABufferRange(const sp<ABuffer> &buffer, size_t offset, size_t size)
+        : mBuffer(buffer),
+          mOffset(offset),
+          mSize(size) {
+    }
+
+    uint8_t *data() const { return mBuffer->base() + mOffset; }
+
+    sp<ABuffer> mBuffer;
+    size_t mOffset;
+    size_t mSize;
+};
+
+}  // namespace android
+
+#endif  // A_BUFFER_RANGE_H_
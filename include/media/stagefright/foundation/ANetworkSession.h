@@ -27,6 +27,7 @@
 
 namespace android {
 
+struct ABufferRange;
 struct AMessage;
 
 // Helper class to manage a number of live sockets (datagram and stream-based)
@@ -77,6 +78,14 @@ struct ANetworkSession : public RefBase {
             int32_t sessionID, const void *data, ssize_t size = -1,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    // Queues a single datagram made up of the given ranges, in order. On
+    // UDP sessions the data is handed to the kernel straight from the
+    // ranges' buffers, which must not be modified until it has been sent,
+    // other sessions copy it as sendRequest() would.
+    status_t sendDatagram(
+            int32_t sessionID, const ABufferRange *ranges, size_t numRanges,
+            bool timeValid = false, int64_t timeUs = -1ll);
+
     status_t switchToWebSocketMode(int32_t sessionID);
 
     enum NotificationReason {
@@ -75,6 +75,7 @@
 #include "nuplayer/NuPlayerDriver.h"
 
 #include <OMX.h>
+#include <SoftOMXLooperPool.h>
 
 #include "Crypto.h"
 #include "Drm.h"
@@ -415,6 +416,8 @@ status_t MediaPlayerService::dump(int fd, const Vector<String16>& args)
             }
         }
 
+        SoftOMXLooperPool::Dump(&result);
+
         result.append(" Files opened and/or mapped:\n");
         snprintf(buffer, SIZE, "/proc/%d/maps", gettid());
         FILE *f = fopen(buffer, "r");
@@ -43,6 +43,7 @@ LOCAL_SRC_FILES:=                         \
         SampleIterator.cpp                \
         SampleTable.cpp                   \
         SkipCutBuffer.cpp                 \
+        SniffingSource.cpp                \
         StagefrightMediaScanner.cpp       \
         StagefrightMetadataRetriever.cpp  \
         SurfaceMediaSource.cpp            \
@@ -662,6 +662,7 @@ void AwesomePlayer::reset_l() {
         Mutex::Autolock autoLock(mStatsLock);
         mStats.mFd = -1;
         mStats.mURI = String8();
+        mStats.mCachedSource.clear();
         mStats.mBitrate = -1;
         mStats.mAudioTrackIndex = -1;
         mStats.mVideoTrackIndex = -1;
@@ -2651,6 +2652,11 @@ status_t AwesomePlayer::finishSetDataSource_l() {
                     disconnectAtHighwatermark);
 #endif
 
+            {
+                Mutex::Autolock autoLock(mStatsLock);
+                mStats.mCachedSource = mCachedSource;
+            }
+
             dataSource = mCachedSource;
         } else {
             dataSource = mConnectingDataSource;
@@ -3287,6 +3293,13 @@ status_t AwesomePlayer::dump(int fd, const Vector<String16> &args) const {
         }
     }
 
+    sp<NuCachedSource2> cachedSource = mStats.mCachedSource.promote();
+    if (cachedSource != NULL) {
+        String8 cacheStats;
+        cachedSource->dump(&cacheStats);
+        fprintf(out, "%s", cacheStats.string());
+    }
+
     fclose(out);
     out = NULL;
 
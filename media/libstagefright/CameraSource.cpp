@@ -183,6 +183,7 @@ CameraSource::CameraSource(
       mStarted(false),
       mNumFramesEncoded(0),
       mTimeBetweenFrameCaptureUs(0),
+      mCollectStats(false),
       mFirstFrameTimeUs(0),
       mNumFramesDropped(0),
       mNumGlitches(0),
@@ -190,8 +191,7 @@ CameraSource::CameraSource(
       mPauseAdjTimeUs(0),
       mPauseStartTimeUs(0),
       mPauseEndTimeUs(0),
-      mGlitchDurationThresholdUs(200000),
-      mCollectStats(false) {
+      mGlitchDurationThresholdUs(200000) {
     mVideoSize.width  = -1;
     mVideoSize.height = -1;
 
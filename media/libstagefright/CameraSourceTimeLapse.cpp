@@ -18,8 +18,6 @@
 #define LOG_TAG "CameraSourceTimeLapse"
 
 #include <binder/IPCThreadState.h>
-#include <binder/MemoryBase.h>
-#include <binder/MemoryHeapBase.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/CameraSource.h>
 #include <media/stagefright/CameraSourceTimeLapse.h>
@@ -31,6 +29,11 @@
 
 namespace android {
 
+// Longest recording frame interval asked of the camera service. A quick read
+// return has to wait for the next frame the service sends, so this bounds how
+// long stopping a recording can take.
+static const int64_t kMaxRecordingFrameIntervalUs = 1000000;
+
 // static
 CameraSourceTimeLapse *CameraSourceTimeLapse::CreateFromCamera(
         const sp<ICamera> &camera,
@@ -87,20 +90,52 @@ CameraSourceTimeLapse::CameraSourceTimeLapse(
 
     if (!trySettingVideoSize(videoSize.width, videoSize.height)) {
         mInitCheck = NO_INIT;
+    } else {
+        setRecordingFrameInterval();
     }
 
     // Initialize quick stop variables.
     mQuickStop = false;
     mForceRead = false;
-    mLastReadBufferCopy = NULL;
+    mLastReadBuffer = NULL;
     mStopWaitingForIdleCamera = false;
+
+    mNumFramesSkipped = 0;
+    mNumCallbacks = 0;
+    mTotalCallbackTimeUs = 0;
+    mMaxCallbackTimeUs = 0;
 }
 
 CameraSourceTimeLapse::~CameraSourceTimeLapse() {
-    if (mLastReadBufferCopy) {
-        mLastReadBufferCopy->release();
-        mLastReadBufferCopy = NULL;
+    if (mLastReadBuffer) {
+        mLastReadBuffer->release();
+        mLastReadBuffer = NULL;
+    }
+}
+
+status_t CameraSourceTimeLapse::stop() {
+    ALOGV("stop");
+    MediaBuffer *lastReadBuffer;
+    {
+        Mutex::Autolock autoLock(mQuickStopLock);
+        lastReadBuffer = mLastReadBuffer;
+        mLastReadBuffer = NULL;
+        // Don't keep a frame that read() returns from now on
+        mQuickStop = false;
+    }
+    if (lastReadBuffer) {
+        // Returns the recording frame once the encoder is done with it too
+        lastReadBuffer->release();
     }
+
+    if (mCollectStats) {
+        ALOGI("Time lapse frames skipped: %d of %d, callback time "
+                "avg/max: %lld/%lld us", mNumFramesSkipped, mNumCallbacks,
+                mNumCallbacks > 0 ? mTotalCallbackTimeUs / mNumCallbacks : 0,
+                mMaxCallbackTimeUs);
+    }
+
+    return CameraSource::stop();
 }
 
 void CameraSourceTimeLapse::startQuickReadReturns() {
@@ -163,72 +198,47 @@ bool CameraSourceTimeLapse::trySettingVideoSize(
     return isSuccessful;
 }
 
-void CameraSourceTimeLapse::signalBufferReturned(MediaBuffer* buffer) {
-    ALOGV("signalBufferReturned");
-    Mutex::Autolock autoLock(mQuickStopLock);
-    if (mQuickStop && (buffer == mLastReadBufferCopy)) {
-        buffer->setObserver(NULL);
-        buffer->release();
-    } else {
-        return CameraSource::signalBufferReturned(buffer);
+void CameraSourceTimeLapse::setRecordingFrameInterval() {
+    ALOGV("setRecordingFrameInterval");
+    int64_t intervalUs = mTimeBetweenFrameCaptureUs;
+    if (intervalUs > kMaxRecordingFrameIntervalUs) {
+        intervalUs = kMaxRecordingFrameIntervalUs;
     }
-}
-
-void createMediaBufferCopy(
-        const MediaBuffer& sourceBuffer,
-        int64_t frameTime,
-        MediaBuffer **newBuffer) {
-
-    ALOGV("createMediaBufferCopy");
-    size_t sourceSize = sourceBuffer.size();
-    void* sourcePointer = sourceBuffer.data();
-
-    (*newBuffer) = new MediaBuffer(sourceSize);
-    memcpy((*newBuffer)->data(), sourcePointer, sourceSize);
 
-    (*newBuffer)->meta_data()->setInt64(kKeyTime, frameTime);
-}
-
-void CameraSourceTimeLapse::fillLastReadBufferCopy(MediaBuffer& sourceBuffer) {
-    ALOGV("fillLastReadBufferCopy");
-    int64_t frameTime;
-    CHECK(sourceBuffer.meta_data()->findInt64(kKeyTime, &frameTime));
-    createMediaBufferCopy(sourceBuffer, frameTime, &mLastReadBufferCopy);
-    mLastReadBufferCopy->add_ref();
-    mLastReadBufferCopy->setObserver(this);
+    int64_t token = IPCThreadState::self()->clearCallingIdentity();
+    CameraParameters params(mCamera->getParameters());
+    params.set(CameraParameters::KEY_RECORDING_FRAME_INTERVAL,
+            String8::format("%lld", intervalUs).string());
+    if (mCamera->setParameters(params.flatten()) != OK) {
+        ALOGW("Camera can't drop frames for time lapse, skipping them here");
+    }
+    IPCThreadState::self()->restoreCallingIdentity(token);
 }
 
 status_t CameraSourceTimeLapse::read(
         MediaBuffer **buffer, const ReadOptions *options) {
     ALOGV("read");
-    if (mLastReadBufferCopy == NULL) {
-        mLastReadStatus = CameraSource::read(buffer, options);
-
-        // mQuickStop may have turned to true while read was blocked.
-        // Make a copy of the buffer in that case.
+    {
         Mutex::Autolock autoLock(mQuickStopLock);
-        if (mQuickStop && *buffer) {
-            fillLastReadBufferCopy(**buffer);
+        if (mLastReadBuffer != NULL) {
+            (*buffer) = mLastReadBuffer;
+            (*buffer)->add_ref();
+            return mLastReadStatus;
         }
-        return mLastReadStatus;
-    } else {
-        (*buffer) = mLastReadBufferCopy;
-        (*buffer)->add_ref();
-        return mLastReadStatus;
     }
-}
 
-sp<IMemory> CameraSourceTimeLapse::createIMemoryCopy(
-        const sp<IMemory> &source_data) {
+    status_t err = CameraSource::read(buffer, options);
 
-    ALOGV("createIMemoryCopy");
-    size_t source_size = source_data->size();
-    void* source_pointer = source_data->pointer();
-
-    sp<MemoryHeapBase> newMemoryHeap = new MemoryHeapBase(source_size);
-    sp<MemoryBase> newMemory = new MemoryBase(newMemoryHeap, 0, source_size);
-    memcpy(newMemory->pointer(), source_pointer, source_size);
-    return newMemory;
+    // mQuickStop may have turned to true while read was blocked.
+    // Keep a reference to the buffer in that case; it still wraps the
+    // camera's recording frame, which is given back once stop() drops it.
+    Mutex::Autolock autoLock(mQuickStopLock);
+    mLastReadStatus = err;
+    if (mQuickStop && *buffer) {
+        mLastReadBuffer = *buffer;
+        mLastReadBuffer->add_ref();
+    }
+    return err;
 }
 
 bool CameraSourceTimeLapse::skipCurrentFrame(int64_t timestampUs) {
@@ -299,8 +309,20 @@ bool CameraSourceTimeLapse::skipFrameAndModifyTimeStamp(int64_t *timestampUs) {
 void CameraSourceTimeLapse::dataCallbackTimestamp(int64_t timestampUs, int32_t msgType,
             const sp<IMemory> &data) {
     ALOGV("dataCallbackTimestamp");
+    int64_t startTimeUs = ns2us(systemTime());
+
     mSkipCurrentFrame = skipFrameAndModifyTimeStamp(&timestampUs);
+    if (mSkipCurrentFrame) {
+        ++mNumFramesSkipped;
+    }
     CameraSource::dataCallbackTimestamp(timestampUs, msgType, data);
+
+    int64_t callbackTimeUs = ns2us(systemTime()) - startTimeUs;
+    ++mNumCallbacks;
+    mTotalCallbackTimeUs += callbackTimeUs;
+    if (callbackTimeUs > mMaxCallbackTimeUs) {
+        mMaxCallbackTimeUs = callbackTimeUs;
+    }
 }
 
 }  // namespace android
@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DataSource"
+#include <utils/Log.h>
+
 #include "include/AMRExtractor.h"
 
 #if CHROMIUM_AVAILABLE
@@ -30,6 +34,7 @@
 #include "include/MPEG4Extractor.h"
 #include "include/NuCachedSource2.h"
 #include "include/OggExtractor.h"
+#include "include/SniffingSource.h"
 #include "include/WAVExtractor.h"
 #include "include/WVMExtractor.h"
 #ifdef QCOM_HARDWARE
@@ -38,6 +43,7 @@
 
 #include "matroska/MatroskaExtractor.h"
 
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -112,25 +118,169 @@ Mutex DataSource::gSnifferMutex;
 List<DataSource::SnifferFunc> DataSource::gSniffers;
 bool DataSource::gSniffersRegistered = false;
 
+// How much of the head of the stream the sniffers share, enough for every
+// container's magic and for an MP3 frame sync following a modest ID3 tag.
+static const size_t kSniffWindowSize = 65536;
+
+// No other default sniffer reports more than this for content that a
+// sniffer at or above it recognized, the rest can be skipped.
+static const float kShortCircuitConfidence = 0.4f;
+
+// Sniffers to try first if the URI's extension or the content type the
+// server reported matches.
+static const struct {
+    DataSource::SnifferFunc mSniffer;
+    const char *mExtensions;
+    const char *mMIMETypes;
+} kSnifferHints[] = {
+    { SniffMPEG4, "mp4 m4a m4v 3gp 3gpp 3g2 3gpp2 mov",
+      "video/mp4 audio/mp4 video/3gpp audio/3gpp video/3gpp2 video/quicktime" },
+    { SniffMatroska, "mkv mka webm",
+      "video/x-matroska audio/x-matroska video/webm audio/webm" },
+    { SniffOgg, "ogg oga", "application/ogg audio/ogg" },
+    { SniffWAV, "wav", "audio/wav audio/x-wav" },
+    { SniffFLAC, "flac", "audio/flac audio/x-flac" },
+    { SniffAMR, "amr awb", "audio/amr audio/amr-wb" },
+    { SniffMPEG2TS, "ts", "video/mp2t" },
+    { SniffMP3, "mp3", "audio/mpeg audio/mp3" },
+    { SniffAAC, "aac", "audio/aac audio/aacp" },
+    { SniffMPEG2PS, "mpg mpeg vob", "video/mpeg" },
+};
+
+// Returns true if "token" is one of the space separated words in "list".
+static bool ListContains(const char *list, const char *token) {
+    size_t tokenLen = strlen(token);
+    if (tokenLen == 0) {
+        return false;
+    }
+
+    while (*list != '\0') {
+        const char *end = strchr(list, ' ');
+        size_t len = (end != NULL) ? end - list : strlen(list);
+
+        if (len == tokenLen && !strncasecmp(list, token, len)) {
+            return true;
+        }
+
+        if (end == NULL) {
+            break;
+        }
+        list = end + 1;
+    }
+
+    return false;
+}
+
+static bool IsHinted(
+        DataSource::SnifferFunc func,
+        const String8 &extension, const String8 &mimeType) {
+    for (size_t i = 0; i < sizeof(kSnifferHints) / sizeof(kSnifferHints[0]);
+            ++i) {
+        if (kSnifferHints[i].mSniffer == func) {
+            return ListContains(kSnifferHints[i].mExtensions, extension.string())
+                || ListContains(kSnifferHints[i].mMIMETypes, mimeType.string());
+        }
+    }
+
+    return false;
+}
+
+// Sniffers that get to run even after a confident match, their verdicts
+// (DRM, widevine, vendor overrides) take precedence over the container's.
+static bool IsAlwaysRun(DataSource::SnifferFunc func) {
+    return func == SniffDRM
+        || func == SniffWVM
+#ifdef QCOM_HARDWARE
+        || func == ExtendedExtractor::Sniff
+#endif
+        ;
+}
+
 bool DataSource::sniff(
         String8 *mimeType, float *confidence, sp<AMessage> *meta) {
     *mimeType = "";
     *confidence = 0.0f;
     meta->clear();
 
+    Vector<SnifferFunc> sniffers;
+
     {
         Mutex::Autolock autoLock(gSnifferMutex);
         if (!gSniffersRegistered) {
             return false;
         }
+
+        for (List<SnifferFunc>::iterator it = gSniffers.begin();
+             it != gSniffers.end(); ++it) {
+            sniffers.push(*it);
+        }
     }
 
-    for (List<SnifferFunc>::iterator it = gSniffers.begin();
-         it != gSniffers.end(); ++it) {
+    // Extension of the last path component, ignoring any query.
+    String8 extension;
+    {
+        String8 uri = getUri();
+        const char *path = uri.string();
+        const char *query = strchr(path, '?');
+        String8 tmp(path, query != NULL ? query - path : strlen(path));
+
+        const char *slash = strrchr(tmp.string(), '/');
+        const char *dot = strrchr(tmp.string(), '.');
+        if (dot != NULL && (slash == NULL || dot > slash)) {
+            extension.setTo(dot + 1);
+        }
+    }
+
+    // Content type without parameters such as "; charset=".
+    String8 contentType = getMIMEType();
+    {
+        const char *semicolon = strchr(contentType.string(), ';');
+        if (semicolon != NULL) {
+            contentType.setTo(
+                    contentType.string(), semicolon - contentType.string());
+        }
+    }
+
+    // Hinted sniffers first, then the others in registration order, the
+    // ones that always run last.
+    Vector<SnifferFunc> ordered;
+    for (size_t pass = 0; pass < 3; ++pass) {
+        for (size_t i = 0; i < sniffers.size(); ++i) {
+            SnifferFunc func = sniffers[i];
+
+            size_t funcPass;
+            if (IsAlwaysRun(func)) {
+                funcPass = 2;
+            } else if (IsHinted(func, extension, contentType)) {
+                funcPass = 0;
+            } else {
+                funcPass = 1;
+            }
+
+            if (funcPass == pass) {
+                ordered.push(func);
+            }
+        }
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    sp<SniffingSource> source = new SniffingSource(this, kSniffWindowSize);
+
+    size_t numRun = 0;
+    for (size_t i = 0; i < ordered.size(); ++i) {
+        SnifferFunc func = ordered[i];
+
+        if (*confidence >= kShortCircuitConfidence && !IsAlwaysRun(func)) {
+            continue;
+        }
+
+        ++numRun;
+
         String8 newMimeType;
         float newConfidence;
         sp<AMessage> newMeta;
-        if ((*it)(this, &newMimeType, &newConfidence, &newMeta)) {
+        if ((*func)(source, &newMimeType, &newConfidence, &newMeta)) {
             if (newConfidence > *confidence) {
                 *mimeType = newMimeType;
                 *confidence = newConfidence;
@@ -139,6 +289,12 @@ bool DataSource::sniff(
         }
     }
 
+    ALOGV("sniffed '%s' (%.2f) in %lld us, ran %d of %d sniffers, "
+          "%d reads of which %d went to the source",
+          mimeType->string(), *confidence, ALooper::GetNowUs() - startUs,
+          numRun, ordered.size(),
+          source->numReads(), source->numForwardedReads());
+
     return *confidence > 0.0;
 }
 
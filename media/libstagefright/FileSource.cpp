@@ -14,8 +14,15 @@
  * limitations under the License.
  */
 
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FileSource"
+#include <utils/Log.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/FileSource.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -24,6 +31,23 @@
 
 namespace android {
 
+// Files larger than this are never mapped, to stay clear of address space
+// exhaustion in 32-bit processes.
+static const int64_t kMaxMmapSize = 128ll * 1024 * 1024;
+
+// static
+uint32_t FileSource::DefaultFlags() {
+    uint32_t flags = kFlagReadAheadCache;
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.stagefright.filesource-mmap", value, NULL)
+            && (!strcmp(value, "1") || !strcasecmp(value, "true"))) {
+        flags |= kFlagMmap;
+    }
+
+    return flags;
+}
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
@@ -33,14 +57,21 @@ FileSource::FileSource(const char *filename)
       mDrmBufOffset(0),
       mDrmBufSize(0),
       mDrmBuf(NULL){
+    openFile(filename);
+    init(DefaultFlags());
+}
 
-    mFd = open(filename, O_LARGEFILE | O_RDONLY);
-
-    if (mFd >= 0) {
-        mLength = lseek64(mFd, 0, SEEK_END);
-    } else {
-        ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
-    }
+FileSource::FileSource(const char *filename, uint32_t flags)
+    : mFd(-1),
+      mOffset(0),
+      mLength(-1),
+      mDecryptHandle(NULL),
+      mDrmManagerClient(NULL),
+      mDrmBufOffset(0),
+      mDrmBufSize(0),
+      mDrmBuf(NULL){
+    openFile(filename);
+    init(flags);
 }
 
 FileSource::FileSource(int fd, int64_t offset, int64_t length)
@@ -54,9 +85,105 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
       mDrmBuf(NULL){
     CHECK(offset >= 0);
     CHECK(length >= 0);
+
+    mNumSyscalls = 0;
+    init(DefaultFlags());
+}
+
+FileSource::FileSource(int fd, int64_t offset, int64_t length, uint32_t flags)
+    : mFd(fd),
+      mOffset(offset),
+      mLength(length),
+      mDecryptHandle(NULL),
+      mDrmManagerClient(NULL),
+      mDrmBufOffset(0),
+      mDrmBufSize(0),
+      mDrmBuf(NULL){
+    CHECK(offset >= 0);
+    CHECK(length >= 0);
+
+    mNumSyscalls = 0;
+    init(flags);
+}
+
+void FileSource::openFile(const char *filename) {
+    mUri.setTo(filename);
+
+    mNumSyscalls = 1;
+    mFd = open(filename, O_LARGEFILE | O_RDONLY);
+
+    if (mFd >= 0) {
+        ++mNumSyscalls;
+        mLength = lseek64(mFd, 0, SEEK_END);
+    } else {
+        ALOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
+    }
+}
+
+void FileSource::init(uint32_t flags) {
+    mMapBase = NULL;
+    mMapSize = 0;
+    mMapData = NULL;
+
+    mUseCache = (flags & kFlagReadAheadCache) != 0;
+    mCacheClock = 0;
+
+    for (size_t i = 0; i < kNumCacheBlocks; ++i) {
+        CacheBlock *block = &mCacheBlocks[i];
+        block->mOffset = -1;
+        block->mSize = 0;
+        block->mLastUsed = 0;
+        block->mData = NULL;
+    }
+
+    mNumReads = 0;
+    mNumCacheHits = 0;
+
+    if (mFd >= 0 && (flags & kFlagMmap)) {
+        initMmap();
+    }
+}
+
+void FileSource::initMmap() {
+    if (mLength <= 0 || mLength > kMaxMmapSize) {
+        return;
+    }
+
+    // mmap() wants a page aligned file offset.
+    off64_t pageSize = sysconf(_SC_PAGESIZE);
+    off64_t mapOffset = mOffset - (mOffset % pageSize);
+    size_t delta = mOffset - mapOffset;
+
+    ++mNumSyscalls;
+    void *base = mmap64(
+            NULL, mLength + delta, PROT_READ, MAP_SHARED, mFd, mapOffset);
+
+    if (base == MAP_FAILED) {
+        ALOGW("Failed to map %lld bytes at offset %lld, using pread. (%s)",
+              mLength, mOffset, strerror(errno));
+        return;
+    }
+
+    mMapBase = base;
+    mMapSize = mLength + delta;
+    mMapData = (const uint8_t *)base + delta;
 }
 
 FileSource::~FileSource() {
+    ALOGV("%d reads, %d served from cache, %d syscalls",
+          mNumReads, mNumCacheHits, mNumSyscalls);
+
+    if (mMapBase != NULL) {
+        munmap(mMapBase, mMapSize);
+        mMapBase = NULL;
+        mMapData = NULL;
+    }
+
+    for (size_t i = 0; i < kNumCacheBlocks; ++i) {
+        delete[] mCacheBlocks[i].mData;
+        mCacheBlocks[i].mData = NULL;
+    }
+
     if (mFd >= 0) {
         close(mFd);
         mFd = -1;
@@ -89,8 +216,6 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
         return NO_INIT;
     }
 
-    Mutex::Autolock autoLock(mLock);
-
     if (mLength >= 0) {
         if (offset >= mLength) {
             return 0;  // read beyond EOF.
@@ -101,18 +226,123 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
         }
     }
 
+    android_atomic_inc(&mNumReads);
+
     if (mDecryptHandle != NULL && DecryptApiType::CONTAINER_BASED
             == mDecryptHandle->decryptApiType) {
+        Mutex::Autolock autoLock(mLock);
         return readAtDRM(offset, data, size);
-   } else {
-        off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
-        if (result == -1) {
-            ALOGE("seek to %lld failed", offset + mOffset);
-            return UNKNOWN_ERROR;
+    }
+
+    if (mMapData != NULL) {
+        // mLength is known here, the range was clamped above.
+        memcpy(data, mMapData + offset, size);
+        return size;
+    }
+
+    if (mUseCache && size <= kMaxCachedReadSize) {
+        return readAtCached(offset, data, size);
+    }
+
+    return preadFully(offset, data, size);
+}
+
+ssize_t FileSource::preadFully(off64_t offset, void *data, size_t size) {
+    size_t numRead = 0;
+    while (numRead < size) {
+        android_atomic_inc(&mNumSyscalls);
+
+        ssize_t n = pread64(
+                mFd, (uint8_t *)data + numRead, size - numRead,
+                offset + mOffset + numRead);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            ALOGE("read at %lld failed. (%s)",
+                  offset + mOffset + numRead, strerror(errno));
+
+            return numRead > 0 ? (ssize_t)numRead : UNKNOWN_ERROR;
+        } else if (n == 0) {
+            break;
         }
 
-        return ::read(mFd, data, size);
+        numRead += n;
     }
+
+    return numRead;
+}
+
+ssize_t FileSource::readAtCached(off64_t offset, void *data, size_t size) {
+    Mutex::Autolock autoLock(mCacheLock);
+
+    size_t numCopied = 0;
+    bool hit = true;
+
+    while (numCopied < size) {
+        off64_t blockOffset =
+            (offset + numCopied) - (offset + numCopied) % kCacheBlockSize;
+
+        CacheBlock *block = NULL;
+        CacheBlock *victim = &mCacheBlocks[0];
+
+        for (size_t i = 0; i < kNumCacheBlocks; ++i) {
+            CacheBlock *candidate = &mCacheBlocks[i];
+
+            if (candidate->mOffset == blockOffset) {
+                block = candidate;
+                break;
+            }
+
+            if (candidate->mLastUsed < victim->mLastUsed) {
+                victim = candidate;
+            }
+        }
+
+        if (block == NULL) {
+            hit = false;
+
+            block = victim;
+            if (block->mData == NULL) {
+                block->mData = new uint8_t[kCacheBlockSize];
+            }
+
+            block->mOffset = -1;
+
+            ssize_t n = preadFully(blockOffset, block->mData, kCacheBlockSize);
+            if (n < 0) {
+                return numCopied > 0 ? (ssize_t)numCopied : n;
+            }
+
+            block->mOffset = blockOffset;
+            block->mSize = n;
+        }
+
+        block->mLastUsed = ++mCacheClock;
+
+        size_t offsetInBlock = (offset + numCopied) - blockOffset;
+        if ((ssize_t)offsetInBlock >= block->mSize) {
+            break;  // short block, end of file.
+        }
+
+        size_t copy = block->mSize - offsetInBlock;
+        if (copy > size - numCopied) {
+            copy = size - numCopied;
+        }
+
+        memcpy((uint8_t *)data + numCopied,
+               block->mData + offsetInBlock, copy);
+
+        numCopied += copy;
+    }
+
+    if (hit) {
+        android_atomic_inc(&mNumCacheHits);
+    }
+
+    return numCopied;
 }
 
 status_t FileSource::getSize(off64_t *size) {
@@ -155,6 +385,16 @@ void FileSource::getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client
     *client = mDrmManagerClient;
 }
 
+String8 FileSource::getUri() {
+    return mUri;
+}
+
+void FileSource::getStats(Stats *stats) const {
+    stats->mNumReads = mNumReads;
+    stats->mNumCacheHits = mNumCacheHits;
+    stats->mNumSyscalls = mNumSyscalls;
+}
+
 ssize_t FileSource::readAtDRM(off64_t offset, void *data, size_t size) {
     size_t DRM_CACHE_SIZE = 1024;
     if (mDrmBuf == NULL) {
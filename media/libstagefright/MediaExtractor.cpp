@@ -32,6 +32,7 @@
 
 #include "matroska/MatroskaExtractor.h"
 
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaDefs.h>
@@ -58,6 +59,9 @@ sp<MediaExtractor> MediaExtractor::Create(
         const sp<DataSource> &source, const char *mime) {
     sp<AMessage> meta;
 
+    int64_t startUs = ALooper::GetNowUs();
+    int64_t sniffUs = 0;
+
     String8 tmp;
     if (mime == NULL) {
         float confidence;
@@ -70,6 +74,8 @@ sp<MediaExtractor> MediaExtractor::Create(
         mime = tmp.string();
         ALOGV("Autodetected media content as '%s' with confidence %.2f",
              mime, confidence);
+
+        sniffUs = ALooper::GetNowUs() - startUs;
     }
 
     bool isDrm = false;
@@ -128,6 +134,16 @@ sp<MediaExtractor> MediaExtractor::Create(
        } else {
            ret->setDrmFlag(false);
        }
+
+       uint32_t sourceFlags = source->flags();
+
+       ALOGV("created '%s' extractor for %s source in %.2f ms "
+             "(sniffing %.2f ms)",
+             mime,
+             (sourceFlags & DataSource::kIsCachingDataSource) ? "cached"
+                : (sourceFlags & DataSource::kIsHTTPBasedSource) ? "http"
+                : "local",
+             (ALooper::GetNowUs() - startUs) / 1E3, sniffUs / 1E3);
     }
 
 #ifdef QCOM_HARDWARE
@@ -25,6 +25,11 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaErrors.h>
+#include <utils/KeyedVector.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 namespace android {
 
@@ -43,10 +48,18 @@ struct PageCache {
     void appendPage(Page *page);
     size_t releaseFromStart(size_t maxBytes);
 
+    // Removes the first page and hands it to the caller, unless it holds
+    // more than "maxBytes".
+    Page *detachFirstPage(size_t maxBytes);
+
     size_t totalSize() const {
         return mTotalSize;
     }
 
+    size_t pageSize() const {
+        return mPageSize;
+    }
+
     void copy(size_t from, void *data, size_t size);
 
 private:
@@ -134,6 +147,24 @@ size_t PageCache::releaseFromStart(size_t maxBytes) {
     return bytesReleased;
 }
 
+PageCache::Page *PageCache::detachFirstPage(size_t maxBytes) {
+    if (mActivePages.empty()) {
+        return NULL;
+    }
+
+    List<Page *>::iterator it = mActivePages.begin();
+    Page *page = *it;
+
+    if (page->mSize > maxBytes) {
+        return NULL;
+    }
+
+    mActivePages.erase(it);
+    mTotalSize -= page->mSize;
+
+    return page;
+}
+
 void PageCache::copy(size_t from, void *data, size_t size) {
     ALOGV("copy from %d size %d", from, size);
 
@@ -177,6 +208,405 @@ void PageCache::copy(size_t from, void *data, size_t size) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Pages that dropped out of the prefetch window, kept around by absolute
+// offset so that seeking back to them doesn't fetch them again. Entries
+// never overlap each other. Least recently used pages are evicted first,
+// pages near the head and tail of the stream (where the moov atom of an
+// MP4 file lives) only once nothing else is left. Evicted pages are
+// optionally written to a page sized slot of an unlinked spill file instead
+// of being dropped.
+struct RangeCache {
+    RangeCache(PageCache *pageCache);
+    ~RangeCache();
+
+    void setMaxBytes(size_t maxBytes);
+    void setPinnedRegions(off64_t headSize, off64_t tailOffset);
+    void enableSpill(const char *dir, size_t maxBytes);
+
+    // Takes ownership of "page", replacing whatever overlaps it.
+    void insert(off64_t offset, PageCache::Page *page);
+
+    // Succeeds only if [offset, offset + size) is completely cached.
+    bool read(off64_t offset, void *data, size_t size, bool *fromSpill);
+
+    // Number of contiguously cached bytes starting at "offset" and the
+    // offset of the first cached byte at or after it.
+    size_t contiguousSizeAt(off64_t offset) const;
+    off64_t nextCachedOffset(off64_t offset) const;
+
+    // Start of the cached page containing "offset", -1 if there is none.
+    off64_t startOfPageContaining(off64_t offset) const;
+
+    // Returns the page starting at "offset" and forgets about it, pages
+    // read back from the spill file are taken from the page cache.
+    PageCache::Page *removeAt(off64_t offset);
+
+    // Drops everything overlapping the range, returns the bytes dropped.
+    size_t removeOverlapping(off64_t offset, size_t size);
+
+    size_t memorySize() const { return mMemorySize; }
+    size_t spillSize() const { return mSpillSize; }
+
+private:
+    struct Entry {
+        PageCache::Page *mPage;  // NULL if the data is in the spill file
+        size_t mSpillSlot;
+        size_t mSize;
+        uint32_t mLastUsed;
+    };
+
+    PageCache *mPageCache;
+    KeyedVector<off64_t, Entry> mEntries;
+
+    size_t mMaxBytes;
+    size_t mMemorySize;
+    off64_t mPinnedHeadSize;
+    off64_t mPinnedTailOffset;
+    uint32_t mClock;
+
+    int mSpillFd;
+    size_t mMaxSpillSlots;
+    size_t mNumSpillSlots;
+    Vector<size_t> mFreeSpillSlots;
+    size_t mSpillSize;
+
+    ssize_t indexOfEntryContaining(off64_t offset) const;
+    bool isPinned(off64_t offset, size_t size) const;
+    bool spill(Entry *entry);
+    ssize_t readSpilled(const Entry &entry, size_t delta, void *data, size_t size);
+    void removeEntryAt(size_t index);
+    void evictIfNecessary();
+
+    DISALLOW_EVIL_CONSTRUCTORS(RangeCache);
+};
+
+RangeCache::RangeCache(PageCache *pageCache)
+    : mPageCache(pageCache),
+      mMaxBytes(0),
+      mMemorySize(0),
+      mPinnedHeadSize(0),
+      mPinnedTailOffset(-1),
+      mClock(0),
+      mSpillFd(-1),
+      mMaxSpillSlots(0),
+      mNumSpillSlots(0),
+      mSpillSize(0) {
+}
+
+RangeCache::~RangeCache() {
+    while (!mEntries.isEmpty()) {
+        removeEntryAt(mEntries.size() - 1);
+    }
+
+    if (mSpillFd >= 0) {
+        close(mSpillFd);
+        mSpillFd = -1;
+    }
+}
+
+void RangeCache::setMaxBytes(size_t maxBytes) {
+    mMaxBytes = maxBytes;
+    evictIfNecessary();
+}
+
+void RangeCache::setPinnedRegions(off64_t headSize, off64_t tailOffset) {
+    mPinnedHeadSize = headSize;
+    mPinnedTailOffset = tailOffset;
+}
+
+void RangeCache::enableSpill(const char *dir, size_t maxBytes) {
+    String8 path(dir);
+    path.append("/NuCachedSource2-XXXXXX");
+
+    int fd = mkstemp(path.lockBuffer(path.size()));
+    path.unlockBuffer();
+
+    if (fd < 0) {
+        ALOGW("Unable to create spill file in '%s'. (%s)",
+              dir, strerror(errno));
+        return;
+    }
+
+    // Nobody else needs to see it, the space is reclaimed on close.
+    unlink(path.string());
+
+    mSpillFd = fd;
+    mMaxSpillSlots = maxBytes / mPageCache->pageSize();
+}
+
+bool RangeCache::spill(Entry *entry) {
+    if (mSpillFd < 0) {
+        return false;
+    }
+
+    size_t slot;
+    if (!mFreeSpillSlots.isEmpty()) {
+        slot = mFreeSpillSlots.top();
+        mFreeSpillSlots.pop();
+    } else if (mNumSpillSlots < mMaxSpillSlots) {
+        slot = mNumSpillSlots++;
+    } else {
+        return false;
+    }
+
+    off64_t fileOffset = (off64_t)slot * mPageCache->pageSize();
+
+    if (pwrite64(mSpillFd, entry->mPage->mData, entry->mSize, fileOffset)
+            != (ssize_t)entry->mSize) {
+        ALOGW("Failed to spill a page. (%s)", strerror(errno));
+
+        mFreeSpillSlots.push(slot);
+        return false;
+    }
+
+    mMemorySize -= entry->mSize;
+    mSpillSize += entry->mSize;
+
+    mPageCache->releasePage(entry->mPage);
+    entry->mPage = NULL;
+    entry->mSpillSlot = slot;
+
+    return true;
+}
+
+ssize_t RangeCache::readSpilled(
+        const Entry &entry, size_t delta, void *data, size_t size) {
+    off64_t fileOffset =
+        (off64_t)entry.mSpillSlot * mPageCache->pageSize() + delta;
+
+    return pread64(mSpillFd, data, size, fileOffset);
+}
+
+ssize_t RangeCache::indexOfEntryContaining(off64_t offset) const {
+    // Last entry starting at or before "offset".
+    ssize_t lo = 0;
+    ssize_t hi = (ssize_t)mEntries.size() - 1;
+    ssize_t index = -1;
+
+    while (lo <= hi) {
+        ssize_t mid = (lo + hi) / 2;
+        if (mEntries.keyAt(mid) <= offset) {
+            index = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    if (index >= 0
+            && offset < mEntries.keyAt(index)
+                + (off64_t)mEntries.valueAt(index).mSize) {
+        return index;
+    }
+
+    return -1;
+}
+
+bool RangeCache::isPinned(off64_t offset, size_t size) const {
+    return offset < mPinnedHeadSize
+        || (mPinnedTailOffset >= 0
+                && offset + (off64_t)size > mPinnedTailOffset);
+}
+
+void RangeCache::removeEntryAt(size_t index) {
+    const Entry &entry = mEntries.valueAt(index);
+
+    if (entry.mPage != NULL) {
+        mMemorySize -= entry.mSize;
+        mPageCache->releasePage(entry.mPage);
+    } else {
+        mSpillSize -= entry.mSize;
+        mFreeSpillSlots.push(entry.mSpillSlot);
+    }
+
+    mEntries.removeItemsAt(index);
+}
+
+void RangeCache::insert(off64_t offset, PageCache::Page *page) {
+    removeOverlapping(offset, page->mSize);
+
+    Entry entry;
+    entry.mPage = page;
+    entry.mSpillSlot = 0;
+    entry.mSize = page->mSize;
+    entry.mLastUsed = ++mClock;
+
+    mEntries.add(offset, entry);
+    mMemorySize += entry.mSize;
+
+    evictIfNecessary();
+}
+
+void RangeCache::evictIfNecessary() {
+    while (mMemorySize > mMaxBytes) {
+        ssize_t victim = -1;
+        bool victimPinned = true;
+
+        for (size_t i = 0; i < mEntries.size(); ++i) {
+            const Entry &entry = mEntries.valueAt(i);
+            if (entry.mPage == NULL) {
+                continue;
+            }
+
+            bool pinned = isPinned(mEntries.keyAt(i), entry.mSize);
+
+            if (victim < 0
+                    || (victimPinned && !pinned)
+                    || (victimPinned == pinned && entry.mLastUsed
+                            < mEntries.valueAt(victim).mLastUsed)) {
+                victim = i;
+                victimPinned = pinned;
+            }
+        }
+
+        CHECK_GE(victim, 0);
+
+        if (!spill(&mEntries.editValueAt(victim))) {
+            removeEntryAt(victim);
+        }
+    }
+}
+
+bool RangeCache::read(
+        off64_t offset, void *data, size_t size, bool *fromSpill) {
+    *fromSpill = false;
+
+    if (contiguousSizeAt(offset) < size) {
+        return false;
+    }
+
+    while (size > 0) {
+        ssize_t index = indexOfEntryContaining(offset);
+        CHECK_GE(index, 0);
+
+        Entry *entry = &mEntries.editValueAt(index);
+        entry->mLastUsed = ++mClock;
+
+        size_t delta = offset - mEntries.keyAt(index);
+        size_t copy = entry->mSize - delta;
+        if (copy > size) {
+            copy = size;
+        }
+
+        if (entry->mPage != NULL) {
+            memcpy(data, (const uint8_t *)entry->mPage->mData + delta, copy);
+        } else {
+            *fromSpill = true;
+
+            if (readSpilled(*entry, delta, data, copy) != (ssize_t)copy) {
+                ALOGE("Failed to read back spilled data. (%s)",
+                      strerror(errno));
+
+                removeEntryAt(index);
+                return false;
+            }
+        }
+
+        offset += copy;
+        data = (uint8_t *)data + copy;
+        size -= copy;
+    }
+
+    return true;
+}
+
+size_t RangeCache::contiguousSizeAt(off64_t offset) const {
+    ssize_t index = indexOfEntryContaining(offset);
+    if (index < 0) {
+        return 0;
+    }
+
+    off64_t end = mEntries.keyAt(index) + mEntries.valueAt(index).mSize;
+
+    while ((size_t)++index < mEntries.size() && mEntries.keyAt(index) == end) {
+        end += mEntries.valueAt(index).mSize;
+    }
+
+    return end - offset;
+}
+
+off64_t RangeCache::nextCachedOffset(off64_t offset) const {
+    if (indexOfEntryContaining(offset) >= 0) {
+        return offset;
+    }
+
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        if (mEntries.keyAt(i) > offset) {
+            return mEntries.keyAt(i);
+        }
+    }
+
+    return -1;
+}
+
+off64_t RangeCache::startOfPageContaining(off64_t offset) const {
+    ssize_t index = indexOfEntryContaining(offset);
+    return index >= 0 ? mEntries.keyAt(index) : -1;
+}
+
+PageCache::Page *RangeCache::removeAt(off64_t offset) {
+    ssize_t index = mEntries.indexOfKey(offset);
+    if (index < 0) {
+        return NULL;
+    }
+
+    const Entry &entry = mEntries.valueAt(index);
+    PageCache::Page *page = entry.mPage;
+
+    if (page != NULL) {
+        // Ownership passes to the caller.
+        mMemorySize -= entry.mSize;
+        mEntries.removeItemsAt(index);
+        return page;
+    }
+
+    page = mPageCache->acquirePage();
+
+    if (readSpilled(entry, 0, page->mData, entry.mSize)
+            != (ssize_t)entry.mSize) {
+        ALOGE("Failed to read back spilled data. (%s)", strerror(errno));
+
+        mPageCache->releasePage(page);
+        page = NULL;
+    } else {
+        page->mSize = entry.mSize;
+    }
+
+    removeEntryAt(index);
+
+    return page;
+}
+
+size_t RangeCache::removeOverlapping(off64_t offset, size_t size) {
+    size_t removed = 0;
+
+    size_t i = 0;
+    while (i < mEntries.size()) {
+        off64_t start = mEntries.keyAt(i);
+        off64_t end = start + mEntries.valueAt(i).mSize;
+
+        if (start >= offset + (off64_t)size) {
+            break;
+        }
+
+        if (end > offset) {
+            off64_t overlapStart = start > offset ? start : offset;
+            off64_t overlapEnd = end < offset + (off64_t)size
+                ? end : offset + (off64_t)size;
+
+            removed += overlapEnd - overlapStart;
+            removeEntryAt(i);
+            continue;
+        }
+
+        ++i;
+    }
+
+    return removed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 NuCachedSource2::NuCachedSource2(
         const sp<DataSource> &source,
         const char *cacheConfig,
@@ -185,6 +615,7 @@ NuCachedSource2::NuCachedSource2(
       mReflector(new AHandlerReflector<NuCachedSource2>(this)),
       mLooper(new ALooper),
       mCache(new PageCache(kPageSize)),
+      mRangeCache(new RangeCache(mCache)),
       mCacheOffset(0),
       mFinalStatus(OK),
       mLastAccessPos(0),
@@ -194,18 +625,37 @@ NuCachedSource2::NuCachedSource2(
       mHighwaterThresholdBytes(kDefaultHighWaterThreshold),
       mLowwaterThresholdBytes(kDefaultLowWaterThreshold),
       mKeepAliveIntervalUs(kDefaultKeepAliveIntervalUs),
-      mDisconnectAtHighwatermark(disconnectAtHighwatermark) {
+      mDisconnectAtHighwatermark(disconnectAtHighwatermark),
+      mNumReads(0),
+      mNumWindowHits(0),
+      mNumRetainedHits(0),
+      mNumSpillHits(0),
+      mBytesFetched(0),
+      mBytesRefetched(0),
+      mBytesAdopted(0) {
     // We are NOT going to support disconnect-at-highwatermark indefinitely
     // and we are not guaranteeing support for client-specified cache
     // parameters. Both of these are temporary measures to solve a specific
     // problem that will be solved in a better way going forward.
 
+    mRangeCache->setMaxBytes(kDefaultRetainedBytes);
+
     updateCacheParamsFromSystemProperty();
 
     if (cacheConfig != NULL) {
         updateCacheParamsFromString(cacheConfig);
     }
 
+    updateSpillParamsFromSystemProperty();
+
+    off64_t size;
+    if (mSource->getSize(&size) == OK && size > kPinnedRegionSize) {
+        mRangeCache->setPinnedRegions(
+                kPinnedRegionSize, size - kPinnedRegionSize);
+    } else {
+        mRangeCache->setPinnedRegions(kPinnedRegionSize, -1);
+    }
+
     if (mDisconnectAtHighwatermark) {
         // Makes no sense to disconnect and do keep-alives...
         mKeepAliveIntervalUs = 0;
@@ -223,6 +673,10 @@ NuCachedSource2::~NuCachedSource2() {
     mLooper->stop();
     mLooper->unregisterHandler(mReflector->id());
 
+    // Hands its pages back to mCache.
+    delete mRangeCache;
+    mRangeCache = NULL;
+
     delete mCache;
     mCache = NULL;
 }
@@ -311,10 +765,37 @@ void NuCachedSource2::fetchInternal() {
         }
     }
 
+    off64_t fetchOffset;
+    size_t fetchSize = kPageSize;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        fetchOffset = mCacheOffset + mCache->totalSize();
+
+        // Data we had before is put back into the window instead of
+        // being downloaded again.
+        PageCache::Page *page = mRangeCache->removeAt(fetchOffset);
+        if (page != NULL) {
+            mBytesAdopted += page->mSize;
+            mCache->appendPage(page);
+            return;
+        }
+
+        // Stop short of a long enough run of such data, so that the next
+        // fetch starts exactly where it does.
+        off64_t nextCachedOffset = mRangeCache->nextCachedOffset(fetchOffset);
+        if (nextCachedOffset > fetchOffset
+                && nextCachedOffset < fetchOffset + (off64_t)fetchSize
+                && mRangeCache->contiguousSizeAt(nextCachedOffset)
+                        >= kMinAdoptedRunSize) {
+            fetchSize = nextCachedOffset - fetchOffset;
+        }
+    }
+
     PageCache::Page *page = mCache->acquirePage();
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    ssize_t n = mSource->readAt(fetchOffset, page->mData, fetchSize);
 
     Mutex::Autolock autoLock(mLock);
 
@@ -344,6 +825,9 @@ void NuCachedSource2::fetchInternal() {
 
         page->mSize = n;
         mCache->appendPage(page);
+
+        mBytesFetched += n;
+        mBytesRefetched += mRangeCache->removeOverlapping(fetchOffset, n);
     }
 }
 
@@ -454,8 +938,7 @@ void NuCachedSource2::restartPrefetcherIfNecessary_l(
         maxBytes -= kGrayArea;
     }
 
-    size_t actualBytes = mCache->releaseFromStart(maxBytes);
-    mCacheOffset += actualBytes;
+    releaseFromStart_l(maxBytes);
 
     ALOGI("restarting prefetcher, totalSize = %d", mCache->totalSize());
     mFetching = true;
@@ -468,6 +951,8 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
     Mutex::Autolock autoLock(mLock);
 
+    ++mNumReads;
+
     // If the request can be completely satisfied from the cache, do so.
 
     if (offset >= mCacheOffset
@@ -477,6 +962,13 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
 
         mLastAccessPos = offset + size;
 
+        ++mNumWindowHits;
+        return size;
+    }
+
+    // Data outside the window doesn't move the read position the
+    // prefetcher works from.
+    if (readFromRangeCache_l(offset, data, size)) {
         return size;
     }
 
@@ -536,6 +1028,10 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
 
     Mutex::Autolock autoLock(mLock);
 
+    if (readFromRangeCache_l(offset, data, size)) {
+        return size;
+    }
+
     if (!mFetching) {
         mLastAccessPos = offset;
         restartPrefetcherIfNecessary_l(
@@ -595,10 +1091,13 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
 
     ALOGI("new range: offset= %lld", offset);
 
-    mCacheOffset = offset;
-
     size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
+    CHECK_EQ(releaseFromStart_l(totalSize), totalSize);
+
+    // Line the new window up with any retained page it starts in, so that
+    // the fetcher can take the pages over one by one.
+    off64_t pageOffset = mRangeCache->startOfPageContaining(offset);
+    mCacheOffset = (pageOffset >= 0) ? pageOffset : offset;
 
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
@@ -606,6 +1105,64 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
     return OK;
 }
 
+size_t NuCachedSource2::releaseFromStart_l(size_t maxBytes) {
+    size_t bytesReleased = 0;
+
+    PageCache::Page *page;
+    while ((page = mCache->detachFirstPage(maxBytes - bytesReleased))
+            != NULL) {
+        size_t pageSize = page->mSize;
+
+        mRangeCache->insert(mCacheOffset + bytesReleased, page);
+        bytesReleased += pageSize;
+    }
+
+    mCacheOffset += bytesReleased;
+
+    return bytesReleased;
+}
+
+bool NuCachedSource2::readFromRangeCache_l(
+        off64_t offset, void *data, size_t size) {
+    bool fromSpill;
+    if (!mRangeCache->read(offset, data, size, &fromSpill)) {
+        return false;
+    }
+
+    if (fromSpill) {
+        ++mNumSpillHits;
+    } else {
+        ++mNumRetainedHits;
+    }
+
+    return true;
+}
+
+void NuCachedSource2::dump(String8 *result) const {
+    Mutex::Autolock autoLock(mLock);
+
+    double percent = mNumReads > 0 ? 100.0 / mNumReads : 0.0;
+
+    result->appendFormat(
+            "  NuCachedSource2: window(%lld..%lld), "
+            "retained(%d bytes in memory, %d bytes spilled)\n",
+            mCacheOffset, mCacheOffset + mCache->totalSize(),
+            mRangeCache->memorySize(), mRangeCache->spillSize());
+
+    result->appendFormat(
+            "   reads(%lld), hits: window(%.1f%%), retained(%.1f%%), "
+            "spilled(%.1f%%)\n",
+            mNumReads,
+            mNumWindowHits * percent,
+            mNumRetainedHits * percent,
+            mNumSpillHits * percent);
+
+    result->appendFormat(
+            "   fetched(%lld bytes), refetched(%lld bytes), "
+            "reused(%lld bytes)\n",
+            mBytesFetched, mBytesRefetched, mBytesAdopted);
+}
+
 void NuCachedSource2::resumeFetchingIfNecessary() {
     Mutex::Autolock autoLock(mLock);
 
@@ -638,15 +1195,25 @@ void NuCachedSource2::updateCacheParamsFromSystemProperty() {
 }
 
 void NuCachedSource2::updateCacheParamsFromString(const char *s) {
-    ssize_t lowwaterMarkKb, highwaterMarkKb;
+    ssize_t lowwaterMarkKb, highwaterMarkKb, retainedKb;
     int keepAliveSecs;
 
-    if (sscanf(s, "%ld/%ld/%d",
-               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs) != 3) {
+    // The size of the range cache is an optional fourth field.
+    int numFields = sscanf(s, "%ld/%ld/%d/%ld",
+               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs,
+               &retainedKb);
+
+    if (numFields != 3 && numFields != 4) {
         ALOGE("Failed to parse cache parameters from '%s'.", s);
         return;
     }
 
+    if (numFields == 4 && retainedKb >= 0) {
+        mRangeCache->setMaxBytes(retainedKb * 1024);
+    } else {
+        mRangeCache->setMaxBytes(kDefaultRetainedBytes);
+    }
+
     if (lowwaterMarkKb >= 0) {
         mLowwaterThresholdBytes = lowwaterMarkKb * 1024;
     } else {
@@ -678,6 +1245,16 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
          mKeepAliveIntervalUs);
 }
 
+void NuCachedSource2::updateSpillParamsFromSystemProperty() {
+    char value[PROPERTY_VALUE_MAX];
+    if (!property_get("media.stagefright.cache-spill-dir", value, NULL)
+            || value[0] == '\0') {
+        return;
+    }
+
+    mRangeCache->enableSpill(value, kDefaultMaxSpillBytes);
+}
+
 // static
 void NuCachedSource2::RemoveCacheSpecificHeaders(
         KeyedVector<String8, String8> *headers,
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SniffingSource"
+#include <utils/Log.h>
+
+#include "include/SniffingSource.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+SniffingSource::SniffingSource(
+        const sp<DataSource> &source, size_t windowSize)
+    : mSource(source),
+      mWindow(new uint8_t[windowSize]),
+      mWindowCapacity(windowSize),
+      mWindowSize(0),
+      mReachedEOS(false),
+      mNumReads(0),
+      mNumForwardedReads(0) {
+}
+
+SniffingSource::~SniffingSource() {
+    delete[] mWindow;
+    mWindow = NULL;
+}
+
+ssize_t SniffingSource::readAt(off64_t offset, void *data, size_t size) {
+    ++mNumReads;
+
+    if (offset < 0 || offset > mWindowSize) {
+        ++mNumForwardedReads;
+        return mSource->readAt(offset, data, size);
+    }
+
+    off64_t end = offset + (off64_t)size;
+    if (end > mWindowSize && !mReachedEOS) {
+        if (end > (off64_t)mWindowCapacity) {
+            ++mNumForwardedReads;
+            return mSource->readAt(offset, data, size);
+        }
+
+        // Only fetch what was asked for, the source may be slow to
+        // deliver anything beyond it.
+        ++mNumForwardedReads;
+        ssize_t n = mSource->readAt(
+                mWindowSize, &mWindow[mWindowSize], end - mWindowSize);
+
+        if (n < 0) {
+            return n;
+        }
+
+        if (mWindowSize + n < end) {
+            mReachedEOS = true;
+        }
+        mWindowSize += n;
+
+        ALOGV("window extended to %d bytes", mWindowSize);
+    }
+
+    size_t available = end <= mWindowSize ? size : mWindowSize - offset;
+    memcpy(data, &mWindow[offset], available);
+
+    return available;
+}
+
+}  // namespace android
@@ -29,6 +29,8 @@
 #include <media/stagefright/OMXCodec.h>
 #include <media/stagefright/MediaDefs.h>
 
+#include <unistd.h>
+
 namespace android {
 
 StagefrightMetadataRetriever::StagefrightMetadataRetriever()
@@ -293,6 +295,11 @@ static VideoFrame *extractVideoFrameWithCodecFlags(
     ColorConverter converter(
             (OMX_COLOR_FORMATTYPE)srcFormat, OMX_COLOR_Format16bitRGB565);
 
+    // Thumbnails are extracted on the caller's thread, spread the
+    // conversion of large frames over a few more.
+    long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+    converter.setNumThreads(numCores < 1 ? 1 : numCores > 4 ? 4 : numCores);
+
     if (converter.isValid()) {
         err = converter.convert(
                 (const uint8_t *)buffer->data() + buffer->range_offset(),
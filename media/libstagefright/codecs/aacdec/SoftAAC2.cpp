@@ -62,6 +62,7 @@ SoftAAC2::SoftAAC2(
       mNumSamplesOutput(0),
       mOutputPortSettingsChange(NONE) {
     initPorts();
+    setBatchedQueueing(true);
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
 
@@ -58,6 +58,7 @@ SoftAMR::SoftAMR(
     }
 
     initPorts();
+    setBatchedQueueing(true);
     CHECK_EQ(initDecoder(), (status_t)OK);
 }
 
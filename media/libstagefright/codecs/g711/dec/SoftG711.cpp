@@ -50,6 +50,7 @@ SoftG711::SoftG711(
     }
 
     initPorts();
+    setBatchedQueueing(true);
 }
 
 SoftG711::~SoftG711() {
@@ -51,6 +51,7 @@ SoftMP3::SoftMP3(
       mSignalledError(false),
       mOutputPortSettingsChange(NONE) {
     initPorts();
+    setBatchedQueueing(true);
     initDecoder();
 }
 
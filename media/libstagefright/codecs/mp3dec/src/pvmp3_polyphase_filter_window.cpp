@@ -76,6 +76,10 @@ Input
 #include "pvmp3_dec_defs.h"
 #include "pvmp3_tables.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /*----------------------------------------------------------------------------
 ; MACROS
 ; Define module1 specific macros here
@@ -94,6 +98,115 @@ Input
 ; Function Prototype declaration
 ----------------------------------------------------------------------------*/
 
+#if defined(__SSE2__)
+
+/*
+ *  Per-lane equivalent of fxp_mul32_Q32(), i.e. the upper 32 bits of the
+ *  signed 64-bit product. SSE2 only offers an unsigned 32x32->64 multiply,
+ *  so the signed result is recovered from the unsigned one:
+ *      hi(a*b) = hi(ua*ub) - (a < 0 ? b : 0) - (b < 0 ? a : 0)
+ *  which is bit-exact with the C equivalent for all inputs.
+ */
+static inline __m128i fxp_mul32_Q32_sse2(__m128i a, __m128i b)
+{
+    const __m128i hi_mask = _mm_set_epi32(-1, 0, -1, 0);
+
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    __m128i hi = _mm_or_si128(_mm_srli_epi64(even, 32),
+                              _mm_and_si128(odd, hi_mask));
+
+    hi = _mm_sub_epi32(hi, _mm_and_si128(_mm_srai_epi32(a, 31), b));
+    hi = _mm_sub_epi32(hi, _mm_and_si128(_mm_srai_epi32(b, 31), a));
+
+    return hi;
+}
+
+/*
+ *  Computes output samples j = 1..15 four at a time, one j per lane.
+ *  Samples at synth_buffer[16 + j + 32*m] are contiguous across the lanes,
+ *  samples at synth_buffer[16 - j + 32*m] are contiguous in reverse order,
+ *  and the window rows (16 coefficients per j) are transposed in registers.
+ *  The last group carries a 16th lane whose result is discarded; its reads
+ *  stay within the synthesis buffer and the window table.
+ */
+static void pvmp3_polyphase_filter_window_sse2(int32 *synth_buffer,
+        int16 *outPcm,
+        int32 numChannels)
+{
+    const __m128i rounding = _mm_set1_epi32(0x00000020);
+
+    for (int32 j0 = 1; j0 < SUBBANDS_NUMBER / 2; j0 += 4)
+    {
+        const int32 *winRow = &pqmfSynthWin[(j0 - 1) << 4];
+        const int32 *pt_1   = &synth_buffer[(SUBBANDS_NUMBER >> 1) + j0];
+        const int32 *pt_2   = &synth_buffer[(SUBBANDS_NUMBER >> 1) - j0 - 3];
+
+        __m128i sum1 = rounding;
+        __m128i sum2 = rounding;
+
+        for (int32 k = 0; k < 4; k++)
+        {
+            /* transpose window coefficients 4k..4k+3 of rows j0..j0+3 */
+            __m128i r0 = _mm_loadu_si128((const __m128i *)&winRow[ 0 + 4*k]);
+            __m128i r1 = _mm_loadu_si128((const __m128i *)&winRow[16 + 4*k]);
+            __m128i r2 = _mm_loadu_si128((const __m128i *)&winRow[32 + 4*k]);
+            __m128i r3 = _mm_loadu_si128((const __m128i *)&winRow[48 + 4*k]);
+
+            __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+            __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+            __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+            __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+            __m128i w0 = _mm_unpacklo_epi64(t0, t1);
+            __m128i w1 = _mm_unpackhi_epi64(t0, t1);
+            __m128i w2 = _mm_unpacklo_epi64(t2, t3);
+            __m128i w3 = _mm_unpackhi_epi64(t2, t3);
+
+            __m128i temp1 = _mm_loadu_si128(
+                                (const __m128i *)&pt_1[SUBBANDS_NUMBER*(2*k)]);
+            __m128i temp4 = _mm_loadu_si128(
+                                (const __m128i *)&pt_1[SUBBANDS_NUMBER*(14 - 2*k)]);
+            __m128i temp3 = _mm_shuffle_epi32(_mm_loadu_si128(
+                                (const __m128i *)&pt_2[SUBBANDS_NUMBER*(15 - 2*k)]),
+                                _MM_SHUFFLE(0, 1, 2, 3));
+            __m128i temp2 = _mm_shuffle_epi32(_mm_loadu_si128(
+                                (const __m128i *)&pt_2[SUBBANDS_NUMBER*(2*k + 1)]),
+                                _MM_SHUFFLE(0, 1, 2, 3));
+
+            sum1 = _mm_add_epi32(sum1, fxp_mul32_Q32_sse2(temp1, w0));
+            sum2 = _mm_add_epi32(sum2, fxp_mul32_Q32_sse2(temp3, w0));
+            sum2 = _mm_add_epi32(sum2, fxp_mul32_Q32_sse2(temp1, w1));
+            sum1 = _mm_sub_epi32(sum1, fxp_mul32_Q32_sse2(temp3, w1));
+            sum1 = _mm_add_epi32(sum1, fxp_mul32_Q32_sse2(temp2, w2));
+            sum2 = _mm_sub_epi32(sum2, fxp_mul32_Q32_sse2(temp4, w2));
+            sum2 = _mm_add_epi32(sum2, fxp_mul32_Q32_sse2(temp2, w3));
+            sum1 = _mm_add_epi32(sum1, fxp_mul32_Q32_sse2(temp4, w3));
+        }
+
+        /* _mm_packs_epi32 saturates exactly like saturate16() */
+        int16 pcm[8];
+        _mm_storeu_si128((__m128i *)pcm,
+                         _mm_packs_epi32(_mm_srai_epi32(sum1, 6),
+                                         _mm_srai_epi32(sum2, 6)));
+
+        for (int32 lane = 0; lane < 4; lane++)
+        {
+            int32 j = j0 + lane;
+            if (j >= SUBBANDS_NUMBER / 2)
+            {
+                break;
+            }
+            int32 k = j << (numChannels - 1);
+            outPcm[k] = pcm[lane];
+            outPcm[(numChannels<<5) - k] = pcm[4 + lane];
+        }
+    }
+}
+
+#endif
+
 /*----------------------------------------------------------------------------
 ; LOCAL STORE/BUFFER/POINTER DEFINITIONS
 ; Variable declaration - defined here and used outside this module1
@@ -121,6 +234,13 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
     const int32 *winPtr = pqmfSynthWin;
     int32 i;
 
+#if defined(__SSE2__)
+
+    pvmp3_polyphase_filter_window_sse2(synth_buffer, outPcm, numChannels);
+
+    winPtr += ((SUBBANDS_NUMBER / 2) - 1) << 4;
+
+#else
 
     for (int16 j = 1; j < SUBBANDS_NUMBER / 2; j++)
     {
@@ -200,6 +320,8 @@ void pvmp3_polyphase_filter_window(int32 *synth_buffer,
         outPcm[(numChannels<<5) - k] = saturate16(sum2 >> 6);
     }
 
+#endif
+
 
 
     sum1 = 0x00000020;
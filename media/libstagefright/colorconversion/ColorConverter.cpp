@@ -23,22 +23,242 @@
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/MediaErrors.h>
 
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace android {
 
 enum {
   QOMX_COLOR_FormatYUV420PackedSemiPlanar64x32Tile2m8ka = 0x7FA30C03
 }; 
 
+static const signed kClipMin = -278;
+static const signed kClipMax = 535;
+
 static const size_t NV12TILE_BLOCK_WIDTH = 64;
 static const size_t NV12TILE_BLOCK_HEIGHT = 32;
 static const size_t NV12TILE_BLOCK_SIZE = NV12TILE_BLOCK_WIDTH* NV12TILE_BLOCK_HEIGHT;
 static const size_t NV12TILE_BLOCK_GROUP_SIZE =  NV12TILE_BLOCK_SIZE*4;
 
+// Converts pixels [x, width) of a row, "x" being even.
+template<bool kToRGBA, bool kSwapRB, size_t kUVStep>
+static void ConvertYUV420RowScalar(
+        const uint8_t *kAdjustedClip,
+        const uint8_t *src_y, const uint8_t *src_u, const uint8_t *src_v,
+        size_t x, size_t width, uint8_t *dst) {
+    for (; x < width; x += 2) {
+        // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
+        // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
+        // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
+
+        // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
+        // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
+        // R = .................. + 409/256 * (V - 128)
+
+        // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
+        // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
+        // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
+
+        // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
+        // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
+        // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
+
+        // clip range -278 .. 535
+
+        signed y1 = (signed)src_y[x] - 16;
+        signed y2 = (signed)src_y[x + 1] - 16;
+
+        signed u = (signed)src_u[(x / 2) * kUVStep] - 128;
+        signed v = (signed)src_v[(x / 2) * kUVStep] - 128;
+
+        signed u_b = u * 517;
+        signed u_g = -u * 100;
+        signed v_g = -v * 208;
+        signed v_r = v * 409;
+
+        signed tmp1 = y1 * 298;
+        signed b1 = (tmp1 + u_b) / 256;
+        signed g1 = (tmp1 + v_g + u_g) / 256;
+        signed r1 = (tmp1 + v_r) / 256;
+
+        signed tmp2 = y2 * 298;
+        signed b2 = (tmp2 + u_b) / 256;
+        signed g2 = (tmp2 + v_g + u_g) / 256;
+        signed r2 = (tmp2 + v_r) / 256;
+
+        if (kSwapRB) {
+            signed tmp = r1; r1 = b1; b1 = tmp;
+            tmp = r2; r2 = b2; b2 = tmp;
+        }
+
+        bool hasSecondPixel = (x + 1 < width);
+
+        if (kToRGBA) {
+            uint8_t *rgba = &dst[x * 4];
+            rgba[0] = kAdjustedClip[r1];
+            rgba[1] = kAdjustedClip[g1];
+            rgba[2] = kAdjustedClip[b1];
+            rgba[3] = 0xff;
+
+            if (hasSecondPixel) {
+                rgba[4] = kAdjustedClip[r2];
+                rgba[5] = kAdjustedClip[g2];
+                rgba[6] = kAdjustedClip[b2];
+                rgba[7] = 0xff;
+            }
+            continue;
+        }
+
+        uint32_t rgb1 =
+            ((kAdjustedClip[r1] >> 3) << 11)
+            | ((kAdjustedClip[g1] >> 2) << 5)
+            | (kAdjustedClip[b1] >> 3);
+
+        uint32_t rgb2 =
+            ((kAdjustedClip[r2] >> 3) << 11)
+            | ((kAdjustedClip[g2] >> 2) << 5)
+            | (kAdjustedClip[b2] >> 3);
+
+        uint16_t *dst16 = (uint16_t *)dst;
+        if (hasSecondPixel) {
+            *(uint32_t *)(&dst16[x]) = (rgb2 << 16) | rgb1;
+        } else {
+            dst16[x] = rgb1;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+
+// (x / 256) rounding towards zero, like the scalar code.
+static inline __m128i DivideBy256(__m128i x) {
+    return _mm_srai_epi32(
+            _mm_add_epi32(x, _mm_and_si128(_mm_srai_epi32(x, 31),
+                                           _mm_set1_epi32(255))),
+            8);
+}
+
+// Clamps four 32-bit values of each input to 0..255, as the clip table
+// does, and returns them as eight 16-bit values.
+static inline __m128i ClampTo8Bits(__m128i lo, __m128i hi) {
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+    return _mm_unpacklo_epi8(packed, _mm_setzero_si128());
+}
+
+// Converts the row eight pixels at a time and returns the number of pixels
+// done, the caller finishes the rest. Bit-exact with the scalar path.
+static size_t ConvertYUV420RowSSE2(
+        const uint8_t *src_y, const uint8_t *src_u, const uint8_t *src_v,
+        size_t uvStep, size_t width, bool swapRB, bool toRGBA,
+        uint8_t *dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i kY = _mm_set1_epi16(16);
+    const __m128i kUV = _mm_set1_epi16(128);
+    const __m128i kB = _mm_set_epi16(517, 298, 517, 298, 517, 298, 517, 298);
+    const __m128i kG1 =
+        _mm_set_epi16(-100, 298, -100, 298, -100, 298, -100, 298);
+    const __m128i kG2 = _mm_set_epi16(0, -208, 0, -208, 0, -208, 0, -208);
+    const __m128i kR = _mm_set_epi16(409, 298, 409, 298, 409, 298, 409, 298);
+
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i y = _mm_sub_epi16(
+                _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i *)&src_y[x]), zero),
+                kY);
+
+        // Chroma for 4 pixel pairs, each value duplicated for both pixels.
+        __m128i u, v;
+        if (uvStep == 1) {
+            int32_t u4, v4;
+            memcpy(&u4, &src_u[x / 2], 4);
+            memcpy(&v4, &src_v[x / 2], 4);
+
+            u = _mm_unpacklo_epi8(_mm_cvtsi32_si128(u4), zero);
+            v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v4), zero);
+            u = _mm_unpacklo_epi16(u, u);
+            v = _mm_unpacklo_epi16(v, v);
+        } else {
+            bool uFirst = src_u < src_v;
+            __m128i uv = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64(
+                        (const __m128i *)&(uFirst ? src_u : src_v)[x]),
+                    zero);
+
+            __m128i even = _mm_shufflehi_epi16(
+                    _mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)),
+                    _MM_SHUFFLE(2, 2, 0, 0));
+            __m128i odd = _mm_shufflehi_epi16(
+                    _mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)),
+                    _MM_SHUFFLE(3, 3, 1, 1));
+
+            u = uFirst ? even : odd;
+            v = uFirst ? odd : even;
+        }
+
+        u = _mm_sub_epi16(u, kUV);
+        v = _mm_sub_epi16(v, kUV);
+
+        __m128i yu_lo = _mm_unpacklo_epi16(y, u);
+        __m128i yu_hi = _mm_unpackhi_epi16(y, u);
+        __m128i yv_lo = _mm_unpacklo_epi16(y, v);
+        __m128i yv_hi = _mm_unpackhi_epi16(y, v);
+        __m128i v_lo = _mm_unpacklo_epi16(v, zero);
+        __m128i v_hi = _mm_unpackhi_epi16(v, zero);
+
+        __m128i b = ClampTo8Bits(
+                DivideBy256(_mm_madd_epi16(yu_lo, kB)),
+                DivideBy256(_mm_madd_epi16(yu_hi, kB)));
+
+        __m128i g = ClampTo8Bits(
+                DivideBy256(_mm_add_epi32(_mm_madd_epi16(yu_lo, kG1),
+                                          _mm_madd_epi16(v_lo, kG2))),
+                DivideBy256(_mm_add_epi32(_mm_madd_epi16(yu_hi, kG1),
+                                          _mm_madd_epi16(v_hi, kG2))));
+
+        __m128i r = ClampTo8Bits(
+                DivideBy256(_mm_madd_epi16(yv_lo, kR)),
+                DivideBy256(_mm_madd_epi16(yv_hi, kR)));
+
+        if (swapRB) {
+            __m128i tmp = r;
+            r = b;
+            b = tmp;
+        }
+
+        if (toRGBA) {
+            __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+            __m128i ba = _mm_or_si128(b, _mm_set1_epi16((short)0xff00));
+
+            _mm_storeu_si128((__m128i *)&dst[x * 4],
+                             _mm_unpacklo_epi16(rg, ba));
+            _mm_storeu_si128((__m128i *)&dst[x * 4 + 16],
+                             _mm_unpackhi_epi16(rg, ba));
+        } else {
+            __m128i rgb = _mm_or_si128(
+                    _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+                                 _mm_slli_epi16(_mm_srli_epi16(g, 2), 5)),
+                    _mm_srli_epi16(b, 3));
+
+            _mm_storeu_si128((__m128i *)&dst[x * 2], rgb);
+        }
+    }
+
+    return x;
+}
+
+#endif  // __SSE2__
+
 ColorConverter::ColorConverter(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL) {
+      mClip(NULL),
+      mNumThreads(1) {
 }
 
 ColorConverter::~ColorConverter() {
@@ -47,6 +267,19 @@ ColorConverter::~ColorConverter() {
 }
 
 bool ColorConverter::isValid() const {
+    if (mDstFormat == (OMX_COLOR_FORMATTYPE)OMX_COLOR_Format32BitRGBA8888) {
+        switch (mSrcFormat) {
+            case OMX_COLOR_FormatYUV420Planar:
+            case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+            case OMX_COLOR_FormatYUV420SemiPlanar:
+            case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
     if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
         return false;
     }
@@ -65,6 +298,10 @@ bool ColorConverter::isValid() const {
     }
 }
 
+void ColorConverter::setNumThreads(size_t numThreads) {
+    mNumThreads = numThreads > 0 ? numThreads : 1;
+}
+
 ColorConverter::BitmapParams::BitmapParams(
         void *bits,
         size_t width, size_t height,
@@ -96,7 +333,7 @@ status_t ColorConverter::convert(
         size_t dstWidth, size_t dstHeight,
         size_t dstCropLeft, size_t dstCropTop,
         size_t dstCropRight, size_t dstCropBottom) {
-    if (mDstFormat != OMX_COLOR_Format16bitRGB565) {
+    if (!isValid()) {
         return ERROR_UNSUPPORTED;
     }
 
@@ -221,312 +458,236 @@ status_t ColorConverter::convertYUV420Planar(
         return ERROR_UNSUPPORTED;
     }
 
-    uint8_t *kAdjustedClip = initClip();
+    YUV420Params params;
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
-
-    const uint8_t *src_y =
+    params.mSrcY =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    params.mSrcYStride = src.mWidth;
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
+    params.mSrcU =
+        params.mSrcY + src.mWidth * src.mHeight
         + src.mCropTop * (src.mWidth / 2) + src.mCropLeft / 2;
 
-    const uint8_t *src_v =
-        src_u + (src.mWidth / 2) * (src.mHeight / 2);
-
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
-
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
+    params.mSrcV =
+        params.mSrcU + (src.mWidth / 2) * (src.mHeight / 2);
 
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
+    params.mSrcUVStride = src.mWidth / 2;
+    params.mSrcUVStep = 1;
+    params.mSwapRB = false;
 
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
-
-            // clip range -278 .. 535
-
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
-
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth / 2;
-            src_v += src.mWidth / 2;
-        }
-
-        dst_ptr += dst.mWidth;
-    }
-
-    return OK;
+    return convertYUV420(params, src, dst);
 }
 
 status_t ColorConverter::convertQCOMYUV420SemiPlanar(
         const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
-
     if (!((src.mCropLeft & 1) == 0
             && src.cropWidth() == dst.cropWidth()
             && src.cropHeight() == dst.cropHeight())) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    YUV420Params params;
 
-    const uint8_t *src_y =
+    params.mSrcY =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    params.mSrcYStride = src.mWidth;
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
+    params.mSrcU =
+        params.mSrcY + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
+    params.mSrcV = params.mSrcU + 1;
+    params.mSrcUVStride = src.mWidth;
+    params.mSrcUVStep = 2;
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+    // This format has always been rendered with red and blue swapped.
+    params.mSwapRB = true;
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
-
-        src_y += src.mWidth;
-
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
-
-        dst_ptr += dst.mWidth;
-    }
-
-    return OK;
+    return convertYUV420(params, src, dst);
 }
 
 status_t ColorConverter::convertYUV420SemiPlanar(
         const BitmapParams &src, const BitmapParams &dst) {
     // XXX Untested
 
-    uint8_t *kAdjustedClip = initClip();
-
     if (!((src.mCropLeft & 1) == 0
             && src.cropWidth() == dst.cropWidth()
             && src.cropHeight() == dst.cropHeight())) {
         return ERROR_UNSUPPORTED;
     }
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    YUV420Params params;
 
-    const uint8_t *src_y =
+    params.mSrcY =
         (const uint8_t *)src.mBits + src.mCropTop * src.mWidth + src.mCropLeft;
+    params.mSrcYStride = src.mWidth;
 
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * src.mHeight
+    params.mSrcV =
+        params.mSrcY + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+    params.mSrcU = params.mSrcV + 1;
+    params.mSrcUVStride = src.mWidth;
+    params.mSrcUVStep = 2;
+    params.mSwapRB = true;
 
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
+    return convertYUV420(params, src, dst);
+}
 
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst) {
+    if (!((src.mCropLeft & 1) == 0
+            && src.cropWidth() == dst.cropWidth()
+            && src.cropHeight() == dst.cropHeight())) {
+        return ERROR_UNSUPPORTED;
+    }
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+    YUV420Params params;
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+    params.mSrcY = (const uint8_t *)src.mBits;
+    params.mSrcYStride = src.mWidth;
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
+    params.mSrcU =
+        params.mSrcY + src.mWidth * (src.mHeight - src.mCropTop / 2);
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
+    params.mSrcV = params.mSrcU + 1;
+    params.mSrcUVStride = src.mWidth;
+    params.mSrcUVStep = 2;
+    params.mSwapRB = false;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    return convertYUV420(params, src, dst);
+}
 
-        src_y += src.mWidth;
+struct ColorConverter::RowBand {
+    const ColorConverter *mConverter;
+    const YUV420Params *mParams;
+    size_t mFirstRow;
+    size_t mLastRow;
+    pthread_t mThread;
+};
 
-        if (y & 1) {
-            src_u += src.mWidth;
-        }
+// static
+void *ColorConverter::RowBandThread(void *me) {
+    const RowBand *band = static_cast<const RowBand *>(me);
 
-        dst_ptr += dst.mWidth;
-    }
+    band->mConverter->convertYUV420Rows(
+            *band->mParams, band->mFirstRow, band->mLastRow);
 
-    return OK;
+    return NULL;
 }
 
-status_t ColorConverter::convertTIYUV420PackedSemiPlanar(
+status_t ColorConverter::convertYUV420(
+        YUV420Params &params,
         const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
+    initClip();
 
-    uint16_t *dst_ptr = (uint16_t *)dst.mBits
-        + dst.mCropTop * dst.mWidth + dst.mCropLeft;
+    size_t bytesPerPixel = (mDstFormat == OMX_COLOR_Format16bitRGB565) ? 2 : 4;
 
-    const uint8_t *src_y = (const uint8_t *)src.mBits;
-
-    const uint8_t *src_u =
-        (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
+    params.mDst = (uint8_t *)dst.mBits
+        + (dst.mCropTop * dst.mWidth + dst.mCropLeft) * bytesPerPixel;
+    params.mDstStride = dst.mWidth * bytesPerPixel;
+    params.mWidth = src.cropWidth();
+    params.mHeight = src.cropHeight();
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+    // Bands are kept large enough to amortize thread startup, and start on
+    // even rows so that no two bands share a chroma row.
+    static const size_t kMinRowsPerBand = 64;
 
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+    size_t numBands = mNumThreads;
+    if (numBands > params.mHeight / kMinRowsPerBand) {
+        numBands = params.mHeight / kMinRowsPerBand;
+    }
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
+    if (numBands <= 1) {
+        convertYUV420Rows(params, 0, params.mHeight);
+        return OK;
+    }
 
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+    size_t rowsPerBand = ((params.mHeight / numBands) + 1) & ~1;
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
+    RowBand *bands = new RowBand[numBands];
 
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
+    for (size_t i = 0; i < numBands; ++i) {
+        RowBand *band = &bands[i];
+        band->mConverter = this;
+        band->mParams = &params;
+        band->mFirstRow = i * rowsPerBand;
+        band->mLastRow = (i + 1 == numBands)
+            ? params.mHeight : (i + 1) * rowsPerBand;
 
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
+        // The calling thread takes the first band itself.
+        if (i > 0 && pthread_create(
+                    &band->mThread, NULL, RowBandThread, band) != 0) {
+            band->mThread = 0;
+            RowBandThread(band);
         }
+    }
 
-        src_y += src.mWidth;
+    RowBandThread(&bands[0]);
 
-        if (y & 1) {
-            src_u += src.mWidth;
+    for (size_t i = 1; i < numBands; ++i) {
+        if (bands[i].mThread != 0) {
+            pthread_join(bands[i].mThread, NULL);
         }
-
-        dst_ptr += dst.mWidth;
     }
 
+    delete[] bands;
+    bands = NULL;
+
     return OK;
 }
 
-uint8_t *ColorConverter::initClip() {
-    static const signed kClipMin = -278;
-    static const signed kClipMax = 535;
+void ColorConverter::convertYUV420Rows(
+        const YUV420Params &params, size_t firstRow, size_t lastRow) const {
+    const uint8_t *kAdjustedClip = &mClip[-kClipMin];
+    bool toRGBA = (mDstFormat != OMX_COLOR_Format16bitRGB565);
+
+    // Pick the scalar variant once rather than branching on the layout
+    // for every pixel pair.
+    typedef void (*RowFunc)(
+            const uint8_t *, const uint8_t *, const uint8_t *,
+            const uint8_t *, size_t, size_t, uint8_t *);
+
+    static const RowFunc kRowFuncs[2][2][2] = {
+        {
+            { ConvertYUV420RowScalar<false, false, 1>,
+              ConvertYUV420RowScalar<false, false, 2> },
+            { ConvertYUV420RowScalar<false, true, 1>,
+              ConvertYUV420RowScalar<false, true, 2> },
+        },
+        {
+            { ConvertYUV420RowScalar<true, false, 1>,
+              ConvertYUV420RowScalar<true, false, 2> },
+            { ConvertYUV420RowScalar<true, true, 1>,
+              ConvertYUV420RowScalar<true, true, 2> },
+        },
+    };
+
+    CHECK(params.mSrcUVStep == 1 || params.mSrcUVStep == 2);
+
+    RowFunc convertRow =
+        kRowFuncs[toRGBA][params.mSwapRB][params.mSrcUVStep - 1];
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        const uint8_t *src_y = params.mSrcY + y * params.mSrcYStride;
+        const uint8_t *src_u = params.mSrcU + (y / 2) * params.mSrcUVStride;
+        const uint8_t *src_v = params.mSrcV + (y / 2) * params.mSrcUVStride;
+        uint8_t *dst_ptr = params.mDst + y * params.mDstStride;
+
+        size_t x = 0;
+
+#if defined(__SSE2__)
+        x = ConvertYUV420RowSSE2(
+                src_y, src_u, src_v, params.mSrcUVStep,
+                params.mWidth, params.mSwapRB, toRGBA, dst_ptr);
+#endif
+
+        convertRow(
+                kAdjustedClip, src_y, src_u, src_v, x, params.mWidth, dst_ptr);
+    }
+}
 
+uint8_t *ColorConverter::initClip() {
     if (mClip == NULL) {
         mClip = new uint8_t[kClipMax - kClipMin + 1];
 
@@ -29,8 +29,11 @@
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ABufferRange.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/hexdump.h>
@@ -52,6 +55,20 @@ static uint64_t U64_AT(const uint8_t *ptr) {
 static const size_t kMaxUDPSize = 1500;
 static const int32_t kMaxUDPRetries = 200;
 
+// Datagrams are handed to the kernel in batches of up to this many, using
+// at most this many iovecs in total.
+static const size_t kMaxDatagramsPerBatch = 16;
+static const size_t kMaxIOVecsPerBatch = 256;
+
+// Gathered datagrams with more ranges than this are copied instead.
+static const size_t kMaxIOVecsPerDatagram = 64;
+
+// Mirrors the kernel's struct mmsghdr, which not all C libraries declare.
+struct DatagramMessage {
+    struct msghdr mHeader;
+    unsigned mLength;
+};
+
 struct ANetworkSession::NetworkThread : public Thread {
     NetworkThread(ANetworkSession *session);
 
@@ -102,6 +119,10 @@ struct ANetworkSession::Session : public RefBase {
     status_t sendRequest(
             const void *data, ssize_t size, bool timeValid, int64_t timeUs);
 
+    status_t sendDatagram(
+            const ABufferRange *ranges, size_t numRanges,
+            bool timeValid, int64_t timeUs);
+
     void setMode(Mode mode);
 
     status_t switchToWebSocketMode();
@@ -116,7 +137,11 @@ private:
     struct Fragment {
         uint32_t mFlags;
         int64_t mTimeUs;
+
+        // Either a buffer or, for gathered datagrams, the ranges making
+        // up the datagram.
         sp<ABuffer> mBuffer;
+        Vector<ABufferRange> mRanges;
     };
 
     int32_t mSessionID;
@@ -126,6 +151,7 @@ private:
     sp<AMessage> mNotify;
     bool mSawReceiveFailure, mSawSendFailure;
     int32_t mUDPRetries;
+    bool mUseSendMMsg;
 
     List<Fragment> mOutFragments;
 
@@ -138,6 +164,11 @@ private:
 
     void dumpFragmentStats(const Fragment &frag);
 
+    void queueFragment(
+            const sp<ABuffer> &buffer, bool timeValid, int64_t timeUs);
+
+    ssize_t sendMessages(DatagramMessage *msgs, size_t count);
+
     DISALLOW_EVIL_CONSTRUCTORS(Session);
 };
 ////////////////////////////////////////////////////////////////////////////////
@@ -170,6 +201,11 @@ ANetworkSession::Session::Session(
       mSawReceiveFailure(false),
       mSawSendFailure(false),
       mUDPRetries(kMaxUDPRetries),
+#ifdef __NR_sendmmsg
+      mUseSendMMsg(true),
+#else
+      mUseSendMMsg(false),
+#endif
       mLastStallReportUs(-1ll) {
     if (mState == CONNECTED) {
         struct sockaddr_in localAddr;
@@ -552,24 +588,62 @@ status_t ANetworkSession::Session::writeMore() {
     if (mState == DATAGRAM) {
         CHECK(!mOutFragments.empty());
 
+        DatagramMessage msgs[kMaxDatagramsPerBatch];
+        struct iovec iov[kMaxIOVecsPerBatch];
+
         status_t err;
         do {
-            const Fragment &frag = *mOutFragments.begin();
-            const sp<ABuffer> &datagram = frag.mBuffer;
+            memset(msgs, 0, sizeof(msgs));
 
-            int n;
-            do {
-                n = send(mSocket, datagram->data(), datagram->size(), 0);
-            } while (n < 0 && errno == EINTR);
+            size_t numMsgs = 0;
+            size_t numIOVecs = 0;
+
+            for (List<Fragment>::iterator it = mOutFragments.begin();
+                    it != mOutFragments.end()
+                        && numMsgs < kMaxDatagramsPerBatch; ++it) {
+                const Fragment &frag = *it;
+
+                size_t count =
+                    (frag.mBuffer != NULL) ? 1 : frag.mRanges.size();
+
+                if (numIOVecs + count > kMaxIOVecsPerBatch) {
+                    break;
+                }
+
+                struct msghdr *header = &msgs[numMsgs++].mHeader;
+                header->msg_iov = &iov[numIOVecs];
+                header->msg_iovlen = count;
+
+                if (frag.mBuffer != NULL) {
+                    iov[numIOVecs].iov_base = frag.mBuffer->data();
+                    iov[numIOVecs].iov_len = frag.mBuffer->size();
+                    ++numIOVecs;
+                    continue;
+                }
+
+                for (size_t i = 0; i < count; ++i) {
+                    const ABufferRange &range = frag.mRanges.itemAt(i);
+
+                    iov[numIOVecs].iov_base = range.data();
+                    iov[numIOVecs].iov_len = range.mSize;
+                    ++numIOVecs;
+                }
+            }
+
+            ssize_t n = sendMessages(msgs, numMsgs);
 
             err = OK;
 
             if (n > 0) {
-                if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
-                    dumpFragmentStats(frag);
-                }
+                for (ssize_t i = 0; i < n; ++i) {
+                    const Fragment &frag = *mOutFragments.begin();
 
-                mOutFragments.erase(mOutFragments.begin());
+                    if (frag.mFlags & FRAGMENT_FLAG_TIME_VALID) {
+                        dumpFragmentStats(frag);
+                    }
+
+                    mOutFragments.erase(mOutFragments.begin());
+                }
             } else if (n < 0) {
                 err = -errno;
             } else if (n == 0) {
@@ -762,6 +836,43 @@ status_t ANetworkSession::Session::sendRequest(
         memcpy(buffer->data(), data, size);
     }
 
+    queueFragment(buffer, timeValid, timeUs);
+
+    return OK;
+}
+
+status_t ANetworkSession::Session::sendDatagram(
+        const ABufferRange *ranges, size_t numRanges,
+        bool timeValid, int64_t timeUs) {
+    CHECK(mState == CONNECTED || mState == DATAGRAM);
+
+    size_t size = 0;
+    for (size_t i = 0; i < numRanges; ++i) {
+        size += ranges[i].mSize;
+    }
+
+    if (size == 0) {
+        return OK;
+    }
+
+    if (mState != DATAGRAM || numRanges > kMaxIOVecsPerDatagram) {
+        // Stream sockets need framing, so there is no way around a copy.
+        sp<ABuffer> buffer = new ABuffer(size);
+
+        size_t offset = 0;
+        for (size_t i = 0; i < numRanges; ++i) {
+            memcpy(buffer->data() + offset, ranges[i].data(), ranges[i].mSize);
+            offset += ranges[i].mSize;
+        }
+
+        if (mState == DATAGRAM) {
+            queueFragment(buffer, timeValid, timeUs);
+            return OK;
+        }
+
+        return sendRequest(buffer->data(), size, timeValid, timeUs);
+    }
+
     Fragment frag;
 
     frag.mFlags = 0;
@@ -770,13 +881,63 @@ status_t ANetworkSession::Session::sendRequest(
         frag.mTimeUs = timeUs;
     }
 
-    frag.mBuffer = buffer;
+    frag.mRanges.appendArray(ranges, numRanges);
 
     mOutFragments.push_back(frag);
 
     return OK;
 }
 
+void ANetworkSession::Session::queueFragment(
+        const sp<ABuffer> &buffer, bool timeValid, int64_t timeUs) {
+    Fragment frag;
+
+    frag.mFlags = 0;
+    if (timeValid) {
+        frag.mFlags = FRAGMENT_FLAG_TIME_VALID;
+        frag.mTimeUs = timeUs;
+    }
+
+    frag.mBuffer = buffer;
+
+    mOutFragments.push_back(frag);
+}
+
+ssize_t ANetworkSession::Session::sendMessages(
+        DatagramMessage *msgs, size_t count) {
+    ssize_t n;
+
+#ifdef __NR_sendmmsg
+    if (mUseSendMMsg) {
+        do {
+            n = syscall(__NR_sendmmsg, mSocket, msgs, count, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+
+        ALOGW("sendmmsg is not supported, sending one datagram at a time.");
+        mUseSendMMsg = false;
+    }
+#endif
+
+    size_t i = 0;
+    while (i < count) {
+        do {
+            n = sendmsg(mSocket, &msgs[i].mHeader, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n <= 0) {
+            break;
+        }
+
+        msgs[i++].mLength = n;
+    }
+
+    return i > 0 ? (ssize_t)i : n;
+}
+
 void ANetworkSession::Session::notifyError(
         bool send, status_t err, const char *detail) {
     sp<AMessage> msg = mNotify->dup();
@@ -1222,6 +1383,27 @@ status_t ANetworkSession::sendRequest(
     return err;
 }
 
+status_t ANetworkSession::sendDatagram(
+        int32_t sessionID, const ABufferRange *ranges, size_t numRanges,
+        bool timeValid, int64_t timeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionID);
+
+    if (index < 0) {
+        return -ENOENT;
+    }
+
+    const sp<Session> session = mSessions.valueAt(index);
+
+    status_t err =
+        session->sendDatagram(ranges, numRanges, timeValid, timeUs);
+
+    interrupt();
+
+    return err;
+}
+
 status_t ANetworkSession::switchToWebSocketMode(int32_t sessionID) {
     Mutex::Autolock autoLock(mLock);
 
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABRPolicy"
+#include <utils/Log.h>
+
+#include "ABRPolicy.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <math.h>
+#include <string.h>
+
+namespace android {
+
+// Transfers this small are dominated by request latency and say little
+// about throughput.
+static const size_t kMinSampleBytes = 16384;
+
+// No estimate is given until this much has been transferred.
+static const int64_t kMinTotalBytes = 128 * 1024;
+
+static const double kFastHalfLifeSecs = 2.0;
+static const double kSlowHalfLifeSecs = 5.0;
+
+// Only this fraction of the estimated bandwidth is considered usable.
+static const double kBandwidthSafetyFactor = 0.8;
+
+BandwidthEstimator::MovingAverage::MovingAverage(double halfLifeSecs)
+    : mAlpha(exp(log(0.5) / halfLifeSecs)),
+      mEstimate(0.0),
+      mTotalWeight(0.0) {
+}
+
+void BandwidthEstimator::MovingAverage::addSample(
+        double weight, double value) {
+    double alpha = pow(mAlpha, weight);
+    mEstimate = value * (1.0 - alpha) + alpha * mEstimate;
+    mTotalWeight += weight;
+}
+
+double BandwidthEstimator::MovingAverage::estimate() const {
+    // Undo the bias towards the initial value of 0.
+    double zeroFactor = 1.0 - pow(mAlpha, mTotalWeight);
+    return zeroFactor > 0.0 ? mEstimate / zeroFactor : 0.0;
+}
+
+void BandwidthEstimator::MovingAverage::reset() {
+    mEstimate = 0.0;
+    mTotalWeight = 0.0;
+}
+
+BandwidthEstimator::BandwidthEstimator()
+    : mFastAverage(kFastHalfLifeSecs),
+      mSlowAverage(kSlowHalfLifeSecs),
+      mNumRecentSamples(0),
+      mNextRecentSample(0),
+      mTotalBytes(0ll) {
+    memset(mRecentSamples, 0, sizeof(mRecentSamples));
+}
+
+void BandwidthEstimator::addSample(size_t numBytes, int64_t delayUs) {
+    if (numBytes < kMinSampleBytes || delayUs <= 0) {
+        return;
+    }
+
+    double bandwidthBps = numBytes * 8E6 / delayUs;
+    double weight = delayUs / 1E6;
+
+    Mutex::Autolock autoLock(mLock);
+
+    mFastAverage.addSample(weight, bandwidthBps);
+    mSlowAverage.addSample(weight, bandwidthBps);
+
+    mRecentSamples[mNextRecentSample] = bandwidthBps;
+    mNextRecentSample = (mNextRecentSample + 1) % kNumRecentSamples;
+    if (mNumRecentSamples < kNumRecentSamples) {
+        ++mNumRecentSamples;
+    }
+
+    mTotalBytes += numBytes;
+}
+
+bool BandwidthEstimator::estimateBandwidth(int32_t *bandwidthBps) const {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mNumRecentSamples == 0 || mTotalBytes < kMinTotalBytes) {
+        return false;
+    }
+
+    double sumOfInverses = 0.0;
+    for (size_t i = 0; i < mNumRecentSamples; ++i) {
+        sumOfInverses += 1.0 / mRecentSamples[i];
+    }
+
+    double estimate = mNumRecentSamples / sumOfInverses;
+
+    double fast = mFastAverage.estimate();
+    double slow = mSlowAverage.estimate();
+    if (fast < estimate) {
+        estimate = fast;
+    }
+    if (slow < estimate) {
+        estimate = slow;
+    }
+
+    *bandwidthBps = estimate > 0x7fffffff ? 0x7fffffff : (int32_t)estimate;
+
+    return true;
+}
+
+void BandwidthEstimator::reset() {
+    Mutex::Autolock autoLock(mLock);
+
+    mFastAverage.reset();
+    mSlowAverage.reset();
+    mNumRecentSamples = 0;
+    mNextRecentSample = 0;
+    mTotalBytes = 0ll;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// static
+sp<ABRPolicy> ABRPolicy::Create() {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.abr", value, NULL)) {
+        sp<ABRPolicy> policy = CreateByName(value);
+        if (policy != NULL) {
+            return policy;
+        }
+
+        ALOGW("unknown adaptation policy '%s'", value);
+    }
+
+    return new BufferABRPolicy;
+}
+
+// static
+sp<ABRPolicy> ABRPolicy::CreateByName(const char *name) {
+    if (!strcmp(name, "throughput")) {
+        return new ThroughputABRPolicy;
+    } else if (!strcmp(name, "buffer")) {
+        return new BufferABRPolicy;
+    }
+
+    return NULL;
+}
+
+// static
+size_t ABRPolicy::PickByThroughput(
+        const Vector<unsigned long> &bandwidths,
+        int32_t bandwidthBps, double fraction) {
+    CHECK(!bandwidths.isEmpty());
+
+    double usableBps = bandwidthBps * fraction;
+
+    size_t index = bandwidths.size() - 1;
+    while (index > 0 && bandwidths[index] > usableBps) {
+        --index;
+    }
+
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int64_t ThroughputABRPolicy::kMinUpSwitchBufferUs = 10000000ll;
+
+size_t ThroughputABRPolicy::pickVariant(
+        const Vector<unsigned long> &bandwidths, const State &state) {
+    if (state.mBandwidthBps < 0) {
+        // Pick the lowest bandwidth stream by default.
+        return state.mCurrentIndex >= 0 ? state.mCurrentIndex : 0;
+    }
+
+    size_t index = PickByThroughput(
+            bandwidths, state.mBandwidthBps, kBandwidthSafetyFactor);
+
+    if (state.mCurrentIndex >= 0
+            && index > (size_t)state.mCurrentIndex
+            && state.mBufferedDurationUs < kMinUpSwitchBufferUs) {
+        index = state.mCurrentIndex;
+    }
+
+    return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const int64_t BufferABRPolicy::kMinBufferUs = 3000000ll;
+const int64_t BufferABRPolicy::kTargetBufferUs = 8000000ll;
+
+size_t BufferABRPolicy::pickVariant(
+        const Vector<unsigned long> &bandwidths, const State &state) {
+    size_t numVariants = bandwidths.size();
+    CHECK_GT(numVariants, 0u);
+
+    size_t throughputIndex;
+    if (state.mBandwidthBps >= 0) {
+        throughputIndex = PickByThroughput(
+                bandwidths, state.mBandwidthBps, kBandwidthSafetyFactor);
+    } else {
+        throughputIndex = state.mCurrentIndex >= 0 ? state.mCurrentIndex : 0;
+    }
+
+    if (numVariants == 1
+            || bandwidths[0] == 0
+            || bandwidths[numVariants - 1] == bandwidths[0]
+            || state.mBufferedDurationUs < kMinBufferUs) {
+        return throughputIndex;
+    }
+
+    // Utilities are offset so that the lowest variant's is 1.
+    double maxUtility = log((double)bandwidths[numVariants - 1] / bandwidths[0]) + 1.0;
+    double minBufferSecs = kMinBufferUs / 1E6;
+    double gamma = (maxUtility - 1.0) / ((double)kTargetBufferUs / kMinBufferUs - 1.0);
+    double V = minBufferSecs / gamma;
+    double bufferedSecs = state.mBufferedDurationUs / 1E6;
+
+    size_t index = 0;
+    double bestScore = 0.0;
+    for (size_t i = 0; i < numVariants; ++i) {
+        double utility = log((double)bandwidths[i] / bandwidths[0]) + 1.0;
+        double score = (V * (utility + gamma) - bufferedSecs) / bandwidths[i];
+
+        if (i == 0 || score >= bestScore) {
+            index = i;
+            bestScore = score;
+        }
+    }
+
+    // Don't switch up past what the network is estimated to sustain, the
+    // buffer would only drain again.
+    if (state.mBandwidthBps >= 0 && index > throughputIndex) {
+        size_t limit = throughputIndex;
+        if (state.mCurrentIndex >= 0 && (size_t)state.mCurrentIndex > limit) {
+            limit = state.mCurrentIndex;
+        }
+
+        if (index > limit) {
+            index = limit;
+        }
+    }
+
+    ALOGV("buffered %.2f secs, throughput index %d, picked %d",
+          bufferedSecs, (int)throughputIndex, (int)index);
+
+    return index;
+}
+
+}  // namespace android
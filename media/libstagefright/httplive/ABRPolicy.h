@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ABR_POLICY_H_
+
+#define ABR_POLICY_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Estimates the available bandwidth from completed segment downloads. The
+// estimate is the lowest of a fast and a slow exponentially weighted moving
+// average (weighted by transfer time) and the harmonic mean of the last few
+// samples, so it drops quickly when throughput falls and only recovers once
+// the improvement has been sustained. Safe to use from multiple threads.
+struct BandwidthEstimator : public RefBase {
+    BandwidthEstimator();
+
+    void addSample(size_t numBytes, int64_t delayUs);
+
+    // Returns false until enough data has been transferred.
+    bool estimateBandwidth(int32_t *bandwidthBps) const;
+
+    void reset();
+
+private:
+    enum {
+        kNumRecentSamples = 5,
+    };
+
+    struct MovingAverage {
+        MovingAverage(double halfLifeSecs);
+
+        void addSample(double weight, double value);
+        double estimate() const;
+        void reset();
+
+    private:
+        double mAlpha;
+        double mEstimate;
+        double mTotalWeight;
+    };
+
+    mutable Mutex mLock;
+
+    MovingAverage mFastAverage;
+    MovingAverage mSlowAverage;
+
+    double mRecentSamples[kNumRecentSamples];
+    size_t mNumRecentSamples;
+    size_t mNextRecentSample;
+
+    int64_t mTotalBytes;
+
+    DISALLOW_EVIL_CONSTRUCTORS(BandwidthEstimator);
+};
+
+// Picks the variant to play next. Implementations must be deterministic,
+// LiveSession calls them on its looper whenever a segment completes.
+struct ABRPolicy : public RefBase {
+    struct State {
+        State()
+            : mBandwidthBps(-1),
+              mBufferedDurationUs(-1ll),
+              mCurrentIndex(-1) {
+        }
+
+        // Negative if there is no estimate yet.
+        int32_t mBandwidthBps;
+
+        // Least amount of media buffered among the active audio/video
+        // streams, negative if unknown.
+        int64_t mBufferedDurationUs;
+
+        // The variant currently being fetched, negative before the first
+        // selection.
+        ssize_t mCurrentIndex;
+    };
+
+    // "bandwidths" lists the variants' advertised bitrates in ascending
+    // order and is never empty.
+    virtual size_t pickVariant(
+            const Vector<unsigned long> &bandwidths, const State &state) = 0;
+
+    virtual const char *name() const = 0;
+
+    // Returns the policy named by the property "media.httplive.abr",
+    // "buffer" (the default) or "throughput".
+    static sp<ABRPolicy> Create();
+
+    static sp<ABRPolicy> CreateByName(const char *name);
+
+protected:
+    ABRPolicy() {}
+    virtual ~ABRPolicy() {}
+
+    // Highest variant whose bitrate fits into "fraction" of the bandwidth.
+    static size_t PickByThroughput(
+            const Vector<unsigned long> &bandwidths,
+            int32_t bandwidthBps, double fraction);
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(ABRPolicy);
+};
+
+// Picks the highest variant that fits into 80% of the estimated bandwidth,
+// but only switches up once at least kMinUpSwitchBufferUs are buffered.
+struct ThroughputABRPolicy : public ABRPolicy {
+    ThroughputABRPolicy() {}
+
+    virtual size_t pickVariant(
+            const Vector<unsigned long> &bandwidths, const State &state);
+
+    virtual const char *name() const { return "throughput"; }
+
+private:
+    static const int64_t kMinUpSwitchBufferUs;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ThroughputABRPolicy);
+};
+
+// A buffer based policy after BOLA (Spiteri et al., "BOLA: Near-Optimal
+// Bitrate Adaptation for Online Videos"). Each variant's utility is the log
+// of its bitrate, and the variant maximizing
+//
+//     (V * (utility + gamma) - buffered) / bitrate
+//
+// is picked, with V and gamma chosen so that this is the lowest variant at
+// kMinBufferUs and the highest one from kTargetBufferUs on. Below
+// kMinBufferUs, or while there is no buffer to go by, the throughput
+// estimate decides, and up-switches never go past what the network is
+// estimated to sustain.
+struct BufferABRPolicy : public ABRPolicy {
+    BufferABRPolicy() {}
+
+    virtual size_t pickVariant(
+            const Vector<unsigned long> &bandwidths, const State &state);
+
+    virtual const char *name() const { return "buffer"; }
+
+private:
+    static const int64_t kMinBufferUs;
+    static const int64_t kTargetBufferUs;
+
+    DISALLOW_EVIL_CONSTRUCTORS(BufferABRPolicy);
+};
+
+}  // namespace android
+
+#endif  // ABR_POLICY_H_
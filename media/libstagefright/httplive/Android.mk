@@ -3,10 +3,12 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:=               \
+        ABRPolicy.cpp           \
         LiveDataSource.cpp      \
         LiveSession.cpp         \
         M3UParser.cpp           \
         PlaylistFetcher.cpp     \
+        SegmentPrefetcher.cpp   \
 
 LOCAL_C_INCLUDES:= \
 	$(TOP)/frameworks/av/media/libstagefright \
@@ -29,3 +31,29 @@ ifeq ($(TARGET_ARCH),arm)
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+        hlsbench.cpp                    \
+
+LOCAL_SHARED_LIBRARIES:= \
+        libcutils                       \
+        liblog                          \
+        libstagefright                  \
+        libstagefright_foundation       \
+        libstagefright_httplive         \
+        libstagefright_wfd              \
+        libutils                        \
+
+LOCAL_C_INCLUDES:= \
+        $(TOP)/frameworks/av/media/libstagefright \
+        $(TOP)/frameworks/native/include/media/openmax \
+
+LOCAL_MODULE:= hlsbench
+
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
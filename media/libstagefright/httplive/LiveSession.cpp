@@ -20,6 +20,7 @@
 
 #include "LiveSession.h"
 
+#include "ABRPolicy.h"
 #include "M3UParser.h"
 #include "PlaylistFetcher.h"
 
@@ -45,6 +46,10 @@
 
 namespace android {
 
+// static
+const int64_t LiveSession::kMinCheckBandwidthIntervalUs = 2000000ll;
+const int64_t LiveSession::kCheckBandwidthIntervalUs = 10000000ll;
+
 LiveSession::LiveSession(
         const sp<AMessage> &notify, uint32_t flags, bool uidValid, uid_t uid)
     : mNotify(notify),
@@ -57,11 +62,15 @@ LiveSession::LiveSession(
                   (mFlags & kFlagIncognito)
                     ? HTTPBase::kFlagIncognito
                     : 0)),
+      mBandwidthEstimator(new BandwidthEstimator),
+      mABRPolicy(ABRPolicy::Create()),
       mPrevBandwidthIndex(-1),
       mStreamMask(0),
       mNewStreamMask(0),
       mSwapMask(0),
       mCheckBandwidthGeneration(0),
+      mCheckBandwidthPending(false),
+      mLastCheckBandwidthTimeUs(-1ll),
       mSwitchGeneration(0),
       mLastDequeuedTimeUs(0ll),
       mRealTimeBaseUs(0ll),
@@ -220,6 +229,16 @@ void LiveSession::connectAsync(
 }
 
 status_t LiveSession::disconnect() {
+    {
+        // Fetchers stop their prefetchers on their own loopers, which may
+        // be busy with a download of their own. Don't leave segment
+        // prefetches running until then.
+        Mutex::Autolock autoLock(mPrefetchDataSourcesLock);
+        for (size_t i = 0; i < mPrefetchDataSources.size(); ++i) {
+            mPrefetchDataSources.itemAt(i)->disconnect();
+        }
+    }
+
     sp<AMessage> msg = new AMessage(kWhatDisconnect, id());
 
     sp<AMessage> response;
@@ -394,6 +413,20 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                     break;
                 }
 
+                case PlaylistFetcher::kWhatSegmentFetched:
+                {
+                    // Re-evaluate now rather than at the next periodic check,
+                    // but only if a check is due at all, i.e. no configuration
+                    // change is in progress.
+                    if (mCheckBandwidthPending
+                            && ALooper::GetNowUs() - mLastCheckBandwidthTimeUs
+                                >= kMinCheckBandwidthIntervalUs) {
+                        cancelCheckBandwidthEvent();
+                        onCheckBandwidth();
+                    }
+                    break;
+                }
+
                 default:
                     TRESPASS();
             }
@@ -410,6 +443,7 @@ void LiveSession::onMessageReceived(const sp<AMessage> &msg) {
                 break;
             }
 
+            mCheckBandwidthPending = false;
             onCheckBandwidth();
             break;
         }
@@ -631,7 +665,8 @@ ssize_t LiveSession::fetchFile(
         int64_t range_offset, int64_t range_length,
         uint32_t block_size, /* download block size */
         sp<DataSource> *source, /* to return and reuse source */
-        String8 *actualUrl) {
+        String8 *actualUrl,
+        const sp<HTTPBase> &httpDataSource) {
     off64_t size;
     sp<DataSource> temp_source;
     if (source == NULL) {
@@ -657,13 +692,16 @@ ssize_t LiveSession::fetchFile(
                                     ? "" : StringPrintf("%lld",
                                             range_offset + range_length - 1).c_str()).c_str()));
             }
-            status_t err = mHTTPDataSource->connect(url, &headers);
+            sp<HTTPBase> http =
+                httpDataSource != NULL ? httpDataSource : mHTTPDataSource;
+
+            status_t err = http->connect(url, &headers);
 
             if (err != OK) {
                 return err;
             }
 
-            *source = mHTTPDataSource;
+            *source = http;
         }
     }
 
@@ -683,10 +721,17 @@ ssize_t LiveSession::fetchFile(
         range_length = buffer->size() + block_size;
     }
     for (;;) {
-        // Only resize when we don't know the size.
+        // Only resize when we don't know the size. Grow geometrically so that
+        // a large segment without a Content-Length costs a handful of copies
+        // rather than one per 32 KB.
         size_t bufferRemaining = buffer->capacity() - buffer->size();
         if (bufferRemaining == 0 && getSizeErr != OK) {
-            bufferRemaining = 32768;
+            bufferRemaining = buffer->size();
+            if (bufferRemaining < kMinBufferGrowth) {
+                bufferRemaining = kMinBufferGrowth;
+            } else if (bufferRemaining > kMaxBufferGrowth) {
+                bufferRemaining = kMaxBufferGrowth;
+            }
 
             ALOGV("increasing download buffer to %d bytes",
                  buffer->size() + bufferRemaining);
@@ -740,14 +785,16 @@ ssize_t LiveSession::fetchFile(
 }
 
 sp<M3UParser> LiveSession::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+        const sp<M3UParser> &previous, const sp<HTTPBase> &httpDataSource) {
     ALOGV("fetchPlaylist '%s'", url);
 
     *unchanged = false;
 
     sp<ABuffer> buffer;
     String8 actualUrl;
-    ssize_t  err = fetchFile(url, &buffer, 0, -1, 0, NULL, &actualUrl);
+    ssize_t  err = fetchFile(
+            url, &buffer, 0, -1, 0, NULL, &actualUrl, httpDataSource);
 
     if (err <= 0) {
         return NULL;
@@ -780,8 +827,8 @@ sp<M3UParser> LiveSession::fetchPlaylist(
     }
 #endif
 
-    sp<M3UParser> playlist =
-        new M3UParser(actualUrl.string(), buffer->data(), buffer->size());
+    sp<M3UParser> playlist = new M3UParser(
+            actualUrl.string(), buffer->data(), buffer->size(), previous);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -792,39 +839,81 @@ sp<M3UParser> LiveSession::fetchPlaylist(
     return playlist;
 }
 
-static double uniformRand() {
-    return (double)rand() / RAND_MAX;
+void LiveSession::addBandwidthMeasurement(size_t numBytes, int64_t delayUs) {
+    mBandwidthEstimator->addSample(numBytes, delayUs);
+}
+
+void LiveSession::addPrefetchDataSource(const sp<HTTPBase> &httpDataSource) {
+    Mutex::Autolock autoLock(mPrefetchDataSourcesLock);
+    mPrefetchDataSources.push(httpDataSource);
+}
+
+void LiveSession::removePrefetchDataSource(
+        const sp<HTTPBase> &httpDataSource) {
+    Mutex::Autolock autoLock(mPrefetchDataSourcesLock);
+    for (size_t i = 0; i < mPrefetchDataSources.size(); ++i) {
+        if (mPrefetchDataSources.itemAt(i) == httpDataSource) {
+            mPrefetchDataSources.removeAt(i);
+            break;
+        }
+    }
+}
+
+int64_t LiveSession::getMinBufferedDurationUs() {
+    int64_t minDurationUs = -1ll;
+    for (size_t i = 0; i < mPacketSources.size(); ++i) {
+        StreamType stream = mPacketSources.keyAt(i);
+        if (!(mStreamMask & stream) || stream == STREAMTYPE_SUBTITLES) {
+            continue;
+        }
+
+        status_t finalResult;
+        int64_t durationUs =
+            mPacketSources.valueAt(i)->getBufferedDurationUs(&finalResult);
+
+        if (finalResult != OK) {
+            // Nothing more to fetch for this stream.
+            continue;
+        }
+
+        if (minDurationUs < 0ll || durationUs < minDurationUs) {
+            minDurationUs = durationUs;
+        }
+    }
+
+    return minDurationUs;
 }
 
-size_t LiveSession::getBandwidthIndex() {
+size_t LiveSession::getBandwidthIndex(ssize_t currentIndex) {
     if (mBandwidthItems.size() == 0) {
         return 0;
     }
 
-#if 1
     char value[PROPERTY_VALUE_MAX];
-    ssize_t index = -1;
     if (property_get("media.httplive.bw-index", value, NULL)) {
         char *end;
-        index = strtol(value, &end, 10);
+        ssize_t index = strtol(value, &end, 10);
         CHECK(end > value && *end == '\0');
 
-        if (index >= 0 && (size_t)index >= mBandwidthItems.size()) {
-            index = mBandwidthItems.size() - 1;
+        if (index >= 0) {
+            if ((size_t)index >= mBandwidthItems.size()) {
+                index = mBandwidthItems.size() - 1;
+            }
+
+            return index;
         }
     }
 
-    if (index < 0) {
-        int32_t bandwidthBps;
-        if (mHTTPDataSource != NULL
-                && mHTTPDataSource->estimateBandwidth(&bandwidthBps)) {
-            ALOGV("bandwidth estimated at %.2f kbps", bandwidthBps / 1024.0f);
-        } else {
-            ALOGV("no bandwidth estimate.");
-            return 0;  // Pick the lowest bandwidth stream by default.
-        }
+    ABRPolicy::State state;
+    state.mCurrentIndex = currentIndex;
+    state.mBufferedDurationUs = getMinBufferedDurationUs();
+
+    int32_t bandwidthBps;
+    if (mBandwidthEstimator->estimateBandwidth(&bandwidthBps)
+            || (mHTTPDataSource != NULL
+                && mHTTPDataSource->estimateBandwidth(&bandwidthBps))) {
+        ALOGV("bandwidth estimated at %.2f kbps", bandwidthBps / 1024.0f);
 
-        char value[PROPERTY_VALUE_MAX];
         if (property_get("media.httplive.max-bw", value, NULL)) {
             char *end;
             long maxBw = strtoul(value, &end, 10);
@@ -836,66 +925,22 @@ size_t LiveSession::getBandwidthIndex() {
             }
         }
 
-        // Consider only 80% of the available bandwidth usable.
-        bandwidthBps = (bandwidthBps * 8) / 10;
-
-        // Pick the highest bandwidth stream below or equal to estimated bandwidth.
-
-        index = mBandwidthItems.size() - 1;
-        while (index > 0 && mBandwidthItems.itemAt(index).mBandwidth
-                                > (size_t)bandwidthBps) {
-            --index;
-        }
-    }
-#elif 0
-    // Change bandwidth at random()
-    size_t index = uniformRand() * mBandwidthItems.size();
-#elif 0
-    // There's a 50% chance to stay on the current bandwidth and
-    // a 50% chance to switch to the next higher bandwidth (wrapping around
-    // to lowest)
-    const size_t kMinIndex = 0;
-
-    static ssize_t mPrevBandwidthIndex = -1;
-
-    size_t index;
-    if (mPrevBandwidthIndex < 0) {
-        index = kMinIndex;
-    } else if (uniformRand() < 0.5) {
-        index = (size_t)mPrevBandwidthIndex;
+        state.mBandwidthBps = bandwidthBps;
     } else {
-        index = mPrevBandwidthIndex + 1;
-        if (index == mBandwidthItems.size()) {
-            index = kMinIndex;
-        }
+        ALOGV("no bandwidth estimate.");
     }
-    mPrevBandwidthIndex = index;
-#elif 0
-    // Pick the highest bandwidth stream below or equal to 1.2 Mbit/sec
 
-    size_t index = mBandwidthItems.size() - 1;
-    while (index > 0 && mBandwidthItems.itemAt(index).mBandwidth > 1200000) {
-        --index;
+    Vector<unsigned long> bandwidths;
+    for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+        bandwidths.push(mBandwidthItems.itemAt(i).mBandwidth);
     }
-#elif 1
-    char value[PROPERTY_VALUE_MAX];
-    size_t index;
-    if (property_get("media.httplive.bw-index", value, NULL)) {
-        char *end;
-        index = strtoul(value, &end, 10);
-        CHECK(end > value && *end == '\0');
 
-        if (index >= mBandwidthItems.size()) {
-            index = mBandwidthItems.size() - 1;
-        }
-    } else {
-        index = 0;
-    }
-#else
-    size_t index = mBandwidthItems.size() - 1;  // Highest bandwidth stream
-#endif
+    size_t index = mABRPolicy->pickVariant(bandwidths, state);
+    CHECK_LT(index, mBandwidthItems.size());
 
-    CHECK_GE(index, 0);
+    ALOGV("%s policy picked variant %d (current %d, buffered %lld us)",
+          mABRPolicy->name(), (int)index, (int)currentIndex,
+          state.mBufferedDurationUs);
 
     return index;
 }
@@ -947,19 +992,6 @@ status_t LiveSession::selectTrack(size_t index, bool select) {
     return err;
 }
 
-bool LiveSession::canSwitchUp() {
-    // Allow upwards bandwidth switch when a stream has buffered at least 10 seconds.
-    status_t err = OK;
-    for (size_t i = 0; i < mPacketSources.size(); ++i) {
-        sp<AnotherPacketSource> source = mPacketSources.valueAt(i);
-        int64_t dur = source->getBufferedDurationUs(&err);
-        if (err == OK && dur > 10000000) {
-            return true;
-        }
-    }
-    return false;
-}
-
 void LiveSession::changeConfiguration(
         int64_t timeUs, size_t bandwidthIndex, bool pickTrack) {
     // Protect mPacketSources from a swapPacketSource race condition through reconfiguration.
@@ -1296,11 +1328,14 @@ void LiveSession::tryToFinishBandwidthSwitch() {
 void LiveSession::scheduleCheckBandwidthEvent() {
     sp<AMessage> msg = new AMessage(kWhatCheckBandwidth, id());
     msg->setInt32("generation", mCheckBandwidthGeneration);
-    msg->post(10000000ll);
+    msg->post(kCheckBandwidthIntervalUs);
+
+    mCheckBandwidthPending = true;
 }
 
 void LiveSession::cancelCheckBandwidthEvent() {
     ++mCheckBandwidthGeneration;
+    mCheckBandwidthPending = false;
 }
 
 void LiveSession::cancelBandwidthSwitch() {
@@ -1319,17 +1354,14 @@ bool LiveSession::canSwitchBandwidthTo(size_t bandwidthIndex) {
         return true;
     }
 
-    if (bandwidthIndex == (size_t)mPrevBandwidthIndex) {
-        return false;
-    } else if (bandwidthIndex > (size_t)mPrevBandwidthIndex) {
-        return canSwitchUp();
-    } else {
-        return true;
-    }
+    // Whether an up-switch is safe is up to the adaptation policy.
+    return bandwidthIndex != (size_t)mPrevBandwidthIndex;
 }
 
 void LiveSession::onCheckBandwidth() {
-    size_t bandwidthIndex = getBandwidthIndex();
+    mLastCheckBandwidthTimeUs = ALooper::GetNowUs();
+
+    size_t bandwidthIndex = getBandwidthIndex(mPrevBandwidthIndex);
     if (canSwitchBandwidthTo(bandwidthIndex)) {
         changeConfiguration(-1ll /* timeUs */, bandwidthIndex);
     } else {
@@ -24,8 +24,10 @@
 
 namespace android {
 
+struct ABRPolicy;
 struct ABuffer;
 struct AnotherPacketSource;
+struct BandwidthEstimator;
 struct DataSource;
 struct HTTPBase;
 struct LiveDataSource;
@@ -93,6 +95,7 @@ protected:
 
 private:
     friend struct PlaylistFetcher;
+    friend struct SegmentPrefetcher;
 
     enum {
         kWhatConnect                    = 'conn',
@@ -107,6 +110,19 @@ private:
         kWhatSwapped                    = 'swap',
     };
 
+    // Bandwidth is re-evaluated whenever a segment completes, but no more
+    // often than every kMinCheckBandwidthIntervalUs, and at least every
+    // kCheckBandwidthIntervalUs while no segments are being fetched.
+    static const int64_t kMinCheckBandwidthIntervalUs;
+    static const int64_t kCheckBandwidthIntervalUs;
+
+    // Bounds on how much fetchFile grows its buffer by when the size of the
+    // file isn't known up front.
+    enum {
+        kMinBufferGrowth = 32768,
+        kMaxBufferGrowth = 1048576,
+    };
+
     struct BandwidthItem {
         size_t mPlaylistIndex;
         unsigned long mBandwidth;
@@ -140,8 +156,14 @@ private:
     bool mInPreparationPhase;
 
     sp<HTTPBase> mHTTPDataSource;
+
+    Mutex mPrefetchDataSourcesLock;
+    Vector<sp<HTTPBase> > mPrefetchDataSources;
     KeyedVector<String8, String8> mExtraHeaders;
 
+    sp<BandwidthEstimator> mBandwidthEstimator;
+    sp<ABRPolicy> mABRPolicy;
+
     AString mMasterURL;
 
     Vector<BandwidthItem> mBandwidthItems;
@@ -171,6 +193,8 @@ private:
     Mutex mSwapMutex;
 
     int32_t mCheckBandwidthGeneration;
+    bool mCheckBandwidthPending;
+    int64_t mLastCheckBandwidthTimeUs;
     int32_t mSwitchGeneration;
 
     size_t mContinuationCounter;
@@ -202,6 +226,9 @@ private:
     //
     // For reused HTTP sources, the caller must download a file sequentially without
     // any overlaps or gaps to prevent reconnection.
+    //
+    // HTTP downloads go over the session's own connection unless another one is
+    // given in httpDataSource.
     ssize_t fetchFile(
             const char *url, sp<ABuffer> *out,
             /* request/open a file starting at range_offset for range_length bytes */
@@ -210,12 +237,32 @@ private:
             uint32_t block_size = 0,
             /* reuse DataSource if doing partial fetch */
             sp<DataSource> *source = NULL,
-            String8 *actualUrl = NULL);
+            String8 *actualUrl = NULL,
+            const sp<HTTPBase> &httpDataSource = NULL);
 
+    // If "previous" is given, segments it has in common with the fetched
+    // playlist are taken over from it rather than parsed again. Like
+    // fetchFile, downloads over httpDataSource if given.
     sp<M3UParser> fetchPlaylist(
-            const char *url, uint8_t *curPlaylistHash, bool *unchanged);
+            const char *url, uint8_t *curPlaylistHash, bool *unchanged,
+            const sp<M3UParser> &previous = NULL,
+            const sp<HTTPBase> &httpDataSource = NULL);
+
+    // Thread-safe, called for every completed segment download.
+    void addBandwidthMeasurement(size_t numBytes, int64_t delayUs);
+
+    // Thread-safe. Connections of segment prefetchers, disconnect() aborts
+    // their transfers.
+    void addPrefetchDataSource(const sp<HTTPBase> &httpDataSource);
+    void removePrefetchDataSource(const sp<HTTPBase> &httpDataSource);
+
+    // Least amount of media buffered among the active audio/video streams,
+    // -1 if there are none.
+    int64_t getMinBufferedDurationUs();
 
-    size_t getBandwidthIndex();
+    // Passing the variant currently played lets the adaptation policy take
+    // the switch itself into account, otherwise a fresh selection is made.
+    size_t getBandwidthIndex(ssize_t currentIndex = -1);
 
     static int SortByBandwidth(const BandwidthItem *, const BandwidthItem *);
     static StreamType indexToType(int idx);
@@ -244,7 +291,6 @@ private:
     void postPrepared(status_t err);
 
     void swapPacketSource(StreamType stream);
-    bool canSwitchUp();
 
     DISALLOW_EVIL_CONSTRUCTORS(LiveSession);
 };
@@ -231,15 +231,18 @@ bool M3UParser::MediaGroup::getActiveURI(AString *uri) const {
 ////////////////////////////////////////////////////////////////////////////////
 
 M3UParser::M3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<M3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
       mIsVariantPlaylist(false),
       mIsComplete(false),
       mIsEvent(false),
+      mCanBlockReload(false),
+      mData((const char *)data, size),
       mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+    mInitCheck = parse(previous);
 }
 
 M3UParser::~M3UParser() {
@@ -265,6 +268,10 @@ bool M3UParser::isEvent() const {
     return mIsEvent;
 }
 
+bool M3UParser::canBlockReload() const {
+    return mCanBlockReload;
+}
+
 sp<AMessage> M3UParser::meta() {
     return mMeta;
 }
@@ -286,17 +293,92 @@ bool M3UParser::itemAt(size_t index, AString *uri, sp<AMessage> *meta) {
         return false;
     }
 
+    const Item &item = mItems.itemAt(index);
+
     if (uri) {
-        *uri = mItems.itemAt(index).mURI;
+        makeItemURI(item, uri);
     }
 
-    if (meta) {
-        *meta = mItems.itemAt(index).mMeta;
+    if (meta == NULL) {
+        return true;
+    }
+
+    if (mIsVariantPlaylist) {
+        if (item.mMetaIndex >= 0) {
+            *meta = mMetas.itemAt(item.mMetaIndex);
+        }
+        return true;
+    }
+
+    // Media segments get their meta data put together on demand, most of
+    // them are never looked at.
+    if (item.mMetaIndex >= 0) {
+        *meta = mMetas.itemAt(item.mMetaIndex)->dup();
+    } else {
+        *meta = new AMessage;
+    }
+
+    if (item.mDurationUs >= 0ll) {
+        (*meta)->setInt64("durationUs", item.mDurationUs);
+    }
+
+    if (item.mFlags & kItemDiscontinuity) {
+        (*meta)->setInt32("discontinuity", true);
+    }
+
+    if (item.mFlags & kItemHasByteRange) {
+        (*meta)->setInt64("range-offset", item.mRangeOffset);
+        (*meta)->setInt64("range-length", item.mRangeLength);
     }
 
     return true;
 }
 
+bool M3UParser::getItemDurationUs(size_t index, int64_t *durationUs) const {
+    if (index >= mItems.size() || mItems.itemAt(index).mDurationUs < 0ll) {
+        return false;
+    }
+
+    *durationUs = mItems.itemAt(index).mDurationUs;
+
+    return true;
+}
+
+int64_t M3UParser::getItemStartTimeUs(size_t index) const {
+    CHECK_LE(index, mItems.size());
+
+    if (index < mItems.size()) {
+        return mItems.itemAt(index).mStartTimeUs;
+    }
+
+    if (index == 0) {
+        return 0ll;
+    }
+
+    const Item &last = mItems.itemAt(index - 1);
+    return last.mStartTimeUs + (last.mDurationUs > 0ll ? last.mDurationUs : 0ll);
+}
+
+size_t M3UParser::getItemIndexForTime(int64_t timeUs) const {
+    // Find the first item that ends after timeUs.
+    size_t lo = 0;
+    size_t hi = mItems.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (getItemStartTimeUs(mid + 1) <= timeUs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo >= mItems.size()) {
+        lo = mItems.size() - 1;
+    }
+
+    return lo;
+}
+
 void M3UParser::pickRandomMediaItems() {
     for (size_t i = 0; i < mMediaGroups.size(); ++i) {
         mMediaGroups.valueAt(i)->pickRandomMediaItems();
@@ -347,11 +429,16 @@ bool M3UParser::getTypeURI(size_t index, const char *key, AString *uri) const {
 
     CHECK_LT(index, mItems.size());
 
-    sp<AMessage> meta = mItems.itemAt(index).mMeta;
+    const Item &item = mItems.itemAt(index);
+
+    sp<AMessage> meta;
+    if (item.mMetaIndex >= 0) {
+        meta = mMetas.itemAt(item.mMetaIndex);
+    }
 
     AString groupID;
     if (!meta->findString(key, &groupID)) {
-        *uri = mItems.itemAt(index).mURI;
+        makeItemURI(item, uri);
 
         AString codecs;
         if (!meta->findString("codecs", &codecs)) {
@@ -383,7 +470,7 @@ bool M3UParser::getTypeURI(size_t index, const char *key, AString *uri) const {
     }
 
     if ((*uri).empty()) {
-        *uri = mItems.itemAt(index).mURI;
+        makeItemURI(item, uri);
     }
 
     return true;
@@ -457,99 +544,243 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t M3UParser::parse(const void *_data, size_t size) {
+void M3UParser::makeItemURI(const Item &item, AString *uri) const {
+    AString line(mData, item.mURIOffset, item.mURISize);
+    CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), uri));
+}
+
+int32_t M3UParser::mediaSequence() const {
+    int32_t seqNumber;
+    if (mMeta == NULL || !mMeta->findInt32("media-sequence", &seqNumber)) {
+        seqNumber = 0;
+    }
+    return seqNumber;
+}
+
+// Returns the length of "uri" up to its query string, if any.
+static size_t PathLength(const AString &uri) {
+    ssize_t qsPos = uri.find("?");
+    return qsPos < 0 ? uri.size() : (size_t)qsPos;
+}
+
+bool M3UParser::canReuseItemsOf(
+        const sp<M3UParser> &previous, size_t *prevIndex) const {
+    if (previous == NULL
+            || !mIsExtM3U || !previous->mIsExtM3U
+            || mIsVariantPlaylist || previous->mIsVariantPlaylist) {
+        return false;
+    }
+
+    // Key URIs have been resolved against the previous base URI. The query
+    // string doesn't matter for that, it changes with every blocking reload.
+    size_t pathLength = PathLength(mBaseURI);
+    if (pathLength != PathLength(previous->mBaseURI)
+            || strncmp(mBaseURI.c_str(),
+                       previous->mBaseURI.c_str(), pathLength)) {
+        return false;
+    }
+
+    int32_t firstSeqNumber = mediaSequence();
+    int32_t prevFirstSeqNumber = previous->mediaSequence();
+
+    if (firstSeqNumber < prevFirstSeqNumber
+            || (size_t)(firstSeqNumber - prevFirstSeqNumber)
+                    >= previous->mItems.size()) {
+        return false;
+    }
+
+    *prevIndex = firstSeqNumber - prevFirstSeqNumber;
+
+    return true;
+}
+
+void M3UParser::reset() {
+    mIsExtM3U = false;
+    mIsVariantPlaylist = false;
+    mIsComplete = false;
+    mIsEvent = false;
+    mCanBlockReload = false;
+    mMeta.clear();
+    mItems.clear();
+    mMetas.clear();
+    mMediaGroups.clear();
+    mSelectedIndex = -1;
+}
+
+static bool LineStartsWith(const char *line, size_t size, const char *prefix) {
+    size_t prefixSize = strlen(prefix);
+    return size >= prefixSize && !memcmp(line, prefix, prefixSize);
+}
+
+status_t M3UParser::parse(const sp<M3UParser> &previous) {
     int32_t lineNo = 0;
 
+    // Attributes of the next item.
     sp<AMessage> itemMeta;
+    bool hasDuration = false;
+    int64_t durationUs = 0ll;
+    uint32_t flags = 0;
+    uint64_t rangeOffset = 0;
+    uint64_t rangeLength = 0;
+
+    // Index into mMetas of the EXT-X-KEY in effect.
+    int32_t keyIndex = -1;
+
+    int64_t startTimeUs = 0ll;
+
+    // Segments of a live playlist keep their sequence number, URI and
+    // attributes across reloads. Once the first one is reached, the segments
+    // the previous version of the playlist already has are taken over from
+    // it, their lines are only compared against the old ones.
+    bool checkedPrevious = (previous == NULL);
+    size_t prevIndex = 0;
+    size_t numItemsToReuse = 0;
+
+    // Keys are carried over as the items referring to them are, segments
+    // share them in runs.
+    int32_t prevKeyIndex = -1;
 
-    const char *data = (const char *)_data;
+    const char *data = mData.c_str();
+    size_t size = mData.size();
     size_t offset = 0;
     uint64_t segmentRangeOffset = 0;
     while (offset < size) {
-        size_t offsetLF = offset;
-        while (offsetLF < size && data[offsetLF] != '\n') {
-            ++offsetLF;
-        }
+        const char *lf = (const char *)memchr(&data[offset], '\n', size - offset);
+        size_t offsetLF = (lf != NULL) ? lf - data : size;
 
-        AString line;
-        if (offsetLF > offset && data[offsetLF - 1] == '\r') {
-            line.setTo(&data[offset], offsetLF - offset - 1);
-        } else {
-            line.setTo(&data[offset], offsetLF - offset);
+        const char *line = &data[offset];
+        size_t lineSize = offsetLF - offset;
+        if (lineSize > 0 && line[lineSize - 1] == '\r') {
+            --lineSize;
         }
 
-        // ALOGI("#%s#", line.c_str());
+        // ALOGI("#%.*s#", (int)lineSize, line);
 
-        if (line.empty()) {
+        if (lineSize == 0) {
             offset = offsetLF + 1;
             continue;
         }
 
-        if (lineNo == 0 && line == "#EXTM3U") {
-            mIsExtM3U = true;
-        }
+        if (numItemsToReuse > 0) {
+            if (line[0] != '#') {
+                const Item &prevItem = previous->mItems.itemAt(prevIndex);
 
-        if (mIsExtM3U) {
-            status_t err = OK;
+                if (lineSize != prevItem.mURISize
+                        || memcmp(line,
+                                  previous->mData.c_str() + prevItem.mURIOffset,
+                                  lineSize)) {
+                    ALOGW("segment %d changed its URI, reparsing playlist",
+                          previous->mediaSequence() + (int32_t)prevIndex);
 
-            if (line.startsWith("#EXT-X-TARGETDURATION")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-                err = parseMetaData(line, &mMeta, "target-duration");
-            } else if (line.startsWith("#EXT-X-MEDIA-SEQUENCE")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-                err = parseMetaData(line, &mMeta, "media-sequence");
-            } else if (line.startsWith("#EXT-X-KEY")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-                err = parseCipherInfo(line, &itemMeta, mBaseURI);
-            } else if (line.startsWith("#EXT-X-ENDLIST")) {
-                mIsComplete = true;
-            } else if (line.startsWith("#EXT-X-PLAYLIST-TYPE:EVENT")) {
-                mIsEvent = true;
-            } else if (line.startsWith("#EXTINF")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
+                    reset();
+                    return parse(NULL);
                 }
-                err = parseMetaDataDuration(line, &itemMeta, "durationUs");
-            } else if (line.startsWith("#EXT-X-DISCONTINUITY")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
+
+                if (prevItem.mMetaIndex != prevKeyIndex) {
+                    prevKeyIndex = prevItem.mMetaIndex;
+
+                    if (prevKeyIndex >= 0) {
+                        mMetas.push(previous->mMetas.itemAt(prevKeyIndex));
+                        keyIndex = mMetas.size() - 1;
+                    } else {
+                        keyIndex = -1;
+                    }
                 }
-                if (itemMeta == NULL) {
-                    itemMeta = new AMessage;
+
+                mItems.push(prevItem);
+                Item *item = &mItems.editItemAt(mItems.size() - 1);
+                item->mURIOffset = offset;
+                item->mMetaIndex = keyIndex;
+                item->mStartTimeUs = startTimeUs;
+
+                if (item->mDurationUs > 0ll) {
+                    startTimeUs += item->mDurationUs;
                 }
-                itemMeta->setInt32("discontinuity", true);
-            } else if (line.startsWith("#EXT-X-STREAM-INF")) {
-                if (mMeta != NULL) {
-                    return ERROR_MALFORMED;
+
+                if (item->mFlags & kItemHasByteRange) {
+                    segmentRangeOffset =
+                        item->mRangeOffset + item->mRangeLength;
                 }
-                mIsVariantPlaylist = true;
-                err = parseStreamInf(line, &itemMeta);
-            } else if (line.startsWith("#EXT-X-BYTERANGE")) {
+
+                ++prevIndex;
+                --numItemsToReuse;
+            }
+
+            offset = offsetLF + 1;
+            ++lineNo;
+            continue;
+        }
+
+        if (lineNo == 0 && lineSize == 7 && !memcmp(line, "#EXTM3U", 7)) {
+            mIsExtM3U = true;
+        }
+
+        if (mIsExtM3U && line[0] == '#') {
+            status_t err = OK;
+
+            if (LineStartsWith(line, lineSize, "#EXTINF")) {
                 if (mIsVariantPlaylist) {
                     return ERROR_MALFORMED;
                 }
+                err = parseDurationUs(line, lineSize, &durationUs);
+                hasDuration = (err == OK);
+            } else if (LineStartsWith(line, lineSize, "#EXT-X-")) {
+                AString tag(line, lineSize);
+
+                if (tag.startsWith("#EXT-X-TARGETDURATION")) {
+                    if (mIsVariantPlaylist) {
+                        return ERROR_MALFORMED;
+                    }
+                    err = parseMetaData(tag, &mMeta, "target-duration");
+                } else if (tag.startsWith("#EXT-X-MEDIA-SEQUENCE")) {
+                    if (mIsVariantPlaylist) {
+                        return ERROR_MALFORMED;
+                    }
+                    err = parseMetaData(tag, &mMeta, "media-sequence");
+                } else if (tag.startsWith("#EXT-X-KEY")) {
+                    if (mIsVariantPlaylist) {
+                        return ERROR_MALFORMED;
+                    }
 
-                uint64_t length, offset;
-                err = parseByteRange(line, segmentRangeOffset, &length, &offset);
+                    sp<AMessage> keyMeta;
+                    err = parseCipherInfo(tag, &keyMeta, mBaseURI);
 
-                if (err == OK) {
-                    if (itemMeta == NULL) {
-                        itemMeta = new AMessage;
+                    if (err == OK && keyMeta != NULL) {
+                        mMetas.push(keyMeta);
+                        keyIndex = mMetas.size() - 1;
+                    }
+                } else if (tag.startsWith("#EXT-X-ENDLIST")) {
+                    mIsComplete = true;
+                } else if (tag.startsWith("#EXT-X-PLAYLIST-TYPE:EVENT")) {
+                    mIsEvent = true;
+                } else if (tag.startsWith("#EXT-X-DISCONTINUITY")) {
+                    if (mIsVariantPlaylist) {
+                        return ERROR_MALFORMED;
+                    }
+                    flags |= kItemDiscontinuity;
+                } else if (tag.startsWith("#EXT-X-STREAM-INF")) {
+                    if (mMeta != NULL) {
+                        return ERROR_MALFORMED;
+                    }
+                    mIsVariantPlaylist = true;
+                    err = parseStreamInf(tag, &itemMeta);
+                } else if (tag.startsWith("#EXT-X-BYTERANGE")) {
+                    if (mIsVariantPlaylist) {
+                        return ERROR_MALFORMED;
                     }
 
-                    itemMeta->setInt64("range-offset", offset);
-                    itemMeta->setInt64("range-length", length);
+                    err = parseByteRange(
+                            tag, segmentRangeOffset, &rangeLength, &rangeOffset);
 
-                    segmentRangeOffset = offset + length;
+                    if (err == OK) {
+                        flags |= kItemHasByteRange;
+                        segmentRangeOffset = rangeOffset + rangeLength;
+                    }
+                } else if (tag.startsWith("#EXT-X-MEDIA")) {
+                    err = parseMedia(tag);
+                } else if (tag.startsWith("#EXT-X-SERVER-CONTROL")) {
+                    parseServerControl(tag);
                 }
-            } else if (line.startsWith("#EXT-X-MEDIA")) {
-                err = parseMedia(line);
             }
 
             if (err != OK) {
@@ -557,23 +788,61 @@ status_t M3UParser::parse(const void *_data, size_t size) {
             }
         }
 
-        if (!line.startsWith("#")) {
-            if (!mIsVariantPlaylist) {
-                int64_t durationUs;
-                if (itemMeta == NULL
-                        || !itemMeta->findInt64("durationUs", &durationUs)) {
-                    return ERROR_MALFORMED;
+        if (line[0] != '#') {
+            if (!checkedPrevious) {
+                checkedPrevious = true;
+
+                if (canReuseItemsOf(previous, &prevIndex)) {
+                    numItemsToReuse = previous->mItems.size() - prevIndex;
+
+                    ALOGV("reusing %d segments of the previous playlist",
+                          (int)numItemsToReuse);
+
+                    // Any key seen so far is carried over with the items.
+                    mMetas.clear();
+                    keyIndex = -1;
+
+                    hasDuration = false;
+                    flags = 0;
+
+                    // Take this line over as well.
+                    continue;
                 }
             }
 
+            if (!mIsVariantPlaylist && !hasDuration) {
+                return ERROR_MALFORMED;
+            }
+
             mItems.push();
             Item *item = &mItems.editItemAt(mItems.size() - 1);
 
-            CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &item->mURI));
+            item->mURIOffset = offset;
+            item->mURISize = lineSize;
+            item->mFlags = flags;
+            item->mDurationUs = hasDuration ? durationUs : -1ll;
+            item->mStartTimeUs = startTimeUs;
+            item->mRangeOffset = rangeOffset;
+            item->mRangeLength = rangeLength;
+
+            if (mIsVariantPlaylist) {
+                if (itemMeta != NULL) {
+                    mMetas.push(itemMeta);
+                    item->mMetaIndex = mMetas.size() - 1;
+                } else {
+                    item->mMetaIndex = -1;
+                }
+            } else {
+                item->mMetaIndex = keyIndex;
+            }
 
-            item->mMeta = itemMeta;
+            if (hasDuration && durationUs > 0ll) {
+                startTimeUs += durationUs;
+            }
 
             itemMeta.clear();
+            hasDuration = false;
+            flags = 0;
         }
 
         offset = offsetLF + 1;
@@ -608,25 +877,39 @@ status_t M3UParser::parseMetaData(
 }
 
 // static
-status_t M3UParser::parseMetaDataDuration(
-        const AString &line, sp<AMessage> *meta, const char *key) {
-    ssize_t colonPos = line.find(":");
+status_t M3UParser::parseDurationUs(
+        const char *line, size_t size, int64_t *durationUs) {
+    const char *colon = (const char *)memchr(line, ':', size);
 
-    if (colonPos < 0) {
+    if (colon == NULL) {
         return ERROR_MALFORMED;
     }
 
+    // The line isn't NUL terminated, copy the number out.
+    const char *s = colon + 1;
+    size_t n = line + size - s;
+
+    const char *comma = (const char *)memchr(s, ',', n);
+    if (comma != NULL) {
+        n = comma - s;
+    }
+
+    char tmp[32];
+    if (n >= sizeof(tmp)) {
+        return ERROR_MALFORMED;
+    }
+
+    memcpy(tmp, s, n);
+    tmp[n] = '\0';
+
     double x;
-    status_t err = ParseDouble(line.c_str() + colonPos + 1, &x);
+    status_t err = ParseDouble(tmp, &x);
 
     if (err != OK) {
         return err;
     }
 
-    if (meta->get() == NULL) {
-        *meta = new AMessage;
-    }
-    (*meta)->setInt64(key, (int64_t)x * 1E6);
+    *durationUs = (int64_t)(x * 1E6);
 
     return OK;
 }
@@ -812,6 +1095,43 @@ status_t M3UParser::parseCipherInfo(
     return OK;
 }
 
+void M3UParser::parseServerControl(const AString &line) {
+    ssize_t colonPos = line.find(":");
+
+    if (colonPos < 0) {
+        return;
+    }
+
+    size_t offset = colonPos + 1;
+
+    while (offset < line.size()) {
+        ssize_t end = FindNextUnquoted(line, ',', offset);
+        if (end < 0) {
+            end = line.size();
+        }
+
+        AString attr(line, offset, end - offset);
+        attr.trim();
+
+        offset = end + 1;
+
+        ssize_t equalPos = attr.find("=");
+        if (equalPos < 0) {
+            continue;
+        }
+
+        AString key(attr, 0, equalPos);
+        key.trim();
+
+        AString val(attr, equalPos + 1, attr.size() - equalPos - 1);
+        val.trim();
+
+        if (!strcasecmp("can-block-reload", key.c_str())) {
+            mCanBlockReload = !strcasecmp("yes", val.c_str());
+        }
+    }
+}
+
 // static
 status_t M3UParser::parseByteRange(
         const AString &line, uint64_t curOffset,
@@ -26,7 +26,11 @@
 namespace android {
 
 struct M3UParser : public RefBase {
-    M3UParser(const char *baseURI, const void *data, size_t size);
+    // If "previous" is an earlier version of the same live media playlist,
+    // the segments both versions have in common are taken over from it
+    // instead of being parsed again.
+    M3UParser(const char *baseURI, const void *data, size_t size,
+              const sp<M3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -35,11 +39,28 @@ struct M3UParser : public RefBase {
     bool isComplete() const;
     bool isEvent() const;
 
+    // True if the server supports blocking playlist reloads, i.e. holds a
+    // request for the playlist until the given media sequence number is
+    // available (EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES).
+    bool canBlockReload() const;
+
     sp<AMessage> meta();
 
     size_t size();
     bool itemAt(size_t index, AString *uri, sp<AMessage> *meta = NULL);
 
+    // Cheaper alternatives to itemAt() for segment timing, which don't
+    // resolve the URI or build the item's meta data.
+    bool getItemDurationUs(size_t index, int64_t *durationUs) const;
+
+    // Sum of the durations of the items before index, the total duration
+    // of the playlist for index == size().
+    int64_t getItemStartTimeUs(size_t index) const;
+
+    // Index of the item playing at timeUs, the last one if timeUs is past
+    // the end of the playlist.
+    size_t getItemIndexForTime(int64_t timeUs) const;
+
     void pickRandomMediaItems();
     status_t selectTrack(size_t index, bool select);
     status_t getTrackInfo(Parcel* reply) const;
@@ -53,9 +74,25 @@ protected:
 private:
     struct MediaGroup;
 
+    enum ItemFlags {
+        kItemDiscontinuity      = 1,
+        kItemHasByteRange       = 2,
+    };
+
+    // Items are kept small and flat, playlists of live streams with a long
+    // DVR window hold thousands of them. The URI is the line's raw text in
+    // mData, resolved against the base URI on access. Attributes that don't
+    // fit here, i.e. the EXT-X-KEY in effect for a media segment or the
+    // EXT-X-STREAM-INF attributes of a variant, are shared through mMetas.
     struct Item {
-        AString mURI;
-        sp<AMessage> mMeta;
+        uint32_t mURIOffset;
+        uint32_t mURISize;
+        uint32_t mFlags;
+        int32_t mMetaIndex;     // into mMetas, negative if none
+        int64_t mDurationUs;    // negative if unknown
+        int64_t mStartTimeUs;
+        uint64_t mRangeOffset;
+        uint64_t mRangeLength;
     };
 
     status_t mInitCheck;
@@ -65,20 +102,32 @@ private:
     bool mIsVariantPlaylist;
     bool mIsComplete;
     bool mIsEvent;
+    bool mCanBlockReload;
+
+    // Copy of the playlist text, item URIs point into it.
+    AString mData;
 
     sp<AMessage> mMeta;
     Vector<Item> mItems;
+    Vector<sp<AMessage> > mMetas;
     ssize_t mSelectedIndex;
 
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    status_t parse(const sp<M3UParser> &previous);
+    void reset();
 
-    static status_t parseMetaData(
-            const AString &line, sp<AMessage> *meta, const char *key);
+    // Returns true if the items of "previous" from this playlist's media
+    // sequence number on can be taken over, and sets *prevIndex to the
+    // index of the first of them.
+    bool canReuseItemsOf(
+            const sp<M3UParser> &previous, size_t *prevIndex) const;
+
+    int32_t mediaSequence() const;
+    void makeItemURI(const Item &item, AString *uri) const;
 
-    static status_t parseMetaDataDuration(
+    static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
 
     status_t parseStreamInf(
@@ -93,6 +142,11 @@ private:
 
     status_t parseMedia(const AString &line);
 
+    void parseServerControl(const AString &line);
+
+    static status_t parseDurationUs(
+            const char *line, size_t size, int64_t *durationUs);
+
     static status_t ParseInt32(const char *s, int32_t *x);
     static status_t ParseDouble(const char *s, double *x);
 
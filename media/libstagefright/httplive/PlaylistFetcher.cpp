@@ -23,6 +23,7 @@
 #include "LiveDataSource.h"
 #include "LiveSession.h"
 #include "M3UParser.h"
+#include "SegmentPrefetcher.h"
 
 #include "include/avc_utils.h"
 #include "include/HTTPBase.h"
@@ -40,7 +41,7 @@
 #include <media/stagefright/Utils.h>
 
 #include <ctype.h>
-#include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/md5.h>
 
 namespace android {
@@ -49,7 +50,144 @@ namespace android {
 const int64_t PlaylistFetcher::kMinBufferedDurationUs = 10000000ll;
 const int64_t PlaylistFetcher::kMaxMonitorDelayUs = 3000000ll;
 const int32_t PlaylistFetcher::kDownloadBlockSize = 192;
+const int32_t PlaylistFetcher::kMaxDownloadBlockSize = 47 * 1024;
 const int32_t PlaylistFetcher::kNumSkipFrames = 10;
+const size_t PlaylistFetcher::kMaxNumCachedKeys = 8;
+
+// Downloads keys and holds blocking playlist reloads on its own looper and
+// HTTP connection, so the fetcher's looper never waits for the network.
+// Each result is posted to the fetcher when done.
+struct PlaylistFetcher::BackgroundDownloader : public AHandler {
+    enum {
+        kWhatFetchKey       = 'ftch',
+        kWhatReloadPlaylist = 'rlod',
+    };
+
+    BackgroundDownloader(const sp<LiveSession> &session, const char *name)
+        : mSession(session),
+          mName(name),
+          mLooper(new ALooper),
+          mHTTPDataSource(HTTPBase::Create(
+                  (session->mFlags & LiveSession::kFlagIncognito)
+                    ? HTTPBase::kFlagIncognito
+                    : 0)) {
+        if (session->mUIDValid) {
+            mHTTPDataSource->setUID(session->mUID);
+        }
+    }
+
+    void start() {
+        mSession->addPrefetchDataSource(mHTTPDataSource);
+
+        mLooper->setName(mName.c_str());
+        mLooper->start();
+        mLooper->registerHandler(this);
+    }
+
+    void stop() {
+        mSession->removePrefetchDataSource(mHTTPDataSource);
+
+        // Unblocks a download in progress.
+        mHTTPDataSource->disconnect();
+        mLooper->unregisterHandler(id());
+        mLooper->stop();
+    }
+
+    // "notify" is posted with the key in "buffer", or an error in "err".
+    void fetchKey(const AString &keyURI, const sp<AMessage> &notify) {
+        sp<AMessage> msg = new AMessage(kWhatFetchKey, id());
+        msg->setString("uri", keyURI.c_str());
+        msg->setMessage("notify", notify);
+        msg->post();
+    }
+
+    // "notify" is posted with the reloaded playlist in "playlist" (none if
+    // it failed or was unchanged), "unchanged" and the playlist's new hash
+    // in "hash". playlistHash is that of "previous".
+    void reloadPlaylist(
+            const AString &uri, const uint8_t *playlistHash,
+            const sp<M3UParser> &previous, const sp<AMessage> &notify) {
+        sp<ABuffer> hash = new ABuffer(16);
+        memcpy(hash->data(), playlistHash, hash->size());
+
+        sp<AMessage> msg = new AMessage(kWhatReloadPlaylist, id());
+        msg->setString("uri", uri.c_str());
+        msg->setBuffer("hash", hash);
+        if (previous != NULL) {
+            msg->setObject("previous", previous);
+        }
+        msg->setMessage("notify", notify);
+        msg->post();
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        AString uri;
+        sp<AMessage> notify;
+        CHECK(msg->findString("uri", &uri));
+        CHECK(msg->findMessage("notify", &notify));
+
+        switch (msg->what()) {
+            case kWhatFetchKey:
+            {
+                sp<ABuffer> key;
+                ssize_t err = mSession->fetchFile(
+                        uri.c_str(), &key, 0 /* range_offset */,
+                        -1 /* range_length */, 0 /* block_size */,
+                        NULL /* source */, NULL /* actualUrl */,
+                        mHTTPDataSource);
+
+                notify->setString("uri", uri.c_str());
+                if (err < 0) {
+                    notify->setInt32("err", ERROR_IO);
+                } else if (key->size() != 16) {
+                    notify->setInt32("err", ERROR_MALFORMED);
+                } else {
+                    notify->setInt32("err", OK);
+                    notify->setBuffer("buffer", key);
+                }
+                break;
+            }
+
+            case kWhatReloadPlaylist:
+            {
+                sp<ABuffer> hash;
+                CHECK(msg->findBuffer("hash", &hash));
+
+                sp<RefBase> obj;
+                sp<M3UParser> previous;
+                if (msg->findObject("previous", &obj)) {
+                    previous = static_cast<M3UParser *>(obj.get());
+                }
+
+                bool unchanged;
+                sp<M3UParser> playlist = mSession->fetchPlaylist(
+                        uri.c_str(), hash->data(), &unchanged, previous,
+                        mHTTPDataSource);
+
+                if (playlist != NULL) {
+                    notify->setObject("playlist", playlist);
+                }
+                notify->setInt32("unchanged", unchanged);
+                notify->setBuffer("hash", hash);
+                break;
+            }
+
+            default:
+                TRESPASS();
+        }
+
+        notify->post();
+    }
+
+private:
+    sp<LiveSession> mSession;
+    AString mName;
+    sp<ALooper> mLooper;
+    sp<HTTPBase> mHTTPDataSource;
+
+    DISALLOW_EVIL_CONSTRUCTORS(BackgroundDownloader);
+};
 
 PlaylistFetcher::PlaylistFetcher(
         const sp<AMessage> &notify,
@@ -63,6 +201,10 @@ PlaylistFetcher::PlaylistFetcher(
       mStartTimeUs(-1ll),
       mMinStartTimeUs(0ll),
       mStopParams(NULL),
+      mKeyWaitGeneration(-1),
+      mReloadPending(false),
+      mReloadGeneration(0),
+      mReloadWaitGeneration(-1),
       mLastPlaylistFetchTimeUs(-1ll),
       mSeqNumber(-1),
       mNumRetries(0),
@@ -70,15 +212,36 @@ PlaylistFetcher::PlaylistFetcher(
       mPrepared(false),
       mNextPTSTimeUs(-1ll),
       mMonitorQueueGeneration(0),
+      mStreamingPrefetch(false),
+      mSegmentDecryptedSize(0),
+      mSegmentDiscontinuity(false),
+      mSegmentFetchStartUs(0ll),
+      mStartRequestTimeUs(-1ll),
+      mNumSegmentsFetched(0),
+      mNumSegmentsPrefetched(0),
+      mBytesFetched(0ll),
+      mFetchTimeUs(0ll),
       mRefreshState(INITIAL_MINIMUM_RELOAD_DELAY),
       mFirstPTSValid(false),
-      mAbsoluteTimeAnchorUs(0ll) {
+      mAbsoluteTimeAnchorUs(0ll),
+      mAESContext(NULL),
+      mSegmentEncrypted(false),
+      mBytesDecrypted(0ll),
+      mDecryptCpuTimeNs(0ll) {
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mStartTimeUsNotify->setInt32("what", kWhatStartedAt);
     mStartTimeUsNotify->setInt32("streamMask", 0);
 }
 
 PlaylistFetcher::~PlaylistFetcher() {
+    stopPrefetcher();
+    stopKeyPrefetcher();
+    stopPlaylistReloader();
+
+    if (mAESContext != NULL) {
+        EVP_CIPHER_CTX_free(mAESContext);
+        mAESContext = NULL;
+    }
 }
 
 int64_t PlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
@@ -96,20 +259,29 @@ int64_t PlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
     CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
     CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
-    int64_t segmentStartUs = 0ll;
-    for (int32_t index = 0;
-            index < seqNumber - firstSeqNumberInPlaylist; ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
+    return mPlaylist->getItemStartTimeUs(seqNumber - firstSeqNumberInPlaylist);
+}
 
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
+int32_t PlaylistFetcher::getBlockingReloadSeqNumber() const {
+    if (mPlaylist == NULL
+            || !mPlaylist->canBlockReload()
+            || mPlaylist->isComplete()
+            || mSeqNumber < 0) {
+        return -1;
+    }
 
-        segmentStartUs += itemDurationUs;
+    int32_t firstSeqNumberInPlaylist;
+    if (mPlaylist->meta() == NULL || !mPlaylist->meta()->findInt32(
+                "media-sequence", &firstSeqNumberInPlaylist)) {
+        firstSeqNumberInPlaylist = 0;
     }
 
-    return segmentStartUs;
+    int32_t nextSeqNumberInPlaylist =
+        firstSeqNumberInPlaylist + (int32_t)mPlaylist->size();
+
+    // Only block while waiting for the segment to appear, the server
+    // rejects requests for segments too far ahead.
+    return mSeqNumber >= nextSeqNumberInPlaylist ? nextSeqNumberInPlaylist : -1;
 }
 
 int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
@@ -120,10 +292,17 @@ int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
         return 0ll;
     }
 
-    if (mPlaylist->isComplete()) {
+    if (mPlaylist->isComplete() || mReloadPending) {
+        // A pending blocking reload refreshes the playlist once the server
+        // answers or it times out.
         return (~0llu >> 1);
     }
 
+    if (getBlockingReloadSeqNumber() >= 0) {
+        // The server holds the request until there is something new.
+        return 0ll;
+    }
+
     int32_t targetDurationSecs;
     CHECK(mPlaylist->meta()->findInt32("target-duration", &targetDurationSecs));
 
@@ -136,11 +315,8 @@ int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
         {
             size_t n = mPlaylist->size();
             if (n > 0) {
-                sp<AMessage> itemMeta;
-                CHECK(mPlaylist->itemAt(n - 1, NULL /* uri */, &itemMeta));
-
                 int64_t itemDurationUs;
-                CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
+                CHECK(mPlaylist->getItemDurationUs(n - 1, &itemDurationUs));
 
                 minPlaylistAgeUs = itemDurationUs;
                 break;
@@ -176,27 +352,150 @@ int64_t PlaylistFetcher::delayUsToRefreshPlaylist() const {
     return delayUs > 0ll ? delayUs : 0ll;
 }
 
-status_t PlaylistFetcher::decryptBuffer(
-        size_t playlistIndex, const sp<ABuffer> &buffer,
-        bool first) {
+bool PlaylistFetcher::findCipherMeta(
+        size_t playlistIndex, sp<AMessage> *itemMeta) const {
+    // The attributes of an EXT-X-KEY tag only appear on the item that
+    // follows it and apply until the next one.
+    for (ssize_t i = playlistIndex; i >= 0; --i) {
+        sp<AMessage> meta;
+        CHECK(mPlaylist->itemAt(i, NULL /* uri */, &meta));
+
+        AString method;
+        if (meta->findString("cipher-method", &method)) {
+            *itemMeta = meta;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+status_t PlaylistFetcher::fetchKey(const AString &keyURI, sp<ABuffer> *key) {
+    ssize_t index = mAESKeyForURI.indexOfKey(keyURI);
+
+    if (index >= 0) {
+        *key = mAESKeyForURI.valueAt(index);
+    } else {
+        ssize_t err = mSession->fetchFile(keyURI.c_str(), key);
+
+        if (err < 0) {
+            ALOGE("failed to fetch cipher key from '%s'.", keyURI.c_str());
+            return ERROR_IO;
+        } else if ((*key)->size() != 16) {
+            ALOGE("key file '%s' wasn't 16 bytes in size.", keyURI.c_str());
+            return ERROR_MALFORMED;
+        }
+
+        addKeyToCache(keyURI, *key);
+    }
+
+    (*key)->meta()->setInt64("lastUsedUs", ALooper::GetNowUs());
+
+    return OK;
+}
+
+void PlaylistFetcher::addKeyToCache(
+        const AString &keyURI, const sp<ABuffer> &key) {
+    if (mAESKeyForURI.size() >= kMaxNumCachedKeys) {
+        // Streams that rotate keys would otherwise accumulate them
+        // forever, drop the one that went unused the longest.
+        size_t oldest = 0;
+        int64_t oldestUs = 0ll;
+        for (size_t i = 0; i < mAESKeyForURI.size(); ++i) {
+            int64_t lastUsedUs;
+            CHECK(mAESKeyForURI.valueAt(i)->meta()->findInt64(
+                        "lastUsedUs", &lastUsedUs));
+
+            if (i == 0 || lastUsedUs < oldestUs) {
+                oldest = i;
+                oldestUs = lastUsedUs;
+            }
+        }
+
+        mAESKeyForURI.removeItemsAt(oldest);
+    }
+
+    key->meta()->setInt64("lastUsedUs", ALooper::GetNowUs());
+    mAESKeyForURI.add(keyURI, key);
+}
+
+void PlaylistFetcher::prefetchNextKey(size_t playlistIndex) {
+    if (playlistIndex + 1 >= mPlaylist->size()) {
+        return;
+    }
+
     sp<AMessage> itemMeta;
-    bool found = false;
-    AString method;
+    AString method, keyURI;
+    if (!findCipherMeta(playlistIndex + 1, &itemMeta)
+            || !itemMeta->findString("cipher-method", &method)
+            || !(method == "AES-128")
+            || !itemMeta->findString("cipher-uri", &keyURI)
+            || mAESKeyForURI.indexOfKey(keyURI) >= 0
+            || !mPendingKeyURI.empty()) {
+        return;
+    }
 
-    for (ssize_t i = playlistIndex; i >= 0; --i) {
-        AString uri;
-        CHECK(mPlaylist->itemAt(i, &uri, &itemMeta));
+    ALOGV("prefetching key for segment %d", mSeqNumber + 1);
 
-        if (itemMeta->findString("cipher-method", &method)) {
-            found = true;
-            break;
+    if (mKeyPrefetcher == NULL) {
+        mKeyPrefetcher = new BackgroundDownloader(mSession, "KeyPrefetch");
+        mKeyPrefetcher->start();
+    }
+
+    mPendingKeyURI = keyURI;
+    mKeyPrefetcher->fetchKey(keyURI, new AMessage(kWhatKeyPrefetched, id()));
+}
+
+void PlaylistFetcher::onKeyPrefetched(const sp<AMessage> &msg) {
+    AString keyURI;
+    int32_t err;
+    CHECK(msg->findString("uri", &keyURI));
+    CHECK(msg->findInt32("err", &err));
+
+    if (keyURI == mPendingKeyURI) {
+        mPendingKeyURI.clear();
+    }
+
+    sp<ABuffer> key;
+    if (err == OK) {
+        CHECK(msg->findBuffer("buffer", &key));
+
+        if (mAESKeyForURI.indexOfKey(keyURI) < 0) {
+            addKeyToCache(keyURI, key);
         }
+    } else {
+        // Not fatal yet, it will be retried once the segment is due.
+        ALOGW("failed to prefetch key '%s'", keyURI.c_str());
+    }
+
+    if (mKeyWaitGeneration >= 0) {
+        // Stale if the fetcher was stopped, paused or seeked meanwhile.
+        sp<AMessage> downloadNext = new AMessage(kWhatDownloadNext, id());
+        downloadNext->setInt32("generation", mKeyWaitGeneration);
+        downloadNext->post();
+
+        mKeyWaitGeneration = -1;
+    }
+}
+
+void PlaylistFetcher::stopKeyPrefetcher() {
+    if (mKeyPrefetcher == NULL) {
+        return;
     }
 
-    if (!found) {
+    mKeyPrefetcher->stop();
+    mKeyPrefetcher.clear();
+}
+
+status_t PlaylistFetcher::initDecryption(size_t playlistIndex) {
+    mSegmentEncrypted = false;
+
+    sp<AMessage> itemMeta;
+    AString method;
+    if (!findCipherMeta(playlistIndex, &itemMeta)
+            || !itemMeta->findString("cipher-method", &method)) {
         method = "NONE";
     }
-    buffer->meta()->setString("cipher-method", method.c_str());
 
     if (method == "NONE") {
         return OK;
@@ -211,83 +510,97 @@ status_t PlaylistFetcher::decryptBuffer(
         return ERROR_MALFORMED;
     }
 
-    ssize_t index = mAESKeyForURI.indexOfKey(keyURI);
+    if (keyURI == mPendingKeyURI && mAESKeyForURI.indexOfKey(keyURI) < 0) {
+        ALOGV("waiting for prefetch of key '%s'", keyURI.c_str());
+        mKeyWaitGeneration = mMonitorQueueGeneration;
+        return -EWOULDBLOCK;
+    }
 
     sp<ABuffer> key;
-    if (index >= 0) {
-        key = mAESKeyForURI.valueAt(index);
-    } else {
-        ssize_t err = mSession->fetchFile(keyURI.c_str(), &key);
+    status_t err = fetchKey(keyURI, &key);
+    if (err != OK) {
+        return err;
+    }
 
-        if (err < 0) {
-            ALOGE("failed to fetch cipher key from '%s'.", keyURI.c_str());
-            return ERROR_IO;
-        } else if (key->size() != 16) {
-            ALOGE("key file '%s' wasn't 16 bytes in size.", keyURI.c_str());
+    // Read the iv from the manifest or derive it from the file's sequence
+    // number.
+    uint8_t iv[16];
+    memset(iv, 0, sizeof(iv));
+
+    AString ivString;
+    if (itemMeta->findString("cipher-iv", &ivString)) {
+        if ((!ivString.startsWith("0x") && !ivString.startsWith("0X"))
+                || ivString.size() != 16 * 2 + 2) {
+            ALOGE("malformed cipher IV '%s'.", ivString.c_str());
             return ERROR_MALFORMED;
         }
 
-        mAESKeyForURI.add(keyURI, key);
+        for (size_t i = 0; i < 16; ++i) {
+            char c1 = tolower(ivString.c_str()[2 + 2 * i]);
+            char c2 = tolower(ivString.c_str()[3 + 2 * i]);
+            if (!isxdigit(c1) || !isxdigit(c2)) {
+                ALOGE("malformed cipher IV '%s'.", ivString.c_str());
+                return ERROR_MALFORMED;
+            }
+            uint8_t nibble1 = isdigit(c1) ? c1 - '0' : c1 - 'a' + 10;
+            uint8_t nibble2 = isdigit(c2) ? c2 - '0' : c2 - 'a' + 10;
+
+            iv[i] = nibble1 << 4 | nibble2;
+        }
+    } else {
+        iv[15] = mSeqNumber & 0xff;
+        iv[14] = (mSeqNumber >> 8) & 0xff;
+        iv[13] = (mSeqNumber >> 16) & 0xff;
+        iv[12] = (mSeqNumber >> 24) & 0xff;
     }
 
-    AES_KEY aes_key;
-    if (AES_set_decrypt_key(key->data(), 128, &aes_key) != 0) {
+    if (mAESContext == NULL) {
+        mAESContext = EVP_CIPHER_CTX_new();
+        CHECK(mAESContext != NULL);
+    }
+
+    if (!EVP_DecryptInit_ex(
+                mAESContext, EVP_aes_128_cbc(), NULL, key->data(), iv)) {
         ALOGE("failed to set AES decryption key.");
         return UNKNOWN_ERROR;
     }
 
-    size_t n = buffer->size();
-    if (!n) {
+    // Padding is checked and stripped by checkDecryptPadding once the whole
+    // segment is in.
+    EVP_CIPHER_CTX_set_padding(mAESContext, 0);
+
+    mSegmentEncrypted = true;
+
+    return OK;
+}
+
+status_t PlaylistFetcher::decryptSpan(
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    if (!mSegmentEncrypted || size == 0) {
         return OK;
     }
-    CHECK(n % 16 == 0);
-
-    if (first) {
-        // If decrypting the first block in a file, read the iv from the manifest
-        // or derive the iv from the file's sequence number.
 
-        AString iv;
-        if (itemMeta->findString("cipher-iv", &iv)) {
-            if ((!iv.startsWith("0x") && !iv.startsWith("0X"))
-                    || iv.size() != 16 * 2 + 2) {
-                ALOGE("malformed cipher IV '%s'.", iv.c_str());
-                return ERROR_MALFORMED;
-            }
+    CHECK_EQ(size % 16, 0u);
+    CHECK_LE(offset + size, buffer->size());
 
-            memset(mAESInitVec, 0, sizeof(mAESInitVec));
-            for (size_t i = 0; i < 16; ++i) {
-                char c1 = tolower(iv.c_str()[2 + 2 * i]);
-                char c2 = tolower(iv.c_str()[3 + 2 * i]);
-                if (!isxdigit(c1) || !isxdigit(c2)) {
-                    ALOGE("malformed cipher IV '%s'.", iv.c_str());
-                    return ERROR_MALFORMED;
-                }
-                uint8_t nibble1 = isdigit(c1) ? c1 - '0' : c1 - 'a' + 10;
-                uint8_t nibble2 = isdigit(c2) ? c2 - '0' : c2 - 'a' + 10;
+    nsecs_t startNs = systemTime(SYSTEM_TIME_THREAD);
 
-                mAESInitVec[i] = nibble1 << 4 | nibble2;
-            }
-        } else {
-            memset(mAESInitVec, 0, sizeof(mAESInitVec));
-            mAESInitVec[15] = mSeqNumber & 0xff;
-            mAESInitVec[14] = (mSeqNumber >> 8) & 0xff;
-            mAESInitVec[13] = (mSeqNumber >> 16) & 0xff;
-            mAESInitVec[12] = (mSeqNumber >> 24) & 0xff;
-        }
+    uint8_t *data = buffer->data() + offset;
+    int outSize;
+    if (!EVP_DecryptUpdate(mAESContext, data, &outSize, data, size)
+            || (size_t)outSize != size) {
+        ALOGE("failed to decrypt %d bytes", (int)size);
+        return UNKNOWN_ERROR;
     }
 
-    AES_cbc_encrypt(
-            buffer->data(), buffer->data(), buffer->size(),
-            &aes_key, mAESInitVec, AES_DECRYPT);
+    mDecryptCpuTimeNs += systemTime(SYSTEM_TIME_THREAD) - startNs;
+    mBytesDecrypted += size;
 
     return OK;
 }
 
 status_t PlaylistFetcher::checkDecryptPadding(const sp<ABuffer> &buffer) {
-    status_t err;
-    AString method;
-    CHECK(buffer->meta()->findString("cipher-method", &method));
-    if (method == "NONE") {
+    if (!mSegmentEncrypted) {
         return OK;
     }
 
@@ -296,11 +609,11 @@ status_t PlaylistFetcher::checkDecryptPadding(const sp<ABuffer> &buffer) {
         padding = buffer->data()[buffer->size() - 1];
     }
 
-    if (padding > 16) {
+    if (padding > 16 || padding > buffer->size()) {
         return ERROR_MALFORMED;
     }
 
-    for (size_t i = buffer->size() - padding; i < padding; i++) {
+    for (size_t i = buffer->size() - padding; i < buffer->size(); i++) {
         if (buffer->data()[i] != padding) {
             return ERROR_MALFORMED;
         }
@@ -435,6 +748,24 @@ void PlaylistFetcher::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatKeyPrefetched:
+        {
+            onKeyPrefetched(msg);
+            break;
+        }
+
+        case kWhatPlaylistReloaded:
+        {
+            onPlaylistReloaded(msg);
+            break;
+        }
+
+        case kWhatReloadTimeout:
+        {
+            onReloadTimeout(msg);
+            break;
+        }
+
         default:
             TRESPASS();
     }
@@ -492,6 +823,18 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
         mSeqNumber = startSeqNumberHint;
     }
 
+    if (mStartup) {
+        mStartRequestTimeUs = ALooper::GetNowUs();
+    }
+
+    if (mPrefetcher == NULL) {
+        mPrefetcher = SegmentPrefetcher::Create(mSession);
+    }
+
+    // Whatever segment was left half demuxed, the packet sources it went
+    // to are gone.
+    resetSegment();
+
     postMonitorQueue();
 
     return OK;
@@ -499,6 +842,10 @@ status_t PlaylistFetcher::onStart(const sp<AMessage> &msg) {
 
 void PlaylistFetcher::onPause() {
     cancelMonitorQueue();
+
+    // Don't leave the server holding a reload nobody waits for.
+    stopPlaylistReloader();
+    mReloadWaitGeneration = -1;
 }
 
 void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
@@ -517,6 +864,69 @@ void PlaylistFetcher::onStop(const sp<AMessage> &msg) {
 
     mPacketSources.clear();
     mStreamTypeMask = 0;
+
+    size_t numScheduled = 0, numTaken = 0, numDiscarded = 0;
+    if (mPrefetcher != NULL) {
+        mPrefetcher->getStats(&numScheduled, &numTaken, &numDiscarded);
+    }
+
+    stopPrefetcher();
+    resetSegment();
+    stopKeyPrefetcher();
+    mPendingKeyURI.clear();
+    mKeyWaitGeneration = -1;
+    stopPlaylistReloader();
+    mReloadWaitGeneration = -1;
+
+    if (mNumSegmentsFetched > 0) {
+        ALOGI("fetched %d segments (%d prefetched, %d prefetches wasted), "
+              "%lld bytes at %.2f KB/s",
+              (int)mNumSegmentsFetched, (int)mNumSegmentsPrefetched,
+              (int)numDiscarded, mBytesFetched,
+              mFetchTimeUs > 0 ? mBytesFetched * 1E6 / 1024 / mFetchTimeUs : 0.0);
+    }
+
+    if (mBytesDecrypted > 0) {
+        ALOGI("decrypted %lld bytes, %.2f ms cpu per MB",
+              mBytesDecrypted,
+              mDecryptCpuTimeNs / 1E6 / (mBytesDecrypted / 1048576.0));
+    }
+}
+
+void PlaylistFetcher::stopPrefetcher() {
+    if (mPrefetcher == NULL) {
+        return;
+    }
+
+    mPrefetcher->stop();
+    mPrefetcher.clear();
+}
+
+void PlaylistFetcher::prefetchSegments(
+        int32_t firstSeqNumberInPlaylist, int32_t lastSeqNumberInPlaylist) {
+    int32_t lastSeqNumber = mSeqNumber + (int32_t)mPrefetcher->maxSegments();
+    if (lastSeqNumber > lastSeqNumberInPlaylist) {
+        lastSeqNumber = lastSeqNumberInPlaylist;
+    }
+
+    for (int32_t seqNumber = mSeqNumber + 1;
+            seqNumber <= lastSeqNumber; ++seqNumber) {
+        AString uri;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(
+                    seqNumber - firstSeqNumberInPlaylist, &uri, &itemMeta));
+
+        int64_t rangeOffset, rangeLength;
+        if (!itemMeta->findInt64("range-offset", &rangeOffset)
+                || !itemMeta->findInt64("range-length", &rangeLength)) {
+            rangeOffset = 0;
+            rangeLength = -1;
+        }
+
+        if (!mPrefetcher->prefetch(seqNumber, uri, rangeOffset, rangeLength)) {
+            break;
+        }
+    }
 }
 
 // Resume until we have reached the boundary timestamps listed in `msg`; when
@@ -673,45 +1083,177 @@ void PlaylistFetcher::onMonitorQueue() {
 }
 
 status_t PlaylistFetcher::refreshPlaylist() {
+    if (mReloadPending) {
+        return -EWOULDBLOCK;
+    }
+
     if (delayUsToRefreshPlaylist() <= 0) {
+        int32_t blockingSeqNumber = getBlockingReloadSeqNumber();
+        if (blockingSeqNumber >= 0) {
+            startBlockingReload(blockingSeqNumber);
+            return -EWOULDBLOCK;
+        }
+
         bool unchanged;
         sp<M3UParser> playlist = mSession->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged);
+                mURI.c_str(), mPlaylistHash, &unchanged, mPlaylist);
 
-        if (playlist == NULL) {
-            if (unchanged) {
-                // We succeeded in fetching the playlist, but it was
-                // unchanged from the last time we tried.
+        return onPlaylistFetched(playlist, unchanged);
+    }
+    return OK;
+}
 
-                if (mRefreshState != THIRD_UNCHANGED_RELOAD_ATTEMPT) {
-                    mRefreshState = (RefreshState)(mRefreshState + 1);
-                }
-            } else {
-                ALOGE("failed to load playlist at url '%s'", mURI.c_str());
-                notifyError(ERROR_IO);
-                return ERROR_IO;
-            }
-        } else {
-            mRefreshState = INITIAL_MINIMUM_RELOAD_DELAY;
-            mPlaylist = playlist;
+status_t PlaylistFetcher::onPlaylistFetched(
+        const sp<M3UParser> &playlist, bool unchanged) {
+    if (playlist == NULL) {
+        if (unchanged) {
+            // We succeeded in fetching the playlist, but it was
+            // unchanged from the last time we tried.
 
-            if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
-                updateDuration();
+            if (mRefreshState != THIRD_UNCHANGED_RELOAD_ATTEMPT) {
+                mRefreshState = (RefreshState)(mRefreshState + 1);
             }
+        } else {
+            ALOGE("failed to load playlist at url '%s'", mURI.c_str());
+            notifyError(ERROR_IO);
+            return ERROR_IO;
         }
+    } else {
+        mRefreshState = INITIAL_MINIMUM_RELOAD_DELAY;
+        mPlaylist = playlist;
 
-        mLastPlaylistFetchTimeUs = ALooper::GetNowUs();
+        if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
+            updateDuration();
+        }
     }
+
+    mLastPlaylistFetchTimeUs = ALooper::GetNowUs();
     return OK;
 }
 
+void PlaylistFetcher::startBlockingReload(int32_t seqNumber) {
+    AString uri = mURI;
+    uri.append(uri.find("?") < 0 ? "?" : "&");
+    uri.append("_HLS_msn=");
+    uri.append(seqNumber);
+
+    ALOGV("blocking reload for segment %d", seqNumber);
+
+    if (mPlaylistReloader == NULL) {
+        mPlaylistReloader = new BackgroundDownloader(mSession, "PlaylistReload");
+        mPlaylistReloader->start();
+    }
+
+    mReloadPending = true;
+    ++mReloadGeneration;
+
+    sp<AMessage> notify = new AMessage(kWhatPlaylistReloaded, id());
+    notify->setInt32("generation", mReloadGeneration);
+    mPlaylistReloader->reloadPlaylist(uri, mPlaylistHash, mPlaylist, notify);
+
+    // Servers hold a blocking reload for up to three target durations.
+    int32_t targetDurationSecs;
+    CHECK(mPlaylist->meta()->findInt32("target-duration", &targetDurationSecs));
+
+    sp<AMessage> timeout = new AMessage(kWhatReloadTimeout, id());
+    timeout->setInt32("generation", mReloadGeneration);
+    timeout->post(targetDurationSecs * 3000000ll + kMaxMonitorDelayUs);
+}
+
+void PlaylistFetcher::onPlaylistReloaded(const sp<AMessage> &msg) {
+    int32_t generation;
+    CHECK(msg->findInt32("generation", &generation));
+
+    if (!mReloadPending || generation != mReloadGeneration) {
+        // Timed out, or the fetcher was stopped or paused meanwhile.
+        return;
+    }
+    mReloadPending = false;
+
+    sp<RefBase> obj;
+    sp<M3UParser> playlist;
+    if (msg->findObject("playlist", &obj)) {
+        playlist = static_cast<M3UParser *>(obj.get());
+    }
+
+    int32_t unchanged;
+    sp<ABuffer> hash;
+    CHECK(msg->findInt32("unchanged", &unchanged));
+    CHECK(msg->findBuffer("hash", &hash));
+    memcpy(mPlaylistHash, hash->data(), sizeof(mPlaylistHash));
+
+    if (onPlaylistFetched(playlist, unchanged) != OK) {
+        mReloadWaitGeneration = -1;
+        return;
+    }
+
+    resumeAfterReload();
+}
+
+void PlaylistFetcher::onReloadTimeout(const sp<AMessage> &msg) {
+    int32_t generation;
+    CHECK(msg->findInt32("generation", &generation));
+
+    if (!mReloadPending || generation != mReloadGeneration) {
+        return;
+    }
+
+    ALOGW("blocking playlist reload timed out");
+
+    // Aborts the request; the next refresh asks again.
+    stopPlaylistReloader();
+    onPlaylistFetched(NULL, true /* unchanged */);
+    resumeAfterReload();
+}
+
+void PlaylistFetcher::resumeAfterReload() {
+    if (mReloadWaitGeneration < 0) {
+        return;
+    }
+
+    // Stale if the fetcher was stopped, paused or seeked meanwhile.
+    sp<AMessage> downloadNext = new AMessage(kWhatDownloadNext, id());
+    downloadNext->setInt32("generation", mReloadWaitGeneration);
+    downloadNext->post();
+
+    mReloadWaitGeneration = -1;
+}
+
+void PlaylistFetcher::stopPlaylistReloader() {
+    // Results and timeouts of the reload in progress are stale from now on.
+    ++mReloadGeneration;
+    mReloadPending = false;
+
+    if (mPlaylistReloader == NULL) {
+        return;
+    }
+
+    mPlaylistReloader->stop();
+    mPlaylistReloader.clear();
+}
+
 // static
 bool PlaylistFetcher::bufferStartsWithTsSyncByte(const sp<ABuffer>& buffer) {
     return buffer->size() > 0 && buffer->data()[0] == 0x47;
 }
 
 void PlaylistFetcher::onDownloadNext() {
-    if (refreshPlaylist() != OK) {
+    if (mStreamingPrefetch) {
+        // More of the current segment has arrived.
+        if (streamPrefetchedSegment()) {
+            return;
+        }
+
+        // Its prefetch failed before handing over any data, start over
+        // and fetch it here.
+    }
+
+    status_t err = refreshPlaylist();
+    if (err == -EWOULDBLOCK) {
+        // Continued once the blocking reload is done.
+        mReloadWaitGeneration = mMonitorQueueGeneration;
+        return;
+    } else if (err != OK) {
         return;
     }
 
@@ -721,7 +1263,6 @@ void PlaylistFetcher::onDownloadNext() {
         firstSeqNumberInPlaylist = 0;
     }
 
-    bool seekDiscontinuity = false;
     bool explicitDiscontinuity = false;
 
     const int32_t lastSeqNumberInPlaylist =
@@ -829,108 +1370,234 @@ void PlaylistFetcher::onDownloadNext() {
 
     ALOGV("fetching '%s'", uri.c_str());
 
-    sp<DataSource> source;
-    sp<ABuffer> buffer, tsBuffer;
-    // decrypt a junk buffer to prefetch key; since a session uses only one http connection,
-    // this avoids interleaved connections to the key and segment file.
+    // Get hold of the key before starting on the segment; since a session uses only one
+    // http connection, this avoids interleaved connections to the key and segment file.
     {
-        sp<ABuffer> junk = new ABuffer(16);
-        junk->setRange(0, 16);
-        status_t err = decryptBuffer(mSeqNumber - firstSeqNumberInPlaylist, junk,
-                true /* first */);
-        if (err != OK) {
+        status_t err = initDecryption(mSeqNumber - firstSeqNumberInPlaylist);
+        if (err == -EWOULDBLOCK) {
+            return;
+        } else if (err != OK) {
             notifyError(err);
             return;
         }
     }
 
-    // block-wise download
+    resetSegment();
+    mSegmentItemMeta = itemMeta;
+    mSegmentDiscontinuity = explicitDiscontinuity;
+    mSegmentFetchStartUs = ALooper::GetNowUs();
+
+    // Stream this segment in from its prefetch if it is being downloaded in
+    // the background, and keep the next few coming. Prefetching only begins
+    // once the first segment after a start or seek has been streamed in, so
+    // that it doesn't compete for bandwidth with startup.
+    if (mPrefetcher != NULL) {
+        int32_t maxSeqNumber =
+            mSeqNumber + (int32_t)mPrefetcher->maxSegments();
+
+        // A discontinuity found above isn't found again if the prefetch
+        // fails and we come back here, so fetch the segment directly then.
+        mPrefetcher->discardOutside(
+                explicitDiscontinuity ? mSeqNumber + 1 : mSeqNumber,
+                maxSeqNumber);
+
+        if (!mStartup) {
+            prefetchSegments(firstSeqNumberInPlaylist, lastSeqNumberInPlaylist);
+        }
+
+        if (streamPrefetchedSegment()) {
+            return;
+        }
+    }
+
+    // block-wise download, the first blocks are kept small so that access
+    // units reach the decoder early, later ones grow to cut the per-block
+    // overhead.
+    sp<DataSource> source;
+    int32_t blockSize = kDownloadBlockSize;
+    int64_t downloadTimeUs = 0ll;
     ssize_t bytesRead;
     do {
+        int64_t downloadStartUs = ALooper::GetNowUs();
         bytesRead = mSession->fetchFile(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize, &source);
+                uri.c_str(), &mSegmentBuffer, range_offset, range_length,
+                blockSize, &source);
+        downloadTimeUs += ALooper::GetNowUs() - downloadStartUs;
 
         if (bytesRead < 0) {
             status_t err = bytesRead;
             ALOGE("failed to fetch .ts segment at url '%s'", uri.c_str());
+            resetSegment();
             notifyError(err);
             return;
         }
 
-        CHECK(buffer != NULL);
-
-        size_t size = buffer->size();
-        // Set decryption range.
-        buffer->setRange(size - bytesRead, bytesRead);
-        status_t err = decryptBuffer(mSeqNumber - firstSeqNumberInPlaylist, buffer,
-                buffer->offset() == 0 /* first */);
-        // Unset decryption range.
-        buffer->setRange(0, size);
-
-        if (err != OK) {
-            ALOGE("decryptBuffer failed w/ error %d", err);
+        blockSize *= 2;
+        if (blockSize > kMaxDownloadBlockSize) {
+            blockSize = kMaxDownloadBlockSize;
+        }
 
-            notifyError(err);
+        if (!onSegmentData(bytesRead)) {
             return;
         }
+    } while (bytesRead != 0);
 
-        if (mStartup || seekDiscontinuity || explicitDiscontinuity) {
-            // Signal discontinuity.
+    // Prefetches are measured by the prefetcher.
+    mSession->addBandwidthMeasurement(mSegmentBuffer->size(), downloadTimeUs);
 
-            if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
-                // If this was a live event this made no sense since
-                // we don't have access to all the segment before the current
-                // one.
-                mNextPTSTimeUs = getSegmentStartTimeUs(mSeqNumber);
-            }
+    finishSegment();
+}
 
-            if (seekDiscontinuity || explicitDiscontinuity) {
-                ALOGI("queueing discontinuity (seek=%d, explicit=%d)",
-                     seekDiscontinuity, explicitDiscontinuity);
+bool PlaylistFetcher::streamPrefetchedSegment() {
+    for (;;) {
+        // Come back once more data is in instead of blocking the looper; a
+        // stop, pause or seek meanwhile makes that message stale.
+        sp<AMessage> msg = new AMessage(kWhatDownloadNext, id());
+        msg->setInt32("generation", mMonitorQueueGeneration);
 
-                queueDiscontinuity(
-                        explicitDiscontinuity
-                            ? ATSParser::DISCONTINUITY_FORMATCHANGE
-                            : ATSParser::DISCONTINUITY_SEEK,
-                        NULL /* extra */);
+        ssize_t bytesRead = mPrefetcher->read(mSeqNumber, &mSegmentBuffer, msg);
+        if (bytesRead == -EWOULDBLOCK) {
+            ALOGV("waiting for prefetch of segment %d", mSeqNumber);
+            mStreamingPrefetch = true;
+            return true;
+        } else if (bytesRead < 0) {
+            mStreamingPrefetch = false;
+
+            if (mSegmentBuffer == NULL) {
+                // Not scheduled, or failed before any of it was demuxed.
+                return false;
             }
+
+            ALOGE("failed to prefetch segment %d", mSeqNumber);
+            resetSegment();
+            notifyError(bytesRead);
+            return true;
         }
 
-        err = OK;
-        if (bufferStartsWithTsSyncByte(buffer)) {
-            // Incremental extraction is only supported for MPEG2 transport streams.
-            if (tsBuffer == NULL) {
-                tsBuffer = new ABuffer(buffer->data(), buffer->capacity());
-                tsBuffer->setRange(0, 0);
-            } else if (tsBuffer->capacity() != buffer->capacity()) {
-                size_t tsOff = tsBuffer->offset(), tsSize = tsBuffer->size();
-                tsBuffer = new ABuffer(buffer->data(), buffer->capacity());
-                tsBuffer->setRange(tsOff, tsSize);
-            }
-            tsBuffer->setRange(tsBuffer->offset(), tsBuffer->size() + bytesRead);
+        if (!onSegmentData(bytesRead)) {
+            return true;
+        }
 
-            err = extractAndQueueAccessUnitsFromTs(tsBuffer);
+        if (bytesRead == 0) {
+            ++mNumSegmentsPrefetched;
+            finishSegment();
+            return true;
         }
+    }
+}
 
-        if (err == -EAGAIN) {
-            // bad starting sequence number hint
-            postMonitorQueue();
-            return;
+bool PlaylistFetcher::onSegmentData(ssize_t bytesRead) {
+    CHECK(mSegmentBuffer != NULL);
+
+    sp<ABuffer> buffer = mSegmentBuffer;
+
+    // Decrypt whatever whole cipher blocks have arrived, the rest is
+    // left for the next round. Only decrypted data is demuxed.
+    size_t newDataSize = buffer->size() - mSegmentDecryptedSize;
+    if (mSegmentEncrypted) {
+        if (bytesRead == 0 && newDataSize % 16 != 0) {
+            ALOGE("encrypted segment is not an even multiple of 16 bytes.");
+            resetSegment();
+            notifyError(ERROR_MALFORMED);
+            return false;
         }
 
-        if (err == ERROR_OUT_OF_RANGE) {
-            // reached stopping point
-            stopAsync(/* selfTriggered = */ true);
-            return;
+        newDataSize &= ~(size_t)15;
+    }
+
+    status_t err = decryptSpan(buffer, mSegmentDecryptedSize, newDataSize);
+
+    if (err != OK) {
+        ALOGE("decryptSpan failed w/ error %d", err);
+
+        resetSegment();
+        notifyError(err);
+        return false;
+    }
+
+    mSegmentDecryptedSize += newDataSize;
+
+    if (mStartup || mSegmentDiscontinuity) {
+        // Signal discontinuity.
+
+        if (mPlaylist->isComplete() || mPlaylist->isEvent()) {
+            // If this was a live event this made no sense since
+            // we don't have access to all the segment before the current
+            // one.
+            mNextPTSTimeUs = getSegmentStartTimeUs(mSeqNumber);
         }
 
-        if (err != OK) {
-            notifyError(err);
-            return;
+        if (mSegmentDiscontinuity) {
+            ALOGI("queueing discontinuity (explicit)");
+
+            queueDiscontinuity(
+                    ATSParser::DISCONTINUITY_FORMATCHANGE, NULL /* extra */);
         }
+    }
 
-        mStartup = false;
-    } while (bytesRead != 0);
+    err = OK;
+    if (mSegmentDecryptedSize > 0 && bufferStartsWithTsSyncByte(buffer)) {
+        // Incremental extraction is only supported for MPEG2 transport streams.
+        sp<ABuffer> &tsBuffer = mSegmentTsBuffer;
+        if (tsBuffer == NULL) {
+            tsBuffer = new ABuffer(buffer->data(), buffer->capacity());
+            tsBuffer->setRange(0, 0);
+        } else if (tsBuffer->capacity() != buffer->capacity()) {
+            size_t tsOff = tsBuffer->offset(), tsSize = tsBuffer->size();
+            tsBuffer = new ABuffer(buffer->data(), buffer->capacity());
+            tsBuffer->setRange(tsOff, tsSize);
+        }
+        tsBuffer->setRange(tsBuffer->offset(), tsBuffer->size() + newDataSize);
+
+        err = extractAndQueueAccessUnitsFromTs(tsBuffer);
+    }
+
+    if (err == -EAGAIN) {
+        // bad starting sequence number hint
+        resetSegment();
+        postMonitorQueue();
+        return false;
+    }
+
+    if (err == ERROR_OUT_OF_RANGE) {
+        // reached stopping point
+        resetSegment();
+        stopAsync(/* selfTriggered = */ true);
+        return false;
+    }
+
+    if (err != OK) {
+        resetSegment();
+        notifyError(err);
+        return false;
+    }
+
+    if (mStartup && mStartRequestTimeUs >= 0ll) {
+        ALOGI("first data of segment %d%s after %lld ms",
+              mSeqNumber, mSegmentEncrypted ? " (encrypted)" : "",
+              (ALooper::GetNowUs() - mStartRequestTimeUs) / 1000ll);
+        mStartRequestTimeUs = -1ll;
+    }
+
+    mStartup = false;
+
+    return true;
+}
+
+void PlaylistFetcher::finishSegment() {
+    sp<ABuffer> buffer = mSegmentBuffer;
+    sp<ABuffer> tsBuffer = mSegmentTsBuffer;
+    sp<AMessage> itemMeta = mSegmentItemMeta;
+
+    ++mNumSegmentsFetched;
+    mBytesFetched += buffer->size();
+    mFetchTimeUs += ALooper::GetNowUs() - mSegmentFetchStartUs;
+
+    resetSegment();
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatSegmentFetched);
+    notify->post();
 
     if (bufferStartsWithTsSyncByte(buffer)) {
         // If we still don't see a stream after fetching a full ts segment mark it as
@@ -968,9 +1635,7 @@ void PlaylistFetcher::onDownloadNext() {
 
     status_t err = OK;
     if (tsBuffer != NULL) {
-        AString method;
-        CHECK(buffer->meta()->findString("cipher-method", &method));
-        if ((tsBuffer->size() > 0 && method == "NONE")
+        if ((tsBuffer->size() > 0 && !mSegmentEncrypted)
                 || tsBuffer->size() > 16) {
             ALOGE("MPEG2 transport stream is not an even multiple of 188 "
                     "bytes in length.");
@@ -989,41 +1654,40 @@ void PlaylistFetcher::onDownloadNext() {
         return;
     }
 
-    ++mSeqNumber;
-
-    postMonitorQueue();
-}
-
-int32_t PlaylistFetcher::getSeqNumberForTime(int64_t timeUs) const {
+    // The playlist may have been reloaded while a prefetched segment was
+    // streaming in.
     int32_t firstSeqNumberInPlaylist;
     if (mPlaylist->meta() == NULL || !mPlaylist->meta()->findInt32(
                 "media-sequence", &firstSeqNumberInPlaylist)) {
         firstSeqNumberInPlaylist = 0;
     }
 
-    size_t index = 0;
-    int64_t segmentStartUs = 0;
-    while (index < mPlaylist->size()) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
+    if (mSeqNumber >= firstSeqNumberInPlaylist) {
+        prefetchNextKey(mSeqNumber - firstSeqNumberInPlaylist);
+    }
 
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
+    ++mSeqNumber;
 
-        if (timeUs < segmentStartUs + itemDurationUs) {
-            break;
-        }
+    postMonitorQueue();
+}
 
-        segmentStartUs += itemDurationUs;
-        ++index;
-    }
+void PlaylistFetcher::resetSegment() {
+    mStreamingPrefetch = false;
+    mSegmentItemMeta.clear();
+    mSegmentBuffer.clear();
+    mSegmentTsBuffer.clear();
+    mSegmentDecryptedSize = 0;
+    mSegmentDiscontinuity = false;
+}
 
-    if (index >= mPlaylist->size()) {
-        index = mPlaylist->size() - 1;
+int32_t PlaylistFetcher::getSeqNumberForTime(int64_t timeUs) const {
+    int32_t firstSeqNumberInPlaylist;
+    if (mPlaylist->meta() == NULL || !mPlaylist->meta()->findInt32(
+                "media-sequence", &firstSeqNumberInPlaylist)) {
+        firstSeqNumberInPlaylist = 0;
     }
 
-    return firstSeqNumberInPlaylist + index;
+    return firstSeqNumberInPlaylist + mPlaylist->getItemIndexForTime(timeUs);
 }
 
 status_t PlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &buffer) {
@@ -1354,17 +2018,7 @@ status_t PlaylistFetcher::extractAndQueueAccessUnits(
 }
 
 void PlaylistFetcher::updateDuration() {
-    int64_t durationUs = 0ll;
-    for (size_t index = 0; index < mPlaylist->size(); ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        durationUs += itemDurationUs;
-    }
+    int64_t durationUs = mPlaylist->getItemStartTimeUs(mPlaylist->size());
 
     sp<AMessage> msg = mNotify->dup();
     msg->setInt32("what", kWhatDurationUpdate);
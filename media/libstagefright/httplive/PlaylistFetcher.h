@@ -19,10 +19,13 @@
 #define PLAYLIST_FETCHER_H_
 
 #include <media/stagefright/foundation/AHandler.h>
+#include <utils/Timers.h>
 
 #include "mpeg2ts/ATSParser.h"
 #include "LiveSession.h"
 
+struct evp_cipher_ctx_st;
+
 namespace android {
 
 struct ABuffer;
@@ -31,6 +34,7 @@ struct DataSource;
 struct HTTPBase;
 struct LiveDataSource;
 struct M3UParser;
+struct SegmentPrefetcher;
 struct String8;
 
 struct PlaylistFetcher : public AHandler {
@@ -44,6 +48,7 @@ struct PlaylistFetcher : public AHandler {
         kWhatPrepared,
         kWhatPreparationFailed,
         kWhatStartedAt,
+        kWhatSegmentFetched,
     };
 
     PlaylistFetcher(
@@ -83,12 +88,19 @@ private:
         kWhatMonitorQueue   = 'moni',
         kWhatResumeUntil    = 'rsme',
         kWhatDownloadNext   = 'dlnx',
+        kWhatKeyPrefetched  = 'keyp',
+        kWhatPlaylistReloaded = 'rldd',
+        kWhatReloadTimeout  = 'rlto',
     };
 
+    struct BackgroundDownloader;
+
     static const int64_t kMinBufferedDurationUs;
     static const int64_t kMaxMonitorDelayUs;
     static const int32_t kDownloadBlockSize;
+    static const int32_t kMaxDownloadBlockSize;
     static const int32_t kNumSkipFrames;
+    static const size_t kMaxNumCachedKeys;
 
     static bool bufferStartsWithTsSyncByte(const sp<ABuffer>& buffer);
 
@@ -107,8 +119,24 @@ private:
     KeyedVector<LiveSession::StreamType, sp<AnotherPacketSource> >
         mPacketSources;
 
+    // AES keys by URI, each tagged with the time it was last used in its
+    // "lastUsedUs" meta entry so that the cache can be bounded.
     KeyedVector<AString, sp<ABuffer> > mAESKeyForURI;
 
+    // The next segment's key, downloading in the background. A download
+    // that needs it waits for it if mKeyWaitGeneration isn't -1.
+    sp<BackgroundDownloader> mKeyPrefetcher;
+    AString mPendingKeyURI;
+    int32_t mKeyWaitGeneration;
+
+    // Holds blocking playlist reloads, which the server answers only once
+    // the segment asked for is out. A download that needs the reloaded
+    // playlist waits for it if mReloadWaitGeneration isn't -1.
+    sp<BackgroundDownloader> mPlaylistReloader;
+    bool mReloadPending;
+    int32_t mReloadGeneration;
+    int32_t mReloadWaitGeneration;
+
     int64_t mLastPlaylistFetchTimeUs;
     sp<M3UParser> mPlaylist;
     int32_t mSeqNumber;
@@ -119,6 +147,26 @@ private:
 
     int32_t mMonitorQueueGeneration;
 
+    sp<SegmentPrefetcher> mPrefetcher;
+
+    // The segment being downloaded. A prefetched segment is demuxed block
+    // by block as its data arrives, over as many kWhatDownloadNext messages;
+    // mStreamingPrefetch is set while that is under way.
+    bool mStreamingPrefetch;
+    sp<AMessage> mSegmentItemMeta;
+    sp<ABuffer> mSegmentBuffer;
+    sp<ABuffer> mSegmentTsBuffer;
+    size_t mSegmentDecryptedSize;
+    bool mSegmentDiscontinuity;
+    int64_t mSegmentFetchStartUs;
+
+    // Download statistics, logged when the fetcher is stopped.
+    int64_t mStartRequestTimeUs;
+    size_t mNumSegmentsFetched;
+    size_t mNumSegmentsPrefetched;
+    int64_t mBytesFetched;
+    int64_t mFetchTimeUs;
+
     enum RefreshState {
         INITIAL_MINIMUM_RELOAD_DELAY,
         FIRST_UNCHANGED_RELOAD_ATTEMPT,
@@ -135,29 +183,63 @@ private:
     uint64_t mFirstPTS;
     int64_t mAbsoluteTimeAnchorUs;
 
-    // Stores the initialization vector to decrypt the next block of cipher text, which can
-    // either be derived from the sequence number, read from the manifest, or copied from
-    // the last block of cipher text (cipher-block chaining).
-    unsigned char mAESInitVec[16];
-
-    // Set first to true if decrypting the first segment of a playlist segment. When
-    // first is true, reset the initialization vector based on the available
-    // information in the manifest; otherwise, use the initialization vector as
-    // updated by the last call to AES_cbc_encrypt.
-    //
-    // For the input to decrypt correctly, decryptBuffer must be called on
-    // consecutive byte ranges on block boundaries, e.g. 0..15, 16..47, 48..63,
-    // and so on.
-    status_t decryptBuffer(
-            size_t playlistIndex, const sp<ABuffer> &buffer,
-            bool first = true);
+    // Cipher state of the segment being downloaded. The context carries the
+    // CBC chaining across calls to decryptSpan, and goes through EVP so that
+    // OpenSSL can use the CPU's AES instructions where it has them.
+    struct evp_cipher_ctx_st *mAESContext;
+    bool mSegmentEncrypted;
+
+    // Decryption statistics, logged when the fetcher is stopped.
+    int64_t mBytesDecrypted;
+    nsecs_t mDecryptCpuTimeNs;
+
+    // Looks up the cipher method of the segment at playlistIndex, fetches
+    // its key unless cached, and sets up mAESContext with the key and IV.
+    // Returns -EWOULDBLOCK if the key is still being prefetched, the
+    // download is resumed with kWhatDownloadNext once it's here.
+    status_t initDecryption(size_t playlistIndex);
+
+    // Decrypts size bytes at offset in place, size must be a multiple of 16.
+    // Must be called on consecutive byte ranges of the segment.
+    status_t decryptSpan(
+            const sp<ABuffer> &buffer, size_t offset, size_t size);
+
     status_t checkDecryptPadding(const sp<ABuffer> &buffer);
 
+    // Finds the EXT-X-KEY attributes in effect for the segment at
+    // playlistIndex, returns false if there are none.
+    bool findCipherMeta(size_t playlistIndex, sp<AMessage> *itemMeta) const;
+
+    status_t fetchKey(const AString &keyURI, sp<ABuffer> *key);
+    void addKeyToCache(const AString &keyURI, const sp<ABuffer> &key);
+
+    // Starts fetching the key of the segment following playlistIndex in the
+    // background, so it is at hand once that segment is downloaded.
+    void prefetchNextKey(size_t playlistIndex);
+    void onKeyPrefetched(const sp<AMessage> &msg);
+    void stopKeyPrefetcher();
+
     void postMonitorQueue(int64_t delayUs = 0, int64_t minDelayUs = 0);
     void cancelMonitorQueue();
 
     int64_t delayUsToRefreshPlaylist() const;
+
+    // Returns the sequence number to have the server hold a reload of the
+    // playlist for, or -1 if the playlist is to be polled.
+    int32_t getBlockingReloadSeqNumber() const;
+
+    // Reloads the playlist if it's due. Returns -EWOULDBLOCK while a
+    // blocking reload is pending.
     status_t refreshPlaylist();
+    status_t onPlaylistFetched(const sp<M3UParser> &playlist, bool unchanged);
+
+    // Has mPlaylistReloader ask for the playlist with seqNumber in it, and
+    // gives up on it after a timeout.
+    void startBlockingReload(int32_t seqNumber);
+    void onPlaylistReloaded(const sp<AMessage> &msg);
+    void onReloadTimeout(const sp<AMessage> &msg);
+    void resumeAfterReload();
+    void stopPlaylistReloader();
 
     // Returns the media time in us of the segment specified by seqNumber.
     // This is computed by summing the durations of all segments before it.
@@ -169,6 +251,25 @@ private:
     void onMonitorQueue();
     void onDownloadNext();
 
+    // Demuxes the data the prefetch of the current segment has received so
+    // far. Returns false if there's no usable prefetch of the segment, it
+    // has to be fetched directly then.
+    bool streamPrefetchedSegment();
+
+    // Decrypts and demuxes the data appended to mSegmentBuffer, bytesRead
+    // is 0 once the segment is complete. Returns false if that ended the
+    // download of the segment.
+    bool onSegmentData(ssize_t bytesRead);
+
+    void finishSegment();
+    void resetSegment();
+
+    // Schedules background downloads of the segments following mSeqNumber.
+    void prefetchSegments(
+            int32_t firstSeqNumberInPlaylist, int32_t lastSeqNumberInPlaylist);
+
+    void stopPrefetcher();
+
     // Resume a fetcher to continue until the stopping point stored in msg.
     status_t onResumeUntil(const sp<AMessage> &msg);
 
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SegmentPrefetcher"
+#include <utils/Log.h>
+
+#include "SegmentPrefetcher.h"
+
+#include "LiveSession.h"
+
+#include "include/HTTPBase.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+static const size_t kDefaultNumSegments = 2;
+static const size_t kMaxNumSegments = 4;
+
+// Data is published to the fetcher in blocks of this size, a multiple of
+// both the transport stream packet and the cipher block size.
+static const uint32_t kBlockSize = 47 * 1024;
+
+struct SegmentPrefetcher::Worker : public AHandler {
+    enum {
+        kWhatFetch = 'ftch',
+    };
+
+    Worker(SegmentPrefetcher *owner, size_t index)
+        : mOwner(owner),
+          mIndex(index),
+          mLooper(new ALooper) {
+    }
+
+    void start(const sp<HTTPBase> &httpDataSource) {
+        mHTTPDataSource = httpDataSource;
+
+        mLooper->setName("SegmentPrefetch");
+        mLooper->start();
+        mLooper->registerHandler(this);
+    }
+
+    sp<HTTPBase> httpDataSource() const {
+        return mHTTPDataSource;
+    }
+
+    void stop() {
+        // Unblocks a download in progress, the looper then exits once the
+        // current message has been handled.
+        mHTTPDataSource->disconnect();
+        mLooper->unregisterHandler(id());
+        mLooper->stop();
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        CHECK_EQ(msg->what(), (uint32_t)kWhatFetch);
+
+        int32_t seqNumber;
+        AString uri;
+        int64_t rangeOffset, rangeLength;
+        CHECK(msg->findInt32("seqNumber", &seqNumber));
+        CHECK(msg->findString("uri", &uri));
+        CHECK(msg->findInt64("rangeOffset", &rangeOffset));
+        CHECK(msg->findInt64("rangeLength", &rangeLength));
+
+        mOwner->fetchSegment(
+                mIndex, seqNumber, uri, rangeOffset, rangeLength,
+                mHTTPDataSource);
+    }
+
+private:
+    SegmentPrefetcher *mOwner;
+    size_t mIndex;
+    sp<ALooper> mLooper;
+    sp<HTTPBase> mHTTPDataSource;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Worker);
+};
+
+// static
+sp<SegmentPrefetcher> SegmentPrefetcher::Create(
+        const sp<LiveSession> &session) {
+    size_t numSegments = kDefaultNumSegments;
+
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.httplive.prefetch-segments", value, NULL)) {
+        long n = strtol(value, NULL, 10);
+        numSegments = n <= 0 ? 0 : n > (long)kMaxNumSegments
+                ? kMaxNumSegments : (size_t)n;
+    }
+
+    if (numSegments == 0) {
+        return NULL;
+    }
+
+    sp<SegmentPrefetcher> prefetcher =
+        new SegmentPrefetcher(session, numSegments);
+
+    for (size_t i = 0; i < numSegments; ++i) {
+        sp<HTTPBase> httpDataSource = HTTPBase::Create(
+                (session->mFlags & LiveSession::kFlagIncognito)
+                    ? HTTPBase::kFlagIncognito
+                    : 0);
+
+        if (session->mUIDValid) {
+            httpDataSource->setUID(session->mUID);
+        }
+
+        prefetcher->mWorkers.itemAt(i)->start(httpDataSource);
+        session->addPrefetchDataSource(httpDataSource);
+    }
+
+    return prefetcher;
+}
+
+SegmentPrefetcher::SegmentPrefetcher(
+        const sp<LiveSession> &session, size_t numWorkers)
+    : mSession(session),
+      mStopped(false),
+      mNumScheduled(0),
+      mNumTaken(0),
+      mNumDiscarded(0) {
+    for (size_t i = 0; i < numWorkers; ++i) {
+        mWorkers.push(new Worker(this, i));
+        mWorkerBusy.push(false);
+    }
+}
+
+SegmentPrefetcher::~SegmentPrefetcher() {
+    CHECK(mStopped);
+}
+
+bool SegmentPrefetcher::prefetch(
+        int32_t seqNumber, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mStopped) {
+        return false;
+    }
+
+    if (mSegments.indexOfKey(seqNumber) >= 0) {
+        return true;
+    }
+
+    size_t workerIndex = 0;
+    while (workerIndex < mWorkerBusy.size() && mWorkerBusy[workerIndex]) {
+        ++workerIndex;
+    }
+
+    if (workerIndex == mWorkerBusy.size()) {
+        return false;
+    }
+
+    Segment segment;
+    segment.mWorkerIndex = workerIndex;
+    segment.mDone = false;
+    segment.mResult = OK;
+    segment.mAvailable = 0;
+    segment.mBytesRead = 0;
+    mSegments.add(seqNumber, segment);
+
+    mWorkerBusy.editItemAt(workerIndex) = true;
+    ++mNumScheduled;
+
+    sp<AMessage> msg =
+        new AMessage(Worker::kWhatFetch, mWorkers[workerIndex]->id());
+    msg->setInt32("seqNumber", seqNumber);
+    msg->setString("uri", uri.c_str());
+    msg->setInt64("rangeOffset", rangeOffset);
+    msg->setInt64("rangeLength", rangeLength);
+    msg->post();
+
+    ALOGV("prefetching segment %d on connection %d",
+          seqNumber, (int)workerIndex);
+
+    return true;
+}
+
+ssize_t SegmentPrefetcher::read(
+        int32_t seqNumber, sp<ABuffer> *buffer, const sp<AMessage> &notify) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSegments.indexOfKey(seqNumber);
+    if (index < 0 || mStopped) {
+        return -ENOENT;
+    }
+
+    Segment *segment = &mSegments.editValueAt(index);
+
+    if (segment->mDone && segment->mResult < 0) {
+        ssize_t result = segment->mResult;
+        mSegments.removeItemsAt(index);
+        return result;
+    }
+
+    size_t size = segment->mAvailable - segment->mBytesRead;
+    if (size == 0 && !segment->mDone) {
+        segment->mNotify = notify;
+        return -EWOULDBLOCK;
+    }
+
+    sp<ABuffer> out = *buffer;
+    if (out == NULL || out->capacity() < segment->mAvailable) {
+        size_t capacity = segment->mBuffer != NULL
+                ? segment->mBuffer->capacity() : 0;
+
+        sp<ABuffer> copy = new ABuffer(capacity);
+        copy->setRange(0, 0);
+        if (out != NULL) {
+            memcpy(copy->data(), out->data(), out->size());
+            copy->setRange(0, out->size());
+        }
+        out = copy;
+        *buffer = out;
+    }
+
+    CHECK_EQ(out->size(), segment->mBytesRead);
+
+    if (size == 0) {
+        // All of it has been handed over.
+        mSegments.removeItemsAt(index);
+        ++mNumTaken;
+        return 0;
+    }
+
+    // The worker doesn't touch the published part of its buffer, nor the
+    // buffer's base pointer.
+    memcpy(out->data() + out->size(),
+           segment->mBuffer->base() + segment->mBytesRead, size);
+    out->setRange(0, out->size() + size);
+    segment->mBytesRead += size;
+
+    return size;
+}
+
+void SegmentPrefetcher::discardOutside(
+        int32_t minSeqNumber, int32_t maxSeqNumber) {
+    Mutex::Autolock autoLock(mLock);
+
+    size_t i = 0;
+    while (i < mSegments.size()) {
+        int32_t seqNumber = mSegments.keyAt(i);
+        if (seqNumber >= minSeqNumber && seqNumber <= maxSeqNumber) {
+            ++i;
+            continue;
+        }
+
+        ALOGV("discarding prefetched segment %d", seqNumber);
+
+        mSegments.removeItemsAt(i);
+        ++mNumDiscarded;
+    }
+}
+
+void SegmentPrefetcher::stop() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mStopped) {
+            return;
+        }
+
+        mStopped = true;
+        mSegments.clear();
+    }
+
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mSession->removePrefetchDataSource(
+                mWorkers.itemAt(i)->httpDataSource());
+        mWorkers.itemAt(i)->stop();
+    }
+
+    ALOGV("stopped, %d segments scheduled, %d used, %d discarded",
+          (int)mNumScheduled, (int)mNumTaken, (int)mNumDiscarded);
+}
+
+void SegmentPrefetcher::getStats(
+        size_t *numScheduled, size_t *numTaken, size_t *numDiscarded) const {
+    Mutex::Autolock autoLock(mLock);
+
+    *numScheduled = mNumScheduled;
+    *numTaken = mNumTaken;
+    *numDiscarded = mNumDiscarded;
+}
+
+void SegmentPrefetcher::fetchSegment(
+        size_t workerIndex, int32_t seqNumber,
+        const AString &uri, int64_t rangeOffset, int64_t rangeLength,
+        const sp<HTTPBase> &httpDataSource) {
+    int64_t startUs = ALooper::GetNowUs();
+
+    sp<DataSource> source;
+    sp<ABuffer> buffer;
+    ssize_t result;
+    for (;;) {
+        result = mSession->fetchFile(
+                uri.c_str(), &buffer, rangeOffset, rangeLength, kBlockSize,
+                &source, NULL /* actualUrl */, httpDataSource);
+
+        if (result <= 0) {
+            break;
+        }
+
+        if (!onSegmentData(workerIndex, seqNumber, buffer)) {
+            ALOGV("abandoning discarded segment %d", seqNumber);
+            break;
+        }
+    }
+
+    int64_t delayUs = ALooper::GetNowUs() - startUs;
+    size_t size = buffer != NULL ? buffer->size() : 0;
+
+    ALOGV("fetched %d bytes in %lld us", (int)size, delayUs);
+
+    if (size > 0) {
+        mSession->addBandwidthMeasurement(size, delayUs);
+    }
+
+    onSegmentFetched(workerIndex, seqNumber, result < 0 ? result : size);
+}
+
+bool SegmentPrefetcher::onSegmentData(
+        size_t workerIndex, int32_t seqNumber, const sp<ABuffer> &buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSegments.indexOfKey(seqNumber);
+    if (index < 0 || mSegments.valueAt(index).mWorkerIndex != workerIndex) {
+        return false;
+    }
+
+    Segment *segment = &mSegments.editValueAt(index);
+    segment->mBuffer = buffer;
+    segment->mAvailable = buffer->size();
+
+    if (segment->mNotify != NULL) {
+        segment->mNotify->post();
+        segment->mNotify.clear();
+    }
+
+    return true;
+}
+
+void SegmentPrefetcher::onSegmentFetched(
+        size_t workerIndex, int32_t seqNumber, ssize_t result) {
+    Mutex::Autolock autoLock(mLock);
+
+    mWorkerBusy.editItemAt(workerIndex) = false;
+
+    ssize_t index = mSegments.indexOfKey(seqNumber);
+    if (index < 0 || mSegments.valueAt(index).mWorkerIndex != workerIndex) {
+        // Discarded while we were downloading it.
+        return;
+    }
+
+    Segment *segment = &mSegments.editValueAt(index);
+    segment->mDone = true;
+    segment->mResult = result;
+
+    if (result < 0) {
+        ALOGW("failed to prefetch segment %d (%d)", seqNumber, (int)result);
+    }
+
+    if (segment->mNotify != NULL) {
+        segment->mNotify->post();
+        segment->mNotify.clear();
+    }
+}
+
+}  // namespace android
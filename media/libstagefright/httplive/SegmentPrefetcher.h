@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEGMENT_PREFETCHER_H_
+
+#define SEGMENT_PREFETCHER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+struct AMessage;
+struct HTTPBase;
+struct LiveSession;
+
+// Downloads up to a fixed number of media segments ahead of the one a
+// PlaylistFetcher is currently streaming, each over its own HTTP connection
+// and on its own thread. The data of a segment is handed back by sequence
+// number block by block as it arrives, still encrypted, so the fetcher can
+// demux a segment whose download is still under way. Segments are dropped
+// once the fetcher moves past them.
+//
+// The number of segments is taken from the property
+// "media.httplive.prefetch-segments" (default 2), 0 disables prefetching.
+struct SegmentPrefetcher : public RefBase {
+    // Returns NULL if prefetching is disabled.
+    static sp<SegmentPrefetcher> Create(const sp<LiveSession> &session);
+
+    size_t maxSegments() const { return mWorkers.size(); }
+
+    // Starts downloading "seqNumber" in the background unless it is already
+    // pending or all connections are busy. Returns true if the segment is
+    // (or already was) scheduled.
+    bool prefetch(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength);
+
+    // Appends the data of "seqNumber" that arrived since the last call to
+    // "buffer", allocating or growing it as needed, and returns the number
+    // of bytes appended. Returns 0 once the download has finished and all
+    // of it was handed over, the segment is forgotten then. Returns
+    // -EWOULDBLOCK if nothing new has arrived yet, "notify" is then posted
+    // with the next block unless the segment is discarded or the prefetcher
+    // stopped first. Returns -ENOENT if the segment was never scheduled,
+    // the download's error if it failed.
+    ssize_t read(
+            int32_t seqNumber, sp<ABuffer> *buffer,
+            const sp<AMessage> &notify);
+
+    // Forgets all segments outside [minSeqNumber, maxSeqNumber]. Downloads
+    // still in progress are abandoned after their current block.
+    void discardOutside(int32_t minSeqNumber, int32_t maxSeqNumber);
+
+    // Aborts all downloads and stops the worker threads, must be called
+    // before the last reference is dropped.
+    void stop();
+
+    void getStats(
+            size_t *numScheduled, size_t *numTaken, size_t *numDiscarded) const;
+
+protected:
+    virtual ~SegmentPrefetcher();
+
+private:
+    struct Worker;
+
+    struct Segment {
+        size_t mWorkerIndex;
+        bool mDone;
+        ssize_t mResult;
+
+        // The worker's download buffer and the size of the data in it when
+        // it was last published. The worker only appends to the buffer, or
+        // moves on to a larger copy, so the published part can be copied
+        // out while the download goes on.
+        sp<ABuffer> mBuffer;
+        size_t mAvailable;
+
+        // Bytes handed over by read() so far.
+        size_t mBytesRead;
+
+        sp<AMessage> mNotify;
+    };
+
+    mutable Mutex mLock;
+
+    sp<LiveSession> mSession;
+    Vector<sp<Worker> > mWorkers;
+    Vector<bool> mWorkerBusy;
+    KeyedVector<int32_t, Segment> mSegments;
+    bool mStopped;
+
+    size_t mNumScheduled;
+    size_t mNumTaken;
+    size_t mNumDiscarded;
+
+    SegmentPrefetcher(const sp<LiveSession> &session, size_t numWorkers);
+
+    // Called on the worker threads.
+    void fetchSegment(
+            size_t workerIndex, int32_t seqNumber,
+            const AString &uri, int64_t rangeOffset, int64_t rangeLength,
+            const sp<HTTPBase> &httpDataSource);
+
+    // Publishes the data downloaded so far, returns false if the segment
+    // has been discarded and the download can be abandoned.
+    bool onSegmentData(
+            size_t workerIndex, int32_t seqNumber, const sp<ABuffer> &buffer);
+
+    void onSegmentFetched(size_t workerIndex, int32_t seqNumber, ssize_t result);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SegmentPrefetcher);
+};
+
+}  // namespace android
+
+#endif  // SEGMENT_PREFETCHER_H_
@@ -0,0 +1,668 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "hlsbench"
+#include <utils/Log.h>
+
+#include "LiveSession.h"
+
+#include "wifi-display/GatherList.h"
+#include "wifi-display/source/TSPacketizer.h"
+
+#include <arpa/inet.h>
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/ANetworkSession.h>
+#include <media/stagefright/foundation/ParsedMessage.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Serves a generated VOD playlist of H.264 transport stream segments over
+// HTTP on the loopback interface and plays it through LiveSession, taking
+// the video access units as fast as they come. Each connection is throttled
+// to a fixed bandwidth, and every response starts only after a fixed delay
+// that stands in for the round trip. Reports the time to the first access
+// unit and the throughput up to the end of the stream. Run it with -p 0 and
+// with prefetching on to compare the two.
+
+namespace android {
+
+// A minimal HTTP/1.1 server on top of ANetworkSession. Responses on one
+// connection go out in order, in chunks paced to the bandwidth.
+struct Server : public AHandler {
+    Server(const sp<ANetworkSession> &netSession,
+           int32_t bytesPerSec, int64_t responseDelayUs)
+        : mNumRequests(0),
+          mBytesSent(0ll),
+          mNetSession(netSession),
+          mBytesPerSec(bytesPerSec),
+          mResponseDelayUs(responseDelayUs),
+          mSessionID(0) {
+    }
+
+    void addFile(const char *path, const char *mime, const sp<ABuffer> &data) {
+        File file;
+        file.mMime = mime;
+        file.mData = data;
+        mFiles.add(AString(path), file);
+    }
+
+    status_t start(unsigned *port) {
+        struct in_addr addr;
+        addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        status_t err = UNKNOWN_ERROR;
+        for (*port = 8080; *port < 8180; ++*port) {
+            err = mNetSession->createRTSPServer(
+                    addr, *port, new AMessage(kWhatNetworkNotify, id()),
+                    &mSessionID);
+
+            if (err == OK) {
+                break;
+            }
+        }
+
+        return err;
+    }
+
+    void stop() {
+        mNetSession->destroySession(mSessionID);
+    }
+
+    // Read these once the server looper has stopped.
+    size_t mNumRequests;
+    int64_t mBytesSent;
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        switch (msg->what()) {
+            case kWhatNetworkNotify:
+            {
+                int32_t reason, sessionID;
+                CHECK(msg->findInt32("reason", &reason));
+                CHECK(msg->findInt32("sessionID", &sessionID));
+
+                if (reason == ANetworkSession::kWhatClientConnected) {
+                    mConnections.add(sessionID, Connection());
+                } else if (reason == ANetworkSession::kWhatError) {
+                    // The client went away, or, for the server session
+                    // itself, something is badly wrong.
+                    CHECK_NE(sessionID, mSessionID);
+
+                    mConnections.removeItem(sessionID);
+                    mNetSession->destroySession(sessionID);
+                } else if (reason == ANetworkSession::kWhatData) {
+                    sp<RefBase> obj;
+                    CHECK(msg->findObject("data", &obj));
+
+                    onRequest(
+                            sessionID,
+                            static_cast<ParsedMessage *>(obj.get()));
+                }
+                break;
+            }
+
+            case kWhatSendMore:
+            {
+                int32_t sessionID;
+                CHECK(msg->findInt32("sessionID", &sessionID));
+
+                onSendMore(sessionID);
+                break;
+            }
+
+            default:
+                TRESPASS();
+        }
+    }
+
+private:
+    enum {
+        kWhatNetworkNotify,
+        kWhatSendMore,
+    };
+
+    static const size_t kChunkSize = 16 * 1024;
+
+    struct File {
+        AString mMime;
+        sp<ABuffer> mData;
+    };
+
+    struct Connection {
+        Connection() : mOffset(0), mSending(false) {}
+
+        List<sp<ABuffer> > mResponses;
+        size_t mOffset;
+        bool mSending;
+    };
+
+    sp<ANetworkSession> mNetSession;
+    int32_t mBytesPerSec;
+    int64_t mResponseDelayUs;
+    int32_t mSessionID;
+
+    KeyedVector<AString, File> mFiles;
+    KeyedVector<int32_t, Connection> mConnections;
+
+    void onRequest(int32_t sessionID, const sp<ParsedMessage> &request) {
+        ssize_t index = mConnections.indexOfKey(sessionID);
+        if (index < 0) {
+            return;
+        }
+
+        AString method, uri;
+        CHECK(request->getRequestField(0, &method));
+        CHECK(request->getRequestField(1, &uri));
+
+        ssize_t queryStart = uri.find("?");
+        if (queryStart >= 0) {
+            uri.erase(queryStart, uri.size() - queryStart);
+        }
+
+        ALOGV("%s %s", method.c_str(), uri.c_str());
+        ++mNumRequests;
+
+        ssize_t fileIndex = mFiles.indexOfKey(uri);
+
+        AString header;
+        sp<ABuffer> body;
+        if (fileIndex < 0) {
+            header = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        } else {
+            const File &file = mFiles.valueAt(fileIndex);
+
+            header = StringPrintf(
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: %s\r\n"
+                    "Content-Length: %d\r\n"
+                    "\r\n",
+                    file.mMime.c_str(), (int)file.mData->size());
+
+            if (!(method == "HEAD")) {
+                body = file.mData;
+            }
+        }
+
+        size_t size = header.size() + (body != NULL ? body->size() : 0);
+        sp<ABuffer> response = new ABuffer(size);
+        memcpy(response->data(), header.c_str(), header.size());
+        if (body != NULL) {
+            memcpy(response->data() + header.size(),
+                   body->data(), body->size());
+        }
+
+        Connection *connection = &mConnections.editValueAt(index);
+        connection->mResponses.push_back(response);
+
+        if (!connection->mSending) {
+            connection->mSending = true;
+            postSendMore(sessionID, mResponseDelayUs);
+        }
+    }
+
+    void onSendMore(int32_t sessionID) {
+        ssize_t index = mConnections.indexOfKey(sessionID);
+        if (index < 0) {
+            return;
+        }
+
+        Connection *connection = &mConnections.editValueAt(index);
+        const sp<ABuffer> &response = *connection->mResponses.begin();
+
+        size_t size = response->size() - connection->mOffset;
+        if (size > kChunkSize) {
+            size = kChunkSize;
+        }
+
+        status_t err = mNetSession->sendRequest(
+                sessionID, response->data() + connection->mOffset, size);
+
+        if (err != OK) {
+            mConnections.removeItemsAt(index);
+            mNetSession->destroySession(sessionID);
+            return;
+        }
+
+        mBytesSent += size;
+        connection->mOffset += size;
+
+        int64_t delayUs = size * 1000000ll / mBytesPerSec;
+
+        if (connection->mOffset == response->size()) {
+            connection->mResponses.erase(connection->mResponses.begin());
+            connection->mOffset = 0;
+
+            if (connection->mResponses.empty()) {
+                connection->mSending = false;
+                return;
+            }
+
+            delayUs += mResponseDelayUs;
+        }
+
+        postSendMore(sessionID, delayUs);
+    }
+
+    void postSendMore(int32_t sessionID, int64_t delayUs) {
+        sp<AMessage> msg = new AMessage(kWhatSendMore, id());
+        msg->setInt32("sessionID", sessionID);
+        msg->post(delayUs);
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(Server);
+};
+
+// Records what LiveSession tells its player.
+struct SessionObserver : public AHandler {
+    SessionObserver()
+        : mPreparedUs(-1ll),
+          mError(OK) {
+    }
+
+    int64_t preparedUs() {
+        Mutex::Autolock autoLock(mLock);
+        return mPreparedUs;
+    }
+
+    status_t error() {
+        Mutex::Autolock autoLock(mLock);
+        return mError;
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int32_t what;
+        CHECK(msg->findInt32("what", &what));
+
+        Mutex::Autolock autoLock(mLock);
+
+        switch (what) {
+            case LiveSession::kWhatPrepared:
+            {
+                mPreparedUs = ALooper::GetNowUs();
+                break;
+            }
+
+            case LiveSession::kWhatPreparationFailed:
+            case LiveSession::kWhatError:
+            {
+                status_t err;
+                CHECK(msg->findInt32("err", &err));
+
+                // The end of the stream is signalled as an error, too.
+                if (err != ERROR_END_OF_STREAM) {
+                    mError = err;
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+private:
+    Mutex mLock;
+    int64_t mPreparedUs;
+    status_t mError;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SessionObserver);
+};
+
+static sp<ABuffer> MakeFrame(unsigned nalType, size_t size) {
+    sp<ABuffer> frame = new ABuffer(size);
+
+    uint8_t *data = frame->data();
+    data[0] = 0x00;
+    data[1] = 0x00;
+    data[2] = 0x00;
+    data[3] = 0x01;
+    data[4] = 0x60 | nalType;
+
+    // Never emulates a start code.
+    for (size_t i = 5; i < size; ++i) {
+        data[i] = 1 + (rand() % 255);
+    }
+
+    return frame;
+}
+
+// Packetizes a synthetic H.264 stream, one IDR frame per second, into
+// transport stream segments that each start with an IDR frame.
+static void MakeSegments(
+        int32_t bitrate, int32_t frameRate,
+        int32_t segmentDurationSecs, int32_t numSegments,
+        Vector<sp<ABuffer> > *segments) {
+    static const uint8_t kSPS[] = {
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x28,
+        0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0x84,
+    };
+
+    static const uint8_t kPPS[] = {
+        0x00, 0x00, 0x00, 0x01, 0x68, 0xeb, 0xe3, 0xcb,
+    };
+
+    sp<ABuffer> csd0 = new ABuffer(sizeof(kSPS));
+    memcpy(csd0->data(), kSPS, sizeof(kSPS));
+
+    sp<ABuffer> csd1 = new ABuffer(sizeof(kPPS));
+    memcpy(csd1->data(), kPPS, sizeof(kPPS));
+
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", MEDIA_MIMETYPE_VIDEO_AVC);
+    format->setBuffer("csd-0", csd0);
+    format->setBuffer("csd-1", csd1);
+
+    sp<TSPacketizer> packetizer = new TSPacketizer(0);
+    ssize_t trackIndex = packetizer->addTrack(format);
+    CHECK_GE(trackIndex, 0);
+
+    packetizer->extractCSDIfNecessary(trackIndex);
+
+    // The IDR frames are four times the size of the others.
+    size_t frameSize = bitrate / 8 / frameRate;
+    size_t PFrameSize = frameSize * frameRate / (frameRate + 3);
+
+    sp<ABuffer> IDRFrame = MakeFrame(5 /* nalType */, 4 * PFrameSize);
+    sp<ABuffer> PFrame = MakeFrame(1 /* nalType */, PFrameSize);
+
+    int32_t framesPerSegment = frameRate * segmentDurationSecs;
+    for (int32_t i = 0; i < numSegments; ++i) {
+        AString data;
+
+        for (int32_t j = 0; j < framesPerSegment; ++j) {
+            int32_t frameIndex = i * framesPerSegment + j;
+
+            const sp<ABuffer> &frame =
+                (frameIndex % frameRate) == 0 ? IDRFrame : PFrame;
+
+            sp<ABuffer> accessUnit = new ABuffer(frame->size());
+            memcpy(accessUnit->data(), frame->data(), frame->size());
+
+            accessUnit->meta()->setInt64(
+                    "timeUs", (frameIndex * 1000000ll) / frameRate);
+
+            uint32_t flags = TSPacketizer::PREPEND_SPS_PPS_TO_IDR_FRAMES;
+            if ((j % 3) == 0) {
+                flags |= TSPacketizer::EMIT_PAT_AND_PMT;
+                flags |= TSPacketizer::EMIT_PCR;
+            }
+
+            GatherList tsPackets;
+            CHECK_EQ((status_t)OK,
+                     packetizer->packetize(
+                         trackIndex, accessUnit, &tsPackets, flags,
+                         NULL, 0));
+
+            sp<ABuffer> packets = tsPackets.flatten();
+            data.append((const char *)packets->data(), packets->size());
+        }
+
+        sp<ABuffer> segment = new ABuffer(data.size());
+        memcpy(segment->data(), data.c_str(), data.size());
+        segments->push(segment);
+    }
+}
+
+}  // namespace android
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-b bandwidth] [-l delay] [-r bitrate] "
+                    "[-d duration] [-n segments] [-p segments]\n"
+                    "       -b  bandwidth per connection in kbit/sec "
+                    "(default 8000)\n"
+                    "       -l  ms before each response starts (default 50)\n"
+                    "       -r  video bitrate in kbit/sec (default 4000)\n"
+                    "       -d  seconds per segment (default 4)\n"
+                    "       -n  number of segments (default 15)\n"
+                    "       -p  sets media.httplive.prefetch-segments, "
+                    "0 disables prefetching\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int32_t bandwidthKbps = 8000;
+    int32_t responseDelayMs = 50;
+    int32_t bitrateKbps = 4000;
+    int32_t segmentDurationSecs = 4;
+    int32_t numSegments = 15;
+    const char *prefetchSegments = NULL;
+
+    int res;
+    while ((res = getopt(argc, argv, "hb:l:r:d:n:p:")) >= 0) {
+        switch (res) {
+            case 'b':
+            {
+                bandwidthKbps = atoi(optarg);
+                break;
+            }
+
+            case 'l':
+            {
+                responseDelayMs = atoi(optarg);
+                break;
+            }
+
+            case 'r':
+            {
+                bitrateKbps = atoi(optarg);
+                break;
+            }
+
+            case 'd':
+            {
+                segmentDurationSecs = atoi(optarg);
+                break;
+            }
+
+            case 'n':
+            {
+                numSegments = atoi(optarg);
+                break;
+            }
+
+            case 'p':
+            {
+                prefetchSegments = optarg;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    if (optind != argc || bandwidthKbps <= 0 || responseDelayMs < 0
+            || bitrateKbps <= 0 || segmentDurationSecs <= 0
+            || numSegments <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (prefetchSegments != NULL
+            && property_set(
+                "media.httplive.prefetch-segments", prefetchSegments) != 0) {
+        fprintf(stderr, "could not set media.httplive.prefetch-segments\n");
+        return 1;
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("media.httplive.prefetch-segments", value, "default");
+
+    static const int32_t kFrameRate = 30;
+
+    Vector<sp<ABuffer> > segments;
+    MakeSegments(
+            bitrateKbps * 1000, kFrameRate, segmentDurationSecs, numSegments,
+            &segments);
+
+    sp<ANetworkSession> netSession = new ANetworkSession;
+    CHECK_EQ((status_t)OK, netSession->start());
+
+    sp<ALooper> serverLooper = new ALooper;
+    serverLooper->setName("hlsbench server");
+
+    sp<Server> server = new Server(
+            netSession, bandwidthKbps * 1000 / 8, responseDelayMs * 1000ll);
+    serverLooper->registerHandler(server);
+
+    AString playlist = StringPrintf(
+            "#EXTM3U\n"
+            "#EXT-X-VERSION:3\n"
+            "#EXT-X-TARGETDURATION:%d\n"
+            "#EXT-X-MEDIA-SEQUENCE:0\n",
+            segmentDurationSecs);
+
+    int64_t segmentBytes = 0ll;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        AString name = StringPrintf("segment%d.ts", (int)i);
+
+        playlist.append(StringPrintf("#EXTINF:%d,\n", segmentDurationSecs));
+        playlist.append(name);
+        playlist.append("\n");
+
+        server->addFile(
+                StringPrintf("/%s", name.c_str()).c_str(), "video/mp2t",
+                segments[i]);
+        segmentBytes += segments[i]->size();
+    }
+    playlist.append("#EXT-X-ENDLIST\n");
+
+    sp<ABuffer> playlistData = new ABuffer(playlist.size());
+    memcpy(playlistData->data(), playlist.c_str(), playlist.size());
+    server->addFile(
+            "/index.m3u8", "application/vnd.apple.mpegurl", playlistData);
+
+    serverLooper->start();
+
+    unsigned port;
+    CHECK_EQ((status_t)OK, server->start(&port));
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("hlsbench");
+
+    sp<SessionObserver> observer = new SessionObserver;
+    looper->registerHandler(observer);
+
+    sp<LiveSession> session =
+        new LiveSession(new AMessage(0, observer->id()));
+    looper->registerHandler(session);
+
+    looper->start();
+
+    AString url = StringPrintf("http://127.0.0.1:%u/index.m3u8", port);
+
+    int64_t startUs = ALooper::GetNowUs();
+    session->connectAsync(url.c_str());
+
+    // Give up if nothing arrives for this long.
+    static const int64_t kStallTimeoutUs = 30000000ll;
+
+    int64_t firstAccessUnitUs = -1ll;
+    int64_t lastProgressUs = startUs;
+    size_t numAccessUnits = 0;
+    status_t err;
+    for (;;) {
+        if (observer->error() != OK) {
+            err = observer->error();
+            break;
+        }
+
+        sp<ABuffer> accessUnit;
+        err = session->dequeueAccessUnit(
+                LiveSession::STREAMTYPE_VIDEO, &accessUnit);
+
+        int64_t nowUs = ALooper::GetNowUs();
+
+        if (err == OK) {
+            if (firstAccessUnitUs < 0ll) {
+                firstAccessUnitUs = nowUs;
+            }
+            ++numAccessUnits;
+            lastProgressUs = nowUs;
+            continue;
+        } else if (err == INFO_DISCONTINUITY) {
+            continue;
+        } else if (err != -EWOULDBLOCK && err != -EAGAIN) {
+            break;
+        }
+
+        if (nowUs - lastProgressUs > kStallTimeoutUs) {
+            err = TIMED_OUT;
+            break;
+        }
+
+        usleep(5000);
+    }
+
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+
+    session->disconnect();
+    looper->stop();
+
+    server->stop();
+    serverLooper->stop();
+    netSession->stop();
+
+    if (err != ERROR_END_OF_STREAM) {
+        fprintf(stderr, "playback failed (%d)\n", err);
+        return 1;
+    }
+
+    int64_t preparedUs = observer->preparedUs();
+    int64_t mediaDurationUs =
+        (int64_t)numSegments * segmentDurationSecs * 1000000ll;
+
+    printf("prefetch-segments %s, %d kbit/s per connection, "
+           "%d ms response delay\n",
+           value, bandwidthKbps, responseDelayMs);
+
+    printf("prepared after %lld ms, first access unit after %lld ms\n",
+           preparedUs >= 0ll ? (preparedUs - startUs) / 1000ll : -1ll,
+           firstAccessUnitUs >= 0ll
+                ? (firstAccessUnitUs - startUs) / 1000ll : -1ll);
+
+    printf("%d access units, %lld bytes of segments in %.2f secs, "
+           "%.2f Mbit/s, %.1fx realtime\n",
+           (int)numAccessUnits, segmentBytes, elapsedUs / 1E6,
+           segmentBytes * 8.0 / elapsedUs,
+           (double)mediaDurationUs / elapsedUs);
+
+    printf("%d requests, %lld bytes sent\n",
+           (int)server->mNumRequests, server->mBytesSent);
+
+    return 0;
+}
@@ -339,6 +339,7 @@ private:
     struct Stats {
         int mFd;
         String8 mURI;
+        wp<NuCachedSource2> mCachedSource;
         int64_t mBitrate;
 
         // FIXME:
@@ -26,6 +26,7 @@ namespace android {
 
 struct ALooper;
 struct PageCache;
+struct RangeCache;
 
 struct NuCachedSource2 : public DataSource {
     NuCachedSource2(
@@ -59,6 +60,10 @@ struct NuCachedSource2 : public DataSource {
     status_t getEstimatedBandwidthKbps(int32_t *kbps);
     status_t setCacheStatCollectFreq(int32_t freqMs);
 
+    // Appends cache occupancy, hit ratios and the amount of data fetched
+    // more than once.
+    void dump(String8 *result) const;
+
     static void RemoveCacheSpecificHeaders(
             KeyedVector<String8, String8> *headers,
             String8 *cacheConfig,
@@ -75,6 +80,20 @@ private:
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
 
+        // Pages that leave the prefetch window are kept in memory up to
+        // this amount, unless overridden by the cache parameters.
+        kDefaultRetainedBytes           = 8 * 1024 * 1024,
+
+        // Retained pages within this distance of either end of the stream
+        // are evicted last.
+        kPinnedRegionSize               = 1024 * 1024,
+
+        // A run of retained pages shorter than this is fetched again
+        // rather than reconnecting twice to skip over it.
+        kMinAdoptedRunSize              = 256 * 1024,
+
+        kDefaultMaxSpillBytes           = 64 * 1024 * 1024,
+
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
         kDefaultKeepAliveIntervalUs     = 15000000,
@@ -98,6 +117,7 @@ private:
     Condition mCondition;
 
     PageCache *mCache;
+    RangeCache *mRangeCache;
     off64_t mCacheOffset;
     status_t mFinalStatus;
     off64_t mLastAccessPos;
@@ -115,6 +135,14 @@ private:
 
     bool mDisconnectAtHighwatermark;
 
+    int64_t mNumReads;
+    int64_t mNumWindowHits;
+    int64_t mNumRetainedHits;
+    int64_t mNumSpillHits;
+    int64_t mBytesFetched;
+    int64_t mBytesRefetched;
+    int64_t mBytesAdopted;
+
     void onMessageReceived(const sp<AMessage> &msg);
     void onFetch();
     void onRead(const sp<AMessage> &msg);
@@ -123,6 +151,12 @@ private:
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    // Moves up to "maxBytes" from the start of the prefetch window into the
+    // range cache and advances the window accordingly.
+    size_t releaseFromStart_l(size_t maxBytes);
+
+    bool readFromRangeCache_l(off64_t offset, void *data, size_t size);
+
     size_t approxDataRemaining_l(status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
@@ -130,6 +164,7 @@ private:
 
     void updateCacheParamsFromSystemProperty();
     void updateCacheParamsFromString(const char *s);
+    void updateSpillParamsFromSystemProperty();
 
     DISALLOW_EVIL_CONSTRUCTORS(NuCachedSource2);
 };
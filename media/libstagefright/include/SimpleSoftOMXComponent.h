@@ -28,6 +28,7 @@
 namespace android {
 
 struct ALooper;
+struct SoftOMXLooperPool;
 
 struct SimpleSoftOMXComponent : public SoftOMXComponent {
     SimpleSoftOMXComponent(
@@ -75,18 +76,48 @@ protected:
 
     PortInfo *editPortInfo(OMX_U32 portIndex);
 
+    // In batched mode, buffers handed to emptyThisBuffer/fillThisBuffer are
+    // collected and moved onto the port queues in bulk, with a single
+    // onQueueFilled() per port per looper wakeup instead of one message and
+    // one onQueueFilled() per buffer. Must be called from the constructor.
+    void setBatchedQueueing(bool enabled);
+
 private:
     enum {
         kWhatSendCommand,
         kWhatEmptyThisBuffer,
         kWhatFillThisBuffer,
+        kWhatQueueBuffers,
+    };
+
+    struct PendingBuffer {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        uint32_t mWhat;
+        int32_t mGeneration;
     };
 
     Mutex mLock;
 
+    // Protects the buffers submitted in batched mode but not yet taken
+    // over by the looper. Never held while mLock is being acquired.
+    Mutex mPendingLock;
+    bool mBatchedQueueing;
+    List<PendingBuffer> mPendingBuffers;
+    // Bumped by the looper as it handles each command. Buffers submitted
+    // while commands are still queued are tagged with the generation that
+    // follows those commands.
+    int32_t mPendingGeneration;
+    int32_t mPendingCommands;
+    int32_t mPostedGeneration;
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<SimpleSoftOMXComponent> > mHandler;
 
+    // Non-NULL if mLooper is shared with other components, see
+    // SoftOMXLooperPool.
+    SoftOMXLooperPool *mLooperPool;
+    size_t mLooperSlot;
+
     OMX_STATETYPE mState;
     OMX_STATETYPE mTargetState;
 
@@ -136,6 +167,13 @@ private:
 
     void checkTransitions();
 
+    void postMessage(const sp<AMessage> &msg);
+    void handleMessage(const sp<AMessage> &msg);
+
+    void queueBuffer(OMX_BUFFERHEADERTYPE *header, uint32_t what);
+    OMX_U32 addToPortQueue(OMX_BUFFERHEADERTYPE *header, uint32_t what);
+    void onQueueBuffers(int32_t generation);
+
     DISALLOW_EVIL_CONSTRUCTORS(SimpleSoftOMXComponent);
 };
 
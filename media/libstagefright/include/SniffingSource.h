@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SNIFFING_SOURCE_H_
+
+#define SNIFFING_SOURCE_H_
+
+#include <media/stagefright/DataSource.h>
+
+namespace android {
+
+// Wraps the DataSource handed to the sniffers. Reads that extend the head
+// of the stream read through to the wrapped source and are kept, so that
+// later sniffers' reads of the same bytes are served from memory. Nothing
+// is read that no sniffer asked for, anything else goes to the wrapped
+// source.
+struct SniffingSource : public DataSource {
+    SniffingSource(const sp<DataSource> &source, size_t windowSize);
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    // following methods all call through to the wrapped DataSource's methods
+
+    status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual status_t reconnectAtOffset(off64_t offset) {
+        return mSource->reconnectAtOffset(offset);
+    }
+
+    virtual sp<DecryptHandle> DrmInitialization(const char *mime = NULL) {
+        return mSource->DrmInitialization(mime);
+    }
+
+    virtual void getDrmInfo(sp<DecryptHandle> &handle, DrmManagerClient **client) {
+        mSource->getDrmInfo(handle, client);
+    };
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+    virtual String8 getMIMEType() const {
+        return mSource->getMIMEType();
+    }
+
+    size_t numReads() const { return mNumReads; }
+    size_t numForwardedReads() const { return mNumForwardedReads; }
+
+protected:
+    virtual ~SniffingSource();
+
+private:
+    sp<DataSource> mSource;
+
+    uint8_t *mWindow;
+    size_t mWindowCapacity;
+    ssize_t mWindowSize;
+    bool mReachedEOS;
+
+    size_t mNumReads;
+    size_t mNumForwardedReads;
+
+    SniffingSource(const SniffingSource &);
+    SniffingSource &operator=(const SniffingSource &);
+};
+
+}  // namespace android
+
+#endif  // SNIFFING_SOURCE_H_
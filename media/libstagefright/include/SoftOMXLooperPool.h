@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOFT_OMX_LOOPER_POOL_H_
+
+#define SOFT_OMX_LOOPER_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ALooper;
+struct AMessage;
+
+// A fixed set of looper threads shared by all software OMX components in
+// the process, sized to the number of cores. Each component is pinned to
+// one looper for its lifetime, so its messages are still handled serially
+// and in order, but N components no longer need N threads.
+//
+// The pool is opt-in: it is only created if the property
+// "media.stagefright.omx-pool" is set to a non-zero value, which also caps
+// the number of threads.
+struct SoftOMXLooperPool {
+    // Returns NULL if the pool is disabled.
+    static SoftOMXLooperPool *Get();
+
+    // Appends per-thread statistics to "result", if the pool is enabled.
+    static void Dump(String8 *result);
+
+    sp<ALooper> acquire(size_t *slot);
+
+    // Must not be called from the pool's own threads. Returns once any
+    // message of the departing component still being handled on "slot"
+    // has been completed.
+    void release(size_t slot);
+
+    void noteMessageHandled(size_t slot, int64_t queuedUs, int64_t busyUs);
+
+private:
+    struct BarrierHandler;
+
+    struct Slot {
+        sp<ALooper> mLooper;
+        sp<BarrierHandler> mBarrierHandler;
+        size_t mNumComponents;
+        int64_t mNumMessages;
+        int64_t mTotalQueuedUs;
+        int64_t mMaxQueuedUs;
+        int64_t mTotalBusyUs;
+    };
+
+    static Mutex sInitLock;
+    static SoftOMXLooperPool *sPool;
+
+    Mutex mLock;
+    Vector<Slot> mSlots;
+    int64_t mStartTimeUs;
+
+    SoftOMXLooperPool(size_t numThreads);
+
+    void dump(String8 *result);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SoftOMXLooperPool);
+};
+
+}  // namespace android
+
+#endif  // SOFT_OMX_LOOPER_POOL_H_
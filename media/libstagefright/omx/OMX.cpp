@@ -123,7 +123,7 @@ void OMX::CallbackDispatcher::dispatch(const omx_message &msg) {
 
 bool OMX::CallbackDispatcher::loop() {
     for (;;) {
-        omx_message msg;
+        List<omx_message> messages;
 
         {
             Mutex::Autolock autoLock(mLock);
@@ -135,11 +135,18 @@ bool OMX::CallbackDispatcher::loop() {
                 break;
             }
 
-            msg = *mQueue.begin();
-            mQueue.erase(mQueue.begin());
+            // Components that complete several buffers per wakeup post
+            // their callbacks in bursts, deliver a whole burst at once.
+            while (!mQueue.empty()) {
+                messages.push_back(*mQueue.begin());
+                mQueue.erase(mQueue.begin());
+            }
         }
 
-        dispatch(msg);
+        for (List<omx_message>::iterator it = messages.begin();
+             it != messages.end(); ++it) {
+            dispatch(*it);
+        }
     }
 
     return false;
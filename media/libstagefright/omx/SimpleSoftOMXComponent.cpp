@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "include/SimpleSoftOMXComponent.h"
+#include "include/SoftOMXLooperPool.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -32,10 +33,22 @@ SimpleSoftOMXComponent::SimpleSoftOMXComponent(
         OMX_PTR appData,
         OMX_COMPONENTTYPE **component)
     : SoftOMXComponent(name, callbacks, appData, component),
-      mLooper(new ALooper),
+      mBatchedQueueing(false),
+      mPendingGeneration(0),
+      mPendingCommands(0),
+      mPostedGeneration(-1),
       mHandler(new AHandlerReflector<SimpleSoftOMXComponent>(this)),
+      mLooperPool(SoftOMXLooperPool::Get()),
+      mLooperSlot(0),
       mState(OMX_StateLoaded),
       mTargetState(OMX_StateLoaded) {
+    if (mLooperPool != NULL) {
+        mLooper = mLooperPool->acquire(&mLooperSlot);
+        mLooper->registerHandler(mHandler);
+        return;
+    }
+
+    mLooper = new ALooper;
     mLooper->setName(name);
     mLooper->registerHandler(mHandler);
 
@@ -51,9 +64,32 @@ void SimpleSoftOMXComponent::prepareForDestruction() {
     // a subsequent dlunload() does not pull out the rug from under us.
 
     mLooper->unregisterHandler(mHandler->id());
+
+    if (mLooperPool != NULL) {
+        // A shared looper keeps running, wait for a message of ours
+        // that it may be handling right now instead.
+        mLooperPool->release(mLooperSlot);
+        return;
+    }
+
     mLooper->stop();
 }
 
+void SimpleSoftOMXComponent::postMessage(const sp<AMessage> &msg) {
+    if (mLooperPool != NULL) {
+        msg->setInt64("postedUs", ALooper::GetNowUs());
+    }
+
+    msg->post();
+}
+
+void SimpleSoftOMXComponent::setBatchedQueueing(bool enabled) {
+    Mutex::Autolock autoLock(mPendingLock);
+    CHECK(mPendingBuffers.empty());
+
+    mBatchedQueueing = enabled;
+}
+
 OMX_ERRORTYPE SimpleSoftOMXComponent::sendCommand(
         OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data) {
     CHECK(data == NULL);
@@ -61,7 +97,12 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::sendCommand(
     sp<AMessage> msg = new AMessage(kWhatSendCommand, mHandler->id());
     msg->setInt32("cmd", cmd);
     msg->setInt32("param", param);
-    msg->post();
+
+    // Posted under mPendingLock, so that buffers submitted after this
+    // command are tagged for a batch that the looper handles after it.
+    Mutex::Autolock autoLock(mPendingLock);
+    ++mPendingCommands;
+    postMessage(msg);
 
     return OMX_ErrorNone;
 }
@@ -307,22 +348,49 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::freeBuffer(
 
 OMX_ERRORTYPE SimpleSoftOMXComponent::emptyThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatEmptyThisBuffer, mHandler->id());
-    msg->setPointer("header", buffer);
-    msg->post();
+    queueBuffer(buffer, kWhatEmptyThisBuffer);
 
     return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SimpleSoftOMXComponent::fillThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatFillThisBuffer, mHandler->id());
-    msg->setPointer("header", buffer);
-    msg->post();
+    queueBuffer(buffer, kWhatFillThisBuffer);
 
     return OMX_ErrorNone;
 }
 
+void SimpleSoftOMXComponent::queueBuffer(
+        OMX_BUFFERHEADERTYPE *header, uint32_t what) {
+    {
+        Mutex::Autolock autoLock(mPendingLock);
+
+        if (mBatchedQueueing) {
+            PendingBuffer pending;
+            pending.mHeader = header;
+            pending.mWhat = what;
+            pending.mGeneration = mPendingGeneration + mPendingCommands;
+            mPendingBuffers.push_back(pending);
+
+            // Only the first buffer of a batch needs to wake up the looper,
+            // the rest ride along with it.
+            if (mPostedGeneration == pending.mGeneration) {
+                return;
+            }
+            mPostedGeneration = pending.mGeneration;
+
+            sp<AMessage> msg = new AMessage(kWhatQueueBuffers, mHandler->id());
+            msg->setInt32("generation", pending.mGeneration);
+            postMessage(msg);
+            return;
+        }
+    }
+
+    sp<AMessage> msg = new AMessage(what, mHandler->id());
+    msg->setPointer("header", header);
+    postMessage(msg);
+}
+
 OMX_ERRORTYPE SimpleSoftOMXComponent::getState(OMX_STATETYPE *state) {
     Mutex::Autolock autoLock(mLock);
 
@@ -332,6 +400,23 @@ OMX_ERRORTYPE SimpleSoftOMXComponent::getState(OMX_STATETYPE *state) {
 }
 
 void SimpleSoftOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
+    if (mLooperPool == NULL) {
+        handleMessage(msg);
+        return;
+    }
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    handleMessage(msg);
+
+    int64_t postedUs;
+    CHECK(msg->findInt64("postedUs", &postedUs));
+
+    mLooperPool->noteMessageHandled(
+            mLooperSlot, startUs - postedUs, ALooper::GetNowUs() - startUs);
+}
+
+void SimpleSoftOMXComponent::handleMessage(const sp<AMessage> &msg) {
     Mutex::Autolock autoLock(mLock);
     uint32_t msgType = msg->what();
     ALOGV("msgType = %d", msgType);
@@ -342,6 +427,14 @@ void SimpleSoftOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
             CHECK(msg->findInt32("cmd", &cmd));
             CHECK(msg->findInt32("param", &param));
 
+            {
+                // Batches posted from now on come after this command.
+                Mutex::Autolock autoLock(mPendingLock);
+                CHECK_GT(mPendingCommands, 0);
+                --mPendingCommands;
+                ++mPendingGeneration;
+            }
+
             onSendCommand((OMX_COMMANDTYPE)cmd, (OMX_U32)param);
             break;
         }
@@ -352,40 +445,89 @@ void SimpleSoftOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
             OMX_BUFFERHEADERTYPE *header;
             CHECK(msg->findPointer("header", (void **)&header));
 
-            CHECK(mState == OMX_StateExecuting && mTargetState == mState);
+            onQueueFilled(addToPortQueue(header, msgType));
+            break;
+        }
+
+        case kWhatQueueBuffers:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
 
-            bool found = false;
-            size_t portIndex = (kWhatEmptyThisBuffer == msgType)?
-                    header->nInputPortIndex: header->nOutputPortIndex;
-            PortInfo *port = &mPorts.editItemAt(portIndex);
+            onQueueBuffers(generation);
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
 
-            for (size_t j = 0; j < port->mBuffers.size(); ++j) {
-                BufferInfo *buffer = &port->mBuffers.editItemAt(j);
+OMX_U32 SimpleSoftOMXComponent::addToPortQueue(
+        OMX_BUFFERHEADERTYPE *header, uint32_t what) {
+    CHECK(mState == OMX_StateExecuting && mTargetState == mState);
 
-                if (buffer->mHeader == header) {
-                    CHECK(!buffer->mOwnedByUs);
+    size_t portIndex = (kWhatEmptyThisBuffer == what)?
+            header->nInputPortIndex: header->nOutputPortIndex;
+    PortInfo *port = &mPorts.editItemAt(portIndex);
 
-                    buffer->mOwnedByUs = true;
+    for (size_t j = 0; j < port->mBuffers.size(); ++j) {
+        BufferInfo *buffer = &port->mBuffers.editItemAt(j);
 
-                    CHECK((msgType == kWhatEmptyThisBuffer
-                            && port->mDef.eDir == OMX_DirInput)
-                            || (port->mDef.eDir == OMX_DirOutput));
+        if (buffer->mHeader == header) {
+            CHECK(!buffer->mOwnedByUs);
 
-                    port->mQueue.push_back(buffer);
-                    onQueueFilled(portIndex);
+            buffer->mOwnedByUs = true;
 
-                    found = true;
-                    break;
-                }
-            }
+            CHECK((what == kWhatEmptyThisBuffer
+                    && port->mDef.eDir == OMX_DirInput)
+                    || (port->mDef.eDir == OMX_DirOutput));
 
-            CHECK(found);
-            break;
+            port->mQueue.push_back(buffer);
+
+            return portIndex;
         }
+    }
 
-        default:
-            TRESPASS();
-            break;
+    TRESPASS();
+    return portIndex;
+}
+
+void SimpleSoftOMXComponent::onQueueBuffers(int32_t generation) {
+    List<PendingBuffer> pending;
+
+    {
+        Mutex::Autolock autoLock(mPendingLock);
+
+        // Take everything submitted before the next command was sent,
+        // later buffers belong to a batch that was posted after it.
+        List<PendingBuffer>::iterator it = mPendingBuffers.begin();
+        while (it != mPendingBuffers.end()
+                && (*it).mGeneration - generation <= 0) {
+            pending.push_back(*it);
+            it = mPendingBuffers.erase(it);
+        }
+
+        if (mPostedGeneration == generation) {
+            // Buffers arriving from now on need a fresh wakeup.
+            mPostedGeneration = -1;
+        }
+    }
+
+    uint32_t filledPorts = 0;
+    for (List<PendingBuffer>::iterator it = pending.begin();
+         it != pending.end(); ++it) {
+        OMX_U32 portIndex = addToPortQueue((*it).mHeader, (*it).mWhat);
+
+        CHECK_LT(portIndex, 32u);
+        filledPorts |= 1u << portIndex;
+    }
+
+    for (OMX_U32 i = 0; i < mPorts.size(); ++i) {
+        if (filledPorts & (1u << i)) {
+            onQueueFilled(i);
+        }
     }
 }
 
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SoftOMXLooperPool"
+#include <utils/Log.h>
+
+#include "include/SoftOMXLooperPool.h"
+
+#include <cutils/properties.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace android {
+
+// Replies to every message it receives. Since a looper handles messages
+// in order, a reply means that whatever was running on that looper when
+// the barrier was posted has finished.
+struct SoftOMXLooperPool::BarrierHandler : public AHandler {
+    BarrierHandler() {}
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        uint32_t replyID;
+        CHECK(msg->senderAwaitsResponse(&replyID));
+
+        sp<AMessage> response = new AMessage;
+        response->postReply(replyID);
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(BarrierHandler);
+};
+
+Mutex SoftOMXLooperPool::sInitLock;
+SoftOMXLooperPool *SoftOMXLooperPool::sPool;
+
+// static
+SoftOMXLooperPool *SoftOMXLooperPool::Get() {
+    Mutex::Autolock autoLock(sInitLock);
+
+    if (sPool == NULL) {
+        char value[PROPERTY_VALUE_MAX];
+        if (!property_get("media.stagefright.omx-pool", value, NULL)) {
+            return NULL;
+        }
+
+        long maxThreads = strtol(value, NULL, 10);
+        if (maxThreads <= 0) {
+            return NULL;
+        }
+
+        long numCores = sysconf(_SC_NPROCESSORS_CONF);
+        if (numCores < 1) {
+            numCores = 1;
+        }
+
+        sPool = new SoftOMXLooperPool(
+                maxThreads < numCores ? maxThreads : numCores);
+    }
+
+    return sPool;
+}
+
+// static
+void SoftOMXLooperPool::Dump(String8 *result) {
+    SoftOMXLooperPool *pool;
+
+    {
+        Mutex::Autolock autoLock(sInitLock);
+        pool = sPool;
+    }
+
+    if (pool != NULL) {
+        pool->dump(result);
+    }
+}
+
+SoftOMXLooperPool::SoftOMXLooperPool(size_t numThreads)
+    : mStartTimeUs(ALooper::GetNowUs()) {
+    ALOGI("sharing %d looper threads among software components", numThreads);
+
+    for (size_t i = 0; i < numThreads; ++i) {
+        Slot slot;
+        slot.mLooper = new ALooper;
+        slot.mBarrierHandler = new BarrierHandler;
+        slot.mNumComponents = 0;
+        slot.mNumMessages = 0;
+        slot.mTotalQueuedUs = 0;
+        slot.mMaxQueuedUs = 0;
+        slot.mTotalBusyUs = 0;
+
+        slot.mLooper->setName(String8::format("SoftOMXPool%d", i).string());
+        slot.mLooper->registerHandler(slot.mBarrierHandler);
+
+        slot.mLooper->start(
+                false, // runOnCallingThread
+                false, // canCallJava
+                ANDROID_PRIORITY_FOREGROUND);
+
+        mSlots.push(slot);
+    }
+}
+
+sp<ALooper> SoftOMXLooperPool::acquire(size_t *slot) {
+    Mutex::Autolock autoLock(mLock);
+
+    size_t best = 0;
+    for (size_t i = 1; i < mSlots.size(); ++i) {
+        if (mSlots[i].mNumComponents < mSlots[best].mNumComponents) {
+            best = i;
+        }
+    }
+
+    Slot *info = &mSlots.editItemAt(best);
+    ++info->mNumComponents;
+
+    *slot = best;
+
+    return info->mLooper;
+}
+
+void SoftOMXLooperPool::release(size_t slot) {
+    sp<AMessage> msg;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        CHECK_LT(slot, mSlots.size());
+
+        Slot *info = &mSlots.editItemAt(slot);
+        CHECK_GT(info->mNumComponents, 0u);
+        --info->mNumComponents;
+
+        msg = new AMessage(0, info->mBarrierHandler->id());
+    }
+
+    sp<AMessage> response;
+    CHECK_EQ(msg->postAndAwaitResponse(&response), (status_t)OK);
+}
+
+void SoftOMXLooperPool::noteMessageHandled(
+        size_t slot, int64_t queuedUs, int64_t busyUs) {
+    Mutex::Autolock autoLock(mLock);
+    CHECK_LT(slot, mSlots.size());
+
+    Slot *info = &mSlots.editItemAt(slot);
+    ++info->mNumMessages;
+    info->mTotalQueuedUs += queuedUs;
+    info->mTotalBusyUs += busyUs;
+
+    if (queuedUs > info->mMaxQueuedUs) {
+        info->mMaxQueuedUs = queuedUs;
+    }
+}
+
+void SoftOMXLooperPool::dump(String8 *result) {
+    Mutex::Autolock autoLock(mLock);
+
+    int64_t elapsedUs = ALooper::GetNowUs() - mStartTimeUs;
+
+    result->appendFormat(
+            " Software OMX looper pool (%d threads):\n", mSlots.size());
+
+    for (size_t i = 0; i < mSlots.size(); ++i) {
+        const Slot &info = mSlots.itemAt(i);
+
+        double avgQueuedMs = info.mNumMessages > 0
+            ? info.mTotalQueuedUs / 1E3 / info.mNumMessages : 0.0;
+
+        result->appendFormat(
+                "  thread %d: components(%d), messages(%lld), "
+                "avg latency(%.2f ms), max latency(%.2f ms), "
+                "utilization(%.1f%%)\n",
+                i, info.mNumComponents, info.mNumMessages,
+                avgQueuedMs, info.mMaxQueuedUs / 1E3,
+                elapsedUs > 0 ? 100.0 * info.mTotalBusyUs / elapsedUs : 0.0);
+    }
+}
+
+}  // namespace android
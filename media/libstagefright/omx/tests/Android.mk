@@ -5,7 +5,8 @@ LOCAL_SRC_FILES =       \
 	OMXHarness.cpp  \
 
 LOCAL_SHARED_LIBRARIES := \
-	libstagefright libbinder libmedia libutils liblog libstagefright_foundation
+	libstagefright libbinder libmedia libutils liblog libstagefright_foundation \
+	libstagefright_omx
 
 LOCAL_C_INCLUDES := \
 	$(TOP)/frameworks/av/media/libstagefright \
@@ -20,6 +20,8 @@
 
 #include "OMXHarness.h"
 
+#include <pthread.h>
+#include <sys/resource.h>
 #include <sys/time.h>
 
 #include <binder/ProcessState.h>
@@ -37,12 +39,15 @@
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/OMXCodec.h>
 
+#include "include/OMX.h"
+
 #define DEFAULT_TIMEOUT         500000
 
 namespace android {
 
-Harness::Harness()
-    : mInitCheck(NO_INIT) {
+Harness::Harness(bool useLocalOMX)
+    : mInitCheck(NO_INIT),
+      mUseLocalOMX(useLocalOMX) {
     mInitCheck = initOMX();
 }
 
@@ -54,6 +59,13 @@ status_t Harness::initCheck() const {
 }
 
 status_t Harness::initOMX() {
+    if (mUseLocalOMX) {
+        // Host the components in this process, this makes the CPU and
+        // context switch figures reported by testThroughput meaningful.
+        mOMX = new OMX;
+        return OK;
+    }
+
     sp<IServiceManager> sm = defaultServiceManager();
     sp<IBinder> binder = sm->getService(String16("media.player"));
     sp<IMediaPlayerService> service = interface_cast<IMediaPlayerService>(binder);
@@ -508,8 +520,11 @@ static const char *GetURLForMime(const char *mime) {
     return NULL;
 }
 
+// If set, used as test content instead of the per-mime defaults.
+static const char *gContentURI;
+
 static sp<MediaSource> CreateSourceForMime(const char *mime) {
-    const char *url = GetURLForMime(mime);
+    const char *url = gContentURI != NULL ? gContentURI : GetURLForMime(mime);
 
     if (url == NULL) {
         return NULL;
@@ -736,6 +751,254 @@ status_t Harness::testSeek(
     return OK;
 }
 
+static int64_t GetCPUTimeUs(const struct rusage &usage) {
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Returns the value in kB of the given field of /proc/self/status,
+// i.e. "VmRSS" or "VmHWM", or -1 if unavailable.
+static long GetProcStatusKB(const char *field) {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    size_t fieldLength = strlen(field);
+    long valueKB = -1;
+
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (!strncmp(line, field, fieldLength) && line[fieldLength] == ':') {
+            valueKB = strtol(&line[fieldLength + 1], NULL, 10);
+            break;
+        }
+    }
+
+    fclose(file);
+
+    return valueKB;
+}
+
+static int CompareIncreasing(const int64_t *a, const int64_t *b) {
+    return (*a) < (*b) ? -1 : (*a) > (*b) ? 1 : 0;
+}
+
+// Decodes one stream to completion on its own thread.
+struct DecodeJob {
+    sp<MediaSource> mCodec;
+    bool mStarted;
+    pthread_t mThread;
+    status_t mStatus;
+    int64_t mFirstTimeUs;
+    int64_t mLastTimeUs;
+    Vector<int64_t> mFrameLatenciesUs;
+
+    static void *ThreadWrapper(void *me) {
+        static_cast<DecodeJob *>(me)->run();
+        return NULL;
+    }
+
+    void run() {
+        mStatus = OK;
+        mFirstTimeUs = -1;
+        mLastTimeUs = -1;
+
+        for (;;) {
+            MediaBuffer *buffer;
+            int64_t readStartUs = ALooper::GetNowUs();
+            status_t err = mCodec->read(&buffer);
+
+            if (err == INFO_FORMAT_CHANGED) {
+                CHECK(buffer == NULL);
+                continue;
+            } else if (err != OK) {
+                CHECK(buffer == NULL);
+                if (err != ERROR_END_OF_STREAM) {
+                    mStatus = err;
+                }
+                break;
+            }
+
+            if (buffer->range_length() > 0) {
+                mFrameLatenciesUs.push(ALooper::GetNowUs() - readStartUs);
+
+                int64_t timeUs;
+                CHECK(buffer->meta_data()->findInt64(kKeyTime, &timeUs));
+
+                if (mFirstTimeUs < 0) {
+                    mFirstTimeUs = timeUs;
+                }
+                mLastTimeUs = timeUs;
+            }
+
+            buffer->release();
+            buffer = NULL;
+        }
+    }
+};
+
+// Stops and deletes the jobs however the test returns, releasing the last
+// reference to each codec and with it, its node.
+struct DecodeJobReaper {
+    DecodeJobReaper(Vector<DecodeJob *> *jobs)
+        : mJobs(jobs) {
+    }
+
+    ~DecodeJobReaper() {
+        reap();
+    }
+
+    void reap() {
+        for (size_t i = 0; i < mJobs->size(); ++i) {
+            DecodeJob *job = (*mJobs)[i];
+
+            if (job->mStarted && job->mCodec->stop() != OK) {
+                ALOGE("Failed to stop decoder.");
+            }
+            delete job;
+        }
+        mJobs->clear();
+    }
+
+private:
+    Vector<DecodeJob *> *mJobs;
+
+    DecodeJobReaper(const DecodeJobReaper &);
+    DecodeJobReaper &operator=(const DecodeJobReaper &);
+};
+
+status_t Harness::testThroughput(
+        const char *componentName, const char *componentRole,
+        size_t numInstances) {
+    bool isEncoder =
+        !strncmp(componentRole, "audio_encoder.", 14)
+        || !strncmp(componentRole, "video_encoder.", 14);
+
+    if (isEncoder) {
+        printf("  * Not measuring throughput for encoders.\n");
+        return OK;
+    }
+
+    const char *mime = GetMimeFromComponentRole(componentRole);
+
+    if (!mime) {
+        printf("  * Cannot measure throughput with this componentRole (%s)\n",
+               componentRole);
+
+        return OK;
+    }
+
+    CHECK_GT(numInstances, 0u);
+
+    // Each instance gets its own extractor so that instances don't
+    // serialize on a shared source.
+    Vector<DecodeJob *> jobs;
+    DecodeJobReaper reaper(&jobs);
+
+    for (size_t i = 0; i < numInstances; ++i) {
+        sp<MediaSource> source = CreateSourceForMime(mime);
+
+        if (source == NULL) {
+            printf("  * Unable to open test content for type '%s', "
+                   "skipping throughput of componentRole %s\n",
+                   mime, componentRole);
+
+            break;
+        }
+
+        DecodeJob *job = new DecodeJob;
+        job->mStarted = false;
+        jobs.push(job);
+
+        job->mCodec = OMXCodec::Create(
+                mOMX, source->getFormat(), false /* createEncoder */,
+                source, componentName);
+        EXPECT(job->mCodec != NULL, "Unable to instantiate decoder.");
+
+        status_t err = job->mCodec->start();
+        EXPECT_SUCCESS(err, "start");
+        job->mStarted = true;
+    }
+
+    if (jobs.size() < numInstances) {
+        return OK;
+    }
+
+    struct rusage startUsage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &startUsage), 0);
+    int64_t startUs = ALooper::GetNowUs();
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        CHECK_EQ(pthread_create(&jobs[i]->mThread, NULL,
+                                DecodeJob::ThreadWrapper, jobs[i]), 0);
+    }
+
+    Vector<int64_t> frameLatenciesUs;
+    double mediaSecs = 0.0;
+    status_t err = OK;
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        DecodeJob *job = jobs[i];
+
+        void *dummy;
+        CHECK_EQ(pthread_join(job->mThread, &dummy), 0);
+
+        if (job->mStatus != OK) {
+            err = job->mStatus;
+        }
+
+        mediaSecs += (job->mLastTimeUs - job->mFirstTimeUs) / 1E6;
+        frameLatenciesUs.appendVector(job->mFrameLatenciesUs);
+    }
+
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    struct rusage endUsage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &endUsage), 0);
+
+    long rssKB = GetProcStatusKB("VmRSS");
+    long peakRssKB = GetProcStatusKB("VmHWM");
+
+    reaper.reap();
+
+    EXPECT(err == OK, "Decoder returned an error before reaching EOS.");
+
+    size_t numFrames = frameLatenciesUs.size();
+    EXPECT(numFrames > 1 && mediaSecs > 0 && elapsedUs > 0,
+           "Not enough output to measure throughput.");
+
+    frameLatenciesUs.sort(CompareIncreasing);
+
+    double cpuSecs =
+        (GetCPUTimeUs(endUsage) - GetCPUTimeUs(startUsage)) / 1E6;
+    long numSwitches =
+        (endUsage.ru_nvcsw - startUsage.ru_nvcsw)
+            + (endUsage.ru_nivcsw - startUsage.ru_nivcsw);
+
+    printf("\n  * %u instance(s), %u frames, %.2f secs of media in %.2f secs "
+           "(%.2fx realtime aggregate)\n",
+           (unsigned)numInstances, (unsigned)numFrames,
+           mediaSecs, elapsedUs / 1E6, mediaSecs * 1E6 / elapsedUs);
+
+    printf("  * frame latency p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, "
+           "max %.2f ms\n",
+           frameLatenciesUs[numFrames / 2] / 1E3,
+           frameLatenciesUs[numFrames * 9 / 10] / 1E3,
+           frameLatenciesUs[numFrames * 99 / 100] / 1E3,
+           frameLatenciesUs[numFrames - 1] / 1E3);
+
+    // Every looper message and callback delivery costs a thread wakeup,
+    // so context switches per second of media track the messaging overhead.
+    printf("  * cpu %.3f secs per media sec, %.1f context switches "
+           "per media sec%s\n",
+           cpuSecs / mediaSecs, numSwitches / mediaSecs,
+           mUseLocalOMX ? "" : " (client side only, use -l)");
+
+    printf("  * rss %ld kB, peak rss %ld kB\n", rssKB, peakRssKB);
+
+    return OK;
+}
+
 status_t Harness::test(
         const char *componentName, const char *componentRole) {
     printf("testing %s [%s] ... ", componentName, componentRole);
@@ -751,7 +1014,7 @@ status_t Harness::test(
     return err2;
 }
 
-status_t Harness::testAll() {
+status_t Harness::testAll(bool measureThroughput, size_t numInstances) {
     List<IOMX::ComponentInfo> componentInfos;
     status_t err = mOMX->listNodes(&componentInfos);
     EXPECT_SUCCESS(err, "listNodes");
@@ -769,7 +1032,13 @@ status_t Harness::testAll() {
              role_it != info.mRoles.end(); ++role_it) {
             const char *componentRole = (*role_it).string();
 
-            err = test(componentName, componentRole);
+            if (measureThroughput) {
+                printf("testing %s [%s] ... ", componentName, componentRole);
+                err = testThroughput(
+                        componentName, componentRole, numInstances);
+            } else {
+                err = test(componentName, componentRole);
+            }
 
             if (err == OK) {
                 printf("OK\n");
@@ -786,6 +1055,11 @@ static void usage(const char *me) {
     fprintf(stderr, "usage: %s\n"
                     "  -h(elp)  Show this information\n"
                     "  -s(eed)  Set the random seed\n"
+                    "  -l(ocal) Instantiate components in this process\n"
+                    "  -p(erf)  Measure decode throughput instead of "
+                    "testing conformance\n"
+                    "  -n       Number of concurrent instances for -p\n"
+                    "  -u       Test content URI overriding the defaults\n"
                     "    [ component role ]\n\n"
                     "When launched without specifying a specific component "
                     "and role, tool will test all available OMX components "
@@ -806,10 +1080,45 @@ int main(int argc, char **argv) {
     const char *me = argv[0];
 
     unsigned long seed = 0xdeadbeef;
+    bool useLocalOMX = false;
+    bool measureThroughput = false;
+    size_t numInstances = 1;
 
     int res;
-    while ((res = getopt(argc, argv, "hs:")) >= 0) {
+    while ((res = getopt(argc, argv, "hs:lpn:u:")) >= 0) {
         switch (res) {
+            case 'l':
+            {
+                useLocalOMX = true;
+                break;
+            }
+
+            case 'p':
+            {
+                measureThroughput = true;
+                break;
+            }
+
+            case 'n':
+            {
+                char *end;
+                long x = strtol(optarg, &end, 10);
+
+                if (*end != '\0' || end == optarg || x <= 0) {
+                    fprintf(stderr, "Malformed instance count.\n");
+                    return 1;
+                }
+
+                numInstances = x;
+                break;
+            }
+
+            case 'u':
+            {
+                gContentURI = optarg;
+                break;
+            }
+
             case 's':
             {
                 char *end;
@@ -846,13 +1155,21 @@ int main(int argc, char **argv) {
 
     srand(seed);
 
-    sp<Harness> h = new Harness;
+    sp<Harness> h = new Harness(useLocalOMX);
     CHECK_EQ(h->initCheck(), (status_t)OK);
 
     if (argc == 0) {
-        h->testAll();
+        h->testAll(measureThroughput, numInstances);
     } else if (argc == 2) {
-        if (h->test(argv[0], argv[1]) == OK) {
+        status_t err;
+        if (measureThroughput) {
+            printf("testing %s [%s] ... ", argv[0], argv[1]);
+            err = h->testThroughput(argv[0], argv[1], numInstances);
+        } else {
+            err = h->test(argv[0], argv[1]);
+        }
+
+        if (err == OK) {
             printf("OK\n");
         }
     }
@@ -39,7 +39,7 @@ struct Harness : public BnOMXObserver {
         uint32_t mFlags;
     };
 
-    Harness();
+    Harness(bool useLocalOMX = false);
 
     status_t initCheck() const;
 
@@ -69,10 +69,17 @@ struct Harness : public BnOMXObserver {
     status_t testSeek(
             const char *componentName, const char *componentRole);
 
+    // Decodes the test content with "numInstances" concurrent instances of
+    // the component and reports aggregate throughput, per-frame latency,
+    // CPU, context switches and memory use.
+    status_t testThroughput(
+            const char *componentName, const char *componentRole,
+            size_t numInstances = 1);
+
     status_t test(
             const char *componentName, const char *componentRole);
 
-    status_t testAll();
+    status_t testAll(bool measureThroughput = false, size_t numInstances = 1);
 
     virtual void onMessage(const omx_message &msg);
 
@@ -85,6 +92,7 @@ private:
     Mutex mLock;
 
     status_t mInitCheck;
+    bool mUseLocalOMX;
     sp<IOMX> mOMX;
     List<omx_message> mMessageQueue;
     Condition mMessageAddedCondition;
@@ -20,6 +20,7 @@
 
 #include "AAMRAssembler.h"
 
+#include "ARTPBufferChain.h"
 #include "ARTPSource.h"
 
 #include <media/stagefright/foundation/ABuffer.h>
@@ -100,14 +101,14 @@ static size_t getFrameSize(bool isWide, unsigned FT) {
 
 ARTPAssembler::AssemblyStatus AAMRAssembler::addPacket(
         const sp<ARTPSource> &source) {
-    List<sp<ABuffer> > *queue = source->queue();
+    ARTPPacketQueue *queue = source->queue();
 
     if (queue->empty()) {
         return NOT_ENOUGH_DATA;
     }
 
     if (mNextExpectedSeqNoValid) {
-        List<sp<ABuffer> >::iterator it = queue->begin();
+        ARTPPacketQueue::iterator it = queue->begin();
         while (it != queue->end()) {
             if ((uint32_t)(*it)->int32Data() >= mNextExpectedSeqNo) {
                 break;
@@ -149,7 +150,6 @@ ARTPAssembler::AssemblyStatus AAMRAssembler::addPacket(
     Vector<uint8_t> tableOfContents;
 
     size_t offset = 1;
-    size_t totalSize = 0;
     for (;;) {
         if (offset >= buffer->size()) {
             queue->erase(queue->begin());
@@ -174,8 +174,6 @@ ARTPAssembler::AssemblyStatus AAMRAssembler::addPacket(
             return MALFORMED_PACKET;
         }
 
-        totalSize += getFrameSize(mIsWide, (toc >> 3) & 0x0f);
-
         tableOfContents.push(toc);
 
         if (0 == (toc & 0x80)) {
@@ -183,10 +181,7 @@ ARTPAssembler::AssemblyStatus AAMRAssembler::addPacket(
         }
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
-    CopyTimes(accessUnit, buffer);
-
-    size_t dstOffset = 0;
+    ARTPBufferChain chain;
     for (size_t i = 0; i < tableOfContents.size(); ++i) {
         uint8_t toc = tableOfContents[i];
 
@@ -201,14 +196,15 @@ ARTPAssembler::AssemblyStatus AAMRAssembler::addPacket(
             return MALFORMED_PACKET;
         }
 
-        accessUnit->data()[dstOffset++] = toc;
-        memcpy(accessUnit->data() + dstOffset,
-               buffer->data() + offset, frameSize - 1);
+        chain.appendBytes(&toc, 1);
+        chain.append(buffer, offset, frameSize - 1);
 
         offset += frameSize - 1;
-        dstOffset += frameSize - 1;
     }
 
+    sp<ABuffer> accessUnit = flatten(chain);
+    CopyTimes(accessUnit, buffer);
+
     sp<AMessage> msg = mNotifyMsg->dup();
     msg->setBuffer("access-unit", accessUnit);
     msg->post();
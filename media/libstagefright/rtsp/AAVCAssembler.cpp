@@ -31,13 +31,17 @@
 
 namespace android {
 
+static const uint8_t kNALStartCode[4] = { 0x00, 0x00, 0x00, 0x01 };
+
 // static
 AAVCAssembler::AAVCAssembler(const sp<AMessage> &notify)
     : mNotifyMsg(notify),
       mAccessUnitRTPTime(0),
+      mAccessUnitSeqNo(0),
       mNextExpectedSeqNoValid(false),
       mNextExpectedSeqNo(0),
-      mAccessUnitDamaged(false) {
+      mAccessUnitDamaged(false),
+      mNumNALUnits(0) {
 }
 
 AAVCAssembler::~AAVCAssembler() {
@@ -45,14 +49,14 @@ AAVCAssembler::~AAVCAssembler() {
 
 ARTPAssembler::AssemblyStatus AAVCAssembler::addNALUnit(
         const sp<ARTPSource> &source) {
-    List<sp<ABuffer> > *queue = source->queue();
+    ARTPPacketQueue *queue = source->queue();
 
     if (queue->empty()) {
         return NOT_ENOUGH_DATA;
     }
 
     if (mNextExpectedSeqNoValid) {
-        List<sp<ABuffer> >::iterator it = queue->begin();
+        ARTPPacketQueue::iterator it = queue->begin();
         while (it != queue->end()) {
             if ((uint32_t)(*it)->int32Data() >= mNextExpectedSeqNo) {
                 break;
@@ -123,21 +127,42 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addNALUnit(
     }
 }
 
+void AAVCAssembler::beginNALUnit(const sp<ABuffer> &buffer) {
+    uint32_t rtpTime;
+    CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+
+    if (mNumNALUnits > 0 && rtpTime != mAccessUnitRTPTime) {
+        submitAccessUnit();
+    }
+    mAccessUnitRTPTime = rtpTime;
+
+    if (mNumNALUnits++ == 0) {
+        mAccessUnitSeqNo = (uint32_t)buffer->int32Data();
+    }
+}
+
 void AAVCAssembler::addSingleNALUnit(const sp<ABuffer> &buffer) {
     ALOGV("addSingleNALUnit of size %d", buffer->size());
 #if !LOG_NDEBUG
     hexdump(buffer->data(), buffer->size());
 #endif
 
-    uint32_t rtpTime;
-    CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
+    beginNALUnit(buffer);
 
-    if (!mNALUnits.empty() && rtpTime != mAccessUnitRTPTime) {
-        submitAccessUnit();
+    if (buffer->offset() >= sizeof(kNALStartCode)) {
+        // The RTP header in front of the payload has served its purpose,
+        // put the start code there. An access unit made of this NAL unit
+        // alone is then handed on without a copy.
+        buffer->setRange(
+                buffer->offset() - sizeof(kNALStartCode),
+                buffer->size() + sizeof(kNALStartCode));
+
+        memcpy(buffer->data(), kNALStartCode, sizeof(kNALStartCode));
+    } else {
+        mAccessUnit.appendBytes(kNALStartCode, sizeof(kNALStartCode));
     }
-    mAccessUnitRTPTime = rtpTime;
 
-    mNALUnits.push_back(buffer);
+    mAccessUnit.append(buffer);
 }
 
 bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
@@ -159,12 +184,10 @@ bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
             return false;
         }
 
-        sp<ABuffer> unit = new ABuffer(nalSize);
-        memcpy(unit->data(), &data[2], nalSize);
+        beginNALUnit(buffer);
 
-        CopyTimes(unit, buffer);
-
-        addSingleNALUnit(unit);
+        mAccessUnit.appendBytes(kNALStartCode, sizeof(kNALStartCode));
+        mAccessUnit.append(buffer, &data[2] - buffer->data(), nalSize);
 
         data += 2 + nalSize;
         size -= 2 + nalSize;
@@ -178,7 +201,7 @@ bool AAVCAssembler::addSingleTimeAggregationPacket(const sp<ABuffer> &buffer) {
 }
 
 ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
-        List<sp<ABuffer> > *queue) {
+        ARTPPacketQueue *queue) {
     CHECK(!queue->empty());
 
     sp<ABuffer> buffer = *queue->begin();
@@ -223,7 +246,7 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
 
         complete = true;
     } else {
-        List<sp<ABuffer> >::iterator it = ++queue->begin();
+        ARTPPacketQueue::iterator it = ++queue->begin();
         while (it != queue->end()) {
             ALOGV("sequence length %d", totalCount);
 
@@ -280,17 +303,16 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
 
     // We found all the fragments that make up the complete NAL unit.
 
-    // Leave room for the header. So far totalSize did not include the
-    // header byte.
-    ++totalSize;
+    ALOGV("NAL unit of %d bytes in %d fragments", totalSize + 1, totalCount);
+
+    beginNALUnit(*queue->begin());
 
-    sp<ABuffer> unit = new ABuffer(totalSize);
-    CopyTimes(unit, *queue->begin());
+    uint8_t header = (nri << 5) | nalType;
 
-    unit->data()[0] = (nri << 5) | nalType;
+    mAccessUnit.appendBytes(kNALStartCode, sizeof(kNALStartCode));
+    mAccessUnit.appendBytes(&header, 1);
 
-    size_t offset = 1;
-    List<sp<ABuffer> >::iterator it = queue->begin();
+    ARTPPacketQueue::iterator it = queue->begin();
     for (size_t i = 0; i < totalCount; ++i) {
         const sp<ABuffer> &buffer = *it;
 
@@ -299,45 +321,24 @@ ARTPAssembler::AssemblyStatus AAVCAssembler::addFragmentedNALUnit(
         hexdump(buffer->data(), buffer->size());
 #endif
 
-        memcpy(unit->data() + offset, buffer->data() + 2, buffer->size() - 2);
-        offset += buffer->size() - 2;
+        mAccessUnit.append(buffer, 2, buffer->size() - 2);
 
         it = queue->erase(it);
     }
 
-    unit->setRange(0, totalSize);
-
-    addSingleNALUnit(unit);
-
     ALOGV("successfully assembled a NAL unit from fragments.");
 
     return OK;
 }
 
 void AAVCAssembler::submitAccessUnit() {
-    CHECK(!mNALUnits.empty());
-
-    ALOGV("Access unit complete (%d nal units)", mNALUnits.size());
-
-    size_t totalSize = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
-         it != mNALUnits.end(); ++it) {
-        totalSize += 4 + (*it)->size();
-    }
-
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
-    size_t offset = 0;
-    for (List<sp<ABuffer> >::iterator it = mNALUnits.begin();
-         it != mNALUnits.end(); ++it) {
-        memcpy(accessUnit->data() + offset, "\x00\x00\x00\x01", 4);
-        offset += 4;
+    CHECK_GT(mNumNALUnits, 0u);
 
-        sp<ABuffer> nal = *it;
-        memcpy(accessUnit->data() + offset, nal->data(), nal->size());
-        offset += nal->size();
-    }
+    ALOGV("Access unit complete (%d nal units)", mNumNALUnits);
 
-    CopyTimes(accessUnit, *mNALUnits.begin());
+    sp<ABuffer> accessUnit = flatten(mAccessUnit);
+    accessUnit->meta()->setInt32("rtp-time", mAccessUnitRTPTime);
+    accessUnit->setInt32Data(mAccessUnitSeqNo);
 
 #if 0
     printf(mAccessUnitDamaged ? "X" : ".");
@@ -348,7 +349,8 @@ void AAVCAssembler::submitAccessUnit() {
         accessUnit->meta()->setInt32("damaged", true);
     }
 
-    mNALUnits.clear();
+    mAccessUnit.clear();
+    mNumNALUnits = 0;
     mAccessUnitDamaged = false;
 
     sp<AMessage> msg = mNotifyMsg->dup();
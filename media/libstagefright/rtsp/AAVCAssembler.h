@@ -19,14 +19,15 @@
 #define A_AVC_ASSEMBLER_H_
 
 #include "ARTPAssembler.h"
+#include "ARTPBufferChain.h"
 
-#include <utils/List.h>
 #include <utils/RefBase.h>
 
 namespace android {
 
 struct ABuffer;
 struct AMessage;
+struct ARTPPacketQueue;
 
 struct AAVCAssembler : public ARTPAssembler {
     AAVCAssembler(const sp<AMessage> &notify);
@@ -42,14 +43,23 @@ private:
     sp<AMessage> mNotifyMsg;
 
     uint32_t mAccessUnitRTPTime;
+    uint32_t mAccessUnitSeqNo;
     bool mNextExpectedSeqNoValid;
     uint32_t mNextExpectedSeqNo;
     bool mAccessUnitDamaged;
-    List<sp<ABuffer> > mNALUnits;
+
+    // The NAL units of the access unit, each behind a start code, refer to
+    // the packets they came in.
+    ARTPBufferChain mAccessUnit;
+    size_t mNumNALUnits;
 
     AssemblyStatus addNALUnit(const sp<ARTPSource> &source);
+
+    // Submits the pending access unit first if buffer starts the next one.
+    void beginNALUnit(const sp<ABuffer> &buffer);
+
     void addSingleNALUnit(const sp<ABuffer> &buffer);
-    AssemblyStatus addFragmentedNALUnit(List<sp<ABuffer> > *queue);
+    AssemblyStatus addFragmentedNALUnit(ARTPPacketQueue *queue);
     bool addSingleTimeAggregationPacket(const sp<ABuffer> &buffer);
 
     void submitAccessUnit();
@@ -51,14 +51,14 @@ ARTPAssembler::AssemblyStatus AH263Assembler::assembleMore(
 
 ARTPAssembler::AssemblyStatus AH263Assembler::addPacket(
         const sp<ARTPSource> &source) {
-    List<sp<ABuffer> > *queue = source->queue();
+    ARTPPacketQueue *queue = source->queue();
 
     if (queue->empty()) {
         return NOT_ENOUGH_DATA;
     }
 
     if (mNextExpectedSeqNoValid) {
-        List<sp<ABuffer> >::iterator it = queue->begin();
+        ARTPPacketQueue::iterator it = queue->begin();
         while (it != queue->end()) {
             if ((uint32_t)(*it)->int32Data() >= mNextExpectedSeqNo) {
                 break;
@@ -156,30 +156,7 @@ void AH263Assembler::submitAccessUnit() {
     LOG(VERBOSE) << "Access unit complete (" << mPackets.size() << " packets)";
 #endif
 
-    size_t totalSize = 0;
-    List<sp<ABuffer> >::iterator it = mPackets.begin();
-    while (it != mPackets.end()) {
-        const sp<ABuffer> &unit = *it;
-
-        totalSize += unit->size();
-        ++it;
-    }
-
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
-    size_t offset = 0;
-    it = mPackets.begin();
-    while (it != mPackets.end()) {
-        const sp<ABuffer> &unit = *it;
-
-        memcpy((uint8_t *)accessUnit->data() + offset,
-               unit->data(), unit->size());
-
-        offset += unit->size();
-
-        ++it;
-    }
-
-    CopyTimes(accessUnit, *mPackets.begin());
+    sp<ABuffer> accessUnit = MakeCompoundFromPackets(mPackets);
 
 #if 0
     printf(mAccessUnitDamaged ? "X" : ".");
@@ -50,14 +50,14 @@ ARTPAssembler::AssemblyStatus AMPEG2TSAssembler::assembleMore(
 
 ARTPAssembler::AssemblyStatus AMPEG2TSAssembler::addPacket(
         const sp<ARTPSource> &source) {
-    List<sp<ABuffer> > *queue = source->queue();
+    ARTPPacketQueue *queue = source->queue();
 
     if (queue->empty()) {
         return NOT_ENOUGH_DATA;
     }
 
     if (mNextExpectedSeqNoValid) {
-        List<sp<ABuffer> >::iterator it = queue->begin();
+        ARTPPacketQueue::iterator it = queue->begin();
         while (it != queue->end()) {
             if ((uint32_t)(*it)->int32Data() >= mNextExpectedSeqNo) {
                 break;
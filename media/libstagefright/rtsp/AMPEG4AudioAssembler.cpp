@@ -19,6 +19,7 @@
 
 #include "AMPEG4AudioAssembler.h"
 
+#include "ARTPBufferChain.h"
 #include "ARTPSource.h"
 
 #include <media/stagefright/foundation/hexdump.h>
@@ -362,8 +363,7 @@ static status_t parseStreamMuxConfig(
 sp<ABuffer> AMPEG4AudioAssembler::removeLATMFraming(const sp<ABuffer> &buffer) {
     CHECK(!mMuxConfigPresent);  // XXX to be implemented
 
-    sp<ABuffer> out = new ABuffer(buffer->size());
-    out->setRange(0, 0);
+    ARTPBufferChain out;
 
     size_t offset = 0;
     uint8_t *ptr = buffer->data();
@@ -407,8 +407,7 @@ sp<ABuffer> AMPEG4AudioAssembler::removeLATMFraming(const sp<ABuffer> &buffer) {
 
         CHECK_LE(offset + payloadLength, buffer->size());
 
-        memcpy(out->data() + out->size(), &ptr[offset], payloadLength);
-        out->setRange(0, out->size() + payloadLength);
+        out.append(buffer, offset, payloadLength);
 
         offset += payloadLength;
 
@@ -426,7 +425,7 @@ sp<ABuffer> AMPEG4AudioAssembler::removeLATMFraming(const sp<ABuffer> &buffer) {
     }
     CHECK_LE(offset, buffer->size());
 
-    return out;
+    return flatten(out);
 }
 
 AMPEG4AudioAssembler::AMPEG4AudioAssembler(
@@ -484,14 +483,14 @@ ARTPAssembler::AssemblyStatus AMPEG4AudioAssembler::assembleMore(
 
 ARTPAssembler::AssemblyStatus AMPEG4AudioAssembler::addPacket(
         const sp<ARTPSource> &source) {
-    List<sp<ABuffer> > *queue = source->queue();
+    ARTPPacketQueue *queue = source->queue();
 
     if (queue->empty()) {
         return NOT_ENOUGH_DATA;
     }
 
     if (mNextExpectedSeqNoValid) {
-        List<sp<ABuffer> >::iterator it = queue->begin();
+        ARTPPacketQueue::iterator it = queue->begin();
         while (it != queue->end()) {
             if ((uint32_t)(*it)->int32Data() >= mNextExpectedSeqNo) {
                 break;
@@ -123,6 +123,7 @@ AMPEG4ElementaryAssembler::AMPEG4ElementaryAssembler(
       mChannelConfig(0),
       mSampleRateIndex(0),
       mAccessUnitRTPTime(0),
+      mAccessUnitSeqNo(0),
       mNextExpectedSeqNoValid(false),
       mNextExpectedSeqNo(0),
       mAccessUnitDamaged(false) {
@@ -205,14 +206,14 @@ struct AUHeader {
 
 ARTPAssembler::AssemblyStatus AMPEG4ElementaryAssembler::addPacket(
         const sp<ARTPSource> &source) {
-    List<sp<ABuffer> > *queue = source->queue();
+    ARTPPacketQueue *queue = source->queue();
 
     if (queue->empty()) {
         return NOT_ENOUGH_DATA;
     }
 
     if (mNextExpectedSeqNoValid) {
-        List<sp<ABuffer> >::iterator it = queue->begin();
+        ARTPPacketQueue::iterator it = queue->begin();
         while (it != queue->end()) {
             if ((uint32_t)(*it)->int32Data() >= mNextExpectedSeqNo) {
                 break;
@@ -240,13 +241,17 @@ ARTPAssembler::AssemblyStatus AMPEG4ElementaryAssembler::addPacket(
     uint32_t rtpTime;
     CHECK(buffer->meta()->findInt32("rtp-time", (int32_t *)&rtpTime));
 
-    if (mPackets.size() > 0 && rtpTime != mAccessUnitRTPTime) {
+    if (!mAccessUnit.empty() && rtpTime != mAccessUnitRTPTime) {
         submitAccessUnit();
     }
     mAccessUnitRTPTime = rtpTime;
 
+    if (mAccessUnit.empty()) {
+        mAccessUnitSeqNo = (uint32_t)buffer->int32Data();
+    }
+
     if (!mIsGeneric) {
-        mPackets.push_back(buffer);
+        mAccessUnit.append(buffer);
     } else {
         // hexdump(buffer->data(), buffer->size());
 
@@ -344,13 +349,14 @@ ARTPAssembler::AssemblyStatus AMPEG4ElementaryAssembler::addPacket(
 
             CHECK_LE(offset + header.mSize, buffer->size());
 
-            sp<ABuffer> accessUnit = new ABuffer(header.mSize);
-            memcpy(accessUnit->data(), buffer->data() + offset, header.mSize);
+            AppendADTSFrame(
+                    &mAccessUnit,
+                    OMX_AUDIO_AACObjectLC - 1,
+                    mSampleRateIndex,
+                    mChannelConfig,
+                    buffer, offset, header.mSize);
 
             offset += header.mSize;
-
-            CopyTimes(accessUnit, buffer);
-            mPackets.push_back(accessUnit);
         }
 
         CHECK_EQ(offset, buffer->size());
@@ -363,21 +369,13 @@ ARTPAssembler::AssemblyStatus AMPEG4ElementaryAssembler::addPacket(
 }
 
 void AMPEG4ElementaryAssembler::submitAccessUnit() {
-    CHECK(!mPackets.empty());
-
-    ALOGV("Access unit complete (%d nal units)", mPackets.size());
+    CHECK(!mAccessUnit.empty());
 
-    sp<ABuffer> accessUnit;
+    ALOGV("Access unit complete (%d bytes)", mAccessUnit.size());
 
-    if (mIsGeneric) {
-        accessUnit = MakeADTSCompoundFromAACFrames(
-                OMX_AUDIO_AACObjectLC - 1,
-                mSampleRateIndex,
-                mChannelConfig,
-                mPackets);
-    } else {
-        accessUnit = MakeCompoundFromPackets(mPackets);
-    }
+    sp<ABuffer> accessUnit = flatten(mAccessUnit);
+    accessUnit->meta()->setInt32("rtp-time", mAccessUnitRTPTime);
+    accessUnit->setInt32Data(mAccessUnitSeqNo);
 
 #if 0
     printf(mAccessUnitDamaged ? "X" : ".");
@@ -388,7 +386,7 @@ void AMPEG4ElementaryAssembler::submitAccessUnit() {
         accessUnit->meta()->setInt32("damaged", true);
     }
 
-    mPackets.clear();
+    mAccessUnit.clear();
     mAccessUnitDamaged = false;
 
     sp<AMessage> msg = mNotifyMsg->dup();
@@ -19,6 +19,7 @@
 #define A_MPEG4_ELEM_ASSEMBLER_H_
 
 #include "ARTPAssembler.h"
+#include "ARTPBufferChain.h"
 
 #include <media/stagefright/foundation/AString.h>
 
@@ -63,10 +64,14 @@ private:
     size_t mSampleRateIndex;
 
     uint32_t mAccessUnitRTPTime;
+    uint32_t mAccessUnitSeqNo;
     bool mNextExpectedSeqNoValid;
     uint32_t mNextExpectedSeqNo;
     bool mAccessUnitDamaged;
-    List<sp<ABuffer> > mPackets;
+
+    // The payload of the access unit, with ADTS headers for the generic
+    // format, referring to the packets it came in.
+    ARTPBufferChain mAccessUnit;
 
     AssemblyStatus addPacket(const sp<ARTPSource> &source);
     void submitAccessUnit();
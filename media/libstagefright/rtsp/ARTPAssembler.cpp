@@ -16,6 +16,8 @@
 
 #include "ARTPAssembler.h"
 
+#include "ARTPBufferChain.h"
+
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -26,7 +28,9 @@
 namespace android {
 
 ARTPAssembler::ARTPAssembler()
-    : mFirstFailureTimeUs(-1) {
+    : mFirstFailureTimeUs(-1),
+      mNumBuffersAllocated(0),
+      mNumBytesCopied(0) {
 }
 
 void ARTPAssembler::onPacketReceived(const sp<ARTPSource> &source) {
@@ -69,72 +73,60 @@ void ARTPAssembler::CopyTimes(const sp<ABuffer> &to, const sp<ABuffer> &from) {
 }
 
 // static
-sp<ABuffer> ARTPAssembler::MakeADTSCompoundFromAACFrames(
+void ARTPAssembler::AppendADTSFrame(
+        ARTPBufferChain *chain,
         unsigned profile,
         unsigned samplingFreqIndex,
         unsigned channelConfig,
-        const List<sp<ABuffer> > &frames) {
-    size_t totalSize = 0;
-    for (List<sp<ABuffer> >::const_iterator it = frames.begin();
-         it != frames.end(); ++it) {
-        // Each frame is prefixed by a 7 byte ADTS header
-        totalSize += (*it)->size() + 7;
-    }
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    static const unsigned kADTSId = 0;
+    static const unsigned kADTSLayer = 0;
+    static const unsigned kADTSProtectionAbsent = 1;
 
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
-    size_t offset = 0;
-    for (List<sp<ABuffer> >::const_iterator it = frames.begin();
-         it != frames.end(); ++it) {
-        sp<ABuffer> nal = *it;
-        uint8_t *dst = accessUnit->data() + offset;
+    // Each frame is prefixed by a 7 byte ADTS header
+    unsigned frameLength = size + 7;
 
-        static const unsigned kADTSId = 0;
-        static const unsigned kADTSLayer = 0;
-        static const unsigned kADTSProtectionAbsent = 1;
+    uint8_t header[7];
+    header[0] = 0xff;
 
-        unsigned frameLength = nal->size() + 7;
+    header[1] =
+        0xf0 | (kADTSId << 3) | (kADTSLayer << 1) | kADTSProtectionAbsent;
 
-        dst[0] = 0xff;
+    header[2] = (profile << 6)
+            | (samplingFreqIndex << 2)
+            | (channelConfig >> 2);
 
-        dst[1] =
-            0xf0 | (kADTSId << 3) | (kADTSLayer << 1) | kADTSProtectionAbsent;
+    header[3] = ((channelConfig & 3) << 6) | (frameLength >> 11);
 
-        dst[2] = (profile << 6)
-                | (samplingFreqIndex << 2)
-                | (channelConfig >> 2);
+    header[4] = (frameLength >> 3) & 0xff;
+    header[5] = (frameLength & 7) << 5;
+    header[6] = 0x00;
 
-        dst[3] = ((channelConfig & 3) << 6) | (frameLength >> 11);
+    chain->appendBytes(header, sizeof(header));
+    chain->append(buffer, offset, size);
+}
 
-        dst[4] = (frameLength >> 3) & 0xff;
-        dst[5] = (frameLength & 7) << 5;
-        dst[6] = 0x00;
+sp<ABuffer> ARTPAssembler::flatten(const ARTPBufferChain &chain) {
+    bool copied;
+    sp<ABuffer> buffer = chain.flatten(&copied);
 
-        memcpy(dst + 7, nal->data(), nal->size());
-        offset += nal->size() + 7;
+    if (copied) {
+        ++mNumBuffersAllocated;
+        mNumBytesCopied += buffer->size();
     }
 
-    CopyTimes(accessUnit, *frames.begin());
-
-    return accessUnit;
+    return buffer;
 }
 
-// static
 sp<ABuffer> ARTPAssembler::MakeCompoundFromPackets(
         const List<sp<ABuffer> > &packets) {
-    size_t totalSize = 0;
+    ARTPBufferChain chain;
     for (List<sp<ABuffer> >::const_iterator it = packets.begin();
          it != packets.end(); ++it) {
-        totalSize += (*it)->size();
+        chain.append(*it);
     }
 
-    sp<ABuffer> accessUnit = new ABuffer(totalSize);
-    size_t offset = 0;
-    for (List<sp<ABuffer> >::const_iterator it = packets.begin();
-         it != packets.end(); ++it) {
-        sp<ABuffer> nal = *it;
-        memcpy(accessUnit->data() + offset, nal->data(), nal->size());
-        offset += nal->size();
-    }
+    sp<ABuffer> accessUnit = flatten(chain);
 
     CopyTimes(accessUnit, *packets.begin());
 
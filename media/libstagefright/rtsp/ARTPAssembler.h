@@ -25,6 +25,7 @@
 namespace android {
 
 struct ABuffer;
+struct ARTPBufferChain;
 struct ARTPSource;
 
 struct ARTPAssembler : public RefBase {
@@ -40,24 +41,37 @@ struct ARTPAssembler : public RefBase {
     void onPacketReceived(const sp<ARTPSource> &source);
     virtual void onByeReceived() = 0;
 
+    // Buffers allocated and bytes copied so far to put access units
+    // together.
+    size_t numBuffersAllocated() const { return mNumBuffersAllocated; }
+    int64_t numBytesCopied() const { return mNumBytesCopied; }
+
 protected:
     virtual AssemblyStatus assembleMore(const sp<ARTPSource> &source) = 0;
     virtual void packetLost() = 0;
 
     static void CopyTimes(const sp<ABuffer> &to, const sp<ABuffer> &from);
 
-    static sp<ABuffer> MakeADTSCompoundFromAACFrames(
+    // Appends an ADTS header and the AAC frame of size bytes at offset
+    // into buffer->data().
+    static void AppendADTSFrame(
+            ARTPBufferChain *chain,
             unsigned profile,
             unsigned samplingFreqIndex,
             unsigned channelConfig,
-            const List<sp<ABuffer> > &frames);
+            const sp<ABuffer> &buffer, size_t offset, size_t size);
+
+    // Turns the chain into a single buffer, copying only if need be.
+    sp<ABuffer> flatten(const ARTPBufferChain &chain);
 
-    static sp<ABuffer> MakeCompoundFromPackets(
-            const List<sp<ABuffer> > &frames);
+    sp<ABuffer> MakeCompoundFromPackets(const List<sp<ABuffer> > &packets);
 
 private:
     int64_t mFirstFailureTimeUs;
 
+    size_t mNumBuffersAllocated;
+    int64_t mNumBytesCopied;
+
     DISALLOW_EVIL_CONSTRUCTORS(ARTPAssembler);
 };
 
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ARTPBufferChain"
+#include <utils/Log.h>
+
+#include "ARTPBufferChain.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <string.h>
+
+namespace android {
+
+ARTPBufferChain::ARTPBufferChain()
+    : mSize(0) {
+}
+
+void ARTPBufferChain::append(
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    CHECK_LE(offset + size, buffer->size());
+
+    if (size == 0) {
+        return;
+    }
+
+    offset += buffer->offset();
+
+    if (!mChunks.isEmpty()) {
+        // Adjacent ranges of the same buffer make a single one.
+        Chunk *last = &mChunks.editItemAt(mChunks.size() - 1);
+
+        if (last->mBuffer == buffer
+                && last->mOffset + last->mSize == offset) {
+            last->mSize += size;
+            mSize += size;
+            return;
+        }
+    }
+
+    Chunk chunk;
+    chunk.mBuffer = buffer;
+    chunk.mOffset = offset;
+    chunk.mSize = size;
+    mChunks.push(chunk);
+
+    mSize += size;
+}
+
+void ARTPBufferChain::append(const sp<ABuffer> &buffer) {
+    append(buffer, 0, buffer->size());
+}
+
+void ARTPBufferChain::appendBytes(const void *data, size_t size) {
+    CHECK_LE(size, (size_t)kMaxInlineSize);
+
+    if (size == 0) {
+        return;
+    }
+
+    Chunk chunk;
+    chunk.mOffset = 0;
+    chunk.mSize = size;
+    memcpy(chunk.mBytes, data, size);
+    mChunks.push(chunk);
+
+    mSize += size;
+}
+
+sp<ABuffer> ARTPBufferChain::flatten(bool *copied) const {
+    *copied = false;
+
+    if (mChunks.size() == 1 && mChunks[0].mBuffer != NULL) {
+        const Chunk &chunk = mChunks[0];
+
+        // Don't let a small access unit pin down a much larger buffer.
+        if (2 * chunk.mSize >= chunk.mBuffer->capacity()) {
+            chunk.mBuffer->setRange(chunk.mOffset, chunk.mSize);
+            return chunk.mBuffer;
+        }
+    }
+
+    sp<ABuffer> buffer = new ABuffer(mSize);
+    *copied = true;
+
+    uint8_t *dst = buffer->data();
+    for (size_t i = 0; i < mChunks.size(); ++i) {
+        const Chunk &chunk = mChunks[i];
+
+        const uint8_t *src = (chunk.mBuffer != NULL)
+            ? chunk.mBuffer->base() + chunk.mOffset : chunk.mBytes;
+
+        memcpy(dst, src, chunk.mSize);
+        dst += chunk.mSize;
+    }
+
+    return buffer;
+}
+
+void ARTPBufferChain::clear() {
+    mChunks.clear();
+    mSize = 0;
+}
+
+}  // namespace android
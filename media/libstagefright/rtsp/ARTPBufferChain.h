@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_RTP_BUFFER_CHAIN_H_
+
+#define A_RTP_BUFFER_CHAIN_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+
+// An access unit under construction: ranges of the RTP packets it is made
+// of, interleaved with the few bytes of framing (start codes, headers) the
+// payload format leaves out. Nothing is copied until flatten().
+struct ARTPBufferChain {
+    ARTPBufferChain();
+
+    bool empty() const { return mChunks.isEmpty(); }
+    size_t size() const { return mSize; }
+
+    // References size bytes starting offset bytes into buffer->data().
+    void append(const sp<ABuffer> &buffer, size_t offset, size_t size);
+
+    // References all of buffer's data.
+    void append(const sp<ABuffer> &buffer);
+
+    // Copies size bytes, at most kMaxInlineSize.
+    void appendBytes(const void *data, size_t size);
+
+    // Returns the data in a single buffer. A chain that is a single range
+    // covering at least half of its buffer yields that buffer, with its
+    // range set accordingly. Anything else is copied into a new buffer, in
+    // which case *copied is set.
+    sp<ABuffer> flatten(bool *copied) const;
+
+    void clear();
+
+    enum {
+        kMaxInlineSize = 8,
+    };
+
+private:
+    struct Chunk {
+        // NULL for inline bytes.
+        sp<ABuffer> mBuffer;
+        size_t mOffset;  // from mBuffer->base()
+        size_t mSize;
+        uint8_t mBytes[kMaxInlineSize];
+    };
+
+    Vector<Chunk> mChunks;
+    size_t mSize;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ARTPBufferChain);
+};
+
+}  // namespace android
+
+#endif  // A_RTP_BUFFER_CHAIN_H_
@@ -31,12 +31,35 @@
 #include <media/stagefright/foundation/hexdump.h>
 
 #include <arpa/inet.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace android {
 
 static const size_t kMaxUDPSize = 1500;
 
+// Senders keep RTP packets below the path MTU, so they fit these buffers.
+// Assemblers hand on packets that make up an access unit by themselves as
+// is, so the buffers are not much larger than that.
+static const size_t kPooledBufferSize = 2048;
+static const size_t kNumPooledBuffers = 64;
+
+// Up to this many datagrams are received per system call, and a stream is
+// given at most kMaxBatchesPerPoll calls before the others get their turn.
+static const size_t kMaxPacketsPerBatch = 16;
+static const size_t kMaxBatchesPerPoll = 4;
+
+// Whatever of a datagram doesn't fit its pooled buffer is received into an
+// overflow area and copied into a buffer of its own, so that no datagram is
+// truncated. The area is only touched by such packets.
+static const size_t kMaxDatagramSize = 65536;
+static const size_t kOverflowSize = kMaxDatagramSize - kPooledBufferSize;
+
+static const int kMaxPollEvents = 16;
+
 static uint16_t u16at(const uint8_t *data) {
     return data[0] << 8 | data[1];
 }
@@ -50,7 +73,7 @@ static uint64_t u64at(const uint8_t *data) {
 }
 
 // static
-const int64_t ARTPConnection::kSelectTimeoutUs = 1000ll;
+const int64_t ARTPConnection::kPollTimeoutUs = 1000ll;
 
 struct ARTPConnection::StreamInfo {
     int mRTPSocket;
@@ -67,13 +90,46 @@ struct ARTPConnection::StreamInfo {
     bool mIsInjected;
 };
 
+// Mirrors the kernel's struct mmsghdr, which not all C libraries declare.
+struct ARTPConnection::RTPMessage {
+    struct msghdr mHeader;
+    unsigned int mLength;
+};
+
 ARTPConnection::ARTPConnection(uint32_t flags)
     : mFlags(flags),
       mPollEventPending(false),
-      mLastReceiverReportTimeUs(-1) {
+      mLastReceiverReportTimeUs(-1),
+      mEpollFd(epoll_create(kMaxPollEvents)),
+      mNextPooledBuffer(0),
+      mOverflowBuffer(NULL),
+#ifdef __NR_recvmmsg
+      mUseRecvMMsg(true),
+#else
+      mUseRecvMMsg(false),
+#endif
+      mNumRTPPacketsReceived(0),
+      mNumReceiveCalls(0),
+      mNumBuffersReused(0),
+      mNumBuffersAllocated(0) {
+    CHECK_GE(mEpollFd, 0);
+
+    mBufferPool.insertAt(0, kNumPooledBuffers);
 }
 
 ARTPConnection::~ARTPConnection() {
+    if (mNumRTPPacketsReceived > 0) {
+        ALOGV("received %lld RTP packets in %lld calls, "
+              "%lld buffers reused, %lld allocated",
+              mNumRTPPacketsReceived, mNumReceiveCalls,
+              mNumBuffersReused, mNumBuffersAllocated);
+    }
+
+    free(mOverflowBuffer);
+    mOverflowBuffer = NULL;
+
+    close(mEpollFd);
+    mEpollFd = -1;
 }
 
 void ARTPConnection::addStream(
@@ -206,6 +262,9 @@ void ARTPConnection::onAddStream(const sp<AMessage> &msg) {
     memset(&info->mRemoteRTCPAddr, 0, sizeof(info->mRemoteRTCPAddr));
 
     if (!injected) {
+        addToPoll(info->mRTPSocket);
+        addToPoll(info->mRTCPSocket);
+
         postPollEvent();
     }
 }
@@ -225,7 +284,36 @@ void ARTPConnection::onRemoveStream(const sp<AMessage> &msg) {
         return;
     }
 
-    mStreams.erase(it);
+    eraseStream(it);
+}
+
+void ARTPConnection::addToPoll(int s) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = s;
+
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, s, &event) < 0) {
+        ALOGE("failed to poll socket %d (%s)", s, strerror(errno));
+    }
+}
+
+void ARTPConnection::removeFromPoll(int s) {
+    // The socket may have been closed already, which removed it.
+    struct epoll_event event;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_DEL, s, &event) < 0) {
+        ALOGV("socket %d no longer polled (%s)", s, strerror(errno));
+    }
+}
+
+List<ARTPConnection::StreamInfo>::iterator ARTPConnection::eraseStream(
+        List<StreamInfo>::iterator it) {
+    if (!it->mIsInjected) {
+        removeFromPoll(it->mRTPSocket);
+        removeFromPoll(it->mRTCPSocket);
+    }
+
+    return mStreams.erase(it);
 }
 
 void ARTPConnection::postPollEvent() {
@@ -246,62 +334,54 @@ void ARTPConnection::onPollStreams() {
         return;
     }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = kSelectTimeoutUs;
-
-    fd_set rs;
-    FD_ZERO(&rs);
-
-    int maxSocket = -1;
+    bool polled = false;
     for (List<StreamInfo>::iterator it = mStreams.begin();
          it != mStreams.end(); ++it) {
-        if ((*it).mIsInjected) {
-            continue;
-        }
-
-        FD_SET(it->mRTPSocket, &rs);
-        FD_SET(it->mRTCPSocket, &rs);
-
-        if (it->mRTPSocket > maxSocket) {
-            maxSocket = it->mRTPSocket;
-        }
-        if (it->mRTCPSocket > maxSocket) {
-            maxSocket = it->mRTCPSocket;
+        if (!(*it).mIsInjected) {
+            polled = true;
+            break;
         }
     }
 
-    if (maxSocket == -1) {
+    if (!polled) {
         return;
     }
 
-    int res = select(maxSocket + 1, &rs, NULL, NULL, &tv);
+    struct epoll_event events[kMaxPollEvents];
 
-    if (res > 0) {
+    int res;
+    do {
+        res = epoll_wait(
+                mEpollFd, events, kMaxPollEvents, kPollTimeoutUs / 1000ll);
+    } while (res < 0 && errno == EINTR);
+
+    for (int i = 0; i < res; ++i) {
+        int s = events[i].data.fd;
+
+        // An earlier event may have taken the stream down.
         List<StreamInfo>::iterator it = mStreams.begin();
-        while (it != mStreams.end()) {
-            if ((*it).mIsInjected) {
-                ++it;
-                continue;
-            }
+        while (it != mStreams.end()
+                && (it->mIsInjected
+                    || (it->mRTPSocket != s && it->mRTCPSocket != s))) {
+            ++it;
+        }
 
-            status_t err = OK;
-            if (FD_ISSET(it->mRTPSocket, &rs)) {
-                err = receive(&*it, true);
-            }
-            if (err == OK && FD_ISSET(it->mRTCPSocket, &rs)) {
-                err = receive(&*it, false);
-            }
+        if (it == mStreams.end()) {
+            continue;
+        }
 
-            if (err == -ECONNRESET) {
-                // socket failure, this stream is dead, Jim.
+        status_t err;
+        if (s == it->mRTPSocket) {
+            err = receiveRTPBatch(&*it);
+        } else {
+            err = receive(&*it, false);
+        }
 
-                ALOGW("failed to receive RTP/RTCP datagram.");
-                it = mStreams.erase(it);
-                continue;
-            }
+        if (err == -ECONNRESET) {
+            // socket failure, this stream is dead, Jim.
 
-            ++it;
+            ALOGW("failed to receive RTP/RTCP datagram.");
+            eraseStream(it);
         }
     }
 
@@ -352,7 +432,7 @@ void ARTPConnection::onPollStreams() {
                     ALOGW("failed to send RTCP receiver report (%s).",
                          n == 0 ? "connection gone" : strerror(errno));
 
-                    it = mStreams.erase(it);
+                    it = eraseStream(it);
                     continue;
                 }
 
@@ -410,6 +490,151 @@ status_t ARTPConnection::receive(StreamInfo *s, bool receiveRTP) {
     return err;
 }
 
+sp<ABuffer> ARTPConnection::acquireBuffer() {
+    sp<ABuffer> &slot = mBufferPool.editItemAt(mNextPooledBuffer);
+    mNextPooledBuffer = (mNextPooledBuffer + 1) % kNumPooledBuffers;
+
+    if (slot != NULL && slot->getStrongCount() == 1) {
+        // Nobody but the pool holds on to it anymore.
+        slot->setRange(0, slot->capacity());
+        slot->setInt32Data(0);
+        slot->meta()->clear();
+
+        ++mNumBuffersReused;
+    } else {
+        slot = new ABuffer(kPooledBufferSize);
+
+        ++mNumBuffersAllocated;
+    }
+
+    return slot;
+}
+
+ssize_t ARTPConnection::receiveMessages(
+        int s, RTPMessage *msgs, size_t count) {
+    ssize_t n;
+
+#ifdef __NR_recvmmsg
+    if (mUseRecvMMsg) {
+        do {
+            n = syscall(__NR_recvmmsg, s, msgs, count, MSG_DONTWAIT, NULL);
+        } while (n < 0 && errno == EINTR);
+
+        if (n >= 0 || errno != ENOSYS) {
+            return n;
+        }
+
+        ALOGW("recvmmsg is not supported, receiving one packet at a time.");
+        mUseRecvMMsg = false;
+    }
+#endif
+
+    size_t i = 0;
+    while (i < count) {
+        do {
+            n = recvmsg(s, &msgs[i].mHeader, MSG_DONTWAIT);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0) {
+            break;
+        }
+
+        msgs[i++].mLength = n;
+    }
+
+    return i > 0 ? (ssize_t)i : n;
+}
+
+status_t ARTPConnection::receiveRTPBatch(StreamInfo *s) {
+    CHECK(!s->mIsInjected);
+
+    if (mOverflowBuffer == NULL) {
+        mOverflowBuffer =
+            (uint8_t *)malloc(kMaxPacketsPerBatch * kOverflowSize);
+
+        if (mOverflowBuffer == NULL) {
+            return NO_MEMORY;
+        }
+    }
+
+    sp<ABuffer> buffers[kMaxPacketsPerBatch];
+    struct iovec iov[2 * kMaxPacketsPerBatch];
+    RTPMessage msgs[kMaxPacketsPerBatch];
+
+    for (size_t batch = 0; batch < kMaxBatchesPerPoll; ++batch) {
+        memset(msgs, 0, sizeof(msgs));
+
+        for (size_t i = 0; i < kMaxPacketsPerBatch; ++i) {
+            buffers[i] = acquireBuffer();
+
+            iov[2 * i].iov_base = buffers[i]->data();
+            iov[2 * i].iov_len = buffers[i]->capacity();
+            iov[2 * i + 1].iov_base = mOverflowBuffer + i * kOverflowSize;
+            iov[2 * i + 1].iov_len = kOverflowSize;
+
+            msgs[i].mHeader.msg_iov = &iov[2 * i];
+            msgs[i].mHeader.msg_iovlen = 2;
+        }
+
+        ssize_t n = receiveMessages(s->mRTPSocket, msgs, kMaxPacketsPerBatch);
+
+        // Hand out the buffers that were not filled again next time.
+        size_t numUnused = (n > 0) ? kMaxPacketsPerBatch - n
+                                   : kMaxPacketsPerBatch;
+        mNextPooledBuffer =
+            (mNextPooledBuffer + kNumPooledBuffers - numUnused)
+                % kNumPooledBuffers;
+
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return OK;
+            }
+
+            return -ECONNRESET;
+        }
+
+        ++mNumReceiveCalls;
+
+        for (ssize_t i = 0; i < n; ++i) {
+            sp<ABuffer> buffer = buffers[i];
+            buffers[i].clear();
+
+            if (msgs[i].mHeader.msg_flags & MSG_TRUNC) {
+                ALOGW("dropping RTP packet larger than %zu bytes",
+                      kMaxDatagramSize);
+                continue;
+            }
+
+            ++mNumRTPPacketsReceived;
+
+            size_t length = msgs[i].mLength;
+            if (length > buffer->capacity()) {
+                // The rest of it went to the overflow area.
+                sp<ABuffer> large = new ABuffer(length);
+                memcpy(large->data(), buffer->data(), buffer->capacity());
+                memcpy(large->data() + buffer->capacity(),
+                       iov[2 * i + 1].iov_base,
+                       length - buffer->capacity());
+
+                buffer = large;
+            }
+
+            buffer->setRange(0, length);
+            parseRTP(s, buffer);
+        }
+
+        for (size_t i = n; i < kMaxPacketsPerBatch; ++i) {
+            buffers[i].clear();
+        }
+
+        if ((size_t)n < kMaxPacketsPerBatch) {
+            break;
+        }
+    }
+
+    return OK;
+}
+
 status_t ARTPConnection::parseRTP(StreamInfo *s, const sp<ABuffer> &buffer) {
     if (s->mNumRTPPacketsReceived++ == 0) {
         sp<AMessage> notify = s->mNotifyMsg->dup();
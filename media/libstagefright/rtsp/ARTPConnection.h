@@ -20,6 +20,7 @@
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <utils/List.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -62,24 +63,58 @@ private:
         kWhatInjectPacket,
     };
 
-    static const int64_t kSelectTimeoutUs;
+    static const int64_t kPollTimeoutUs;
 
     uint32_t mFlags;
 
     struct StreamInfo;
     List<StreamInfo> mStreams;
 
+    struct RTPMessage;
+
     bool mPollEventPending;
     int64_t mLastReceiverReportTimeUs;
 
+    // The sockets of all streams that are not injected are registered here.
+    int mEpollFd;
+
+    // RTP packets are received into these, a buffer is reused once the
+    // assembler is done with the packet it last held.
+    Vector<sp<ABuffer> > mBufferPool;
+    size_t mNextPooledBuffer;
+
+    // Receives the part of an RTP packet that doesn't fit its pooled buffer,
+    // one region per packet of a batch. Allocated on first use.
+    uint8_t *mOverflowBuffer;
+
+    bool mUseRecvMMsg;
+
+    // Receive statistics, logged when the connection goes away.
+    int64_t mNumRTPPacketsReceived;
+    int64_t mNumReceiveCalls;
+    int64_t mNumBuffersReused;
+    int64_t mNumBuffersAllocated;
+
     void onAddStream(const sp<AMessage> &msg);
     void onRemoveStream(const sp<AMessage> &msg);
     void onPollStreams();
     void onInjectPacket(const sp<AMessage> &msg);
     void onSendReceiverReports();
 
+    void addToPoll(int s);
+    void removeFromPoll(int s);
+    List<StreamInfo>::iterator eraseStream(List<StreamInfo>::iterator it);
+
+    sp<ABuffer> acquireBuffer();
+
+    // Receives RTCP, or RTP one packet at a time.
     status_t receive(StreamInfo *info, bool receiveRTP);
 
+    // Drains the RTP socket in batches of datagrams.
+    status_t receiveRTPBatch(StreamInfo *info);
+
+    ssize_t receiveMessages(int s, RTPMessage *msgs, size_t count);
+
     status_t parseRTP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseRTCP(StreamInfo *info, const sp<ABuffer> &buffer);
     status_t parseSR(StreamInfo *info, const uint8_t *data, size_t size);
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ARTPPacketQueue"
+#include <utils/Log.h>
+
+#include "ARTPPacketQueue.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+static const size_t kInitialCapacity = 64;
+
+// static
+const size_t ARTPPacketQueue::kMaxSpan = 8192;
+
+sp<ABuffer> &ARTPPacketQueue::iterator::operator*() const {
+    sp<ABuffer> &slot = mQueue->slotAt(mSeqNum);
+    CHECK(slot != NULL);
+
+    return slot;
+}
+
+ARTPPacketQueue::iterator &ARTPPacketQueue::iterator::operator++() {
+    uint32_t endSeqNum = mQueue->mHeadSeqNum + mQueue->mSpan;
+
+    do {
+        ++mSeqNum;
+    } while (mSeqNum != endSeqNum && mQueue->slotAt(mSeqNum) == NULL);
+
+    return *this;
+}
+
+ARTPPacketQueue::ARTPPacketQueue()
+    : mSlots(new sp<ABuffer>[kInitialCapacity]),
+      mCapacity(kInitialCapacity),
+      mHeadSeqNum(0),
+      mSpan(0),
+      mSize(0) {
+}
+
+ARTPPacketQueue::~ARTPPacketQueue() {
+    delete[] mSlots;
+    mSlots = NULL;
+}
+
+ARTPPacketQueue::iterator ARTPPacketQueue::begin() {
+    // The first slot is never empty unless the queue is.
+    return iterator(this, mHeadSeqNum);
+}
+
+ARTPPacketQueue::iterator ARTPPacketQueue::end() {
+    return iterator(this, mHeadSeqNum + mSpan);
+}
+
+ARTPPacketQueue::iterator ARTPPacketQueue::erase(const iterator &it) {
+    CHECK(it.mQueue == this);
+
+    sp<ABuffer> &slot = slotAt(it.mSeqNum);
+    CHECK(slot != NULL);
+
+    slot.clear();
+    --mSize;
+
+    if (mSize == 0) {
+        mHeadSeqNum = it.mSeqNum + 1;
+        mSpan = 0;
+
+        return end();
+    }
+
+    if (it.mSeqNum == mHeadSeqNum) {
+        do {
+            ++mHeadSeqNum;
+            --mSpan;
+        } while (slotAt(mHeadSeqNum) == NULL);
+
+        return begin();
+    }
+
+    if (it.mSeqNum == mHeadSeqNum + mSpan - 1) {
+        do {
+            --mSpan;
+        } while (slotAt(mHeadSeqNum + mSpan - 1) == NULL);
+
+        return end();
+    }
+
+    iterator next = it;
+    return ++next;
+}
+
+bool ARTPPacketQueue::insert(const sp<ABuffer> &buffer) {
+    uint32_t seqNum = (uint32_t)buffer->int32Data();
+
+    if (mSize == 0) {
+        mHeadSeqNum = seqNum;
+        mSpan = 1;
+        mSize = 1;
+        slotAt(seqNum) = buffer;
+
+        return true;
+    }
+
+    int32_t offset = (int32_t)(seqNum - mHeadSeqNum);
+
+    if (offset >= 0 && (size_t)offset < mSpan) {
+        sp<ABuffer> &slot = slotAt(seqNum);
+
+        if (slot != NULL) {
+            return false;
+        }
+
+        slot = buffer;
+        ++mSize;
+
+        return true;
+    }
+
+    size_t span = (offset >= 0) ? (size_t)offset + 1 : mSpan - offset;
+
+    if (span > kMaxSpan) {
+        if (offset < 0) {
+            // The assembler has long given up on this one.
+            return false;
+        }
+
+        ALOGW("sequence number jumped ahead by %d, flushing %d packets",
+              offset, (int)mSize);
+
+        clear();
+        return insert(buffer);
+    }
+
+    if (span > mCapacity) {
+        grow(span);
+    }
+
+    if (offset < 0) {
+        mHeadSeqNum = seqNum;
+    }
+
+    mSpan = span;
+    ++mSize;
+    slotAt(seqNum) = buffer;
+
+    return true;
+}
+
+void ARTPPacketQueue::clear() {
+    for (size_t i = 0; i < mSpan; ++i) {
+        slotAt(mHeadSeqNum + i).clear();
+    }
+
+    mSpan = 0;
+    mSize = 0;
+}
+
+void ARTPPacketQueue::grow(size_t minCapacity) {
+    size_t capacity = mCapacity;
+    while (capacity < minCapacity) {
+        capacity *= 2;
+    }
+
+    sp<ABuffer> *slots = new sp<ABuffer>[capacity];
+
+    for (size_t i = 0; i < mSpan; ++i) {
+        uint32_t seqNum = mHeadSeqNum + i;
+        slots[seqNum & (capacity - 1)] = mSlots[seqNum & (mCapacity - 1)];
+    }
+
+    delete[] mSlots;
+    mSlots = slots;
+    mCapacity = capacity;
+}
+
+}  // namespace android
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef A_RTP_PACKET_QUEUE_H_
+
+#define A_RTP_PACKET_QUEUE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct ABuffer;
+
+// The jitter buffer of an ARTPSource: RTP packets waiting to be assembled,
+// ordered by their extended sequence number (the buffer's int32Data).
+// Packets live in a ring of slots indexed by sequence number, so inserting
+// one takes constant time no matter how far out of order it arrives. Gaps
+// are empty slots that iteration skips. The interface is the part of List's
+// that the assemblers use.
+struct ARTPPacketQueue {
+    struct iterator {
+        iterator()
+            : mQueue(NULL),
+              mSeqNum(0) {
+        }
+
+        sp<ABuffer> &operator*() const;
+        iterator &operator++();
+
+        bool operator==(const iterator &other) const {
+            return mQueue == other.mQueue && mSeqNum == other.mSeqNum;
+        }
+
+        bool operator!=(const iterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend struct ARTPPacketQueue;
+
+        iterator(ARTPPacketQueue *queue, uint32_t seqNum)
+            : mQueue(queue),
+              mSeqNum(seqNum) {
+        }
+
+        ARTPPacketQueue *mQueue;
+        uint32_t mSeqNum;
+    };
+
+    ARTPPacketQueue();
+    ~ARTPPacketQueue();
+
+    bool empty() const { return mSize == 0; }
+    size_t size() const { return mSize; }
+
+    iterator begin();
+    iterator end();
+
+    // Returns an iterator to the packet following the erased one.
+    iterator erase(const iterator &it);
+
+    // Returns false if the packet was dropped, because it is a duplicate or
+    // arrived too late to be of any use. A packet too far ahead of the ones
+    // queued flushes them.
+    bool insert(const sp<ABuffer> &buffer);
+
+    void clear();
+
+private:
+    // Packets farther apart than this are not kept together.
+    static const size_t kMaxSpan;
+
+    sp<ABuffer> *mSlots;
+    size_t mCapacity;  // a power of 2
+
+    // Sequence number of the first packet, and the number of slots from it
+    // up to and including the last one.
+    uint32_t mHeadSeqNum;
+    size_t mSpan;
+
+    size_t mSize;
+
+    sp<ABuffer> &slotAt(uint32_t seqNum) const {
+        return mSlots[seqNum & (mCapacity - 1)];
+    }
+
+    void grow(size_t minCapacity);
+
+    DISALLOW_EVIL_CONSTRUCTORS(ARTPPacketQueue);
+};
+
+}  // namespace android
+
+#endif  // A_RTP_PACKET_QUEUE_H_
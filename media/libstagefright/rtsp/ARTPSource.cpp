@@ -44,6 +44,8 @@ ARTPSource::ARTPSource(
     : mID(id),
       mHighestSeqNumber(0),
       mNumBuffersReceived(0),
+      mNumBuffersReordered(0),
+      mNumBuffersDiscarded(0),
       mLastNTPTime(0),
       mLastNTPTimeUpdateUs(0),
       mIssueFIRRequests(false),
@@ -81,6 +83,19 @@ ARTPSource::ARTPSource(
     }
 }
 
+ARTPSource::~ARTPSource() {
+    ALOGV("source 0x%08x received %d packets, %d out of order, %d discarded",
+          mID, mNumBuffersReceived, mNumBuffersReordered,
+          mNumBuffersDiscarded);
+
+    if (mAssembler != NULL) {
+        ALOGV("source 0x%08x assembled with %zu buffers allocated, "
+              "%lld bytes copied",
+              mID, mAssembler->numBuffersAllocated(),
+              mAssembler->numBytesCopied());
+    }
+}
+
 static uint32_t AbsDiff(uint32_t seq1, uint32_t seq2) {
     return seq1 > seq2 ? seq1 - seq2 : seq2 - seq1;
 }
@@ -107,7 +122,7 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     if (mNumBuffersReceived++ == 0) {
         mHighestSeqNumber = seqNum;
-        mQueue.push_back(buffer);
+        mQueue.insert(buffer);
         return true;
     }
 
@@ -140,22 +155,18 @@ bool ARTPSource::queuePacket(const sp<ABuffer> &buffer) {
 
     if (seqNum > mHighestSeqNumber) {
         mHighestSeqNumber = seqNum;
+    } else if (seqNum < mHighestSeqNumber) {
+        ++mNumBuffersReordered;
     }
 
     buffer->setInt32Data(seqNum);
 
-    List<sp<ABuffer> >::iterator it = mQueue.begin();
-    while (it != mQueue.end() && (uint32_t)(*it)->int32Data() < seqNum) {
-        ++it;
-    }
-
-    if (it != mQueue.end() && (uint32_t)(*it)->int32Data() == seqNum) {
-        ALOGW("Discarding duplicate buffer");
+    if (!mQueue.insert(buffer)) {
+        ALOGW("Discarding duplicate or late buffer");
+        ++mNumBuffersDiscarded;
         return false;
     }
 
-    mQueue.insert(it, buffer);
-
     return true;
 }
 
@@ -21,9 +21,10 @@
 #include <stdint.h>
 
 #include <media/stagefright/foundation/ABase.h>
-#include <utils/List.h>
 #include <utils/RefBase.h>
 
+#include "ARTPPacketQueue.h"
+
 namespace android {
 
 struct ABuffer;
@@ -41,17 +42,25 @@ struct ARTPSource : public RefBase {
     void timeUpdate(uint32_t rtpTime, uint64_t ntpTime);
     void byeReceived();
 
-    List<sp<ABuffer> > *queue() { return &mQueue; }
+    ARTPPacketQueue *queue() { return &mQueue; }
 
     void addReceiverReport(const sp<ABuffer> &buffer);
     void addFIR(const sp<ABuffer> &buffer);
 
+protected:
+    virtual ~ARTPSource();
+
 private:
     uint32_t mID;
     uint32_t mHighestSeqNumber;
     int32_t mNumBuffersReceived;
 
-    List<sp<ABuffer> > mQueue;
+    // Packets that arrived behind one with a higher sequence number, and
+    // duplicate or hopelessly late ones that were discarded.
+    int32_t mNumBuffersReordered;
+    int32_t mNumBuffersDiscarded;
+
+    ARTPPacketQueue mQueue;
     sp<ARTPAssembler> mAssembler;
 
     uint64_t mLastNTPTime;
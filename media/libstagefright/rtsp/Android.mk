@@ -12,7 +12,9 @@ LOCAL_SRC_FILES:=       \
         APacketSource.cpp           \
         ARawAudioAssembler.cpp      \
         ARTPAssembler.cpp           \
+        ARTPBufferChain.cpp         \
         ARTPConnection.cpp          \
+        ARTPPacketQueue.cpp         \
         ARTPSource.cpp              \
         ARTPWriter.cpp              \
         ARTSPConnection.cpp         \
@@ -56,3 +58,29 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE:= rtp_test
 
 # include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=         \
+        rtp_replay.cpp    \
+        UDPPusher.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libstagefright liblog libutils libstagefright_foundation
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_rtsp
+
+LOCAL_C_INCLUDES:= \
+	frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_CFLAGS += -Wno-multichar
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE:= rtp_replay
+
+include $(BUILD_EXECUTABLE)
@@ -29,10 +29,17 @@
 
 namespace android {
 
+// Packets pushed per message when not pacing.
+static const size_t kMaxBurstSize = 32;
+
 UDPPusher::UDPPusher(const char *filename, unsigned port)
     : mFile(fopen(filename, "rb")),
       mFirstTimeMs(0),
-      mFirstTimeUs(0) {
+      mFirstTimeUs(0),
+      mSpeed(1.0),
+      mReorderPeriod(0),
+      mNumPacketsRead(0),
+      mNumPacketsSent(0) {
     CHECK(mFile != NULL);
 
     mSocket = socket(AF_INET, SOCK_DGRAM, 0);
@@ -59,6 +66,15 @@ UDPPusher::~UDPPusher() {
     mFile = NULL;
 }
 
+void UDPPusher::setSpeed(double speed) {
+    CHECK_GE(speed, 0.0);
+    mSpeed = speed;
+}
+
+void UDPPusher::setReorderPeriod(size_t period) {
+    mReorderPeriod = period;
+}
+
 void UDPPusher::start() {
     uint32_t timeMs;
     CHECK_EQ(fread(&timeMs, 1, sizeof(timeMs), mFile), sizeof(timeMs));
@@ -68,44 +84,80 @@ void UDPPusher::start() {
     (new AMessage(kWhatPush, id()))->post();
 }
 
+void UDPPusher::send(const sp<ABuffer> &buffer) {
+    ssize_t n = sendto(
+            mSocket, buffer->data(), buffer->size(), 0,
+            (const struct sockaddr *)&mRemoteAddr, sizeof(mRemoteAddr));
+
+    CHECK_EQ(n, (ssize_t)buffer->size());
+
+    ++mNumPacketsSent;
+}
+
 bool UDPPusher::onPush() {
-    uint32_t length;
-    if (fread(&length, 1, sizeof(length), mFile) < sizeof(length)) {
-        ALOGI("No more data to push.");
-        return false;
-    }
+    size_t burstSize = (mSpeed > 0.0) ? 1 : kMaxBurstSize;
 
-    length = fromlel(length);
+    for (size_t i = 0; i < burstSize; ++i) {
+        uint32_t length;
+        if (fread(&length, 1, sizeof(length), mFile) < sizeof(length)) {
+            ALOGI("No more data to push.");
+            break;
+        }
 
-    CHECK_GT(length, 0u);
+        length = fromlel(length);
 
-    sp<ABuffer> buffer = new ABuffer(length);
-    if (fread(buffer->data(), 1, length, mFile) < length) {
-        ALOGE("File truncated?.");
-        return false;
-    }
+        CHECK_GT(length, 0u);
 
-    ssize_t n = sendto(
-            mSocket, buffer->data(), buffer->size(), 0,
-            (const struct sockaddr *)&mRemoteAddr, sizeof(mRemoteAddr));
+        sp<ABuffer> buffer = new ABuffer(length);
+        if (fread(buffer->data(), 1, length, mFile) < length) {
+            ALOGE("File truncated?.");
+            break;
+        }
 
-    CHECK_EQ(n, (ssize_t)buffer->size());
+        if (mReorderPeriod > 0
+                && mHeldBuffer == NULL
+                && (++mNumPacketsRead % mReorderPeriod) == 0) {
+            // Send it after the next one.
+            mHeldBuffer = buffer;
+        } else {
+            send(buffer);
+
+            if (mHeldBuffer != NULL) {
+                send(mHeldBuffer);
+                mHeldBuffer.clear();
+            }
+        }
 
-    uint32_t timeMs;
-    if (fread(&timeMs, 1, sizeof(timeMs), mFile) < sizeof(timeMs)) {
-        ALOGI("No more data to push.");
-        return false;
-    }
+        uint32_t timeMs;
+        if (fread(&timeMs, 1, sizeof(timeMs), mFile) < sizeof(timeMs)) {
+            ALOGI("No more data to push.");
+            break;
+        }
+
+        timeMs = fromlel(timeMs);
+        CHECK_GE(timeMs, mFirstTimeMs);
+
+        if (i + 1 == burstSize) {
+            int64_t delayUs = 0ll;
+            if (mSpeed > 0.0) {
+                int64_t whenUs = mFirstTimeUs
+                    + (int64_t)((timeMs - mFirstTimeMs) * 1000ll / mSpeed);
+
+                delayUs = whenUs - ALooper::GetNowUs();
+            }
 
-    timeMs = fromlel(timeMs);
-    CHECK_GE(timeMs, mFirstTimeMs);
+            (new AMessage(kWhatPush, id()))->post(delayUs);
 
-    timeMs -= mFirstTimeMs;
-    int64_t whenUs = mFirstTimeUs + timeMs * 1000ll;
-    int64_t nowUs = ALooper::GetNowUs();
-    (new AMessage(kWhatPush, id()))->post(whenUs - nowUs);
+            return true;
+        }
+    }
+
+    if (mHeldBuffer != NULL) {
+        send(mHeldBuffer);
+        mHeldBuffer.clear();
+    }
 
-    return true;
+    return false;
 }
 
 void UDPPusher::onMessageReceived(const sp<AMessage> &msg) {
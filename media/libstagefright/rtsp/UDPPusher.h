@@ -25,11 +25,22 @@
 
 namespace android {
 
+struct ABuffer;
+
 struct UDPPusher : public AHandler {
     UDPPusher(const char *filename, unsigned port);
 
+    // Replays at speed times the recorded rate, or as fast as possible if
+    // speed is 0. Must be called before start().
+    void setSpeed(double speed);
+
+    // Swaps every periodth packet with the one following it.
+    void setReorderPeriod(size_t period);
+
     void start();
 
+    size_t numPacketsSent() const { return mNumPacketsSent; }
+
 protected:
     virtual ~UDPPusher();
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -46,7 +57,15 @@ private:
     uint32_t mFirstTimeMs;
     int64_t mFirstTimeUs;
 
+    double mSpeed;
+    size_t mReorderPeriod;
+    sp<ABuffer> mHeldBuffer;
+
+    size_t mNumPacketsRead;
+    volatile size_t mNumPacketsSent;
+
     bool onPush();
+    void send(const sp<ABuffer> &buffer);
 
     DISALLOW_EVIL_CONSTRUCTORS(UDPPusher);
 };
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "rtp_replay"
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <utils/threads.h>
+
+#include "ARTPConnection.h"
+#include "ASessionDescription.h"
+#include "UDPPusher.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+// Replays a recorded H.264 RTP stream (in UDPPusher's format) over the
+// loopback interface into an ARTPConnection, and reports how fast the
+// packets were received and assembled into access units.
+
+namespace android {
+
+struct Receiver : public AHandler {
+    Receiver()
+        : mNumAccessUnits(0),
+          mNumDamagedAccessUnits(0),
+          mNumBytes(0),
+          mDone(false) {
+    }
+
+    void waitForEOS() {
+        Mutex::Autolock autoLock(mLock);
+        while (!mDone) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    size_t mNumAccessUnits;
+    size_t mNumDamagedAccessUnits;
+    int64_t mNumBytes;
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        sp<ABuffer> accessUnit;
+        int32_t eos;
+
+        if (msg->findBuffer("access-unit", &accessUnit)) {
+            ++mNumAccessUnits;
+            mNumBytes += accessUnit->size();
+
+            int32_t damaged;
+            if (accessUnit->meta()->findInt32("damaged", &damaged)
+                    && damaged) {
+                ++mNumDamagedAccessUnits;
+            }
+        } else if (msg->findInt32("eos", &eos) && eos) {
+            Mutex::Autolock autoLock(mLock);
+            mDone = true;
+            mCondition.signal();
+        }
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    bool mDone;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Receiver);
+};
+
+}  // namespace android
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-s speed] [-r reorderPeriod] rtpFilename\n"
+                    "       -s  replay at speed times the recorded rate, "
+                    "0 for as fast as possible (default)\n"
+                    "       -r  swap every reorderPeriod-th packet with "
+                    "the next one\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    double speed = 0.0;
+    size_t reorderPeriod = 0;
+
+    int res;
+    while ((res = getopt(argc, argv, "hs:r:")) >= 0) {
+        switch (res) {
+            case 's':
+            {
+                speed = atof(optarg);
+                break;
+            }
+
+            case 'r':
+            {
+                reorderPeriod = atoi(optarg);
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    if (optind + 1 != argc || speed < 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int rtpSocket, rtcpSocket;
+    unsigned rtpPort;
+    ARTPConnection::MakePortPair(&rtpSocket, &rtcpSocket, &rtpPort);
+
+    AString raw(
+        "v=0\r\n"
+        "o=- 64 233572944 IN IP4 127.0.0.0\r\n"
+        "s=QuickTime\r\n"
+        "t=0 0\r\n"
+        "a=range:npt=now-\r\n");
+
+    raw.append("m=video ");
+    raw.append(rtpPort);
+    raw.append(" RTP/AVP 96\r\n"
+        "c=IN IP4 127.0.0.1\r\n"
+        "b=AS:320000\r\n"
+        "a=rtpmap:96 H264/90000\r\n"
+        "a=fmtp:96 packetization-mode=1;profile-level-id=42001E;"
+          "sprop-parameter-sets=Z0IAHpZUBaHogA==,aM44gA==\r\n"
+        "a=cliprect:0,0,480,270\r\n"
+        "a=framesize:96 720-480\r\n");
+
+    sp<ASessionDescription> desc = new ASessionDescription;
+    CHECK(desc->setTo(raw.c_str(), raw.size()));
+
+    // The connection polls on its own looper, so that pushing does not
+    // hold up receiving.
+    sp<ALooper> connLooper = new ALooper;
+    connLooper->setName("rtp_replay conn");
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("rtp_replay");
+
+    sp<ARTPConnection> conn = new ARTPConnection;
+    connLooper->registerHandler(conn);
+
+    sp<Receiver> receiver = new Receiver;
+    looper->registerHandler(receiver);
+
+    sp<UDPPusher> pusher = new UDPPusher(argv[optind], rtpPort);
+    pusher->setSpeed(speed);
+    pusher->setReorderPeriod(reorderPeriod);
+    looper->registerHandler(pusher);
+
+    connLooper->start();
+    looper->start();
+
+    conn->addStream(
+            rtpSocket, rtcpSocket, desc, 1 /* index */,
+            new AMessage(0, receiver->id()), false /* injected */);
+
+    // Give the connection a chance to start polling.
+    usleep(100000);
+
+    int64_t startUs = ALooper::GetNowUs();
+    pusher->start();
+
+    receiver->waitForEOS();
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+
+    conn->removeStream(rtpSocket, rtcpSocket);
+
+    looper->stop();
+    connLooper->stop();
+
+    size_t numPackets = pusher->numPacketsSent();
+
+    printf("%d packets in %.2f secs, %.1f packets/sec\n",
+           numPackets, elapsedUs / 1E6, numPackets * 1E6 / elapsedUs);
+
+    printf("%d access units (%lld bytes), %d damaged\n",
+           receiver->mNumAccessUnits, receiver->mNumBytes,
+           receiver->mNumDamagedAccessUnits);
+
+    close(rtpSocket);
+    close(rtcpSocket);
+
+    return 0;
+}
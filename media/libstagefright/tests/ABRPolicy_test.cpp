@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABRPolicy_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include "httplive/ABRPolicy.h"
+
+#include <stdio.h>
+
+namespace android {
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+static const double kSegmentDurationSecs = 4.0;
+static const double kMaxBufferSecs = 10.0;
+static const double kRequestLatencySecs = 0.1;
+
+// Replays a bandwidth trace against a policy, one segment at a time, the
+// way PlaylistFetcher and LiveSession drive it: the variant is re-picked
+// after every segment, fetching pauses while kMaxBufferSecs are buffered and
+// playback starts once the first segment is in.
+class ABRSimulator {
+public:
+    struct TracePoint {
+        double mDurationSecs;
+        int32_t mBandwidthBps;
+    };
+
+    struct Result {
+        double mStartupSecs;
+        double mRebufferSecs;
+        double mAverageBitrateBps;
+        size_t mNumSwitches;
+    };
+
+    ABRSimulator(const TracePoint *trace, size_t traceSize)
+        : mTrace(trace),
+          mTraceSize(traceSize) {
+        static const unsigned long kBandwidths[] = {
+            350000, 700000, 1500000, 3000000, 6000000
+        };
+
+        for (size_t i = 0; i < ARRAY_SIZE(kBandwidths); ++i) {
+            mBandwidths.push(kBandwidths[i]);
+        }
+    }
+
+    Result run(const sp<ABRPolicy> &policy, size_t numSegments) {
+        sp<BandwidthEstimator> estimator = new BandwidthEstimator;
+
+        Result result;
+        result.mStartupSecs = 0.0;
+        result.mRebufferSecs = 0.0;
+        result.mAverageBitrateBps = 0.0;
+        result.mNumSwitches = 0;
+
+        double nowSecs = 0.0;
+        double bufferedSecs = 0.0;
+        bool playing = false;
+        ssize_t currentIndex = -1;
+
+        for (size_t i = 0; i < numSegments; ++i) {
+            ABRPolicy::State state;
+            state.mCurrentIndex = currentIndex;
+            state.mBufferedDurationUs =
+                playing ? (int64_t)(bufferedSecs * 1E6) : -1ll;
+
+            int32_t bandwidthBps;
+            if (estimator->estimateBandwidth(&bandwidthBps)) {
+                state.mBandwidthBps = bandwidthBps;
+            }
+
+            size_t index = policy->pickVariant(mBandwidths, state);
+            if (currentIndex >= 0 && index != (size_t)currentIndex) {
+                ++result.mNumSwitches;
+            }
+            currentIndex = index;
+
+            size_t numBytes = mBandwidths[index] * kSegmentDurationSecs / 8;
+            double downloadSecs = download(nowSecs, numBytes);
+
+            estimator->addSample(numBytes, (int64_t)(downloadSecs * 1E6));
+            nowSecs += downloadSecs;
+
+            if (!playing) {
+                result.mStartupSecs = nowSecs;
+                playing = true;
+            } else if (downloadSecs > bufferedSecs) {
+                result.mRebufferSecs += downloadSecs - bufferedSecs;
+                bufferedSecs = 0.0;
+            } else {
+                bufferedSecs -= downloadSecs;
+            }
+
+            bufferedSecs += kSegmentDurationSecs;
+            result.mAverageBitrateBps += mBandwidths[index];
+
+            if (bufferedSecs > kMaxBufferSecs) {
+                nowSecs += bufferedSecs - kMaxBufferSecs;
+                bufferedSecs = kMaxBufferSecs;
+            }
+        }
+
+        result.mAverageBitrateBps /= numSegments;
+
+        return result;
+    }
+
+private:
+    const TracePoint *mTrace;
+    size_t mTraceSize;
+    Vector<unsigned long> mBandwidths;
+
+    // Seconds it takes to download "numBytes" starting at "startSecs", the
+    // trace repeats.
+    double download(double startSecs, size_t numBytes) const {
+        double traceSecs = 0.0;
+        for (size_t i = 0; i < mTraceSize; ++i) {
+            traceSecs += mTrace[i].mDurationSecs;
+        }
+
+        double nowSecs = startSecs + kRequestLatencySecs;
+        double bitsLeft = numBytes * 8.0;
+
+        while (bitsLeft > 0.0) {
+            double offsetSecs = nowSecs - traceSecs * (int64_t)(nowSecs / traceSecs);
+
+            size_t i = 0;
+            double pointEndSecs = mTrace[0].mDurationSecs;
+            while (offsetSecs >= pointEndSecs && i + 1 < mTraceSize) {
+                ++i;
+                pointEndSecs += mTrace[i].mDurationSecs;
+            }
+
+            double secs = pointEndSecs - offsetSecs;
+            double bits = secs * mTrace[i].mBandwidthBps;
+
+            if (bits >= bitsLeft) {
+                nowSecs += bitsLeft / mTrace[i].mBandwidthBps;
+                break;
+            }
+
+            bitsLeft -= bits;
+            nowSecs += secs;
+        }
+
+        return nowSecs - startSecs;
+    }
+};
+
+class ABRPolicyTest : public ::testing::Test {
+protected:
+    static ABRSimulator::Result Simulate(
+            const char *traceName,
+            const ABRSimulator::TracePoint *trace, size_t traceSize,
+            const char *policyName) {
+        ABRSimulator simulator(trace, traceSize);
+        ABRSimulator::Result result =
+            simulator.run(ABRPolicy::CreateByName(policyName), kNumSegments);
+
+        printf("%-12s %-10s startup %5.2f s, rebuffering %6.2f s, "
+               "average %7.1f kbps, %3d switches\n",
+               traceName, policyName,
+               result.mStartupSecs, result.mRebufferSecs,
+               result.mAverageBitrateBps / 1E3, (int)result.mNumSwitches);
+
+        return result;
+    }
+
+    static const size_t kNumSegments = 150;
+};
+
+static const ABRSimulator::TracePoint kSteadyTrace[] = {
+    { 60.0, 5000000 },
+};
+
+static const ABRSimulator::TracePoint kStepDownTrace[] = {
+    { 120.0, 8000000 },
+    { 120.0, 1000000 },
+};
+
+static const ABRSimulator::TracePoint kOscillatingTrace[] = {
+    { 6.0, 4000000 },
+    { 3.0, 800000 },
+    { 5.0, 2500000 },
+    { 4.0, 600000 },
+};
+
+static const ABRSimulator::TracePoint kOutageTrace[] = {
+    { 40.0, 3000000 },
+    { 6.0, 100000 },
+    { 40.0, 3000000 },
+};
+
+TEST_F(ABRPolicyTest, EstimatorTracksSteadyThroughput) {
+    sp<BandwidthEstimator> estimator = new BandwidthEstimator;
+
+    int32_t bandwidthBps;
+    EXPECT_FALSE(estimator->estimateBandwidth(&bandwidthBps));
+
+    // 2 Mbit/s in 1 second chunks.
+    for (int i = 0; i < 10; ++i) {
+        estimator->addSample(250000, 1000000ll);
+    }
+
+    ASSERT_TRUE(estimator->estimateBandwidth(&bandwidthBps));
+    EXPECT_NEAR(2000000, bandwidthBps, 20000);
+
+    // A sudden drop shows up right away, a recovery only gradually.
+    estimator->addSample(25000, 1000000ll);
+    ASSERT_TRUE(estimator->estimateBandwidth(&bandwidthBps));
+    EXPECT_LT(bandwidthBps, 1000000);
+
+    estimator->addSample(250000, 1000000ll);
+    ASSERT_TRUE(estimator->estimateBandwidth(&bandwidthBps));
+    EXPECT_LT(bandwidthBps, 1500000);
+
+    estimator->reset();
+    EXPECT_FALSE(estimator->estimateBandwidth(&bandwidthBps));
+}
+
+TEST_F(ABRPolicyTest, EstimatorIgnoresTinyTransfers) {
+    sp<BandwidthEstimator> estimator = new BandwidthEstimator;
+
+    for (int i = 0; i < 100; ++i) {
+        estimator->addSample(1000, 100000ll);
+    }
+
+    int32_t bandwidthBps;
+    EXPECT_FALSE(estimator->estimateBandwidth(&bandwidthBps));
+}
+
+TEST_F(ABRPolicyTest, CreateByName) {
+    EXPECT_STREQ("throughput", ABRPolicy::CreateByName("throughput")->name());
+    EXPECT_STREQ("buffer", ABRPolicy::CreateByName("buffer")->name());
+    EXPECT_TRUE(ABRPolicy::CreateByName("random") == NULL);
+}
+
+TEST_F(ABRPolicyTest, SingleVariant) {
+    Vector<unsigned long> bandwidths;
+    bandwidths.push(0);
+
+    ABRPolicy::State state;
+    state.mBandwidthBps = 1000000;
+    state.mBufferedDurationUs = 5000000ll;
+    state.mCurrentIndex = 0;
+
+    EXPECT_EQ(0u, ABRPolicy::CreateByName("throughput")->pickVariant(bandwidths, state));
+    EXPECT_EQ(0u, ABRPolicy::CreateByName("buffer")->pickVariant(bandwidths, state));
+}
+
+TEST_F(ABRPolicyTest, BufferPolicyFollowsBufferLevel) {
+    Vector<unsigned long> bandwidths;
+    bandwidths.push(350000);
+    bandwidths.push(700000);
+    bandwidths.push(1500000);
+    bandwidths.push(3000000);
+
+    sp<ABRPolicy> policy = ABRPolicy::CreateByName("buffer");
+
+    ABRPolicy::State state;
+    state.mBandwidthBps = 100000000;
+    state.mCurrentIndex = 3;
+
+    size_t prevIndex = 0;
+    for (int64_t bufferedUs = 3000000ll;
+            bufferedUs <= 10000000ll; bufferedUs += 500000ll) {
+        state.mBufferedDurationUs = bufferedUs;
+        size_t index = policy->pickVariant(bandwidths, state);
+
+        EXPECT_GE(index, prevIndex);
+        prevIndex = index;
+    }
+
+    EXPECT_EQ(3u, prevIndex);
+
+    // Never switches up beyond what the throughput allows.
+    state.mBandwidthBps = 1000000;
+    state.mCurrentIndex = 0;
+    EXPECT_EQ(1u, policy->pickVariant(bandwidths, state));
+}
+
+TEST_F(ABRPolicyTest, SteadyBandwidth) {
+    static const char *kPolicies[] = { "throughput", "buffer" };
+
+    for (size_t i = 0; i < 2; ++i) {
+        ABRSimulator::Result result = Simulate(
+                "steady", kSteadyTrace, ARRAY_SIZE(kSteadyTrace), kPolicies[i]);
+
+        EXPECT_EQ(0.0, result.mRebufferSecs);
+        EXPECT_GT(result.mAverageBitrateBps, 2500000.0);
+        EXPECT_LE(result.mNumSwitches, 4u);
+    }
+}
+
+TEST_F(ABRPolicyTest, StepDown) {
+    ABRSimulator::Result throughput = Simulate(
+            "step-down", kStepDownTrace, ARRAY_SIZE(kStepDownTrace), "throughput");
+    ABRSimulator::Result buffer = Simulate(
+            "step-down", kStepDownTrace, ARRAY_SIZE(kStepDownTrace), "buffer");
+
+    EXPECT_LE(buffer.mRebufferSecs, throughput.mRebufferSecs);
+}
+
+TEST_F(ABRPolicyTest, Oscillating) {
+    ABRSimulator::Result throughput = Simulate(
+            "oscillating", kOscillatingTrace, ARRAY_SIZE(kOscillatingTrace),
+            "throughput");
+    ABRSimulator::Result buffer = Simulate(
+            "oscillating", kOscillatingTrace, ARRAY_SIZE(kOscillatingTrace),
+            "buffer");
+
+    EXPECT_LE(buffer.mRebufferSecs, throughput.mRebufferSecs);
+    EXPECT_LT(buffer.mNumSwitches, throughput.mNumSwitches);
+}
+
+TEST_F(ABRPolicyTest, Outage) {
+    ABRSimulator::Result throughput = Simulate(
+            "outage", kOutageTrace, ARRAY_SIZE(kOutageTrace), "throughput");
+    ABRSimulator::Result buffer = Simulate(
+            "outage", kOutageTrace, ARRAY_SIZE(kOutageTrace), "buffer");
+
+    EXPECT_LE(buffer.mRebufferSecs, throughput.mRebufferSecs);
+}
+
+}  // namespace android
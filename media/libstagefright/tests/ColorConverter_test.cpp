@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ColorConverter_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaErrors.h>
+#include <OMX_IVCommon.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+static const OMX_COLOR_FORMATTYPE kYUV420Formats[] = {
+    OMX_COLOR_FormatYUV420Planar,
+    OMX_QCOM_COLOR_FormatYVU420SemiPlanar,
+    OMX_COLOR_FormatYUV420SemiPlanar,
+    OMX_TI_COLOR_FormatYUV420PackedSemiPlanar,
+};
+
+static const size_t kNumYUV420Formats =
+    sizeof(kYUV420Formats) / sizeof(kYUV420Formats[0]);
+
+class ColorConverterTest : public ::testing::Test {
+protected:
+    struct Frame {
+        size_t mWidth, mHeight;
+        size_t mCropLeft, mCropTop, mCropRight, mCropBottom;
+    };
+
+    static uint8_t Clip(signed x) {
+        return x < 0 ? 0 : x > 255 ? 255 : x;
+    }
+
+    // Straightforward per-pixel version of the conversion, independent of
+    // the code under test.
+    static void ReferenceConvert(
+            OMX_COLOR_FORMATTYPE srcFormat, const uint8_t *src,
+            const Frame &frame, bool toRGBA, uint8_t *dst) {
+        size_t width = frame.mCropRight - frame.mCropLeft + 1;
+        size_t height = frame.mCropBottom - frame.mCropTop + 1;
+
+        // Plane origins as ColorConverter has always computed them, note
+        // that chroma is offset by the luma crop origin as well.
+        const uint8_t *srcY, *srcU, *srcV;
+        size_t uvStride, uvStep;
+        bool swapRB = false;
+
+        size_t cropOffset = frame.mCropTop * frame.mWidth + frame.mCropLeft;
+        size_t lumaSize = frame.mWidth * frame.mHeight;
+
+        switch (srcFormat) {
+            case OMX_COLOR_FormatYUV420Planar:
+                srcY = src + cropOffset;
+                srcU = srcY + lumaSize
+                    + frame.mCropTop * (frame.mWidth / 2) + frame.mCropLeft / 2;
+                srcV = srcU + (frame.mWidth / 2) * (frame.mHeight / 2);
+                uvStride = frame.mWidth / 2;
+                uvStep = 1;
+                break;
+
+            case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+                srcY = src + cropOffset;
+                srcU = srcY + lumaSize + cropOffset;
+                srcV = srcU + 1;
+                uvStride = frame.mWidth;
+                uvStep = 2;
+                swapRB = true;
+                break;
+
+            case OMX_COLOR_FormatYUV420SemiPlanar:
+                srcY = src + cropOffset;
+                srcV = srcY + lumaSize + cropOffset;
+                srcU = srcV + 1;
+                uvStride = frame.mWidth;
+                uvStep = 2;
+                swapRB = true;
+                break;
+
+            case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+                srcY = src;
+                srcU = srcY + frame.mWidth
+                    * (frame.mHeight - frame.mCropTop / 2);
+                srcV = srcU + 1;
+                uvStride = frame.mWidth;
+                uvStep = 2;
+                break;
+
+            default:
+                FAIL();
+                return;
+        }
+
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                signed Y = srcY[y * frame.mWidth + x];
+                signed U = srcU[(y / 2) * uvStride + (x / 2) * uvStep];
+                signed V = srcV[(y / 2) * uvStride + (x / 2) * uvStep];
+
+                Y -= 16;
+                U -= 128;
+                V -= 128;
+
+                signed b = (298 * Y + 517 * U) / 256;
+                signed g = (298 * Y - 208 * V - 100 * U) / 256;
+                signed r = (298 * Y + 409 * V) / 256;
+
+                if (swapRB) {
+                    signed tmp = r;
+                    r = b;
+                    b = tmp;
+                }
+
+                if (toRGBA) {
+                    uint8_t *out = &dst[(y * width + x) * 4];
+                    out[0] = Clip(r);
+                    out[1] = Clip(g);
+                    out[2] = Clip(b);
+                    out[3] = 0xff;
+                } else {
+                    uint16_t *out = (uint16_t *)dst;
+                    out[y * width + x] =
+                        ((Clip(r) >> 3) << 11)
+                        | ((Clip(g) >> 2) << 5)
+                        | (Clip(b) >> 3);
+                }
+            }
+        }
+    }
+
+    static uint8_t *MakeSource(const Frame &frame) {
+        // Generous in size, the TI layout addresses chroma past 1.5 * w * h.
+        size_t size = frame.mWidth * frame.mHeight * 2 + 16;
+        uint8_t *src = new uint8_t[size];
+        for (size_t i = 0; i < size; ++i) {
+            src[i] = rand() & 0xff;
+        }
+        return src;
+    }
+
+    static status_t Convert(
+            OMX_COLOR_FORMATTYPE srcFormat, const uint8_t *src,
+            const Frame &frame, bool toRGBA, size_t numThreads,
+            uint8_t *dst) {
+        ColorConverter converter(
+                srcFormat,
+                toRGBA ? (OMX_COLOR_FORMATTYPE)OMX_COLOR_Format32BitRGBA8888
+                       : OMX_COLOR_Format16bitRGB565);
+
+        if (!converter.isValid()) {
+            return ERROR_UNSUPPORTED;
+        }
+
+        converter.setNumThreads(numThreads);
+
+        size_t width = frame.mCropRight - frame.mCropLeft + 1;
+        size_t height = frame.mCropBottom - frame.mCropTop + 1;
+
+        return converter.convert(
+                src, frame.mWidth, frame.mHeight,
+                frame.mCropLeft, frame.mCropTop,
+                frame.mCropRight, frame.mCropBottom,
+                dst, width, height, 0, 0, width - 1, height - 1);
+    }
+
+    void verify(const Frame &frame, bool toRGBA, size_t numThreads) {
+        size_t width = frame.mCropRight - frame.mCropLeft + 1;
+        size_t height = frame.mCropBottom - frame.mCropTop + 1;
+        size_t dstSize = width * height * (toRGBA ? 4 : 2);
+
+        uint8_t *src = MakeSource(frame);
+        uint8_t *expected = new uint8_t[dstSize];
+        uint8_t *actual = new uint8_t[dstSize];
+
+        for (size_t i = 0; i < kNumYUV420Formats; ++i) {
+            OMX_COLOR_FORMATTYPE format = kYUV420Formats[i];
+
+            ReferenceConvert(format, src, frame, toRGBA, expected);
+
+            memset(actual, 0x5a, dstSize);
+            ASSERT_EQ((status_t)OK,
+                      Convert(format, src, frame, toRGBA, numThreads, actual));
+
+            EXPECT_EQ(0, memcmp(expected, actual, dstSize))
+                << "format 0x" << std::hex << format << std::dec
+                << ", " << frame.mWidth << "x" << frame.mHeight
+                << ", " << (toRGBA ? "RGBA8888" : "RGB565")
+                << ", " << numThreads << " threads";
+        }
+
+        delete[] actual;
+        delete[] expected;
+        delete[] src;
+    }
+};
+
+TEST_F(ColorConverterTest, MatchesReferenceRGB565) {
+    static const Frame kFrames[] = {
+        { 176, 144, 0, 0, 175, 143 },
+        { 320, 240, 2, 4, 317, 235 },
+        { 33, 18, 0, 0, 32, 17 },
+        { 18, 10, 2, 0, 16, 9 },
+    };
+
+    for (size_t i = 0; i < sizeof(kFrames) / sizeof(kFrames[0]); ++i) {
+        verify(kFrames[i], false /* toRGBA */, 1);
+    }
+}
+
+TEST_F(ColorConverterTest, MatchesReferenceRGBA8888) {
+    static const Frame kFrames[] = {
+        { 176, 144, 0, 0, 175, 143 },
+        { 320, 240, 2, 4, 317, 235 },
+        { 33, 18, 0, 0, 32, 17 },
+    };
+
+    for (size_t i = 0; i < sizeof(kFrames) / sizeof(kFrames[0]); ++i) {
+        verify(kFrames[i], true /* toRGBA */, 1);
+    }
+}
+
+TEST_F(ColorConverterTest, ThreadedMatchesReference) {
+    static const Frame kFrame = { 1280, 720, 0, 0, 1279, 719 };
+
+    for (size_t numThreads = 2; numThreads <= 5; ++numThreads) {
+        verify(kFrame, false /* toRGBA */, numThreads);
+        verify(kFrame, true /* toRGBA */, numThreads);
+    }
+}
+
+TEST_F(ColorConverterTest, RGBA8888OnlyForYUV420) {
+    ColorConverter converter(
+            OMX_COLOR_FormatCbYCrY,
+            (OMX_COLOR_FORMATTYPE)OMX_COLOR_Format32BitRGBA8888);
+
+    EXPECT_FALSE(converter.isValid());
+}
+
+TEST_F(ColorConverterTest, Throughput1080p) {
+    static const Frame kFrame = { 1920, 1088, 0, 0, 1919, 1079 };
+    static const int kNumFrames = 30;
+
+    uint8_t *src = MakeSource(kFrame);
+    uint8_t *dst = new uint8_t[1920 * 1080 * 4];
+
+    for (size_t numThreads = 1; numThreads <= 4; numThreads *= 2) {
+        for (int toRGBA = 0; toRGBA < 2; ++toRGBA) {
+            int64_t startUs = ALooper::GetNowUs();
+            for (int i = 0; i < kNumFrames; ++i) {
+                ASSERT_EQ((status_t)OK,
+                          Convert(OMX_COLOR_FormatYUV420Planar, src, kFrame,
+                                  toRGBA, numThreads, dst));
+            }
+            int64_t delayUs = ALooper::GetNowUs() - startUs;
+
+            printf("1080p YUV420Planar -> %s, %d thread(s): %.2f ms/frame\n",
+                   toRGBA ? "RGBA8888" : "RGB565", (int)numThreads,
+                   delayUs / 1E3 / kNumFrames);
+        }
+    }
+
+    delete[] dst;
+    delete[] src;
+}
+
+}  // namespace android
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "M3UParser_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include "httplive/M3UParser.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+
+#include <stdio.h>
+
+namespace android {
+
+static const char *kBaseURI = "http://example.com/live/index.m3u8";
+
+// Builds a live media playlist of numSegments segments starting at
+// firstSeqNumber, with a key rotation every keyPeriod segments.
+static AString MakeLivePlaylist(
+        int32_t firstSeqNumber, size_t numSegments,
+        size_t keyPeriod = 0, bool canBlockReload = false) {
+    AString playlist("#EXTM3U\n#EXT-X-TARGETDURATION:6\n");
+
+    if (canBlockReload) {
+        playlist.append("#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES\n");
+    }
+
+    playlist.append("#EXT-X-MEDIA-SEQUENCE:");
+    playlist.append(firstSeqNumber);
+    playlist.append("\n");
+
+    for (size_t i = 0; i < numSegments; ++i) {
+        int32_t seqNumber = firstSeqNumber + i;
+
+        if (keyPeriod > 0 && (i == 0 || seqNumber % keyPeriod == 0)) {
+            playlist.append("#EXT-X-KEY:METHOD=AES-128,URI=\"key");
+            playlist.append(seqNumber / (int32_t)keyPeriod);
+            playlist.append(".bin\"\n");
+        }
+
+        if (seqNumber % 100 == 0) {
+            playlist.append("#EXT-X-DISCONTINUITY\n");
+        }
+
+        playlist.append("#EXTINF:5.96,\nsegment");
+        playlist.append(seqNumber);
+        playlist.append(".ts\n");
+    }
+
+    return playlist;
+}
+
+static sp<M3UParser> Parse(
+        const AString &playlist, const sp<M3UParser> &previous = NULL) {
+    return new M3UParser(
+            kBaseURI, playlist.c_str(), playlist.size(), previous);
+}
+
+// Checks that both playlists describe the same segments.
+static void ExpectSameItems(
+        const sp<M3UParser> &expected, const sp<M3UParser> &actual) {
+    ASSERT_EQ(expected->size(), actual->size());
+
+    for (size_t i = 0; i < expected->size(); ++i) {
+        AString expectedURI, actualURI;
+        sp<AMessage> expectedMeta, actualMeta;
+        ASSERT_TRUE(expected->itemAt(i, &expectedURI, &expectedMeta));
+        ASSERT_TRUE(actual->itemAt(i, &actualURI, &actualMeta));
+
+        EXPECT_STREQ(expectedURI.c_str(), actualURI.c_str());
+
+        int64_t expectedDurationUs, actualDurationUs;
+        ASSERT_TRUE(expectedMeta->findInt64("durationUs", &expectedDurationUs));
+        ASSERT_TRUE(actualMeta->findInt64("durationUs", &actualDurationUs));
+        EXPECT_EQ(expectedDurationUs, actualDurationUs);
+
+        int32_t expectedDiscontinuity = 0, actualDiscontinuity = 0;
+        expectedMeta->findInt32("discontinuity", &expectedDiscontinuity);
+        actualMeta->findInt32("discontinuity", &actualDiscontinuity);
+        EXPECT_EQ(expectedDiscontinuity, actualDiscontinuity);
+
+        AString expectedKeyURI, actualKeyURI;
+        EXPECT_EQ(expectedMeta->findString("cipher-uri", &expectedKeyURI),
+                  actualMeta->findString("cipher-uri", &actualKeyURI));
+        EXPECT_STREQ(expectedKeyURI.c_str(), actualKeyURI.c_str());
+
+        EXPECT_EQ(expected->getItemStartTimeUs(i),
+                  actual->getItemStartTimeUs(i));
+    }
+}
+
+TEST(M3UParserTest, ParsesMediaPlaylist) {
+    static const char *kPlaylist =
+        "#EXTM3U\n"
+        "#EXT-X-TARGETDURATION:10\n"
+        "#EXT-X-MEDIA-SEQUENCE:7\n"
+        "#EXTINF:9.5,\n"
+        "a.ts\n"
+        "#EXT-X-KEY:METHOD=AES-128,URI=\"/keys/k1\",IV=0x1234\n"
+        "#EXT-X-BYTERANGE:1000@500\n"
+        "#EXTINF:10,\n"
+        "b.ts\n"
+        "#EXT-X-DISCONTINUITY\n"
+        "#EXT-X-BYTERANGE:2000\n"
+        "#EXTINF:8,\n"
+        "b.ts\n"
+        "#EXT-X-ENDLIST\n";
+
+    sp<M3UParser> parser =
+        new M3UParser(kBaseURI, kPlaylist, strlen(kPlaylist));
+
+    ASSERT_EQ((status_t)OK, parser->initCheck());
+    EXPECT_TRUE(parser->isExtM3U());
+    EXPECT_FALSE(parser->isVariantPlaylist());
+    EXPECT_TRUE(parser->isComplete());
+    EXPECT_FALSE(parser->canBlockReload());
+    ASSERT_EQ(3u, parser->size());
+
+    int32_t seqNumber;
+    ASSERT_TRUE(parser->meta()->findInt32("media-sequence", &seqNumber));
+    EXPECT_EQ(7, seqNumber);
+
+    AString uri;
+    sp<AMessage> meta;
+    ASSERT_TRUE(parser->itemAt(0, &uri, &meta));
+    EXPECT_STREQ("http://example.com/live/a.ts", uri.c_str());
+
+    int64_t durationUs;
+    ASSERT_TRUE(meta->findInt64("durationUs", &durationUs));
+    EXPECT_EQ(9500000ll, durationUs);
+    EXPECT_FALSE(meta->findString("cipher-method", &uri));
+
+    ASSERT_TRUE(parser->itemAt(1, &uri, &meta));
+    AString keyURI;
+    ASSERT_TRUE(meta->findString("cipher-uri", &keyURI));
+    EXPECT_STREQ("http://example.com/keys/k1", keyURI.c_str());
+
+    int64_t rangeOffset, rangeLength;
+    ASSERT_TRUE(meta->findInt64("range-offset", &rangeOffset));
+    ASSERT_TRUE(meta->findInt64("range-length", &rangeLength));
+    EXPECT_EQ(500ll, rangeOffset);
+    EXPECT_EQ(1000ll, rangeLength);
+
+    // The key stays in effect, the byte range continues the previous one.
+    ASSERT_TRUE(parser->itemAt(2, &uri, &meta));
+    EXPECT_TRUE(meta->findString("cipher-uri", &keyURI));
+
+    int32_t discontinuity;
+    EXPECT_TRUE(meta->findInt32("discontinuity", &discontinuity));
+    ASSERT_TRUE(meta->findInt64("range-offset", &rangeOffset));
+    EXPECT_EQ(1500ll, rangeOffset);
+
+    EXPECT_EQ(0ll, parser->getItemStartTimeUs(0));
+    EXPECT_EQ(19500000ll, parser->getItemStartTimeUs(2));
+    EXPECT_EQ(27500000ll, parser->getItemStartTimeUs(3));
+
+    EXPECT_EQ(0u, parser->getItemIndexForTime(0ll));
+    EXPECT_EQ(1u, parser->getItemIndexForTime(9500000ll));
+    EXPECT_EQ(2u, parser->getItemIndexForTime(27000000ll));
+    EXPECT_EQ(2u, parser->getItemIndexForTime(60000000ll));
+}
+
+TEST(M3UParserTest, ParsesServerControl) {
+    AString playlist = MakeLivePlaylist(0, 3, 0, true /* canBlockReload */);
+    sp<M3UParser> parser = Parse(playlist);
+
+    ASSERT_EQ((status_t)OK, parser->initCheck());
+    EXPECT_TRUE(parser->canBlockReload());
+}
+
+TEST(M3UParserTest, ReloadReusesSegments) {
+    sp<M3UParser> previous = Parse(MakeLivePlaylist(1000, 50, 7));
+    ASSERT_EQ((status_t)OK, previous->initCheck());
+
+    // The window moved on by 3 segments, keys rotate in between.
+    AString playlist = MakeLivePlaylist(1003, 50, 7);
+
+    sp<M3UParser> reloaded = Parse(playlist, previous);
+    ASSERT_EQ((status_t)OK, reloaded->initCheck());
+
+    ExpectSameItems(Parse(playlist), reloaded);
+
+    // Unrelated and non-overlapping playlists are parsed from scratch.
+    playlist = MakeLivePlaylist(2000, 50, 7);
+    ExpectSameItems(Parse(playlist), Parse(playlist, previous));
+}
+
+TEST(M3UParserTest, ReloadDetectsChangedSegments) {
+    sp<M3UParser> previous = Parse(MakeLivePlaylist(1000, 20));
+
+    // Same sequence numbers, but the server restarted with new segments.
+    AString playlist = MakeLivePlaylist(1000, 20);
+    playlist.insert(AString("x"), playlist.find("segment1010.ts"));
+
+    sp<M3UParser> reloaded = Parse(playlist, previous);
+    ASSERT_EQ((status_t)OK, reloaded->initCheck());
+
+    ExpectSameItems(Parse(playlist), reloaded);
+
+    AString uri;
+    ASSERT_TRUE(reloaded->itemAt(10, &uri));
+    EXPECT_STREQ("http://example.com/live/xsegment1010.ts", uri.c_str());
+}
+
+// Times the parsing of a live playlist with a 10000 segment window, from
+// scratch and as a reload that adds one segment.
+TEST(M3UParserTest, Benchmark) {
+    static const size_t kNumSegments = 10000;
+    static const int kNumRuns = 10;
+
+    AString playlist = MakeLivePlaylist(0, kNumSegments, 1000);
+    AString nextPlaylist = MakeLivePlaylist(1, kNumSegments, 1000);
+
+    sp<M3UParser> previous = Parse(playlist);
+    ASSERT_EQ((status_t)OK, previous->initCheck());
+    ASSERT_EQ(kNumSegments, previous->size());
+
+    int64_t startUs = ALooper::GetNowUs();
+    for (int i = 0; i < kNumRuns; ++i) {
+        EXPECT_EQ((status_t)OK, Parse(nextPlaylist)->initCheck());
+    }
+    int64_t fullUs = (ALooper::GetNowUs() - startUs) / kNumRuns;
+
+    startUs = ALooper::GetNowUs();
+    for (int i = 0; i < kNumRuns; ++i) {
+        EXPECT_EQ((status_t)OK, Parse(nextPlaylist, previous)->initCheck());
+    }
+    int64_t incrementalUs = (ALooper::GetNowUs() - startUs) / kNumRuns;
+
+    startUs = ALooper::GetNowUs();
+    sp<M3UParser> next = Parse(nextPlaylist);
+    int64_t totalDurationUs = 0ll;
+    for (size_t i = 0; i < next->size(); ++i) {
+        sp<AMessage> meta;
+        CHECK(next->itemAt(i, NULL /* uri */, &meta));
+
+        int64_t durationUs;
+        CHECK(meta->findInt64("durationUs", &durationUs));
+        totalDurationUs += durationUs;
+    }
+    int64_t itemAtUs = ALooper::GetNowUs() - startUs;
+
+    EXPECT_EQ(totalDurationUs, next->getItemStartTimeUs(next->size()));
+
+    printf("%d segments: full parse %lld us, reload %lld us, "
+           "parse and walk all items %lld us\n",
+           (int)kNumSegments, fullUs, incrementalUs, itemAtUs);
+}
+
+}  // namespace android
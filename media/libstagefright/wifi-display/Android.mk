@@ -3,6 +3,7 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
+        GatherList.cpp                  \
         MediaSender.cpp                 \
         Parameters.cpp                  \
         rtp/RTPSender.cpp               \
@@ -35,3 +36,26 @@ LOCAL_MODULE:= libstagefright_wfd
 LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+        tsbench.cpp                     \
+
+LOCAL_SHARED_LIBRARIES:= \
+        liblog                          \
+        libstagefright                  \
+        libstagefright_foundation       \
+        libstagefright_wfd              \
+        libutils                        \
+
+LOCAL_C_INCLUDES:= \
+        $(TOP)/frameworks/av/media/libstagefright \
+
+LOCAL_MODULE:= tsbench
+
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2013, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "GatherList"
+#include <utils/Log.h>
+
+#include "GatherList.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <string.h>
+
+namespace android {
+
+GatherList::GatherList()
+    : mSize(0) {
+}
+
+const ABufferRange &GatherList::rangeAt(size_t index) const {
+    return mRanges.itemAt(index);
+}
+
+void GatherList::append(
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    CHECK_LE(offset + size, buffer->size());
+
+    appendRange(buffer, buffer->offset() + offset, size);
+}
+
+void GatherList::append(const sp<ABuffer> &buffer) {
+    append(buffer, 0, buffer->size());
+}
+
+void GatherList::appendRange(
+        const sp<ABuffer> &buffer, size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    mSize += size;
+
+    if (!mRanges.isEmpty()) {
+        ABufferRange *last = &mRanges.editItemAt(mRanges.size() - 1);
+
+        if (last->mBuffer == buffer && last->mOffset + last->mSize == offset) {
+            last->mSize += size;
+            return;
+        }
+    }
+
+    mRanges.push(ABufferRange(buffer, offset, size));
+}
+
+void GatherList::appendFrom(
+        const GatherList &other, Cursor *cursor, size_t size) {
+    while (size > 0) {
+        CHECK_LT(cursor->mIndex, other.mRanges.size());
+
+        const ABufferRange &range = other.mRanges.itemAt(cursor->mIndex);
+
+        size_t n = range.mSize - cursor->mOffset;
+        if (n > size) {
+            n = size;
+        }
+
+        appendRange(range.mBuffer, range.mOffset + cursor->mOffset, n);
+
+        size -= n;
+        cursor->mOffset += n;
+
+        if (cursor->mOffset == range.mSize) {
+            ++cursor->mIndex;
+            cursor->mOffset = 0;
+        }
+    }
+}
+
+void GatherList::copyTo(uint8_t *dst) const {
+    for (size_t i = 0; i < mRanges.size(); ++i) {
+        const ABufferRange &range = mRanges.itemAt(i);
+
+        memcpy(dst, range.data(), range.mSize);
+        dst += range.mSize;
+    }
+}
+
+sp<ABuffer> GatherList::flatten() const {
+    sp<ABuffer> buffer = new ABuffer(mSize);
+    copyTo(buffer->data());
+
+    return buffer;
+}
+
+void GatherList::clear() {
+    mRanges.clear();
+    mSize = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+HeaderArena::HeaderArena()
+    : mCurrentChunk(0),
+      mOffset(kChunkSize),
+      mNumChunksAllocated(0) {
+}
+
+uint8_t *HeaderArena::append(GatherList *list, size_t size) {
+    CHECK_LE(size, (size_t)kChunkSize);
+
+    if (mChunks.isEmpty() || mOffset + size > kChunkSize) {
+        nextChunk();
+    }
+
+    const sp<ABuffer> &chunk = mChunks.itemAt(mCurrentChunk);
+
+    list->append(chunk, mOffset, size);
+
+    uint8_t *ptr = chunk->base() + mOffset;
+    mOffset += size;
+
+    return ptr;
+}
+
+void HeaderArena::nextChunk() {
+    mOffset = 0;
+
+    for (size_t i = 0; i < mChunks.size(); ++i) {
+        mCurrentChunk = (mCurrentChunk + 1) % mChunks.size();
+
+        if (mChunks.itemAt(mCurrentChunk)->getStrongCount() == 1) {
+            // Nothing but the arena refers to this one anymore.
+            return;
+        }
+    }
+
+    ++mNumChunksAllocated;
+
+    if (mChunks.size() < kMaxNumChunks) {
+        mChunks.push(new ABuffer(kChunkSize));
+        mCurrentChunk = mChunks.size() - 1;
+        return;
+    }
+
+    // Everything is still in use, probably because the network is stalled.
+    // Whoever still refers to the chunk being replaced keeps it alive.
+    mCurrentChunk = (mCurrentChunk + 1) % mChunks.size();
+    mChunks.editItemAt(mCurrentChunk) = new ABuffer(kChunkSize);
+}
+
+}  // namespace android
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2013, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GATHER_LIST_H_
+
+#define GATHER_LIST_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/ABufferRange.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Data made up of ranges of other buffers, e.g. packet headers followed by
+// slices of the access unit they carry, that is only ever copied (if at
+// all) when it is finally handed to the network.
+struct GatherList {
+    GatherList();
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mRanges.isEmpty(); }
+
+    size_t countRanges() const { return mRanges.size(); }
+    const ABufferRange &rangeAt(size_t index) const;
+    const ABufferRange *ranges() const { return mRanges.array(); }
+
+    // References size bytes starting offset bytes into buffer->data().
+    // Merges with the last range if that ends where this one starts.
+    void append(const sp<ABuffer> &buffer, size_t offset, size_t size);
+    void append(const sp<ABuffer> &buffer);
+
+    // Tracks how far a list has been consumed by appendFrom().
+    struct Cursor {
+        Cursor() : mIndex(0), mOffset(0) {}
+
+        size_t mIndex;
+        size_t mOffset;
+    };
+
+    // References the next size bytes of other, starting where the previous
+    // call with the same cursor left off.
+    void appendFrom(const GatherList &other, Cursor *cursor, size_t size);
+
+    // Copies the data into the given memory, which must hold size() bytes.
+    void copyTo(uint8_t *dst) const;
+
+    sp<ABuffer> flatten() const;
+
+    void clear();
+
+private:
+    Vector<ABufferRange> mRanges;
+    size_t mSize;
+
+    void appendRange(const sp<ABuffer> &buffer, size_t offset, size_t size);
+};
+
+// Hands out space for packet headers from a few large buffers that are
+// recycled once nothing references them anymore, instead of allocating a
+// buffer per packet.
+struct HeaderArena {
+    HeaderArena();
+
+    // Reserves size bytes and appends them to *list. The caller fills them
+    // in through the returned pointer before using the list.
+    uint8_t *append(GatherList *list, size_t size);
+
+    size_t numChunksAllocated() const { return mNumChunksAllocated; }
+
+private:
+    enum {
+        kChunkSize      = 16384,
+        kMaxNumChunks   = 64,
+    };
+
+    Vector<sp<ABuffer> > mChunks;
+    size_t mCurrentChunk;
+    size_t mOffset;
+
+    size_t mNumChunksAllocated;
+
+    void nextChunk();
+
+    DISALLOW_EVIL_CONSTRUCTORS(HeaderArena);
+};
+
+}  // namespace android
+
+#endif  // GATHER_LIST_H_
@@ -248,23 +248,23 @@ status_t MediaSender::queueAccessUnit(
             sp<ABuffer> accessUnit = *info->mAccessUnits.begin();
             info->mAccessUnits.erase(info->mAccessUnits.begin());
 
-            sp<ABuffer> tsPackets;
+            GatherList tsPackets;
             status_t err = packetizeAccessUnit(
                     minTrackIndex, accessUnit, &tsPackets);
 
             if (err == OK) {
                 if (mLogFile != NULL) {
-                    fwrite(tsPackets->data(), 1, tsPackets->size(), mLogFile);
+                    for (size_t i = 0; i < tsPackets.countRanges(); ++i) {
+                        const ABufferRange &range = tsPackets.rangeAt(i);
+                        fwrite(range.data(), 1, range.mSize, mLogFile);
+                    }
                 }
 
                 int64_t timeUs;
                 CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
-                tsPackets->meta()->setInt64("timeUs", timeUs);
 
-                err = mTSSender->queueBuffer(
-                        tsPackets,
-                        33 /* packetType */,
-                        RTPSender::PACKETIZATION_TRANSPORT_STREAM);
+                err = mTSSender->queueTSPackets(
+                        tsPackets, timeUs, 33 /* packetType */);
             }
 
             if (err != OK) {
@@ -388,7 +388,7 @@ void MediaSender::notifyNetworkStall(size_t numBytesQueued) {
 status_t MediaSender::packetizeAccessUnit(
         size_t trackIndex,
         sp<ABuffer> accessUnit,
-        sp<ABuffer> *tsPackets) {
+        GatherList *tsPackets) {
     const TrackInfo &info = mTrackInfos.itemAt(trackIndex);
 
     uint32_t flags = 0;
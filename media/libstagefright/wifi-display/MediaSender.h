@@ -121,7 +121,7 @@ private:
     status_t packetizeAccessUnit(
             size_t trackIndex,
             sp<ABuffer> accessUnit,
-            sp<ABuffer> *tsPackets);
+            GatherList *tsPackets);
 
     DISALLOW_EVIL_CONSTRUCTORS(MediaSender);
 };
@@ -32,6 +32,11 @@
 
 namespace android {
 
+static uint16_t GetSeqNo(const GatherList &packet) {
+    // The RTP header is always written in one piece.
+    return U16_AT(packet.rangeAt(0).data() + 2);
+}
+
 RTPSender::RTPSender(
         const sp<ANetworkSession> &netSession,
         const sp<AMessage> &notify)
@@ -214,8 +219,6 @@ status_t RTPSender::queueRawPacket(
 
     sp<ABuffer> udpPacket = new ABuffer(12 + packet->size());
 
-    udpPacket->setInt32Data(mRTPSeqNo);
-
     uint8_t *rtp = udpPacket->data();
     rtp[0] = 0x80;
     rtp[1] = packetType;
@@ -247,21 +250,26 @@ status_t RTPSender::queueRawPacket(
 
 status_t RTPSender::queueTSPackets(
         const sp<ABuffer> &tsPackets, uint8_t packetType) {
-    CHECK_EQ(0, tsPackets->size() % 188);
-
     int64_t timeUs;
     CHECK(tsPackets->meta()->findInt64("timeUs", &timeUs));
 
-    const size_t numTSPackets = tsPackets->size() / 188;
+    GatherList list;
+    list.append(tsPackets);
 
-    size_t srcOffset = 0;
-    while (srcOffset < tsPackets->size()) {
-        sp<ABuffer> udpPacket =
-            new ABuffer(12 + kMaxNumTSPacketsPerRTPPacket * 188);
+    return queueTSPackets(list, timeUs, packetType);
+}
+
+status_t RTPSender::queueTSPackets(
+        const GatherList &tsPackets, int64_t timeUs, uint8_t packetType) {
+    CHECK_EQ(0u, tsPackets.size() % 188);
 
-        udpPacket->setInt32Data(mRTPSeqNo);
+    GatherList::Cursor cursor;
 
-        uint8_t *rtp = udpPacket->data();
+    size_t srcOffset = 0;
+    while (srcOffset < tsPackets.size()) {
+        GatherList udpPacket;
+
+        uint8_t *rtp = mHeaderArena.append(&udpPacket, 12);
         rtp[0] = 0x80;
         rtp[1] = packetType;
 
@@ -282,17 +290,15 @@ status_t RTPSender::queueTSPackets(
         rtp[10] = (kSourceID >> 8) & 0xff;
         rtp[11] = kSourceID & 0xff;
 
-        size_t numTSPackets = (tsPackets->size() - srcOffset) / 188;
+        size_t numTSPackets = (tsPackets.size() - srcOffset) / 188;
         if (numTSPackets > kMaxNumTSPacketsPerRTPPacket) {
             numTSPackets = kMaxNumTSPacketsPerRTPPacket;
         }
 
-        memcpy(&rtp[12], tsPackets->data() + srcOffset, numTSPackets * 188);
-
-        udpPacket->setRange(0, 12 + numTSPackets * 188);
+        udpPacket.appendFrom(tsPackets, &cursor, numTSPackets * 188);
 
         srcOffset += numTSPackets * 188;
-        bool isLastPacket = (srcOffset == tsPackets->size());
+        bool isLastPacket = (srcOffset == tsPackets.size());
 
         status_t err = sendRTPPacket(
                 udpPacket,
@@ -422,8 +428,6 @@ status_t RTPSender::queueAVCBuffer(
         sp<ABuffer> out = *packets.begin();
         packets.erase(packets.begin());
 
-        out->setInt32Data(mRTPSeqNo);
-
         bool last = packets.empty();
 
         uint8_t *dst = out->data();
@@ -461,10 +465,20 @@ status_t RTPSender::queueAVCBuffer(
 status_t RTPSender::sendRTPPacket(
         const sp<ABuffer> &buffer, bool storeInHistory,
         bool timeValid, int64_t timeUs) {
+    GatherList packet;
+    packet.append(buffer);
+
+    return sendRTPPacket(packet, storeInHistory, timeValid, timeUs);
+}
+
+status_t RTPSender::sendRTPPacket(
+        const GatherList &packet, bool storeInHistory,
+        bool timeValid, int64_t timeUs) {
     CHECK(mRTPConnected);
+    CHECK_GE(packet.rangeAt(0).mSize, 12u);
 
-    status_t err = mNetSession->sendRequest(
-            mRTPSessionID, buffer->data(), buffer->size(),
+    status_t err = mNetSession->sendDatagram(
+            mRTPSessionID, packet.ranges(), packet.countRanges(),
             timeValid, timeUs);
 
     if (err != OK) {
@@ -472,10 +486,10 @@ status_t RTPSender::sendRTPPacket(
     }
 
     mLastNTPTime = GetNowNTP();
-    mLastRTPTime = U32_AT(buffer->data() + 4);
+    mLastRTPTime = U32_AT(packet.rangeAt(0).data() + 4);
 
     ++mNumRTPSent;
-    mNumRTPOctetsSent += buffer->size() - 12;
+    mNumRTPOctetsSent += packet.size() - 12;
 
     if (storeInHistory) {
         if (mHistorySize == kMaxHistorySize) {
@@ -483,7 +497,7 @@ status_t RTPSender::sendRTPPacket(
         } else {
             ++mHistorySize;
         }
-        mHistory.push_back(buffer);
+        mHistory.push_back(packet);
     }
 
     return OK;
@@ -710,12 +724,12 @@ status_t RTPSender::parseTSFB(const uint8_t *data, size_t size) {
         uint16_t seqNo = U16_AT(&data[i]);
         uint16_t blp = U16_AT(&data[i + 2]);
 
-        List<sp<ABuffer> >::iterator it = mHistory.begin();
+        List<GatherList>::iterator it = mHistory.begin();
         bool foundSeqNo = false;
         while (it != mHistory.end()) {
-            const sp<ABuffer> &buffer = *it;
+            const GatherList &packet = *it;
 
-            uint16_t bufferSeqNo = buffer->int32Data() & 0xffff;
+            uint16_t bufferSeqNo = GetSeqNo(packet);
 
             bool retransmit = false;
             if (bufferSeqNo == seqNo) {
@@ -734,7 +748,7 @@ status_t RTPSender::parseTSFB(const uint8_t *data, size_t size) {
                 ALOGV("retransmitting seqNo %d", bufferSeqNo);
 
                 CHECK_EQ((status_t)OK,
-                         sendRTPPacket(buffer, false /* storeInHistory */));
+                         sendRTPPacket(packet, false /* storeInHistory */));
 
                 if (bufferSeqNo == seqNo) {
                     foundSeqNo = true;
@@ -754,8 +768,8 @@ status_t RTPSender::parseTSFB(const uint8_t *data, size_t size) {
                   seqNo, foundSeqNo, blp);
 
             if (!mHistory.empty()) {
-                int32_t earliest = (*mHistory.begin())->int32Data() & 0xffff;
-                int32_t latest = (*--mHistory.end())->int32Data() & 0xffff;
+                int32_t earliest = GetSeqNo(*mHistory.begin());
+                int32_t latest = GetSeqNo(*--mHistory.end());
 
                 ALOGI("have seq numbers from %d - %d", earliest, latest);
             }
@@ -20,6 +20,8 @@
 
 #include "RTPBase.h"
 
+#include "GatherList.h"
+
 #include <media/stagefright/foundation/AHandler.h>
 
 namespace android {
@@ -56,6 +58,12 @@ struct RTPSender : public RTPBase, public AHandler {
             uint8_t packetType,
             PacketizationMode mode);
 
+    // Sends transport stream packets, the size of tsPackets must be a
+    // multiple of 188 bytes. Neither the packets nor the RTP headers are
+    // copied, see TSPacketizer::packetize().
+    status_t queueTSPackets(
+            const GatherList &tsPackets, int64_t timeUs, uint8_t packetType);
+
 protected:
     virtual ~RTPSender();
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -89,9 +97,13 @@ private:
 
     uint32_t mRTPSeqNo;
 
-    List<sp<ABuffer> > mHistory;
+    // Packets sent, for retransmission. Their sequence numbers are read
+    // back from their RTP headers.
+    List<GatherList> mHistory;
     size_t mHistorySize;
 
+    HeaderArena mHeaderArena;
+
     static uint64_t GetNowNTP();
 
     status_t queueRawPacket(const sp<ABuffer> &tsPackets, uint8_t packetType);
@@ -102,6 +114,10 @@ private:
             const sp<ABuffer> &packet, bool storeInHistory,
             bool timeValid = false, int64_t timeUs = -1ll);
 
+    status_t sendRTPPacket(
+            const GatherList &packet, bool storeInHistory,
+            bool timeValid = false, int64_t timeUs = -1ll);
+
     void onNetNotify(bool isRTP, const sp<AMessage> &msg);
 
     status_t onRTCPData(const sp<ABuffer> &data);
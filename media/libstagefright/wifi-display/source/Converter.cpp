@@ -674,6 +674,17 @@ status_t Converter::feedEncoderInputBuffers() {
 sp<ABuffer> Converter::prependCSD(const sp<ABuffer> &accessUnit) const {
     CHECK(mCSD0 != NULL);
 
+    if (accessUnit->offset() >= mCSD0->size()) {
+        // Room was left for it in front of the access unit.
+        accessUnit->setRange(
+                accessUnit->offset() - mCSD0->size(),
+                accessUnit->size() + mCSD0->size());
+
+        memcpy(accessUnit->data(), mCSD0->data(), mCSD0->size());
+
+        return accessUnit;
+    }
+
     sp<ABuffer> dup = new ABuffer(accessUnit->size() + mCSD0->size());
     memcpy(dup->data(), mCSD0->data(), mCSD0->size());
     memcpy(dup->data() + mCSD0->size(), accessUnit->data(), accessUnit->size());
@@ -765,7 +776,18 @@ status_t Converter::doMoreWork() {
                 buffer->meta()->setInt32("rangeLength", rangeLength);
                 buffer->meta()->setMessage("notify", notify);
             } else {
-                buffer = new ABuffer(size);
+                // Leave room for the codec specific data in case it has to
+                // be prepended, that way the access unit is copied once.
+                size_t headroom = 0;
+                if (mNeedToManuallyPrependSPSPPS
+                        && mIsH264
+                        && (mFlags & FLAG_PREPEND_CSD_IF_NECESSARY)
+                        && mCSD0 != NULL) {
+                    headroom = mCSD0->size();
+                }
+
+                buffer = new ABuffer(headroom + size);
+                buffer->setRange(headroom, size);
             }
 
             buffer->meta()->setInt64("timeUs", timeUs);
@@ -52,7 +52,10 @@ struct TSPacketizer::Track : public RefBase {
     bool isPCMAudio() const;
 
     sp<ABuffer> prependCSD(const sp<ABuffer> &accessUnit) const;
-    sp<ABuffer> prependADTSHeader(const sp<ABuffer> &accessUnit) const;
+    void appendCSD(GatherList *list) const;
+
+    // Writes the 7 byte ADTS header for an access unit of the given size.
+    void writeADTSHeader(uint8_t *ptr, size_t accessUnitSize) const;
 
     size_t countDescriptors() const;
     sp<ABuffer> descriptorAt(size_t index) const;
@@ -194,15 +197,19 @@ sp<ABuffer> TSPacketizer::Track::prependCSD(
     return dup;
 }
 
-sp<ABuffer> TSPacketizer::Track::prependADTSHeader(
-        const sp<ABuffer> &accessUnit) const {
+void TSPacketizer::Track::appendCSD(GatherList *list) const {
+    for (size_t i = 0; i < mCSD.size(); ++i) {
+        list->append(mCSD.itemAt(i));
+    }
+}
+
+void TSPacketizer::Track::writeADTSHeader(
+        uint8_t *ptr, size_t accessUnitSize) const {
     CHECK_EQ(mCSD.size(), 1u);
 
     const uint8_t *codec_specific_data = mCSD.itemAt(0)->data();
 
-    const uint32_t aac_frame_length = accessUnit->size() + 7;
-
-    sp<ABuffer> dup = new ABuffer(aac_frame_length);
+    const uint32_t aac_frame_length = accessUnitSize + 7;
 
     unsigned profile = (codec_specific_data[0] >> 3) - 1;
 
@@ -213,8 +220,6 @@ sp<ABuffer> TSPacketizer::Track::prependADTSHeader(
     unsigned channel_configuration =
         (codec_specific_data[1] >> 3) & 0x0f;
 
-    uint8_t *ptr = dup->data();
-
     *ptr++ = 0xff;
     *ptr++ = 0xf9;  // b11111001, ID=1(MPEG-2), layer=0, protection_absent=1
 
@@ -232,10 +237,6 @@ sp<ABuffer> TSPacketizer::Track::prependADTSHeader(
 
     // adts_buffer_fullness=0, number_of_raw_data_blocks_in_frame=0
     *ptr++ = 0;
-
-    memcpy(ptr, accessUnit->data(), accessUnit->size());
-
-    return dup;
 }
 
 size_t TSPacketizer::Track::countDescriptors() const {
@@ -452,13 +453,11 @@ status_t TSPacketizer::extractCSDIfNecessary(size_t trackIndex) {
 
 status_t TSPacketizer::packetize(
         size_t trackIndex,
-        const sp<ABuffer> &_accessUnit,
-        sp<ABuffer> *packets,
+        const sp<ABuffer> &accessUnit,
+        GatherList *packets,
         uint32_t flags,
         const uint8_t *PES_private_data, size_t PES_private_data_len,
         size_t numStuffingBytes) {
-    sp<ABuffer> accessUnit = _accessUnit;
-
     int64_t timeUs;
     CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
 
@@ -470,15 +469,22 @@ status_t TSPacketizer::packetize(
 
     const sp<Track> &track = mTracks.itemAt(trackIndex);
 
+    // The PES payload, referring to (not copying) the access unit and
+    // whatever has to go in front of it.
+    GatherList payload;
+
     if (track->isH264() && (flags & PREPEND_SPS_PPS_TO_IDR_FRAMES)
             && IsIDR(accessUnit)) {
         // prepend codec specific data, i.e. SPS and PPS.
-        accessUnit = track->prependCSD(accessUnit);
+        track->appendCSD(&payload);
     } else if (track->isAAC() && track->lacksADTSHeader()) {
         CHECK(!(flags & IS_ENCRYPTED));
-        accessUnit = track->prependADTSHeader(accessUnit);
+        track->writeADTSHeader(
+                mHeaderArena.append(&payload, 7), accessUnit->size());
     }
 
+    payload.append(accessUnit);
+
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
@@ -538,7 +544,7 @@ status_t TSPacketizer::packetize(
        followed by the payload
     */
 
-    size_t PES_packet_length = accessUnit->size() + 8 + numStuffingBytes;
+    size_t PES_packet_length = payload.size() + 8 + numStuffingBytes;
     if (PES_private_data_len > 0) {
         PES_packet_length += PES_private_data_len + 1;
     }
@@ -555,7 +561,7 @@ status_t TSPacketizer::packetize(
         CHECK_LE(PES_header_size, 188u - 4u);
 
         size_t sizeAvailableForPayload = 188 - 4 - PES_header_size;
-        size_t numBytesOfPayload = accessUnit->size();
+        size_t numBytesOfPayload = payload.size();
 
         if (numBytesOfPayload > sizeAvailableForPayload) {
             numBytesOfPayload = sizeAvailableForPayload;
@@ -569,7 +575,7 @@ status_t TSPacketizer::packetize(
         ALOGV("packet 1 contains %zd padding bytes and %zd bytes of payload",
               numPaddingBytes, numBytesOfPayload);
 
-        size_t numBytesOfPayloadRemaining = accessUnit->size() - numBytesOfPayload;
+        size_t numBytesOfPayloadRemaining = payload.size() - numBytesOfPayload;
 
 #if 0
         // The following hopefully illustrates the logic that led to the
@@ -639,8 +645,7 @@ status_t TSPacketizer::packetize(
         ++numTSPackets;
     }
 
-    sp<ABuffer> buffer = new ABuffer(numTSPackets * 188);
-    uint8_t *packetDataStart = buffer->data();
+    uint8_t *packetDataStart;
 
     if (flags & EMIT_PAT_AND_PMT) {
         // Program Association Table (PAT):
@@ -675,6 +680,8 @@ status_t TSPacketizer::packetize(
             mPATContinuityCounter = 0;
         }
 
+        packetDataStart = mHeaderArena.append(packets, 188);
+
         uint8_t *ptr = packetDataStart;
         *ptr++ = 0x47;
         *ptr++ = 0x40;
@@ -704,8 +711,6 @@ status_t TSPacketizer::packetize(
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
 
-        packetDataStart += 188;
-
         // Program Map (PMT):
         // 0x47
         // transport_error_indicator = b0
@@ -745,6 +750,8 @@ status_t TSPacketizer::packetize(
             mPMTContinuityCounter = 0;
         }
 
+        packetDataStart = mHeaderArena.append(packets, 188);
+
         ptr = packetDataStart;
         *ptr++ = 0x47;
         *ptr++ = 0x40 | (kPID_PMT >> 8);
@@ -818,8 +825,6 @@ status_t TSPacketizer::packetize(
 
         sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
-
-        packetDataStart += 188;
     }
 
     if (flags & EMIT_PCR) {
@@ -851,6 +856,8 @@ status_t TSPacketizer::packetize(
         uint64_t PCR_base = PCR / 300;
         uint32_t PCR_ext = PCR % 300;
 
+        packetDataStart = mHeaderArena.append(packets, 188);
+
         uint8_t *ptr = packetDataStart;
         *ptr++ = 0x47;
         *ptr++ = 0x40 | (kPID_PCR >> 8);
@@ -866,8 +873,6 @@ status_t TSPacketizer::packetize(
 
         size_t sizeLeft = packetDataStart + 188 - ptr;
         memset(ptr, 0xff, sizeLeft);
-
-        packetDataStart += 188;
     }
 
     uint64_t PTS = (timeUs * 9ll) / 100ll;
@@ -885,7 +890,7 @@ status_t TSPacketizer::packetize(
         sizeAvailableForPayload -= PES_private_data_len + 1;
     }
 
-    size_t copy = accessUnit->size();
+    size_t copy = payload.size();
 
     if (copy > sizeAvailableForPayload) {
         copy = sizeAvailableForPayload;
@@ -897,6 +902,9 @@ status_t TSPacketizer::packetize(
 
     size_t numPaddingBytes = sizeAvailableForPayload - copy;
 
+    // Only the headers are written, the payload is referenced.
+    packetDataStart = mHeaderArena.append(packets, 188 - copy);
+
     uint8_t *ptr = packetDataStart;
     *ptr++ = 0x47;
     *ptr++ = 0x40 | (track->PID() >> 8);
@@ -946,14 +954,13 @@ status_t TSPacketizer::packetize(
         *ptr++ = 0xff;
     }
 
-    memcpy(ptr, accessUnit->data(), copy);
-    ptr += copy;
+    CHECK_EQ(ptr, packetDataStart + 188 - copy);
 
-    CHECK_EQ(ptr, packetDataStart + 188);
-    packetDataStart += 188;
+    GatherList::Cursor cursor;
+    packets->appendFrom(payload, &cursor, copy);
 
     size_t offset = copy;
-    while (offset < accessUnit->size()) {
+    while (offset < payload.size()) {
         // for subsequent fragments of "buffer":
         // 0x47
         // transport_error_indicator = b0
@@ -967,7 +974,7 @@ status_t TSPacketizer::packetize(
 
         size_t sizeAvailableForPayload = 188 - 4;
 
-        size_t copy = accessUnit->size() - offset;
+        size_t copy = payload.size() - offset;
 
         if (copy > sizeAvailableForPayload) {
             copy = sizeAvailableForPayload;
@@ -979,6 +986,8 @@ status_t TSPacketizer::packetize(
 
         size_t numPaddingBytes = sizeAvailableForPayload - copy;
 
+        packetDataStart = mHeaderArena.append(packets, 188 - copy);
+
         uint8_t *ptr = packetDataStart;
         *ptr++ = 0x47;
         *ptr++ = 0x00 | (track->PID() >> 8);
@@ -996,17 +1005,13 @@ status_t TSPacketizer::packetize(
             }
         }
 
-        memcpy(ptr, accessUnit->data() + offset, copy);
-        ptr += copy;
-        CHECK_EQ(ptr, packetDataStart + 188);
+        CHECK_EQ(ptr, packetDataStart + 188 - copy);
+        packets->appendFrom(payload, &cursor, copy);
 
         offset += copy;
-        packetDataStart += 188;
     }
 
-    CHECK(packetDataStart == buffer->data() + buffer->capacity());
-
-    *packets = buffer;
+    CHECK_EQ(packets->size(), numTSPackets * 188);
 
     return OK;
 }
@@ -18,6 +18,8 @@
 
 #define TS_PACKETIZER_H_
 
+#include "GatherList.h"
+
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
@@ -47,9 +49,14 @@ struct TSPacketizer : public RefBase {
         IS_ENCRYPTED                    = 4,
         PREPEND_SPS_PPS_TO_IDR_FRAMES   = 8,
     };
+
+    // The packets' headers are written into memory owned by the packetizer,
+    // their payload refers to the access unit (and codec specific data) it
+    // was taken from. None of these must be modified while the packets are
+    // in use.
     status_t packetize(
             size_t trackIndex, const sp<ABuffer> &accessUnit,
-            sp<ABuffer> *packets,
+            GatherList *packets,
             uint32_t flags,
             const uint8_t *PES_private_data, size_t PES_private_data_len,
             size_t numStuffingBytes = 0);
@@ -80,6 +87,8 @@ private:
     unsigned mPATContinuityCounter;
     unsigned mPMTContinuityCounter;
 
+    HeaderArena mHeaderArena;
+
     uint32_t mCrcTable[256];
 
     void initCrcTable();
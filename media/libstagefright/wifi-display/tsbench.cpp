@@ -0,0 +1,437 @@
+/*
+ * Copyright 2013, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "tsbench"
+#include <utils/Log.h>
+
+#include "GatherList.h"
+#include "rtp/RTPSender.h"
+#include "source/TSPacketizer.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/ANetworkSession.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/Utils.h>
+#include <utils/threads.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Packetizes a synthetic 1080p H.264 stream into transport stream packets
+// and sends them as RTP over the loopback interface to a local UDP sink,
+// the way the wifi display source does. Reports the CPU time spent and how
+// long packets took from being packetized to arriving at the sink.
+
+namespace android {
+
+// Collects the datagrams arriving at the sink.
+struct Sink : public AHandler {
+    Sink()
+        : mNumPackets(0),
+          mNumBytes(0),
+          mTotalLatencyUs(0),
+          mMaxLatencyUs(0) {
+    }
+
+    size_t mNumPackets;
+    int64_t mNumBytes;
+    int64_t mTotalLatencyUs;
+    int64_t mMaxLatencyUs;
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int32_t reason;
+        CHECK(msg->findInt32("reason", &reason));
+
+        if (reason != ANetworkSession::kWhatDatagram) {
+            return;
+        }
+
+        sp<ABuffer> data;
+        CHECK(msg->findBuffer("data", &data));
+        CHECK_GE(data->size(), 12u);
+
+        int64_t arrivalTimeUs;
+        CHECK(data->meta()->findInt64("arrivalTimeUs", &arrivalTimeUs));
+
+        // The RTP time of transport stream packets is the (90kHz) time at
+        // which they were packetized.
+        uint32_t rtpTime = U32_AT(data->data() + 4);
+        uint32_t arrivalTime = (arrivalTimeUs * 9) / 100ll;
+        int64_t latencyUs = ((int32_t)(arrivalTime - rtpTime) * 100ll) / 9;
+
+        ++mNumPackets;
+        mNumBytes += data->size();
+        mTotalLatencyUs += latencyUs;
+
+        if (latencyUs > mMaxLatencyUs) {
+            mMaxLatencyUs = latencyUs;
+        }
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(Sink);
+};
+
+// Produces access units at the given rate and hands them to the packetizer
+// and RTP sender.
+struct Producer : public AHandler {
+    Producer(
+            const sp<RTPSender> &sender,
+            int32_t bitrate, int32_t frameRate, int32_t numFrames,
+            bool flatten)
+        : mPacketizeTimeUs(0),
+          mSender(sender),
+          mFrameRate(frameRate),
+          mNumFrames(numFrames),
+          mFlatten(flatten),
+          mFrameIndex(0),
+          mStartTimeUs(-1ll),
+          mDone(false) {
+        mPacketizer = new TSPacketizer(0);
+
+        static const uint8_t kSPS[] = {
+            0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x28,
+            0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0x84,
+        };
+
+        static const uint8_t kPPS[] = {
+            0x00, 0x00, 0x00, 0x01, 0x68, 0xeb, 0xe3, 0xcb,
+        };
+
+        sp<ABuffer> csd0 = new ABuffer(sizeof(kSPS));
+        memcpy(csd0->data(), kSPS, sizeof(kSPS));
+
+        sp<ABuffer> csd1 = new ABuffer(sizeof(kPPS));
+        memcpy(csd1->data(), kPPS, sizeof(kPPS));
+
+        sp<AMessage> format = new AMessage;
+        format->setString("mime", MEDIA_MIMETYPE_VIDEO_AVC);
+        format->setBuffer("csd-0", csd0);
+        format->setBuffer("csd-1", csd1);
+
+        mTrackIndex = mPacketizer->addTrack(format);
+        CHECK_GE(mTrackIndex, 0);
+
+        mPacketizer->extractCSDIfNecessary(mTrackIndex);
+
+        // One IDR frame per second, four times the size of the others.
+        size_t frameSize = bitrate / 8 / frameRate;
+        size_t PFrameSize = frameSize * frameRate / (frameRate + 3);
+
+        mIDRFrame = MakeFrame(5 /* nalType */, 4 * PFrameSize);
+        mPFrame = MakeFrame(1 /* nalType */, PFrameSize);
+    }
+
+    void start() {
+        (new AMessage(kWhatProduce, id()))->post();
+    }
+
+    void waitUntilDone() {
+        Mutex::Autolock autoLock(mLock);
+        while (!mDone) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    int64_t mPacketizeTimeUs;
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        CHECK_EQ(msg->what(), (uint32_t)kWhatProduce);
+
+        if (mFrameIndex == mNumFrames) {
+            Mutex::Autolock autoLock(mLock);
+            mDone = true;
+            mCondition.signal();
+            return;
+        }
+
+        int64_t nowUs = ALooper::GetNowUs();
+        if (mStartTimeUs < 0ll) {
+            mStartTimeUs = nowUs;
+        }
+
+        const sp<ABuffer> &frame =
+            (mFrameIndex % mFrameRate) == 0 ? mIDRFrame : mPFrame;
+
+        // Stands in for the copy out of the encoder's output buffer.
+        sp<ABuffer> accessUnit = new ABuffer(frame->size());
+        memcpy(accessUnit->data(), frame->data(), frame->size());
+
+        int64_t timeUs = (mFrameIndex * 1000000ll) / mFrameRate;
+        accessUnit->meta()->setInt64("timeUs", timeUs);
+
+        uint32_t flags = TSPacketizer::PREPEND_SPS_PPS_TO_IDR_FRAMES;
+        if ((mFrameIndex % 3) == 0) {
+            flags |= TSPacketizer::EMIT_PAT_AND_PMT;
+            flags |= TSPacketizer::EMIT_PCR;
+        }
+
+        GatherList tsPackets;
+        CHECK_EQ((status_t)OK,
+                 mPacketizer->packetize(
+                     mTrackIndex, accessUnit, &tsPackets, flags,
+                     NULL, 0));
+
+        if (mFlatten) {
+            sp<ABuffer> buffer = tsPackets.flatten();
+            tsPackets.clear();
+            tsPackets.append(buffer);
+        }
+
+        CHECK_EQ((status_t)OK,
+                 mSender->queueTSPackets(tsPackets, timeUs, 33));
+
+        mPacketizeTimeUs += ALooper::GetNowUs() - nowUs;
+
+        ++mFrameIndex;
+
+        int64_t delayUs =
+            mStartTimeUs + (mFrameIndex * 1000000ll) / mFrameRate
+                - ALooper::GetNowUs();
+
+        msg->post(delayUs > 0ll ? delayUs : 0ll);
+    }
+
+private:
+    enum {
+        kWhatProduce,
+    };
+
+    sp<RTPSender> mSender;
+    sp<TSPacketizer> mPacketizer;
+    ssize_t mTrackIndex;
+
+    int32_t mFrameRate;
+    int32_t mNumFrames;
+    bool mFlatten;
+
+    sp<ABuffer> mIDRFrame;
+    sp<ABuffer> mPFrame;
+
+    int32_t mFrameIndex;
+    int64_t mStartTimeUs;
+
+    Mutex mLock;
+    Condition mCondition;
+    bool mDone;
+
+    static sp<ABuffer> MakeFrame(unsigned nalType, size_t size) {
+        sp<ABuffer> frame = new ABuffer(size);
+
+        uint8_t *data = frame->data();
+        data[0] = 0x00;
+        data[1] = 0x00;
+        data[2] = 0x00;
+        data[3] = 0x01;
+        data[4] = 0x60 | nalType;
+
+        // Never emulates a start code.
+        for (size_t i = 5; i < size; ++i) {
+            data[i] = 1 + (rand() % 255);
+        }
+
+        return frame;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(Producer);
+};
+
+// Swallows the RTP sender's notifications.
+struct Observer : public AHandler {
+    Observer() {}
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int32_t what;
+        if (msg->findInt32("what", &what) && what == RTPSender::kWhatError) {
+            ALOGE("RTP sender signalled an error.");
+        }
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(Observer);
+};
+
+}  // namespace android
+
+using namespace android;
+
+static int64_t GetCPUTimeUs() {
+    struct rusage usage;
+    CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+
+    return usage.ru_utime.tv_sec * 1000000ll + usage.ru_utime.tv_usec
+        + usage.ru_stime.tv_sec * 1000000ll + usage.ru_stime.tv_usec;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-b bitrate] [-r frameRate] [-d duration] [-c]\n"
+                    "       -b  video bitrate in Mbit/sec (default 20)\n"
+                    "       -r  frames per second (default 30)\n"
+                    "       -d  seconds of video to send (default 10)\n"
+                    "       -c  copy the transport stream packets into a "
+                    "single buffer before sending them, for comparison\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int32_t bitrateMbps = 20;
+    int32_t frameRate = 30;
+    int32_t durationSecs = 10;
+    bool flatten = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "hb:r:d:c")) >= 0) {
+        switch (res) {
+            case 'b':
+            {
+                bitrateMbps = atoi(optarg);
+                break;
+            }
+
+            case 'r':
+            {
+                frameRate = atoi(optarg);
+                break;
+            }
+
+            case 'd':
+            {
+                durationSecs = atoi(optarg);
+                break;
+            }
+
+            case 'c':
+            {
+                flatten = true;
+                break;
+            }
+
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    if (optind != argc
+            || bitrateMbps <= 0 || frameRate <= 0 || durationSecs <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Sender and sink each get their own network thread.
+    sp<ANetworkSession> netSession = new ANetworkSession;
+    CHECK_EQ((status_t)OK, netSession->start());
+
+    sp<ANetworkSession> sinkNetSession = new ANetworkSession;
+    CHECK_EQ((status_t)OK, sinkNetSession->start());
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("tsbench");
+
+    sp<ALooper> sinkLooper = new ALooper;
+    sinkLooper->setName("tsbench sink");
+
+    sp<Sink> sink = new Sink;
+    sinkLooper->registerHandler(sink);
+
+    int32_t sinkPort;
+    int32_t sinkSessionID;
+    for (;;) {
+        sinkPort = RTPBase::PickRandomRTPPort();
+
+        if (sinkNetSession->createUDPSession(
+                    sinkPort, new AMessage(0, sink->id()),
+                    &sinkSessionID) == OK) {
+            break;
+        }
+    }
+
+    sp<Observer> observer = new Observer;
+    looper->registerHandler(observer);
+
+    sp<RTPSender> sender =
+        new RTPSender(netSession, new AMessage(0, observer->id()));
+    looper->registerHandler(sender);
+
+    int32_t localRTPPort;
+    CHECK_EQ((status_t)OK,
+             sender->initAsync(
+                 "127.0.0.1", sinkPort, RTPSender::TRANSPORT_UDP,
+                 -1 /* remoteRTCPPort */, RTPSender::TRANSPORT_NONE,
+                 &localRTPPort));
+
+    sp<Producer> producer =
+        new Producer(
+                sender, bitrateMbps * 1000000, frameRate,
+                durationSecs * frameRate, flatten);
+    looper->registerHandler(producer);
+
+    sinkLooper->start();
+    looper->start();
+
+    int64_t startUs = ALooper::GetNowUs();
+    int64_t startCPUUs = GetCPUTimeUs();
+
+    producer->start();
+    producer->waitUntilDone();
+
+    // Let the last packets drain.
+    usleep(200000);
+
+    int64_t elapsedUs = ALooper::GetNowUs() - startUs;
+    int64_t cpuUs = GetCPUTimeUs() - startCPUUs;
+
+    looper->stop();
+    sinkLooper->stop();
+
+    sinkNetSession->destroySession(sinkSessionID);
+
+    int32_t numFrames = durationSecs * frameRate;
+
+    printf("%d frames, %d packets (%lld bytes) received in %.2f secs\n",
+           numFrames, sink->mNumPackets, sink->mNumBytes, elapsedUs / 1E6);
+
+    printf("cpu %.1f %% (all threads), packetizing and queueing "
+           "%.1f us/frame\n",
+           cpuUs * 100.0 / elapsedUs,
+           (double)producer->mPacketizeTimeUs / numFrames);
+
+    if (sink->mNumPackets > 0) {
+        printf("latency avg %.1f us, max %lld us\n",
+               (double)sink->mTotalLatencyUs / sink->mNumPackets,
+               sink->mMaxLatencyUs);
+    }
+
+    sender.clear();
+    netSession->stop();
+    sinkNetSession->stop();
+
+    return 0;
+}
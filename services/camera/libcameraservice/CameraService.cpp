@@ -109,8 +109,8 @@ static void htcCameraSwitch(int cameraId)
 // should be ok for now.
 static CameraService *gCameraService;
 
-CameraService::CameraService()
-    :mSoundRef(0), mModule(0)
+CameraService::CameraService(camera_module_t *module)
+    :mSoundRef(0), mModule(module)
 {
     ALOGI("CameraService started (pid=%d)", getpid());
     gCameraService = this;
@@ -128,7 +128,7 @@ void CameraService::onFirstRef()
 
     BnCameraService::onFirstRef();
 
-    if (hw_get_module(CAMERA_HARDWARE_MODULE_ID,
+    if (mModule == NULL && hw_get_module(CAMERA_HARDWARE_MODULE_ID,
                 (const hw_module_t **)&mModule) < 0) {
         ALOGE("Could not load camera HAL module");
         mNumberOfCameras = 0;
@@ -1186,6 +1186,15 @@ status_t CameraService::dump(int fd, const Vector<String16>& args) {
                 getCallingUid());
         write(fd, result.string(), result.size());
     } else {
+        // Only the frame event log, in a form systrace can load
+        String16 frameTraceOption("--frame-trace");
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i] == frameTraceOption) {
+                camera3::CameraTraces::dumpFrameTrace(fd);
+                return NO_ERROR;
+            }
+        }
+
         bool locked = tryLock(mServiceLock);
         // failed to lock - CameraService is probably deadlocked
         if (!locked) {
@@ -58,7 +58,9 @@ public:
     // Implementation of BinderService<T>
     static char const* getServiceName() { return "media.camera"; }
 
-                        CameraService();
+    // With a module, serves that instead of loading the system's camera
+    // HAL, for tests and benchmarks that bring a fake one
+                        CameraService(camera_module_t *module = NULL);
     virtual             ~CameraService();
 
     /////////////////////////////////////////////////////////////////////
@@ -370,6 +370,8 @@ status_t Camera2Client::dump(int fd, const Vector<String16>& args) {
 
     mCaptureSequencer->dump(fd, args);
 
+    mCallbackProcessor->dump(fd, args);
+
     mFrameProcessor->dump(fd, args);
 
     mZslProcessor->dump(fd, args);
@@ -1074,6 +1076,9 @@ void Camera2Client::stopRecording() {
 
     mCameraService->playSound(CameraService::SOUND_RECORDING_STOP);
 
+    // A recording frame interval only applies to the recording it was set for
+    l.mParameters.recordingFrameIntervalUs = 0;
+
     res = startPreviewL(l.mParameters, true);
     if (res != OK) {
         ALOGE("%s: Camera %d: Unable to return to preview",
@@ -1297,10 +1302,13 @@ status_t Camera2Client::setParameters(const String8& params) {
 
     SharedParameters::Lock l(mParameters);
 
-    res = l.mParameters.set(params);
+    bool requestChanged;
+    res = l.mParameters.set(params, &requestChanged);
     if (res != OK) return res;
 
-    res = updateRequests(l.mParameters);
+    if (requestChanged) {
+        res = updateRequests(l.mParameters);
+    }
 
     return res;
 }
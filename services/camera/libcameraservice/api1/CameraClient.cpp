@@ -55,6 +55,8 @@ CameraClient::CameraClient(const sp<CameraService>& cameraService,
     mPreviewCallbackFlag = CAMERA_FRAME_CALLBACK_FLAG_NOOP;
     mOrientation = getOrientation(0, mCameraFacing == CAMERA_FACING_FRONT);
     mPlayShutterSound = true;
+    mRecordingFrameInterval = 0;
+    mLastRecordingFrameTimestamp = 0;
     LOG1("CameraClient::CameraClient X (pid %d, id %d)", callingPid, cameraId);
 }
 
@@ -450,6 +452,7 @@ status_t CameraClient::startRecordingMode() {
     }
 
     // start recording mode
+    mLastRecordingFrameTimestamp = 0;
     enableMsgType(CAMERA_MSG_VIDEO_FRAME);
     mCameraService->playSound(CameraService::SOUND_RECORDING);
     result = mHardware->startRecording();
@@ -514,6 +517,9 @@ void CameraClient::stopRecording() {
     mHardware->stopRecording();
     mCameraService->playSound(CameraService::SOUND_RECORDING);
 
+    // A recording frame interval only applies to the recording it was set for
+    mRecordingFrameInterval = 0;
+
     mPreviewBuffer.clear();
 }
 
@@ -621,6 +627,21 @@ status_t CameraClient::setParameters(const String8& params) {
     if (result != NO_ERROR) return result;
 
     CameraParameters p(params);
+
+    // The recording frame interval is applied here, the HAL never sees it
+    const char *frameInterval =
+            p.get(CameraParameters::KEY_RECORDING_FRAME_INTERVAL);
+    if (frameInterval != NULL) {
+        char *end;
+        int64_t intervalUs = strtoll(frameInterval, &end, 10);
+        if (end == frameInterval || *end != '\0' || intervalUs < 0) {
+            ALOGE("Invalid recording frame interval %s", frameInterval);
+            return BAD_VALUE;
+        }
+        mRecordingFrameInterval = us2ns(intervalUs);
+        p.remove(CameraParameters::KEY_RECORDING_FRAME_INTERVAL);
+    }
+
     return mHardware->setParameters(p);
 }
 
@@ -1023,6 +1044,18 @@ void CameraClient::handleGenericData(int32_t msgType,
 
 void CameraClient::handleGenericDataTimestamp(nsecs_t timestamp,
     int32_t msgType, const sp<IMemory>& dataPtr) {
+    // Drop the recording frames a time lapse recording would skip anyway
+    if (msgType == CAMERA_MSG_VIDEO_FRAME && mRecordingFrameInterval > 0) {
+        if (mLastRecordingFrameTimestamp != 0 &&
+                timestamp - mLastRecordingFrameTimestamp <
+                    mRecordingFrameInterval) {
+            mHardware->releaseRecordingFrame(dataPtr);
+            mLock.unlock();
+            return;
+        }
+        mLastRecordingFrameTimestamp = timestamp;
+    }
+
     sp<ICameraClient> c = mRemoteCallback;
     mLock.unlock();
     if (c != 0) {
@@ -135,6 +135,9 @@ private:
     int                             mPreviewCallbackFlag;
     int                             mOrientation;     // Current display orientation
     bool                            mPlayShutterSound;
+    // Recording frames closer than this to the last one sent are dropped
+    nsecs_t                         mRecordingFrameInterval;
+    nsecs_t                         mLastRecordingFrameTimestamp;
 
     // Ensures atomicity among the public methods
     mutable Mutex                   mLock;
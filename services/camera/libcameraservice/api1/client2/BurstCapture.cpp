@@ -80,8 +80,22 @@ CpuConsumer::LockedBuffer* BurstCapture::jpegEncode(
 {
     ALOGV("%s", __FUNCTION__);
 
+    // Sized for the largest JPEG the camera produces
+    size_t maxJpegSize = 0;
+    sp<Camera2Client> client = mClient.promote();
+    if (client != 0) {
+        SharedParameters::Lock l(client->getParameters());
+        camera_metadata_ro_entry_t entry =
+                l.mParameters.staticInfo(ANDROID_JPEG_MAX_SIZE);
+        if (entry.count > 0) maxJpegSize = entry.data.i32[0];
+    }
+    if (maxJpegSize == 0) {
+        ALOGE("%s: Can't find ANDROID_JPEG_MAX_SIZE", __FUNCTION__);
+        return NULL;
+    }
+
     CpuConsumer::LockedBuffer *imgEncoded = new CpuConsumer::LockedBuffer;
-    uint8_t *data = new uint8_t[ANDROID_JPEG_MAX_SIZE];
+    uint8_t *data = new uint8_t[maxJpegSize];
     imgEncoded->data = data;
     imgEncoded->width = imgBuffer->width;
     imgEncoded->height = imgBuffer->height;
@@ -92,6 +106,7 @@ CpuConsumer::LockedBuffer* BurstCapture::jpegEncode(
     buffers.push_back(imgEncoded);
 
     sp<JpegCompressor> jpeg = new JpegCompressor();
+    jpeg->setMaxJpegSize(maxJpegSize);
     jpeg->start(buffers, 1);
 
     bool success = jpeg->waitForDone(10 * 1e9);
@@ -26,11 +26,105 @@
 #include "api1/Camera2Client.h"
 #include "api1/client2/CallbackProcessor.h"
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define ALIGN(x, mask) ( ((x) + (mask) - 1) & ~((mask) - 1) )
 
 namespace android {
 namespace camera2 {
 
+// Copies a width x height plane, in one go if neither side has padding.
+static void copyPlane(uint8_t *dst, size_t dstStride,
+        const uint8_t *src, size_t srcStride,
+        size_t width, size_t height) {
+    if (dstStride == width && srcStride == width) {
+        memcpy(dst, src, width * height);
+        return;
+    }
+    for (size_t row = 0; row < height; row++) {
+        memcpy(dst, src, width);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+// dst[2 * i] = a[i], dst[2 * i + 1] = b[i]
+static void interleaveRow(uint8_t *dst,
+        const uint8_t *a, const uint8_t *b, size_t count) {
+    size_t i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t ab;
+        ab.val[0] = vld1q_u8(a + i);
+        ab.val[1] = vld1q_u8(b + i);
+        vst2q_u8(dst + 2 * i, ab);
+    }
+#elif defined(__SSE2__)
+    for (; i + 16 <= count; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(va, vb));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16),
+                _mm_unpackhi_epi8(va, vb));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[2 * i] = a[i];
+        dst[2 * i + 1] = b[i];
+    }
+}
+
+// a[i] = src[2 * i], b[i] = src[2 * i + 1]
+static void deinterleaveRow(uint8_t *a, uint8_t *b,
+        const uint8_t *src, size_t count) {
+    size_t i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t ab = vld2q_u8(src + 2 * i);
+        vst1q_u8(a + i, ab.val[0]);
+        vst1q_u8(b + i, ab.val[1]);
+    }
+#elif defined(__SSE2__)
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    for (; i + 16 <= count; i += 16) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        _mm_storeu_si128((__m128i *)(a + i), _mm_packus_epi16(
+                _mm_and_si128(lo, lowBytes), _mm_and_si128(hi, lowBytes)));
+        _mm_storeu_si128((__m128i *)(b + i), _mm_packus_epi16(
+                _mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+#endif
+    for (; i < count; i++) {
+        a[i] = src[2 * i];
+        b[i] = src[2 * i + 1];
+    }
+}
+
+// Swaps the bytes of count pairs, i.e. CbCr to CrCb.
+static void swapPairsRow(uint8_t *dst, const uint8_t *src, size_t count) {
+    size_t i = 0;
+#if defined(__ARM_NEON__)
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(dst + 2 * i, vrev16q_u8(vld1q_u8(src + 2 * i)));
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i),
+                _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[2 * i] = src[2 * i + 1];
+        dst[2 * i + 1] = src[2 * i];
+    }
+}
+
 CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         Thread(false),
         mClient(client),
@@ -38,7 +132,15 @@ CallbackProcessor::CallbackProcessor(sp<Camera2Client> client):
         mId(client->getCameraId()),
         mCallbackAvailable(false),
         mCallbackToApp(false),
-        mCallbackStreamId(NO_STREAM) {
+        mCallbackStreamId(NO_STREAM),
+        mCallbackHeapHead(0),
+        mCallbackHeapFree(0),
+        mCallbackHeapAllocations(0),
+        mCallbackFrames(0),
+        mCallbackFramesDropped(0),
+        mConversionTimeTotal(0),
+        mConversionTimeMax(0),
+        mConversionTimeLast(0) {
 }
 
 CallbackProcessor::~CallbackProcessor() {
@@ -199,6 +301,7 @@ status_t CallbackProcessor::deleteStream() {
         Mutex::Autolock l(mInputMutex);
 
         mCallbackHeap.clear();
+        mRetiredCallbackHeaps.clear();
         mCallbackWindow.clear();
         mCallbackConsumer.clear();
 
@@ -212,7 +315,28 @@ int CallbackProcessor::getStreamId() const {
     return mCallbackStreamId;
 }
 
-void CallbackProcessor::dump(int /*fd*/, const Vector<String16>& /*args*/) const {
+void CallbackProcessor::dump(int fd, const Vector<String16>& /*args*/) const {
+    String8 result;
+
+    Mutex::Autolock l(mInputMutex);
+
+    result.append("  Preview callbacks:\n");
+    result.appendFormat("    Frames: %d, dropped for lack of buffers: %d\n",
+            mCallbackFrames, mCallbackFramesDropped);
+    if (mCallbackFrames > 0) {
+        result.appendFormat("    Copy/conversion time: last %lld us, "
+                "average %lld us, max %lld us\n",
+                ns2us(mConversionTimeLast),
+                ns2us(mConversionTimeTotal / mCallbackFrames),
+                ns2us(mConversionTimeMax));
+    }
+    result.appendFormat("    Heap: %d bytes x %d, %d free, "
+            "%d retired, %d allocated in total\n",
+            (mCallbackHeap == 0) ? 0 : mCallbackHeap->mBufSize,
+            kCallbackHeapCount, mCallbackHeapFree,
+            mRetiredCallbackHeaps.size(), mCallbackHeapAllocations);
+
+    write(fd, result.string(), result.size());
 }
 
 bool CallbackProcessor::threadLoop() {
@@ -367,33 +491,23 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
         size_t bufferSize = Camera2Client::calculateBufferSize(
                 imgBuffer.width, imgBuffer.height,
                 previewFormat, destYStride);
-        size_t currentBufferSize = (mCallbackHeap == 0) ?
-                0 : (mCallbackHeap->mHeap->getSize() / kCallbackHeapCount);
-        if (bufferSize != currentBufferSize) {
-            mCallbackHeap.clear();
-            mCallbackHeap = new Camera2Heap(bufferSize, kCallbackHeapCount,
-                    "Camera2Client::CallbackHeap");
-            if (mCallbackHeap->mHeap->getSize() == 0) {
-                ALOGE("%s: Camera %d: Unable to allocate memory for callbacks",
-                        __FUNCTION__, mId);
-                mCallbackConsumer->unlockBuffer(imgBuffer);
-                return INVALID_OPERATION;
-            }
-
-            mCallbackHeapHead = 0;
-            mCallbackHeapFree = kCallbackHeapCount;
+        res = setCallbackHeapSizeLocked(bufferSize);
+        if (res != OK) {
+            mCallbackConsumer->unlockBuffer(imgBuffer);
+            return res;
         }
 
         if (mCallbackHeapFree == 0) {
             ALOGE("%s: Camera %d: No free callback buffers, dropping frame",
                     __FUNCTION__, mId);
+            mCallbackFramesDropped++;
             mCallbackConsumer->unlockBuffer(imgBuffer);
             return OK;
         }
 
         heapIdx = mCallbackHeapHead;
 
-        mCallbackHeapHead = (mCallbackHeapHead + 1) & kCallbackHeapCount;
+        mCallbackHeapHead = (mCallbackHeapHead + 1) % kCallbackHeapCount;
         mCallbackHeapFree--;
 
         // TODO: Get rid of this copy by passing the gralloc queue all the way
@@ -406,6 +520,7 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
                         &size);
         uint8_t *data = (uint8_t*)heap->getBase() + offset;
 
+        nsecs_t conversionStart = systemTime();
         if (!useFlexibleYuv) {
             // Can just memcpy when HAL format matches API format
             memcpy(data, imgBuffer.data, bufferSize);
@@ -419,6 +534,12 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
                 return BAD_VALUE;
             }
         }
+        mConversionTimeLast = systemTime() - conversionStart;
+        mConversionTimeTotal += mConversionTimeLast;
+        if (mConversionTimeLast > mConversionTimeMax) {
+            mConversionTimeMax = mConversionTimeLast;
+        }
+        mCallbackFrames++;
 
         ALOGV("%s: Freeing buffer", __FUNCTION__);
         mCallbackConsumer->unlockBuffer(imgBuffer);
@@ -439,14 +560,61 @@ status_t CallbackProcessor::processNewCallback(sp<Camera2Client> &client) {
         }
     }
 
-    // Only increment free if we're still using the same heap
-    mCallbackHeapFree++;
+    {
+        Mutex::Autolock m(mInputMutex);
+        // Only increment free if we're still using the same heap
+        if (callbackHeap == mCallbackHeap) {
+            mCallbackHeapFree++;
+        }
+    }
 
     ALOGV("%s: exit", __FUNCTION__);
 
     return OK;
 }
 
+status_t CallbackProcessor::setCallbackHeapSizeLocked(size_t bufferSize) {
+    if (mCallbackHeap != 0 && mCallbackHeap->mBufSize == bufferSize) {
+        return OK;
+    }
+
+    sp<Camera2Heap> heap;
+    for (size_t i = 0; i < mRetiredCallbackHeaps.size(); i++) {
+        if (mRetiredCallbackHeaps[i]->mBufSize == bufferSize) {
+            heap = mRetiredCallbackHeaps[i];
+            mRetiredCallbackHeaps.removeAt(i);
+            break;
+        }
+    }
+
+    if (heap == 0) {
+        ALOGV("%s: Camera %d: Allocating %d byte callback buffers",
+                __FUNCTION__, mId, bufferSize);
+        heap = new Camera2Heap(bufferSize, kCallbackHeapCount,
+                "Camera2Client::CallbackHeap");
+        if (heap->mHeap->getSize() == 0) {
+            ALOGE("%s: Camera %d: Unable to allocate memory for callbacks",
+                    __FUNCTION__, mId);
+            return INVALID_OPERATION;
+        }
+        mCallbackHeapAllocations++;
+    }
+
+    if (mCallbackHeap != 0) {
+        // Keep the most recently used ones
+        if (mRetiredCallbackHeaps.size() == kMaxRetiredCallbackHeaps) {
+            mRetiredCallbackHeaps.removeAt(0);
+        }
+        mRetiredCallbackHeaps.push_back(mCallbackHeap);
+    }
+
+    mCallbackHeap = heap;
+    mCallbackHeapHead = 0;
+    mCallbackHeapFree = kCallbackHeapCount;
+
+    return OK;
+}
+
 status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         uint8_t *dst,
         const CpuConsumer::LockedBuffer &src,
@@ -461,13 +629,8 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
     }
 
     // Copy Y plane, adjusting for stride
-    const uint8_t *ySrc = src.data;
-    uint8_t *yDst = dst;
-    for (size_t row = 0; row < src.height; row++) {
-        memcpy(yDst, ySrc, src.width);
-        ySrc += src.stride;
-        yDst += dstYStride;
-    }
+    copyPlane(dst, dstYStride, src.data, src.stride, src.width, src.height);
+    uint8_t *yDst = dst + src.height * dstYStride;
 
     // Copy/swizzle chroma planes, 4:2:0 subsampling
     const uint8_t *cbSrc = src.dataCb;
@@ -485,10 +648,24 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         if (cbSrc == crSrc + 1 && src.chromaStep == 2) {
             ALOGV("%s: Fast NV21->NV21", __FUNCTION__);
             // Source has semiplanar CrCb chroma layout, can copy by rows
+            copyPlane(crcbDst, src.width, crSrc, src.chromaStride,
+                    src.width, chromaHeight);
+        } else if (crSrc == cbSrc + 1 && src.chromaStep == 2) {
+            ALOGV("%s: Fast NV12->NV21", __FUNCTION__);
+            // Source has semiplanar CbCr chroma layout, swap each pair
             for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(crcbDst, crSrc, src.width);
-                crcbDst += src.width;
+                swapPairsRow(crcbDst, cbSrc, chromaWidth);
+                crcbDst += chromaWidth * 2;
+                cbSrc += src.chromaStride;
+            }
+        } else if (src.chromaStep == 1) {
+            ALOGV("%s: Fast YV12->NV21", __FUNCTION__);
+            // Source has planar chroma layout, interleave by rows
+            for (size_t row = 0; row < chromaHeight; row++) {
+                interleaveRow(crcbDst, crSrc, cbSrc, chromaWidth);
+                crcbDst += chromaWidth * 2;
                 crSrc += src.chromaStride;
+                cbSrc += src.chromaStride;
             }
         } else {
             ALOGV("%s: Generic->NV21", __FUNCTION__);
@@ -513,15 +690,25 @@ status_t CallbackProcessor::convertFromFlexibleYuv(int32_t previewFormat,
         if (src.chromaStep == 1) {
             ALOGV("%s: Fast YV12->YV12", __FUNCTION__);
             // Source has planar chroma layout, can copy by row
+            copyPlane(crDst, dstCStride, crSrc, src.chromaStride,
+                    chromaWidth, chromaHeight);
+            copyPlane(cbDst, dstCStride, cbSrc, src.chromaStride,
+                    chromaWidth, chromaHeight);
+        } else if (src.chromaStep == 2 &&
+                (cbSrc == crSrc + 1 || crSrc == cbSrc + 1)) {
+            ALOGV("%s: Fast NV21/NV12->YV12", __FUNCTION__);
+            // Source has semiplanar chroma layout, deinterleave by rows
+            bool crFirst = (cbSrc == crSrc + 1);
+            const uint8_t *cSrc = crFirst ? crSrc : cbSrc;
             for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(crDst, crSrc, chromaWidth);
+                if (crFirst) {
+                    deinterleaveRow(crDst, cbDst, cSrc, chromaWidth);
+                } else {
+                    deinterleaveRow(cbDst, crDst, cSrc, chromaWidth);
+                }
+                cSrc += src.chromaStride;
                 crDst += dstCStride;
-                crSrc += src.chromaStride;
-            }
-            for (size_t row = 0; row < chromaHeight; row++) {
-                memcpy(cbDst, cbSrc, chromaWidth);
                 cbDst += dstCStride;
-                cbSrc += src.chromaStride;
             }
         } else {
             ALOGV("%s: Generic->YV12", __FUNCTION__);
@@ -78,12 +78,29 @@ class CallbackProcessor:
     int mCallbackHeapId;
     size_t mCallbackHeapHead, mCallbackHeapFree;
 
+    // Heaps used for earlier callback sizes, reused instead of allocating
+    // a new one when the size changes back.
+    static const size_t kMaxRetiredCallbackHeaps = 2;
+    Vector<sp<Camera2Heap> > mRetiredCallbackHeaps;
+    size_t mCallbackHeapAllocations;
+
+    // Statistics of the copy/conversion into the callback heap
+    size_t mCallbackFrames;
+    size_t mCallbackFramesDropped;
+    nsecs_t mConversionTimeTotal;
+    nsecs_t mConversionTimeMax;
+    nsecs_t mConversionTimeLast;
+
     virtual bool threadLoop();
 
     status_t processNewCallback(sp<Camera2Client> &client);
     // Used when shutting down
     status_t discardNewCallback();
 
+    // Makes mCallbackHeap hold kCallbackHeapCount buffers of bufferSize
+    // bytes, reusing a retired heap if possible
+    status_t setCallbackHeapSizeLocked(size_t bufferSize);
+
     // Convert from flexible YUV to NV21 or YV12
     status_t convertFromFlexibleYuv(int32_t previewFormat,
             uint8_t *dst,
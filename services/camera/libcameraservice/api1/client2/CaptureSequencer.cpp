@@ -104,13 +104,13 @@ void CaptureSequencer::notifyAutoExposure(uint8_t newState, int triggerId) {
     }
 }
 
-void CaptureSequencer::onFrameAvailable(int32_t requestId,
-        const CameraMetadata &frame) {
+void CaptureSequencer::onResultAvailable(int32_t requestId,
+        const sp<CaptureResult> &result) {
     ALOGV("%s: Listener found new frame", __FUNCTION__);
     ATRACE_CALL();
     Mutex::Autolock l(mInputMutex);
     mNewFrameId = requestId;
-    mNewFrame = frame;
+    mNewFrame = result;
     if (!mNewFrameReceived) {
         mNewFrameReceived = true;
         mNewFrameSignal.signal();
@@ -145,7 +145,10 @@ void CaptureSequencer::dump(int fd, const Vector<String16>& /*args*/) {
             kStateNames[mCaptureState]);
     result.append("    Latest captured frame:\n");
     write(fd, result.string(), result.size());
-    mNewFrame.dump(fd, 2, 6);
+    sp<CaptureResult> newFrame = mNewFrame;
+    if (newFrame != 0) {
+        newFrame->metadata().dump(fd, 2, 6);
+    }
 }
 
 /** Private members */
@@ -579,8 +582,8 @@ CaptureSequencer::CaptureState CaptureSequencer::manageStandardCaptureWait(
             ALOGW("Mismatched capture frame IDs: Expected %d, got %d",
                     mCaptureId, mNewFrameId);
         }
-        camera_metadata_entry_t entry;
-        entry = mNewFrame.find(ANDROID_SENSOR_TIMESTAMP);
+        camera_metadata_ro_entry_t entry;
+        entry = mNewFrame->metadata().find(ANDROID_SENSOR_TIMESTAMP);
         if (entry.count == 0) {
             ALOGE("No timestamp field in capture frame!");
         }
@@ -62,7 +62,8 @@ class CaptureSequencer:
     void notifyAutoExposure(uint8_t newState, int triggerId);
 
     // Notifications from the frame processor
-    virtual void onFrameAvailable(int32_t requestId, const CameraMetadata &frame);
+    virtual void onResultAvailable(int32_t requestId,
+            const sp<CaptureResult> &result);
 
     // Notifications from the JPEG processor
     void onCaptureAvailable(nsecs_t timestamp, sp<MemoryBase> captureBuffer);
@@ -86,7 +87,7 @@ class CaptureSequencer:
 
     bool mNewFrameReceived;
     int32_t mNewFrameId;
-    CameraMetadata mNewFrame;
+    sp<CaptureResult> mNewFrame;
     Condition mNewFrameSignal;
 
     bool mNewCaptureReceived;
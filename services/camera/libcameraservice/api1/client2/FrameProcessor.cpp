@@ -55,8 +55,9 @@ FrameProcessor::FrameProcessor(wp<CameraDeviceBase> device,
 FrameProcessor::~FrameProcessor() {
 }
 
-bool FrameProcessor::processSingleFrame(CameraMetadata &frame,
+bool FrameProcessor::processSingleFrame(const sp<CaptureResult> &result,
                                         const sp<CameraDeviceBase> &device) {
+    const CameraMetadata &frame = result->metadata();
 
     sp<Camera2Client> client = mClient.promote();
     if (!client.get()) {
@@ -65,7 +66,7 @@ bool FrameProcessor::processSingleFrame(CameraMetadata &frame,
 
     bool partialResult = false;
     if (mUsePartialQuirk) {
-        camera_metadata_entry_t entry;
+        camera_metadata_ro_entry_t entry;
         entry = frame.find(ANDROID_QUIRKS_PARTIAL_RESULT);
         if (entry.count > 0 &&
                 entry.data.u8[0] == ANDROID_QUIRKS_PARTIAL_RESULT_PARTIAL) {
@@ -81,7 +82,7 @@ bool FrameProcessor::processSingleFrame(CameraMetadata &frame,
         process3aState(frame, client);
     }
 
-    return FrameProcessorBase::processSingleFrame(frame, device);
+    return FrameProcessorBase::processSingleFrame(result, device);
 }
 
 status_t FrameProcessor::processFaceDetect(const CameraMetadata &frame,
@@ -17,6 +17,10 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "Camera2-JpegCompressor"
 
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
 #include <utils/Log.h>
 #include <ui/GraphicBufferMapper.h>
 
@@ -25,10 +29,35 @@
 namespace android {
 namespace camera2 {
 
+/**
+ * Helper thread for compressing stripes in parallel with the compressor
+ * thread itself
+ */
+class JpegCompressor::StripeWorker : public Thread {
+  public:
+    StripeWorker(JpegCompressor *parent) :
+            Thread(false),
+            mParent(parent) {
+    }
+
+  private:
+    JpegCompressor *mParent;
+
+    virtual bool threadLoop() {
+        mParent->compressStripes();
+        return false;
+    }
+};
+
 JpegCompressor::JpegCompressor():
         Thread(false),
         mIsBusy(false),
-        mCaptureTime(0) {
+        mCaptureTime(0),
+        mThreadCount(0),
+        mMaxJpegSize(0),
+        mJpegSize(0),
+        mNextStripe(0),
+        mAborted(0) {
 }
 
 JpegCompressor::~JpegCompressor() {
@@ -50,6 +79,8 @@ status_t JpegCompressor::start(Vector<CpuConsumer::LockedBuffer*> buffers,
 
     mBuffers = buffers;
     mCaptureTime = captureTime;
+    mJpegSize = 0;
+    android_atomic_release_store(0, &mAborted);
 
     status_t res;
     res = run("JpegCompressor");
@@ -63,6 +94,8 @@ status_t JpegCompressor::start(Vector<CpuConsumer::LockedBuffer*> buffers,
 
 status_t JpegCompressor::cancel() {
     ALOGV("%s", __FUNCTION__);
+    // Stops the stripe workers as well
+    android_atomic_release_store(1, &mAborted);
     requestExitAndWait();
     return OK;
 }
@@ -78,63 +111,237 @@ bool JpegCompressor::threadLoop() {
     mAuxBuffer = mBuffers[0];    // input
     mJpegBuffer = mBuffers[1];    // output
 
+    nsecs_t startTime = systemTime();
+
+    // Split the image into stripes of whole restart intervals. Only the
+    // last stripe may be shorter, and it's the bottom of the image anyway,
+    // so compressing the stripes separately produces the same entropy-coded
+    // data as compressing the whole image in one go.
+    size_t width = mAuxBuffer->width;
+    size_t height = mAuxBuffer->height;
+    if (width == 0 || height == 0) {
+        ALOGE("%s: Invalid image size %dx%d", __FUNCTION__, width, height);
+        cleanUp();
+        return false;
+    }
+    size_t mcuHeight = DCTSIZE; // Grayscale: one block per MCU
+    size_t mcusPerRow = (width + DCTSIZE - 1) / DCTSIZE;
+    size_t stripeRows = kStripeMcuRows * mcuHeight;
+    size_t restartRows = kStripeMcuRows;
+    if (mcusPerRow * kStripeMcuRows > kMaxRestartInterval) {
+        // Too wide to restart every stripe; compress in one piece
+        stripeRows = height;
+        restartRows = 0;
+    }
+    size_t stripeCount = (height + stripeRows - 1) / stripeRows;
+
+    mStripes.clear();
+    for (size_t i = 0; i < stripeCount; i++) {
+        Stripe stripe;
+        stripe.firstRow = i * stripeRows;
+        stripe.rows = (i == stripeCount - 1) ?
+                height - stripe.firstRow : stripeRows;
+        stripe.restartRows = restartRows;
+        stripe.data = NULL;
+        stripe.capacity = 0;
+        stripe.size = 0;
+        stripe.failed = false;
+        mStripes.push_back(stripe);
+    }
+    android_atomic_release_store(0, &mNextStripe);
+
+    size_t threadCount, maxJpegSize;
+    {
+        Mutex::Autolock lock(mBusyMutex);
+        threadCount = mThreadCount;
+        maxJpegSize = mMaxJpegSize;
+    }
+    if (maxJpegSize == 0) {
+        if (mJpegBuffer->format != HAL_PIXEL_FORMAT_BLOB) {
+            ALOGE("%s: Output buffer size unknown", __FUNCTION__);
+            freeStripes();
+            cleanUp();
+            return false;
+        }
+        maxJpegSize = mJpegBuffer->width;
+    }
+    if (threadCount == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cores > 0 ? cores : 1;
+    }
+    if (threadCount > stripeCount) threadCount = stripeCount;
+
+    Vector<sp<StripeWorker> > workers;
+    for (size_t i = 1; i < threadCount; i++) {
+        sp<StripeWorker> worker = new StripeWorker(this);
+        status_t res = worker->run("JpegCompressor-Stripe");
+        if (res != OK) {
+            ALOGW("%s: Unable to start stripe worker: %s (%d)",
+                    __FUNCTION__, strerror(-res), res);
+            break;
+        }
+        workers.push_back(worker);
+    }
+
+    compressStripes();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->join();
+    }
+
+    if (android_atomic_acquire_load(&mAborted)) {
+        if (exitPending()) {
+            ALOGV("%s: Cancel called, exiting early", __FUNCTION__);
+        }
+    } else if (assembleJpeg(maxJpegSize)) {
+        ALOGV("%s: Compressed %dx%d image into %d bytes in %d stripes on %d "
+                "threads, %lld us", __FUNCTION__, width, height, mJpegSize,
+                stripeCount, workers.size() + 1,
+                ns2us(systemTime() - startTime));
+    }
+
+    freeStripes();
+    cleanUp();
+    return false;
+}
+
+void JpegCompressor::compressStripes() {
+    while (!android_atomic_acquire_load(&mAborted)) {
+        int32_t i = android_atomic_inc(&mNextStripe);
+        if (i >= (int32_t)mStripes.size()) return;
+
+        if (!compressStripe(&mStripes.editItemAt(i))) {
+            android_atomic_release_store(1, &mAborted);
+        }
+    }
+}
+
+bool JpegCompressor::compressStripe(Stripe *stripe) {
+    jpeg_compress_struct cinfo;
+
     // Set up error management
-    mJpegErrorInfo = NULL;
     JpegError error;
-    error.parent = this;
+    error.errorInfo = NULL;
 
-    mCInfo.err = jpeg_std_error(&error);
-    mCInfo.err->error_exit = jpegErrorHandler;
+    cinfo.err = jpeg_std_error(&error);
+    cinfo.err->error_exit = jpegErrorHandler;
 
-    jpeg_create_compress(&mCInfo);
-    if (checkError("Error initializing compression")) return false;
+    jpeg_create_compress(&cinfo);
+    if (checkError(&cinfo, "Error initializing compression")) return false;
 
-    // Route compressed data straight to output stream buffer
+    // Each stripe goes to a buffer of its own; they are put together once
+    // all are done
     JpegDestination jpegDestMgr;
-    jpegDestMgr.parent = this;
+    jpegDestMgr.stripe = stripe;
     jpegDestMgr.init_destination = jpegInitDestination;
     jpegDestMgr.empty_output_buffer = jpegEmptyOutputBuffer;
     jpegDestMgr.term_destination = jpegTermDestination;
 
-    mCInfo.dest = &jpegDestMgr;
+    cinfo.dest = &jpegDestMgr;
 
     // Set up compression parameters
-    mCInfo.image_width = mAuxBuffer->width;
-    mCInfo.image_height = mAuxBuffer->height;
-    mCInfo.input_components = 1; // 3;
-    mCInfo.in_color_space = JCS_GRAYSCALE; // JCS_RGB
+    cinfo.image_width = mAuxBuffer->width;
+    cinfo.image_height = stripe->rows;
+    cinfo.input_components = 1; // 3;
+    cinfo.in_color_space = JCS_GRAYSCALE; // JCS_RGB
 
-    ALOGV("%s: image_width = %d, image_height = %d", __FUNCTION__, mCInfo.image_width, mCInfo.image_height);
-
-    jpeg_set_defaults(&mCInfo);
-    if (checkError("Error configuring defaults")) return false;
+    jpeg_set_defaults(&cinfo);
+    if (checkError(&cinfo, "Error configuring defaults")) return false;
+    cinfo.restart_in_rows = stripe->restartRows;
 
     // Do compression
-    jpeg_start_compress(&mCInfo, TRUE);
-    if (checkError("Error starting compression")) return false;
+    jpeg_start_compress(&cinfo, TRUE);
+    if (checkError(&cinfo, "Error starting compression")) return false;
 
     size_t rowStride = mAuxBuffer->stride;// * 3;
+    const uint8_t *firstRow = mAuxBuffer->data + stripe->firstRow * rowStride;
     const size_t kChunkSize = 32;
-    while (mCInfo.next_scanline < mCInfo.image_height) {
+    while (cinfo.next_scanline < cinfo.image_height) {
         JSAMPROW chunk[kChunkSize];
-        for (size_t i = 0 ; i < kChunkSize; i++) {
+        size_t rows = cinfo.image_height - cinfo.next_scanline;
+        if (rows > kChunkSize) rows = kChunkSize;
+        for (size_t i = 0 ; i < rows; i++) {
             chunk[i] = (JSAMPROW)
-                    (mAuxBuffer->data + (i + mCInfo.next_scanline) * rowStride);
+                    (firstRow + (i + cinfo.next_scanline) * rowStride);
         }
-        jpeg_write_scanlines(&mCInfo, chunk, kChunkSize);
-        if (checkError("Error while compressing")) return false;
-        if (exitPending()) {
-            ALOGV("%s: Cancel called, exiting early", __FUNCTION__);
-            cleanUp();
+        jpeg_write_scanlines(&cinfo, chunk, rows);
+        if (checkError(&cinfo, "Error while compressing")) return false;
+        if (android_atomic_acquire_load(&mAborted)) {
+            jpeg_destroy_compress(&cinfo);
             return false;
         }
     }
 
-    jpeg_finish_compress(&mCInfo);
-    if (checkError("Error while finishing compression")) return false;
+    jpeg_finish_compress(&cinfo);
+    if (checkError(&cinfo, "Error while finishing compression")) return false;
 
-    cleanUp();
-    return false;
+    jpeg_destroy_compress(&cinfo);
+    return !stripe->failed;
+}
+
+bool JpegCompressor::assembleJpeg(size_t maxJpegSize) {
+    uint8_t *out = mJpegBuffer->data;
+    size_t size = 0;
+
+    for (size_t i = 0; i < mStripes.size(); i++) {
+        const Stripe &stripe = mStripes[i];
+
+        // Skip the headers of the stripe's JPEG, up to and including its
+        // start of scan segment, remembering where the frame header is
+        size_t pos = 2; // SOI
+        size_t frameHeader = 0;
+        for (;;) {
+            if (pos + 4 > stripe.size || stripe.data[pos] != 0xFF) {
+                ALOGE("%s: Malformed header in stripe %d", __FUNCTION__, i);
+                return false;
+            }
+            uint8_t marker = stripe.data[pos + 1];
+            size_t length = (stripe.data[pos + 2] << 8) | stripe.data[pos + 3];
+            if (marker >= 0xC0 && marker <= 0xC2) frameHeader = pos;
+            pos += 2 + length;
+            if (marker == 0xDA) break; // SOS
+        }
+        // The entropy-coded data ends right before EOI
+        if (frameHeader == 0 || pos + 2 > stripe.size) {
+            ALOGE("%s: Malformed header in stripe %d", __FUNCTION__, i);
+            return false;
+        }
+        size_t dataSize = stripe.size - 2 - pos;
+
+        // The first stripe's headers become the image's, stripes after
+        // that are preceded by the restart marker ending the previous one
+        size_t prefixSize = (i == 0) ? pos : 2;
+        if (size + prefixSize + dataSize + 2 > maxJpegSize) {
+            ALOGE("%s: JPEG destination buffer overflow!", __FUNCTION__);
+            return false;
+        }
+        if (i == 0) {
+            memcpy(out, stripe.data, pos);
+            // The frame header still has the stripe's height
+            size_t height = mAuxBuffer->height;
+            out[frameHeader + 5] = height >> 8;
+            out[frameHeader + 6] = height & 0xFF;
+        } else {
+            out[size] = 0xFF;
+            out[size + 1] = JPEG_RST0 + ((i - 1) & 7);
+        }
+        size += prefixSize;
+        memcpy(out + size, stripe.data + pos, dataSize);
+        size += dataSize;
+    }
+
+    out[size++] = 0xFF;
+    out[size++] = JPEG_EOI;
+
+    Mutex::Autolock lock(mBusyMutex);
+    mJpegSize = size;
+    return true;
+}
+
+void JpegCompressor::freeStripes() {
+    for (size_t i = 0; i < mStripes.size(); i++) {
+        free(mStripes[i].data);
+    }
+    mStripes.clear();
 }
 
 bool JpegCompressor::isBusy() {
@@ -166,15 +373,32 @@ bool JpegCompressor::waitForDone(nsecs_t timeout) {
     return (res == OK);
 }
 
-bool JpegCompressor::checkError(const char *msg) {
+void JpegCompressor::setThreadCount(size_t count) {
+    Mutex::Autolock lock(mBusyMutex);
+    mThreadCount = count;
+}
+
+void JpegCompressor::setMaxJpegSize(size_t size) {
+    Mutex::Autolock lock(mBusyMutex);
+    mMaxJpegSize = size;
+}
+
+size_t JpegCompressor::getJpegSize() {
+    Mutex::Autolock lock(mBusyMutex);
+    return mJpegSize;
+}
+
+bool JpegCompressor::checkError(jpeg_compress_struct *cinfo,
+        const char *msg) {
     ALOGV("%s", __FUNCTION__);
-    if (mJpegErrorInfo) {
+    JpegError *error = static_cast<JpegError*>(cinfo->err);
+    if (error->errorInfo) {
         char errBuffer[JMSG_LENGTH_MAX];
-        mJpegErrorInfo->err->format_message(mJpegErrorInfo, errBuffer);
+        error->errorInfo->err->format_message(error->errorInfo, errBuffer);
         ALOGE("%s: %s: %s",
                 __FUNCTION__, msg, errBuffer);
-        cleanUp();
-        mJpegErrorInfo = NULL;
+        jpeg_destroy_compress(cinfo);
+        error->errorInfo = NULL;
         return true;
     }
     return false;
@@ -182,7 +406,6 @@ bool JpegCompressor::checkError(const char *msg) {
 
 void JpegCompressor::cleanUp() {
     ALOGV("%s", __FUNCTION__);
-    jpeg_destroy_compress(&mCInfo);
     Mutex::Autolock lock(mBusyMutex);
     mIsBusy = false;
     mDone.signal();
@@ -191,30 +414,62 @@ void JpegCompressor::cleanUp() {
 void JpegCompressor::jpegErrorHandler(j_common_ptr cinfo) {
     ALOGV("%s", __FUNCTION__);
     JpegError *error = static_cast<JpegError*>(cinfo->err);
-    error->parent->mJpegErrorInfo = cinfo;
+    error->errorInfo = cinfo;
 }
 
 void JpegCompressor::jpegInitDestination(j_compress_ptr cinfo) {
     ALOGV("%s", __FUNCTION__);
     JpegDestination *dest= static_cast<JpegDestination*>(cinfo->dest);
-    ALOGV("%s: Setting destination to %p, size %d",
-            __FUNCTION__, dest->parent->mJpegBuffer->data, kMaxJpegSize);
-    dest->next_output_byte = (JOCTET*)(dest->parent->mJpegBuffer->data);
-    dest->free_in_buffer = kMaxJpegSize;
+    Stripe *stripe = dest->stripe;
+    // Half a byte per pixel is plenty for most images; grow when it isn't
+    size_t capacity = cinfo->image_width * cinfo->image_height / 2 + 4096;
+    stripe->data = (uint8_t*)malloc(capacity);
+    if (stripe->data == NULL) {
+        ALOGE("%s: Unable to allocate %d bytes for stripe", __FUNCTION__,
+                capacity);
+        stripe->failed = true;
+        dest->next_output_byte = dest->scratch;
+        dest->free_in_buffer = sizeof(dest->scratch);
+        return;
+    }
+    stripe->capacity = capacity;
+    dest->next_output_byte = (JOCTET*)stripe->data;
+    dest->free_in_buffer = capacity;
 }
 
-boolean JpegCompressor::jpegEmptyOutputBuffer(j_compress_ptr /*cinfo*/) {
+boolean JpegCompressor::jpegEmptyOutputBuffer(j_compress_ptr cinfo) {
     ALOGV("%s", __FUNCTION__);
-    ALOGE("%s: JPEG destination buffer overflow!",
-            __FUNCTION__);
+    JpegDestination *dest= static_cast<JpegDestination*>(cinfo->dest);
+    Stripe *stripe = dest->stripe;
+    if (!stripe->failed) {
+        // The whole buffer is full at this point
+        size_t capacity = stripe->capacity * 2;
+        uint8_t *data = (uint8_t*)realloc(stripe->data, capacity);
+        if (data != NULL) {
+            dest->next_output_byte = (JOCTET*)(data + stripe->capacity);
+            dest->free_in_buffer = capacity - stripe->capacity;
+            stripe->data = data;
+            stripe->capacity = capacity;
+            return true;
+        }
+        ALOGE("%s: Unable to grow stripe buffer to %d bytes",
+                __FUNCTION__, capacity);
+        stripe->failed = true;
+    }
+    // The stripe is lost; let libjpeg finish into the scratch space
+    dest->next_output_byte = dest->scratch;
+    dest->free_in_buffer = sizeof(dest->scratch);
     return true;
 }
 
 void JpegCompressor::jpegTermDestination(j_compress_ptr cinfo) {
-    (void) cinfo; // TODO: clean up
     ALOGV("%s", __FUNCTION__);
-    ALOGV("%s: Done writing JPEG data. %d bytes left in buffer",
-            __FUNCTION__, cinfo->dest->free_in_buffer);
+    JpegDestination *dest= static_cast<JpegDestination*>(cinfo->dest);
+    Stripe *stripe = dest->stripe;
+    if (stripe->failed) return;
+    stripe->size = stripe->capacity - dest->free_in_buffer;
+    ALOGV("%s: Done writing stripe at row %d, %d bytes", __FUNCTION__,
+            stripe->firstRow, stripe->size);
 }
 
 }; // namespace camera2
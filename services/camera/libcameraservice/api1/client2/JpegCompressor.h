@@ -58,30 +58,68 @@ class JpegCompressor: private Thread, public virtual RefBase {
 
     bool waitForDone(nsecs_t timeout);
 
-    // TODO: Measure this
-    static const size_t kMaxJpegSize = 300000;
+    // Number of threads to compress with; 0, the default, uses one per CPU
+    // core. Takes effect on the next start().
+    void setThreadCount(size_t count);
+
+    // Capacity of the output buffer. Unless set, the output must be a BLOB
+    // buffer, whose size CpuConsumer reports as its width. Takes effect on
+    // the next start().
+    void setMaxJpegSize(size_t size);
+
+    // Size of the last compressed image, 0 if compression failed
+    size_t getJpegSize();
 
   private:
+    // The image is compressed in horizontal stripes of this many MCU rows.
+    // Each stripe is a restart interval of its own, so stripes can be
+    // compressed in parallel and then concatenated. The split doesn't depend
+    // on the thread count, so neither does the output.
+    static const size_t kStripeMcuRows = 16;
+    // Largest restart interval the DRI marker can hold, in MCUs
+    static const size_t kMaxRestartInterval = 65535;
+
     Mutex mBusyMutex;
     Mutex mMutex;
     bool mIsBusy;
     Condition mDone;
     nsecs_t mCaptureTime;
+    size_t mThreadCount;
+    size_t mMaxJpegSize;
+    size_t mJpegSize;
 
     Vector<CpuConsumer::LockedBuffer*> mBuffers;
     CpuConsumer::LockedBuffer *mJpegBuffer;
     CpuConsumer::LockedBuffer *mAuxBuffer;
     bool mFoundJpeg, mFoundAux;
 
-    jpeg_compress_struct mCInfo;
+    // One horizontal stripe of the image, compressed into its own
+    // standalone JPEG
+    struct Stripe {
+        size_t firstRow;
+        size_t rows;
+        size_t restartRows;
+        uint8_t *data;
+        size_t capacity;
+        size_t size;
+        bool failed;
+    };
+    Vector<Stripe> mStripes;
+    // Next stripe to compress, and whether to give up. Shared with the
+    // stripe workers.
+    volatile int32_t mNextStripe;
+    volatile int32_t mAborted;
+
+    class StripeWorker;
 
     struct JpegError : public jpeg_error_mgr {
-        JpegCompressor *parent;
+        j_common_ptr errorInfo;
     };
-    j_common_ptr mJpegErrorInfo;
 
     struct JpegDestination : public jpeg_destination_mgr {
-        JpegCompressor *parent;
+        Stripe *stripe;
+        // Where output goes once the stripe's own buffer can't grow
+        JOCTET scratch[256];
     };
 
     static void jpegErrorHandler(j_common_ptr cinfo);
@@ -90,7 +128,15 @@ class JpegCompressor: private Thread, public virtual RefBase {
     static boolean jpegEmptyOutputBuffer(j_compress_ptr cinfo);
     static void jpegTermDestination(j_compress_ptr cinfo);
 
-    bool checkError(const char *msg);
+    // Compresses stripes until there are none left; runs on the compressor
+    // thread and all stripe workers
+    void compressStripes();
+    bool compressStripe(Stripe *stripe);
+    // Concatenates the compressed stripes into the output buffer
+    bool assembleJpeg(size_t maxJpegSize);
+    void freeStripes();
+
+    bool checkError(jpeg_compress_struct *cinfo, const char *msg);
     void cleanUp();
 
     /**
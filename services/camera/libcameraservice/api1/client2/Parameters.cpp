@@ -788,6 +788,8 @@ status_t Parameters::initialize(const CameraMetadata *info) {
     params.set(CameraParameters::KEY_VIDEO_STABILIZATION,
             CameraParameters::FALSE);
 
+    recordingFrameIntervalUs = 0;
+
     camera_metadata_ro_entry_t availableVideoStabilizationModes =
         staticInfo(ANDROID_CONTROL_AVAILABLE_VIDEO_STABILIZATION_MODES, 0, 0,
                 false);
@@ -1085,10 +1087,17 @@ camera_metadata_ro_entry_t Parameters::staticInfo(uint32_t tag,
     return entry;
 }
 
-status_t Parameters::set(const String8& paramString) {
+status_t Parameters::set(const String8& paramString, bool *requestChanged) {
     status_t res;
 
-    CameraParameters2 newParams(paramString);
+    /**
+     * Only the keys whose values differ from the current parameters get
+     * parsed and validated again; the others were validated when they were
+     * last set, and the typed fields below still hold their values.
+     */
+    CameraParameters2 newParams(params);
+    Vector<String8> changedKeys;
+    newParams.unflatten(paramString, &changedKeys);
 
     // TODO: Currently ignoring any changes to supposedly read-only parameters
     // such as supported preview sizes, etc. Should probably produce an error if
@@ -1098,48 +1107,6 @@ status_t Parameters::set(const String8& paramString) {
 
     size_t i;
 
-    Parameters validatedParams(*this);
-
-    // PREVIEW_SIZE
-    newParams.getPreviewSize(&validatedParams.previewWidth,
-            &validatedParams.previewHeight);
-
-    if (validatedParams.previewWidth != previewWidth ||
-            validatedParams.previewHeight != previewHeight) {
-        if (state >= PREVIEW) {
-            ALOGE("%s: Preview size cannot be updated when preview "
-                    "is active! (Currently %d x %d, requested %d x %d",
-                    __FUNCTION__,
-                    previewWidth, previewHeight,
-                    validatedParams.previewWidth, validatedParams.previewHeight);
-            return BAD_VALUE;
-        }
-        for (i = 0; i < availablePreviewSizes.size(); i++) {
-            if ((availablePreviewSizes[i].width ==
-                    validatedParams.previewWidth) &&
-                (availablePreviewSizes[i].height ==
-                    validatedParams.previewHeight)) break;
-        }
-        if (i == availablePreviewSizes.size()) {
-            ALOGE("%s: Requested preview size %d x %d is not supported",
-                    __FUNCTION__, validatedParams.previewWidth,
-                    validatedParams.previewHeight);
-            return BAD_VALUE;
-        }
-    }
-
-    // RECORDING_HINT (always supported)
-    validatedParams.recordingHint = boolFromString(
-        newParams.get(CameraParameters::KEY_RECORDING_HINT) );
-    IF_ALOGV() { // Avoid unused variable warning
-        bool recordingHintChanged =
-                validatedParams.recordingHint != recordingHint;
-        if (recordingHintChanged) {
-            ALOGV("%s: Recording hint changed to %d",
-                  __FUNCTION__, validatedParams.recordingHint);
-        }
-    }
-
     // PREVIEW_FPS_RANGE
 
     /**
@@ -1186,14 +1153,88 @@ status_t Parameters::set(const String8& paramString) {
         ALOGV("%s: Preview FPS value is used from '%s'",
               __FUNCTION__, fpsUseSingleValue ? "single" : "range");
     }
-    newParams.getPreviewFpsRange(&validatedParams.previewFpsRange[0],
-            &validatedParams.previewFpsRange[1]);
 
-    validatedParams.previewFpsRange[0] /= kFpsToApiScale;
-    validatedParams.previewFpsRange[1] /= kFpsToApiScale;
+    // Which of the FPS keys wins also depends on the order they're in
+    bool fpsChanged =
+            keyChanged(changedKeys, CameraParameters::KEY_PREVIEW_FRAME_RATE) ||
+            keyChanged(changedKeys, CameraParameters::KEY_PREVIEW_FPS_RANGE) ||
+            keyChanged(changedKeys, CameraParameters::KEY_RECORDING_HINT);
+    if (!fpsChanged) {
+        int fpsKeyOrder;
+        res = params.compareSetOrder(
+                CameraParameters::KEY_PREVIEW_FRAME_RATE,
+                CameraParameters::KEY_PREVIEW_FPS_RANGE,
+                &fpsKeyOrder);
+        fpsChanged = (res != OK) || (fpsUseSingleValue != (fpsKeyOrder > 0));
+    }
+
+    // The focus mode is swapped out during an autofocus sweep in continuous
+    // focus mode; setting any parameters restores it
+    bool focusModeOverridden = (shadowFocusMode != FOCUS_MODE_INVALID);
+
+    if (changedKeys.isEmpty() && !fpsChanged && !focusModeOverridden) {
+        ALOGV("%s: No parameters changed", __FUNCTION__);
+        if (requestChanged != NULL) *requestChanged = false;
+        return OK;
+    }
+
+    Parameters validatedParams(*this);
+
+    // PREVIEW_SIZE
+    if (keyChanged(changedKeys, CameraParameters::KEY_PREVIEW_SIZE)) {
+        newParams.getPreviewSize(&validatedParams.previewWidth,
+                &validatedParams.previewHeight);
+
+        if (validatedParams.previewWidth != previewWidth ||
+                validatedParams.previewHeight != previewHeight) {
+            if (state >= PREVIEW) {
+                ALOGE("%s: Preview size cannot be updated when preview "
+                        "is active! (Currently %d x %d, requested %d x %d",
+                        __FUNCTION__,
+                        previewWidth, previewHeight,
+                        validatedParams.previewWidth,
+                        validatedParams.previewHeight);
+                return BAD_VALUE;
+            }
+            for (i = 0; i < availablePreviewSizes.size(); i++) {
+                if ((availablePreviewSizes[i].width ==
+                        validatedParams.previewWidth) &&
+                    (availablePreviewSizes[i].height ==
+                        validatedParams.previewHeight)) break;
+            }
+            if (i == availablePreviewSizes.size()) {
+                ALOGE("%s: Requested preview size %d x %d is not supported",
+                        __FUNCTION__, validatedParams.previewWidth,
+                        validatedParams.previewHeight);
+                return BAD_VALUE;
+            }
+        }
+    }
+
+    // RECORDING_HINT (always supported)
+    if (keyChanged(changedKeys, CameraParameters::KEY_RECORDING_HINT)) {
+        validatedParams.recordingHint = boolFromString(
+            newParams.get(CameraParameters::KEY_RECORDING_HINT) );
+        IF_ALOGV() { // Avoid unused variable warning
+            bool recordingHintChanged =
+                    validatedParams.recordingHint != recordingHint;
+            if (recordingHintChanged) {
+                ALOGV("%s: Recording hint changed to %d",
+                      __FUNCTION__, validatedParams.recordingHint);
+            }
+        }
+    }
+
+    if (fpsChanged) {
+        newParams.getPreviewFpsRange(&validatedParams.previewFpsRange[0],
+                &validatedParams.previewFpsRange[1]);
+
+        validatedParams.previewFpsRange[0] /= kFpsToApiScale;
+        validatedParams.previewFpsRange[1] /= kFpsToApiScale;
+    }
 
     // Ignore the FPS range if the FPS single has higher precedence
-    if (!fpsUseSingleValue) {
+    if (fpsChanged && !fpsUseSingleValue) {
         ALOGV("%s: Preview FPS range (%d, %d)", __FUNCTION__,
                 validatedParams.previewFpsRange[0],
                 validatedParams.previewFpsRange[1]);
@@ -1217,40 +1258,43 @@ status_t Parameters::set(const String8& paramString) {
     }
 
     // PREVIEW_FORMAT
-    validatedParams.previewFormat =
-            formatStringToEnum(newParams.getPreviewFormat());
-    if (validatedParams.previewFormat != previewFormat) {
-        if (state >= PREVIEW) {
-            ALOGE("%s: Preview format cannot be updated when preview "
-                    "is active!", __FUNCTION__);
-            return BAD_VALUE;
-        }
-        camera_metadata_ro_entry_t availableFormats =
-            staticInfo(ANDROID_SCALER_AVAILABLE_FORMATS);
-        // If using flexible YUV, always support NV21/YV12. Otherwise, check
-        // HAL's list.
-        if (! (fastInfo.useFlexibleYuv &&
-                (validatedParams.previewFormat ==
-                        HAL_PIXEL_FORMAT_YCrCb_420_SP ||
-                 validatedParams.previewFormat ==
-                        HAL_PIXEL_FORMAT_YV12) ) ) {
-            // Not using flexible YUV format, so check explicitly
-            for (i = 0; i < availableFormats.count; i++) {
-                if (availableFormats.data.i32[i] ==
-                        validatedParams.previewFormat) break;
-            }
-            if (i == availableFormats.count) {
-                ALOGE("%s: Requested preview format %s (0x%x) is not supported",
-                        __FUNCTION__, newParams.getPreviewFormat(),
-                        validatedParams.previewFormat);
+    if (keyChanged(changedKeys, CameraParameters::KEY_PREVIEW_FORMAT)) {
+        validatedParams.previewFormat =
+                formatStringToEnum(newParams.getPreviewFormat());
+        if (validatedParams.previewFormat != previewFormat) {
+            if (state >= PREVIEW) {
+                ALOGE("%s: Preview format cannot be updated when preview "
+                        "is active!", __FUNCTION__);
                 return BAD_VALUE;
             }
+            camera_metadata_ro_entry_t availableFormats =
+                staticInfo(ANDROID_SCALER_AVAILABLE_FORMATS);
+            // If using flexible YUV, always support NV21/YV12. Otherwise, check
+            // HAL's list.
+            if (! (fastInfo.useFlexibleYuv &&
+                    (validatedParams.previewFormat ==
+                            HAL_PIXEL_FORMAT_YCrCb_420_SP ||
+                     validatedParams.previewFormat ==
+                            HAL_PIXEL_FORMAT_YV12) ) ) {
+                // Not using flexible YUV format, so check explicitly
+                for (i = 0; i < availableFormats.count; i++) {
+                    if (availableFormats.data.i32[i] ==
+                            validatedParams.previewFormat) break;
+                }
+                if (i == availableFormats.count) {
+                    ALOGE("%s: Requested preview format %s (0x%x) is not "
+                            "supported", __FUNCTION__,
+                            newParams.getPreviewFormat(),
+                            validatedParams.previewFormat);
+                    return BAD_VALUE;
+                }
+            }
         }
     }
 
     // PREVIEW_FRAME_RATE Deprecated
     // - Use only if the single FPS value was set later than the FPS range
-    if (fpsUseSingleValue) {
+    if (fpsChanged && fpsUseSingleValue) {
         int previewFps = newParams.getPreviewFrameRate();
         ALOGV("%s: Preview FPS single value requested: %d",
               __FUNCTION__, previewFps);
@@ -1334,7 +1378,7 @@ status_t Parameters::set(const String8& paramString) {
      * - If the client does a setParameters(getParameters()) we retain
      *   the same order for preview FPS.
      */
-    if (!fpsUseSingleValue) {
+    if (fpsChanged && !fpsUseSingleValue) {
         // Set fps single, then fps range (range wins)
         newParams.setPreviewFrameRate(
                 fpsFromRange(/*min*/validatedParams.previewFpsRange[0],
@@ -1342,7 +1386,7 @@ status_t Parameters::set(const String8& paramString) {
         newParams.setPreviewFpsRange(
                 validatedParams.previewFpsRange[0] * kFpsToApiScale,
                 validatedParams.previewFpsRange[1] * kFpsToApiScale);
-    } else {
+    } else if (fpsChanged) {
         // Set fps range, then fps single (single wins)
         newParams.setPreviewFpsRange(
                 validatedParams.previewFpsRange[0] * kFpsToApiScale,
@@ -1353,413 +1397,497 @@ status_t Parameters::set(const String8& paramString) {
     }
 
     // PICTURE_SIZE
-    newParams.getPictureSize(&validatedParams.pictureWidth,
-            &validatedParams.pictureHeight);
-    if (validatedParams.pictureWidth == pictureWidth ||
-            validatedParams.pictureHeight == pictureHeight) {
-        camera_metadata_ro_entry_t availablePictureSizes =
-            staticInfo(ANDROID_SCALER_AVAILABLE_JPEG_SIZES);
-        for (i = 0; i < availablePictureSizes.count; i+=2) {
-            if ((availablePictureSizes.data.i32[i] ==
-                    validatedParams.pictureWidth) &&
-                (availablePictureSizes.data.i32[i+1] ==
-                    validatedParams.pictureHeight)) break;
-        }
-        if (i == availablePictureSizes.count) {
-            ALOGE("%s: Requested picture size %d x %d is not supported",
-                    __FUNCTION__, validatedParams.pictureWidth,
-                    validatedParams.pictureHeight);
-            return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_PICTURE_SIZE)) {
+        newParams.getPictureSize(&validatedParams.pictureWidth,
+                &validatedParams.pictureHeight);
+        if (validatedParams.pictureWidth == pictureWidth ||
+                validatedParams.pictureHeight == pictureHeight) {
+            camera_metadata_ro_entry_t availablePictureSizes =
+                staticInfo(ANDROID_SCALER_AVAILABLE_JPEG_SIZES);
+            for (i = 0; i < availablePictureSizes.count; i+=2) {
+                if ((availablePictureSizes.data.i32[i] ==
+                        validatedParams.pictureWidth) &&
+                    (availablePictureSizes.data.i32[i+1] ==
+                        validatedParams.pictureHeight)) break;
+            }
+            if (i == availablePictureSizes.count) {
+                ALOGE("%s: Requested picture size %d x %d is not supported",
+                        __FUNCTION__, validatedParams.pictureWidth,
+                        validatedParams.pictureHeight);
+                return BAD_VALUE;
+            }
         }
     }
 
     // JPEG_THUMBNAIL_WIDTH/HEIGHT
-    validatedParams.jpegThumbSize[0] =
-            newParams.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH);
-    validatedParams.jpegThumbSize[1] =
-            newParams.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT);
-    if (validatedParams.jpegThumbSize[0] != jpegThumbSize[0] ||
-            validatedParams.jpegThumbSize[1] != jpegThumbSize[1]) {
-        camera_metadata_ro_entry_t availableJpegThumbSizes =
-            staticInfo(ANDROID_JPEG_AVAILABLE_THUMBNAIL_SIZES);
-        for (i = 0; i < availableJpegThumbSizes.count; i+=2) {
-            if ((availableJpegThumbSizes.data.i32[i] ==
-                    validatedParams.jpegThumbSize[0]) &&
-                (availableJpegThumbSizes.data.i32[i+1] ==
-                    validatedParams.jpegThumbSize[1])) break;
-        }
-        if (i == availableJpegThumbSizes.count) {
-            ALOGE("%s: Requested JPEG thumbnail size %d x %d is not supported",
-                    __FUNCTION__, validatedParams.jpegThumbSize[0],
-                    validatedParams.jpegThumbSize[1]);
-            return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH) ||
+            keyChanged(changedKeys,
+                    CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT)) {
+        validatedParams.jpegThumbSize[0] =
+                newParams.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH);
+        validatedParams.jpegThumbSize[1] =
+                newParams.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT);
+        if (validatedParams.jpegThumbSize[0] != jpegThumbSize[0] ||
+                validatedParams.jpegThumbSize[1] != jpegThumbSize[1]) {
+            camera_metadata_ro_entry_t availableJpegThumbSizes =
+                staticInfo(ANDROID_JPEG_AVAILABLE_THUMBNAIL_SIZES);
+            for (i = 0; i < availableJpegThumbSizes.count; i+=2) {
+                if ((availableJpegThumbSizes.data.i32[i] ==
+                        validatedParams.jpegThumbSize[0]) &&
+                    (availableJpegThumbSizes.data.i32[i+1] ==
+                        validatedParams.jpegThumbSize[1])) break;
+            }
+            if (i == availableJpegThumbSizes.count) {
+                ALOGE("%s: Requested JPEG thumbnail size %d x %d is not "
+                        "supported", __FUNCTION__,
+                        validatedParams.jpegThumbSize[0],
+                        validatedParams.jpegThumbSize[1]);
+                return BAD_VALUE;
+            }
         }
     }
 
     // JPEG_THUMBNAIL_QUALITY
-    int quality = newParams.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY);
-    // also makes sure quality fits in uint8_t
-    if (quality < 0 || quality > 100) {
-        ALOGE("%s: Requested JPEG thumbnail quality %d is not supported",
-                __FUNCTION__, quality);
-        return BAD_VALUE;
+    if (keyChanged(changedKeys,
+            CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY)) {
+        int quality =
+                newParams.getInt(CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY);
+        // also makes sure quality fits in uint8_t
+        if (quality < 0 || quality > 100) {
+            ALOGE("%s: Requested JPEG thumbnail quality %d is not supported",
+                    __FUNCTION__, quality);
+            return BAD_VALUE;
+        }
+        validatedParams.jpegThumbQuality = quality;
     }
-    validatedParams.jpegThumbQuality = quality;
 
     // JPEG_QUALITY
-    quality = newParams.getInt(CameraParameters::KEY_JPEG_QUALITY);
-    // also makes sure quality fits in uint8_t
-    if (quality < 0 || quality > 100) {
-        ALOGE("%s: Requested JPEG quality %d is not supported",
-                __FUNCTION__, quality);
-        return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_JPEG_QUALITY)) {
+        int quality = newParams.getInt(CameraParameters::KEY_JPEG_QUALITY);
+        // also makes sure quality fits in uint8_t
+        if (quality < 0 || quality > 100) {
+            ALOGE("%s: Requested JPEG quality %d is not supported",
+                    __FUNCTION__, quality);
+            return BAD_VALUE;
+        }
+        validatedParams.jpegQuality = quality;
     }
-    validatedParams.jpegQuality = quality;
 
     // ROTATION
-    validatedParams.jpegRotation =
-            newParams.getInt(CameraParameters::KEY_ROTATION);
-    if (validatedParams.jpegRotation != 0 &&
-            validatedParams.jpegRotation != 90 &&
-            validatedParams.jpegRotation != 180 &&
-            validatedParams.jpegRotation != 270) {
-        ALOGE("%s: Requested picture rotation angle %d is not supported",
-                __FUNCTION__, validatedParams.jpegRotation);
-        return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_ROTATION)) {
+        validatedParams.jpegRotation =
+                newParams.getInt(CameraParameters::KEY_ROTATION);
+        if (validatedParams.jpegRotation != 0 &&
+                validatedParams.jpegRotation != 90 &&
+                validatedParams.jpegRotation != 180 &&
+                validatedParams.jpegRotation != 270) {
+            ALOGE("%s: Requested picture rotation angle %d is not supported",
+                    __FUNCTION__, validatedParams.jpegRotation);
+            return BAD_VALUE;
+        }
     }
 
     // GPS
+    if (keyChanged(changedKeys, CameraParameters::KEY_GPS_LATITUDE) ||
+            keyChanged(changedKeys, CameraParameters::KEY_GPS_LONGITUDE) ||
+            keyChanged(changedKeys, CameraParameters::KEY_GPS_ALTITUDE) ||
+            keyChanged(changedKeys, CameraParameters::KEY_GPS_TIMESTAMP) ||
+            keyChanged(changedKeys,
+                    CameraParameters::KEY_GPS_PROCESSING_METHOD)) {
+        const char *gpsLatStr =
+                newParams.get(CameraParameters::KEY_GPS_LATITUDE);
+        if (gpsLatStr != NULL) {
+            const char *gpsLongStr =
+                    newParams.get(CameraParameters::KEY_GPS_LONGITUDE);
+            const char *gpsAltitudeStr =
+                    newParams.get(CameraParameters::KEY_GPS_ALTITUDE);
+            const char *gpsTimeStr =
+                    newParams.get(CameraParameters::KEY_GPS_TIMESTAMP);
+            const char *gpsProcMethodStr =
+                    newParams.get(CameraParameters::KEY_GPS_PROCESSING_METHOD);
+            if (gpsLongStr == NULL ||
+                    gpsAltitudeStr == NULL ||
+                    gpsTimeStr == NULL ||
+                    gpsProcMethodStr == NULL) {
+                ALOGE("%s: Incomplete set of GPS parameters provided",
+                        __FUNCTION__);
+                return BAD_VALUE;
+            }
+            char *endPtr;
+            errno = 0;
+            validatedParams.gpsCoordinates[0] = strtod(gpsLatStr, &endPtr);
+            if (errno || endPtr == gpsLatStr) {
+                ALOGE("%s: Malformed GPS latitude: %s", __FUNCTION__,
+                        gpsLatStr);
+                return BAD_VALUE;
+            }
+            errno = 0;
+            validatedParams.gpsCoordinates[1] = strtod(gpsLongStr, &endPtr);
+            if (errno || endPtr == gpsLongStr) {
+                ALOGE("%s: Malformed GPS longitude: %s", __FUNCTION__,
+                        gpsLongStr);
+                return BAD_VALUE;
+            }
+            errno = 0;
+            validatedParams.gpsCoordinates[2] = strtod(gpsAltitudeStr, &endPtr);
+            if (errno || endPtr == gpsAltitudeStr) {
+                ALOGE("%s: Malformed GPS altitude: %s", __FUNCTION__,
+                        gpsAltitudeStr);
+                return BAD_VALUE;
+            }
+            errno = 0;
+            validatedParams.gpsTimestamp = strtoll(gpsTimeStr, &endPtr, 10);
+            if (errno || endPtr == gpsTimeStr) {
+                ALOGE("%s: Malformed GPS timestamp: %s", __FUNCTION__,
+                        gpsTimeStr);
+                return BAD_VALUE;
+            }
+            validatedParams.gpsProcessingMethod = gpsProcMethodStr;
 
-    const char *gpsLatStr =
-            newParams.get(CameraParameters::KEY_GPS_LATITUDE);
-    if (gpsLatStr != NULL) {
-        const char *gpsLongStr =
-                newParams.get(CameraParameters::KEY_GPS_LONGITUDE);
-        const char *gpsAltitudeStr =
-                newParams.get(CameraParameters::KEY_GPS_ALTITUDE);
-        const char *gpsTimeStr =
-                newParams.get(CameraParameters::KEY_GPS_TIMESTAMP);
-        const char *gpsProcMethodStr =
-                newParams.get(CameraParameters::KEY_GPS_PROCESSING_METHOD);
-        if (gpsLongStr == NULL ||
-                gpsAltitudeStr == NULL ||
-                gpsTimeStr == NULL ||
-                gpsProcMethodStr == NULL) {
-            ALOGE("%s: Incomplete set of GPS parameters provided",
-                    __FUNCTION__);
-            return BAD_VALUE;
-        }
-        char *endPtr;
-        errno = 0;
-        validatedParams.gpsCoordinates[0] = strtod(gpsLatStr, &endPtr);
-        if (errno || endPtr == gpsLatStr) {
-            ALOGE("%s: Malformed GPS latitude: %s", __FUNCTION__, gpsLatStr);
-            return BAD_VALUE;
-        }
-        errno = 0;
-        validatedParams.gpsCoordinates[1] = strtod(gpsLongStr, &endPtr);
-        if (errno || endPtr == gpsLongStr) {
-            ALOGE("%s: Malformed GPS longitude: %s", __FUNCTION__, gpsLongStr);
-            return BAD_VALUE;
-        }
-        errno = 0;
-        validatedParams.gpsCoordinates[2] = strtod(gpsAltitudeStr, &endPtr);
-        if (errno || endPtr == gpsAltitudeStr) {
-            ALOGE("%s: Malformed GPS altitude: %s", __FUNCTION__,
-                    gpsAltitudeStr);
-            return BAD_VALUE;
-        }
-        errno = 0;
-        validatedParams.gpsTimestamp = strtoll(gpsTimeStr, &endPtr, 10);
-        if (errno || endPtr == gpsTimeStr) {
-            ALOGE("%s: Malformed GPS timestamp: %s", __FUNCTION__, gpsTimeStr);
-            return BAD_VALUE;
+            validatedParams.gpsEnabled = true;
+        } else {
+            validatedParams.gpsEnabled = false;
         }
-        validatedParams.gpsProcessingMethod = gpsProcMethodStr;
-
-        validatedParams.gpsEnabled = true;
-    } else {
-        validatedParams.gpsEnabled = false;
     }
 
     // EFFECT
-    validatedParams.effectMode = effectModeStringToEnum(
-        newParams.get(CameraParameters::KEY_EFFECT) );
-    if (validatedParams.effectMode != effectMode) {
-        camera_metadata_ro_entry_t availableEffectModes =
-            staticInfo(ANDROID_CONTROL_AVAILABLE_EFFECTS);
-        for (i = 0; i < availableEffectModes.count; i++) {
-            if (validatedParams.effectMode == availableEffectModes.data.u8[i]) break;
-        }
-        if (i == availableEffectModes.count) {
-            ALOGE("%s: Requested effect mode \"%s\" is not supported",
-                    __FUNCTION__,
-                    newParams.get(CameraParameters::KEY_EFFECT) );
-            return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_EFFECT)) {
+        validatedParams.effectMode = effectModeStringToEnum(
+            newParams.get(CameraParameters::KEY_EFFECT) );
+        if (validatedParams.effectMode != effectMode) {
+            camera_metadata_ro_entry_t availableEffectModes =
+                staticInfo(ANDROID_CONTROL_AVAILABLE_EFFECTS);
+            for (i = 0; i < availableEffectModes.count; i++) {
+                if (validatedParams.effectMode ==
+                        availableEffectModes.data.u8[i]) break;
+            }
+            if (i == availableEffectModes.count) {
+                ALOGE("%s: Requested effect mode \"%s\" is not supported",
+                        __FUNCTION__,
+                        newParams.get(CameraParameters::KEY_EFFECT) );
+                return BAD_VALUE;
+            }
         }
     }
 
     // ANTIBANDING
-    validatedParams.antibandingMode = abModeStringToEnum(
-        newParams.get(CameraParameters::KEY_ANTIBANDING) );
-    if (validatedParams.antibandingMode != antibandingMode) {
-        camera_metadata_ro_entry_t availableAbModes =
-            staticInfo(ANDROID_CONTROL_AE_AVAILABLE_ANTIBANDING_MODES);
-        for (i = 0; i < availableAbModes.count; i++) {
-            if (validatedParams.antibandingMode == availableAbModes.data.u8[i])
-                break;
-        }
-        if (i == availableAbModes.count) {
-            ALOGE("%s: Requested antibanding mode \"%s\" is not supported",
-                    __FUNCTION__,
-                    newParams.get(CameraParameters::KEY_ANTIBANDING));
-            return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_ANTIBANDING)) {
+        validatedParams.antibandingMode = abModeStringToEnum(
+            newParams.get(CameraParameters::KEY_ANTIBANDING) );
+        if (validatedParams.antibandingMode != antibandingMode) {
+            camera_metadata_ro_entry_t availableAbModes =
+                staticInfo(ANDROID_CONTROL_AE_AVAILABLE_ANTIBANDING_MODES);
+            for (i = 0; i < availableAbModes.count; i++) {
+                if (validatedParams.antibandingMode ==
+                        availableAbModes.data.u8[i]) break;
+            }
+            if (i == availableAbModes.count) {
+                ALOGE("%s: Requested antibanding mode \"%s\" is not "
+                        "supported", __FUNCTION__,
+                        newParams.get(CameraParameters::KEY_ANTIBANDING));
+                return BAD_VALUE;
+            }
         }
     }
 
     // SCENE_MODE
-    validatedParams.sceneMode = sceneModeStringToEnum(
-        newParams.get(CameraParameters::KEY_SCENE_MODE) );
-    if (validatedParams.sceneMode != sceneMode &&
-            validatedParams.sceneMode !=
-            ANDROID_CONTROL_SCENE_MODE_UNSUPPORTED) {
-        camera_metadata_ro_entry_t availableSceneModes =
-            staticInfo(ANDROID_CONTROL_AVAILABLE_SCENE_MODES);
-        for (i = 0; i < availableSceneModes.count; i++) {
-            if (validatedParams.sceneMode == availableSceneModes.data.u8[i])
-                break;
-        }
-        if (i == availableSceneModes.count) {
-            ALOGE("%s: Requested scene mode \"%s\" is not supported",
-                    __FUNCTION__,
-                    newParams.get(CameraParameters::KEY_SCENE_MODE));
-            return BAD_VALUE;
+    bool sceneModeChanged =
+            keyChanged(changedKeys, CameraParameters::KEY_SCENE_MODE);
+    if (sceneModeChanged) {
+        validatedParams.sceneMode = sceneModeStringToEnum(
+            newParams.get(CameraParameters::KEY_SCENE_MODE) );
+        if (validatedParams.sceneMode != sceneMode &&
+                validatedParams.sceneMode !=
+                ANDROID_CONTROL_SCENE_MODE_UNSUPPORTED) {
+            camera_metadata_ro_entry_t availableSceneModes =
+                staticInfo(ANDROID_CONTROL_AVAILABLE_SCENE_MODES);
+            for (i = 0; i < availableSceneModes.count; i++) {
+                if (validatedParams.sceneMode ==
+                        availableSceneModes.data.u8[i]) break;
+            }
+            if (i == availableSceneModes.count) {
+                ALOGE("%s: Requested scene mode \"%s\" is not supported",
+                        __FUNCTION__,
+                        newParams.get(CameraParameters::KEY_SCENE_MODE));
+                return BAD_VALUE;
+            }
         }
     }
     bool sceneModeSet =
             validatedParams.sceneMode != ANDROID_CONTROL_SCENE_MODE_UNSUPPORTED;
 
     // FLASH_MODE
-    if (sceneModeSet) {
-        validatedParams.flashMode =
-                fastInfo.sceneModeOverrides.
-                        valueFor(validatedParams.sceneMode).flashMode;
-    } else {
-        validatedParams.flashMode = FLASH_MODE_INVALID;
-    }
-    if (validatedParams.flashMode == FLASH_MODE_INVALID) {
-        validatedParams.flashMode = flashModeStringToEnum(
-            newParams.get(CameraParameters::KEY_FLASH_MODE) );
-    }
+    if (sceneModeChanged ||
+            keyChanged(changedKeys, CameraParameters::KEY_FLASH_MODE)) {
+        if (sceneModeSet) {
+            validatedParams.flashMode =
+                    fastInfo.sceneModeOverrides.
+                            valueFor(validatedParams.sceneMode).flashMode;
+        } else {
+            validatedParams.flashMode = FLASH_MODE_INVALID;
+        }
+        if (validatedParams.flashMode == FLASH_MODE_INVALID) {
+            validatedParams.flashMode = flashModeStringToEnum(
+                newParams.get(CameraParameters::KEY_FLASH_MODE) );
+        }
 
-    if (validatedParams.flashMode != flashMode) {
-        camera_metadata_ro_entry_t flashAvailable =
-            staticInfo(ANDROID_FLASH_INFO_AVAILABLE, 1, 1);
-        if (!flashAvailable.data.u8[0] &&
-                validatedParams.flashMode != Parameters::FLASH_MODE_OFF) {
-            ALOGE("%s: Requested flash mode \"%s\" is not supported: "
-                    "No flash on device", __FUNCTION__,
-                    newParams.get(CameraParameters::KEY_FLASH_MODE));
-            return BAD_VALUE;
-        } else if (validatedParams.flashMode == Parameters::FLASH_MODE_RED_EYE) {
-            camera_metadata_ro_entry_t availableAeModes =
-                staticInfo(ANDROID_CONTROL_AE_AVAILABLE_MODES);
-            for (i = 0; i < availableAeModes.count; i++) {
-                if (validatedParams.flashMode == availableAeModes.data.u8[i])
-                    break;
-            }
-            if (i == availableAeModes.count) {
-                ALOGE("%s: Requested flash mode \"%s\" is not supported",
+        if (validatedParams.flashMode != flashMode) {
+            camera_metadata_ro_entry_t flashAvailable =
+                staticInfo(ANDROID_FLASH_INFO_AVAILABLE, 1, 1);
+            if (!flashAvailable.data.u8[0] &&
+                    validatedParams.flashMode != Parameters::FLASH_MODE_OFF) {
+                ALOGE("%s: Requested flash mode \"%s\" is not supported: "
+                        "No flash on device", __FUNCTION__,
+                        newParams.get(CameraParameters::KEY_FLASH_MODE));
+                return BAD_VALUE;
+            } else if (validatedParams.flashMode ==
+                    Parameters::FLASH_MODE_RED_EYE) {
+                camera_metadata_ro_entry_t availableAeModes =
+                    staticInfo(ANDROID_CONTROL_AE_AVAILABLE_MODES);
+                for (i = 0; i < availableAeModes.count; i++) {
+                    if (validatedParams.flashMode ==
+                            availableAeModes.data.u8[i]) break;
+                }
+                if (i == availableAeModes.count) {
+                    ALOGE("%s: Requested flash mode \"%s\" is not supported",
+                            __FUNCTION__,
+                            newParams.get(CameraParameters::KEY_FLASH_MODE));
+                    return BAD_VALUE;
+                }
+            } else if (validatedParams.flashMode == -1) {
+                ALOGE("%s: Requested flash mode \"%s\" is unknown",
                         __FUNCTION__,
                         newParams.get(CameraParameters::KEY_FLASH_MODE));
                 return BAD_VALUE;
             }
-        } else if (validatedParams.flashMode == -1) {
-            ALOGE("%s: Requested flash mode \"%s\" is unknown",
-                    __FUNCTION__,
-                    newParams.get(CameraParameters::KEY_FLASH_MODE));
-            return BAD_VALUE;
+            // Update in case of override
+            newParams.set(CameraParameters::KEY_FLASH_MODE,
+                    flashModeEnumToString(validatedParams.flashMode));
         }
-        // Update in case of override
-        newParams.set(CameraParameters::KEY_FLASH_MODE,
-                flashModeEnumToString(validatedParams.flashMode));
     }
 
     // WHITE_BALANCE
-    if (sceneModeSet) {
-        validatedParams.wbMode =
-                fastInfo.sceneModeOverrides.
-                        valueFor(validatedParams.sceneMode).wbMode;
-    } else {
-        validatedParams.wbMode = ANDROID_CONTROL_AWB_MODE_OFF;
-    }
-    if (validatedParams.wbMode == ANDROID_CONTROL_AWB_MODE_OFF) {
-        validatedParams.wbMode = wbModeStringToEnum(
-            newParams.get(CameraParameters::KEY_WHITE_BALANCE) );
-    }
-    if (validatedParams.wbMode != wbMode) {
-        camera_metadata_ro_entry_t availableWbModes =
-            staticInfo(ANDROID_CONTROL_AWB_AVAILABLE_MODES, 0, 0, false);
-        for (i = 0; i < availableWbModes.count; i++) {
-            if (validatedParams.wbMode == availableWbModes.data.u8[i]) break;
+    if (sceneModeChanged ||
+            keyChanged(changedKeys, CameraParameters::KEY_WHITE_BALANCE)) {
+        if (sceneModeSet) {
+            validatedParams.wbMode =
+                    fastInfo.sceneModeOverrides.
+                            valueFor(validatedParams.sceneMode).wbMode;
+        } else {
+            validatedParams.wbMode = ANDROID_CONTROL_AWB_MODE_OFF;
         }
-        if (i == availableWbModes.count) {
-            ALOGE("%s: Requested white balance mode %s is not supported",
-                    __FUNCTION__,
-                    newParams.get(CameraParameters::KEY_WHITE_BALANCE));
-            return BAD_VALUE;
+        if (validatedParams.wbMode == ANDROID_CONTROL_AWB_MODE_OFF) {
+            validatedParams.wbMode = wbModeStringToEnum(
+                newParams.get(CameraParameters::KEY_WHITE_BALANCE) );
+        }
+        if (validatedParams.wbMode != wbMode) {
+            camera_metadata_ro_entry_t availableWbModes =
+                staticInfo(ANDROID_CONTROL_AWB_AVAILABLE_MODES, 0, 0, false);
+            for (i = 0; i < availableWbModes.count; i++) {
+                if (validatedParams.wbMode == availableWbModes.data.u8[i])
+                    break;
+            }
+            if (i == availableWbModes.count) {
+                ALOGE("%s: Requested white balance mode %s is not supported",
+                        __FUNCTION__,
+                        newParams.get(CameraParameters::KEY_WHITE_BALANCE));
+                return BAD_VALUE;
+            }
+            // Update in case of override
+            newParams.set(CameraParameters::KEY_WHITE_BALANCE,
+                    wbModeEnumToString(validatedParams.wbMode));
         }
-        // Update in case of override
-        newParams.set(CameraParameters::KEY_WHITE_BALANCE,
-                wbModeEnumToString(validatedParams.wbMode));
     }
 
     // FOCUS_MODE
-    if (sceneModeSet) {
-        validatedParams.focusMode =
-                fastInfo.sceneModeOverrides.
-                        valueFor(validatedParams.sceneMode).focusMode;
-    } else {
-        validatedParams.focusMode = FOCUS_MODE_INVALID;
-    }
-    if (validatedParams.focusMode == FOCUS_MODE_INVALID) {
-        validatedParams.focusMode = focusModeStringToEnum(
-                newParams.get(CameraParameters::KEY_FOCUS_MODE) );
-    }
-    if (validatedParams.focusMode != focusMode) {
-        validatedParams.currentAfTriggerId = -1;
-        if (validatedParams.focusMode != Parameters::FOCUS_MODE_FIXED) {
-            camera_metadata_ro_entry_t minFocusDistance =
-                staticInfo(ANDROID_LENS_INFO_MINIMUM_FOCUS_DISTANCE, 0, 0,
-                        false);
-            if (minFocusDistance.count && minFocusDistance.data.f[0] == 0) {
-                ALOGE("%s: Requested focus mode \"%s\" is not available: "
-                        "fixed focus lens",
-                        __FUNCTION__,
-                        newParams.get(CameraParameters::KEY_FOCUS_MODE));
-                return BAD_VALUE;
-            } else if (validatedParams.focusMode !=
-                    Parameters::FOCUS_MODE_INFINITY) {
-                camera_metadata_ro_entry_t availableFocusModes =
-                    staticInfo(ANDROID_CONTROL_AF_AVAILABLE_MODES);
-                for (i = 0; i < availableFocusModes.count; i++) {
-                    if (validatedParams.focusMode ==
-                            availableFocusModes.data.u8[i]) break;
-                }
-                if (i == availableFocusModes.count) {
-                    ALOGE("%s: Requested focus mode \"%s\" is not supported",
+    if (sceneModeChanged || focusModeOverridden ||
+            keyChanged(changedKeys, CameraParameters::KEY_FOCUS_MODE)) {
+        if (sceneModeSet) {
+            validatedParams.focusMode =
+                    fastInfo.sceneModeOverrides.
+                            valueFor(validatedParams.sceneMode).focusMode;
+        } else {
+            validatedParams.focusMode = FOCUS_MODE_INVALID;
+        }
+        if (validatedParams.focusMode == FOCUS_MODE_INVALID) {
+            validatedParams.focusMode = focusModeStringToEnum(
+                    newParams.get(CameraParameters::KEY_FOCUS_MODE) );
+        }
+        if (validatedParams.focusMode != focusMode) {
+            validatedParams.currentAfTriggerId = -1;
+            if (validatedParams.focusMode != Parameters::FOCUS_MODE_FIXED) {
+                camera_metadata_ro_entry_t minFocusDistance =
+                    staticInfo(ANDROID_LENS_INFO_MINIMUM_FOCUS_DISTANCE, 0, 0,
+                            false);
+                if (minFocusDistance.count &&
+                        minFocusDistance.data.f[0] == 0) {
+                    ALOGE("%s: Requested focus mode \"%s\" is not available: "
+                            "fixed focus lens",
                             __FUNCTION__,
                             newParams.get(CameraParameters::KEY_FOCUS_MODE));
                     return BAD_VALUE;
+                } else if (validatedParams.focusMode !=
+                        Parameters::FOCUS_MODE_INFINITY) {
+                    camera_metadata_ro_entry_t availableFocusModes =
+                        staticInfo(ANDROID_CONTROL_AF_AVAILABLE_MODES);
+                    for (i = 0; i < availableFocusModes.count; i++) {
+                        if (validatedParams.focusMode ==
+                                availableFocusModes.data.u8[i]) break;
+                    }
+                    if (i == availableFocusModes.count) {
+                        ALOGE("%s: Requested focus mode \"%s\" is not "
+                                "supported", __FUNCTION__,
+                                newParams.get(
+                                        CameraParameters::KEY_FOCUS_MODE));
+                        return BAD_VALUE;
+                    }
                 }
             }
+            validatedParams.focusState = ANDROID_CONTROL_AF_STATE_INACTIVE;
+            // Always reset shadow focus mode to avoid reverting settings
+            validatedParams.shadowFocusMode = FOCUS_MODE_INVALID;
+            // Update in case of override
+            newParams.set(CameraParameters::KEY_FOCUS_MODE,
+                    focusModeEnumToString(validatedParams.focusMode));
         }
-        validatedParams.focusState = ANDROID_CONTROL_AF_STATE_INACTIVE;
-        // Always reset shadow focus mode to avoid reverting settings
-        validatedParams.shadowFocusMode = FOCUS_MODE_INVALID;
-        // Update in case of override
-        newParams.set(CameraParameters::KEY_FOCUS_MODE,
-                focusModeEnumToString(validatedParams.focusMode));
-    } else {
-        validatedParams.currentAfTriggerId = currentAfTriggerId;
     }
 
-    // FOCUS_AREAS
-    res = parseAreas(newParams.get(CameraParameters::KEY_FOCUS_AREAS),
-            &validatedParams.focusingAreas);
     size_t max3aRegions =
         (size_t)staticInfo(ANDROID_CONTROL_MAX_REGIONS, 1, 1).data.i32[0];
-    if (res == OK) res = validateAreas(validatedParams.focusingAreas,
-            max3aRegions, AREA_KIND_FOCUS);
-    if (res != OK) {
-        ALOGE("%s: Requested focus areas are malformed: %s",
-                __FUNCTION__, newParams.get(CameraParameters::KEY_FOCUS_AREAS));
-        return BAD_VALUE;
+
+    // FOCUS_AREAS
+    if (keyChanged(changedKeys, CameraParameters::KEY_FOCUS_AREAS)) {
+        res = parseAreas(newParams.get(CameraParameters::KEY_FOCUS_AREAS),
+                &validatedParams.focusingAreas);
+        if (res == OK) res = validateAreas(validatedParams.focusingAreas,
+                max3aRegions, AREA_KIND_FOCUS);
+        if (res != OK) {
+            ALOGE("%s: Requested focus areas are malformed: %s",
+                    __FUNCTION__,
+                    newParams.get(CameraParameters::KEY_FOCUS_AREAS));
+            return BAD_VALUE;
+        }
     }
 
     // EXPOSURE_COMPENSATION
-    validatedParams.exposureCompensation =
-        newParams.getInt(CameraParameters::KEY_EXPOSURE_COMPENSATION);
-    camera_metadata_ro_entry_t exposureCompensationRange =
-        staticInfo(ANDROID_CONTROL_AE_COMPENSATION_RANGE);
-    if ((validatedParams.exposureCompensation <
-            exposureCompensationRange.data.i32[0]) ||
-        (validatedParams.exposureCompensation >
-            exposureCompensationRange.data.i32[1])) {
-        ALOGE("%s: Requested exposure compensation index is out of bounds: %d",
-                __FUNCTION__, validatedParams.exposureCompensation);
-        return BAD_VALUE;
+    if (keyChanged(changedKeys,
+            CameraParameters::KEY_EXPOSURE_COMPENSATION)) {
+        validatedParams.exposureCompensation =
+            newParams.getInt(CameraParameters::KEY_EXPOSURE_COMPENSATION);
+        camera_metadata_ro_entry_t exposureCompensationRange =
+            staticInfo(ANDROID_CONTROL_AE_COMPENSATION_RANGE);
+        if ((validatedParams.exposureCompensation <
+                exposureCompensationRange.data.i32[0]) ||
+            (validatedParams.exposureCompensation >
+                exposureCompensationRange.data.i32[1])) {
+            ALOGE("%s: Requested exposure compensation index is out of "
+                    "bounds: %d", __FUNCTION__,
+                    validatedParams.exposureCompensation);
+            return BAD_VALUE;
+        }
     }
 
     // AUTO_EXPOSURE_LOCK (always supported)
-    validatedParams.autoExposureLock = boolFromString(
-        newParams.get(CameraParameters::KEY_AUTO_EXPOSURE_LOCK));
+    if (keyChanged(changedKeys, CameraParameters::KEY_AUTO_EXPOSURE_LOCK)) {
+        validatedParams.autoExposureLock = boolFromString(
+            newParams.get(CameraParameters::KEY_AUTO_EXPOSURE_LOCK));
+    }
 
     // AUTO_WHITEBALANCE_LOCK (always supported)
-    validatedParams.autoWhiteBalanceLock = boolFromString(
-        newParams.get(CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK));
+    if (keyChanged(changedKeys,
+            CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK)) {
+        validatedParams.autoWhiteBalanceLock = boolFromString(
+            newParams.get(CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK));
+    }
 
     // METERING_AREAS
-    res = parseAreas(newParams.get(CameraParameters::KEY_METERING_AREAS),
-            &validatedParams.meteringAreas);
-    if (res == OK) {
-        res = validateAreas(validatedParams.meteringAreas, max3aRegions,
-                            AREA_KIND_METERING);
-    }
-    if (res != OK) {
-        ALOGE("%s: Requested metering areas are malformed: %s",
-                __FUNCTION__,
-                newParams.get(CameraParameters::KEY_METERING_AREAS));
-        return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_METERING_AREAS)) {
+        res = parseAreas(newParams.get(CameraParameters::KEY_METERING_AREAS),
+                &validatedParams.meteringAreas);
+        if (res == OK) {
+            res = validateAreas(validatedParams.meteringAreas, max3aRegions,
+                                AREA_KIND_METERING);
+        }
+        if (res != OK) {
+            ALOGE("%s: Requested metering areas are malformed: %s",
+                    __FUNCTION__,
+                    newParams.get(CameraParameters::KEY_METERING_AREAS));
+            return BAD_VALUE;
+        }
     }
 
     // ZOOM
-    validatedParams.zoom = newParams.getInt(CameraParameters::KEY_ZOOM);
-    if (validatedParams.zoom < 0
-                || validatedParams.zoom >= (int)NUM_ZOOM_STEPS) {
-        ALOGE("%s: Requested zoom level %d is not supported",
-                __FUNCTION__, validatedParams.zoom);
-        return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_ZOOM)) {
+        validatedParams.zoom = newParams.getInt(CameraParameters::KEY_ZOOM);
+        if (validatedParams.zoom < 0
+                    || validatedParams.zoom >= (int)NUM_ZOOM_STEPS) {
+            ALOGE("%s: Requested zoom level %d is not supported",
+                    __FUNCTION__, validatedParams.zoom);
+            return BAD_VALUE;
+        }
     }
 
     // VIDEO_SIZE
-    newParams.getVideoSize(&validatedParams.videoWidth,
-            &validatedParams.videoHeight);
-    if (validatedParams.videoWidth != videoWidth ||
-            validatedParams.videoHeight != videoHeight) {
-        if (state == RECORD) {
-            ALOGE("%s: Video size cannot be updated when recording is active!",
-                    __FUNCTION__);
-            return BAD_VALUE;
-        }
-        for (i = 0; i < availablePreviewSizes.size(); i++) {
-            if ((availablePreviewSizes[i].width ==
-                    validatedParams.videoWidth) &&
-                (availablePreviewSizes[i].height ==
-                    validatedParams.videoHeight)) break;
-        }
-        if (i == availablePreviewSizes.size()) {
-            ALOGE("%s: Requested video size %d x %d is not supported",
-                    __FUNCTION__, validatedParams.videoWidth,
-                    validatedParams.videoHeight);
-            return BAD_VALUE;
+    if (keyChanged(changedKeys, CameraParameters::KEY_VIDEO_SIZE)) {
+        newParams.getVideoSize(&validatedParams.videoWidth,
+                &validatedParams.videoHeight);
+        if (validatedParams.videoWidth != videoWidth ||
+                validatedParams.videoHeight != videoHeight) {
+            if (state == RECORD) {
+                ALOGE("%s: Video size cannot be updated when recording is "
+                        "active!", __FUNCTION__);
+                return BAD_VALUE;
+            }
+            for (i = 0; i < availablePreviewSizes.size(); i++) {
+                if ((availablePreviewSizes[i].width ==
+                        validatedParams.videoWidth) &&
+                    (availablePreviewSizes[i].height ==
+                        validatedParams.videoHeight)) break;
+            }
+            if (i == availablePreviewSizes.size()) {
+                ALOGE("%s: Requested video size %d x %d is not supported",
+                        __FUNCTION__, validatedParams.videoWidth,
+                        validatedParams.videoHeight);
+                return BAD_VALUE;
+            }
         }
     }
 
     // VIDEO_STABILIZATION
-    validatedParams.videoStabilization = boolFromString(
-        newParams.get(CameraParameters::KEY_VIDEO_STABILIZATION) );
-    camera_metadata_ro_entry_t availableVideoStabilizationModes =
-        staticInfo(ANDROID_CONTROL_AVAILABLE_VIDEO_STABILIZATION_MODES, 0, 0,
-                false);
-    if (validatedParams.videoStabilization &&
-            availableVideoStabilizationModes.count == 1) {
-        ALOGE("%s: Video stabilization not supported", __FUNCTION__);
+    if (keyChanged(changedKeys, CameraParameters::KEY_VIDEO_STABILIZATION)) {
+        validatedParams.videoStabilization = boolFromString(
+            newParams.get(CameraParameters::KEY_VIDEO_STABILIZATION) );
+        camera_metadata_ro_entry_t availableVideoStabilizationModes =
+            staticInfo(ANDROID_CONTROL_AVAILABLE_VIDEO_STABILIZATION_MODES, 0,
+                    0, false);
+        if (validatedParams.videoStabilization &&
+                availableVideoStabilizationModes.count == 1) {
+            ALOGE("%s: Video stabilization not supported", __FUNCTION__);
+        }
     }
 
     // LIGHTFX
-    validatedParams.lightFx = lightFxStringToEnum(
-        newParams.get(CameraParameters::KEY_LIGHTFX));
+    if (keyChanged(changedKeys, CameraParameters::KEY_LIGHTFX)) {
+        validatedParams.lightFx = lightFxStringToEnum(
+            newParams.get(CameraParameters::KEY_LIGHTFX));
+    }
+
+    // RECORDING_FRAME_INTERVAL
+    // Not kept in the parameters, so it's set again each time it's present
+    const char *frameInterval =
+            newParams.get(CameraParameters::KEY_RECORDING_FRAME_INTERVAL);
+    if (frameInterval != NULL) {
+        char *end;
+        validatedParams.recordingFrameIntervalUs =
+                strtoll(frameInterval, &end, 10);
+        if (end == frameInterval || *end != '\0' ||
+                validatedParams.recordingFrameIntervalUs < 0) {
+            ALOGE("%s: Requested recording frame interval %s is invalid",
+                    __FUNCTION__, frameInterval);
+            return BAD_VALUE;
+        }
+        newParams.remove(CameraParameters::KEY_RECORDING_FRAME_INTERVAL);
+    }
 
     /** Update internal parameters */
 
@@ -1768,25 +1896,72 @@ status_t Parameters::set(const String8& paramString) {
     /** Update external parameters calculated from the internal ones */
 
     // HORIZONTAL/VERTICAL FIELD OF VIEW
-    float horizFov, vertFov;
-    res = calculatePictureFovs(&horizFov, &vertFov);
-    if (res != OK) {
-        ALOGE("%s: Can't calculate FOVs", __FUNCTION__);
-        // continue so parameters are at least consistent
+    if (keyChanged(changedKeys, CameraParameters::KEY_PICTURE_SIZE) ||
+            keyChanged(changedKeys, CameraParameters::KEY_PREVIEW_SIZE) ||
+            keyChanged(changedKeys, CameraParameters::KEY_VIDEO_SIZE) ||
+            keyChanged(changedKeys,
+                    CameraParameters::KEY_HORIZONTAL_VIEW_ANGLE) ||
+            keyChanged(changedKeys,
+                    CameraParameters::KEY_VERTICAL_VIEW_ANGLE)) {
+        float horizFov, vertFov;
+        res = calculatePictureFovs(&horizFov, &vertFov);
+        if (res != OK) {
+            ALOGE("%s: Can't calculate FOVs", __FUNCTION__);
+            // continue so parameters are at least consistent
+        }
+        newParams.setFloat(CameraParameters::KEY_HORIZONTAL_VIEW_ANGLE,
+                horizFov);
+        newParams.setFloat(CameraParameters::KEY_VERTICAL_VIEW_ANGLE,
+                vertFov);
+        ALOGV("Current still picture FOV: %f x %f deg", horizFov, vertFov);
     }
-    newParams.setFloat(CameraParameters::KEY_HORIZONTAL_VIEW_ANGLE,
-            horizFov);
-    newParams.setFloat(CameraParameters::KEY_VERTICAL_VIEW_ANGLE,
-            vertFov);
-    ALOGV("Current still picture FOV: %f x %f deg", horizFov, vertFov);
 
     // Need to flatten again in case of overrides
     paramsFlattened = newParams.flatten();
     params = newParams;
 
+    if (requestChanged != NULL) {
+        // JPEG and GPS settings only go into still capture requests, which
+        // are built when a picture is taken. The recording frame interval is
+        // applied to recording frames as they come back.
+        *requestChanged = fpsChanged || focusModeOverridden;
+        for (i = 0; i < changedKeys.size() && !*requestChanged; i++) {
+            *requestChanged = !isJpegKey(changedKeys[i]) &&
+                    changedKeys[i] !=
+                        CameraParameters::KEY_RECORDING_FRAME_INTERVAL;
+        }
+    }
+
     return OK;
 }
 
+bool Parameters::keyChanged(const Vector<String8> &changedKeys,
+        const char *key) {
+    for (size_t i = 0; i < changedKeys.size(); i++) {
+        if (changedKeys[i] == key) return true;
+    }
+    return false;
+}
+
+bool Parameters::isJpegKey(const String8 &key) {
+    static const char *kJpegKeys[] = {
+        CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH,
+        CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT,
+        CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY,
+        CameraParameters::KEY_JPEG_QUALITY,
+        CameraParameters::KEY_ROTATION,
+        CameraParameters::KEY_GPS_LATITUDE,
+        CameraParameters::KEY_GPS_LONGITUDE,
+        CameraParameters::KEY_GPS_ALTITUDE,
+        CameraParameters::KEY_GPS_TIMESTAMP,
+        CameraParameters::KEY_GPS_PROCESSING_METHOD,
+    };
+    for (size_t i = 0; i < sizeof(kJpegKeys) / sizeof(kJpegKeys[0]); i++) {
+        if (key == kJpegKeys[i]) return true;
+    }
+    return false;
+}
+
 status_t Parameters::updateRequest(CameraMetadata *request) const {
     ATRACE_CALL();
     status_t res;
@@ -123,6 +123,10 @@ struct Parameters {
     bool recordingHint;
     bool videoStabilization;
 
+    // Recording frames arriving sooner than this after the last one sent to
+    // the client are dropped; 0 sends them all
+    int64_t recordingFrameIntervalUs;
+
     enum lightFxMode_t {
         LIGHTFX_NONE = 0,
         LIGHTFX_LOWLIGHT,
@@ -233,8 +237,11 @@ struct Parameters {
     camera_metadata_ro_entry_t staticInfo(uint32_t tag,
             size_t minCount=0, size_t maxCount=0, bool required=true) const;
 
-    // Validate and update camera parameters based on new settings
-    status_t set(const String8 &paramString);
+    // Validate and update camera parameters based on new settings. Only the
+    // keys that differ from the current settings are parsed and validated.
+    // If requestChanged isn't NULL, it's set to whether the preview and
+    // recording requests need to be updated.
+    status_t set(const String8 &paramString, bool *requestChanged = NULL);
 
     // Retrieve the current settings
     String8 get() const;
@@ -333,6 +340,12 @@ private:
     int normalizedXToCrop(int x) const;
     int normalizedYToCrop(int y) const;
 
+    // Whether key is one of the keys set() found to have changed
+    static bool keyChanged(const Vector<String8> &changedKeys,
+            const char *key);
+    // Whether key only matters for still capture requests
+    static bool isJpegKey(const String8 &key);
+
     Vector<Size> availablePreviewSizes;
     // Get size list (that are no larger than limit) from static metadata.
     status_t getFilteredPreviewSizes(Size limit, Vector<Size> *sizes);
@@ -48,6 +48,7 @@ StreamingProcessor::StreamingProcessor(sp<Camera2Client> client):
         mPreviewStreamId(NO_STREAM),
         mRecordingRequestId(Camera2Client::kRecordingRequestIdStart),
         mRecordingStreamId(NO_STREAM),
+        mLastRecordingFrameTimestamp(0),
         mRecordingFrameAvailable(false),
         mRecordingHeapCount(kDefaultRecordingHeapCount),
         mRecordingHeapFree(kDefaultRecordingHeapCount)
@@ -433,6 +434,7 @@ status_t StreamingProcessor::startStream(StreamType type,
     // There should never be any, so if there are, warn about it.
     if (isStreamActive(outputStreams, mRecordingStreamId)) {
         releaseAllRecordingFramesLocked();
+        mLastRecordingFrameTimestamp = 0;
     }
 
     ALOGV("%s: Camera %d: %s started, recording heap has %d free of %d",
@@ -656,6 +658,18 @@ status_t StreamingProcessor::processRecordingFrame() {
             return INVALID_OPERATION;
         }
 
+        // Time lapse recording only keeps a frame every so often; drop the
+        // others here instead of sending them all to the client
+        if (l.mParameters.recordingFrameIntervalUs > 0 &&
+                mLastRecordingFrameTimestamp != 0 &&
+                timestamp - mLastRecordingFrameTimestamp <
+                    us2ns(l.mParameters.recordingFrameIntervalUs)) {
+            ALOGVV("%s: Camera %d: Skipping recording frame at %lld",
+                    __FUNCTION__, mId, timestamp);
+            mRecordingConsumer->releaseBuffer(imgBuffer);
+            return OK;
+        }
+
         if (mRecordingHeap == 0) {
             const size_t bufferSize = 4 + sizeof(buffer_handle_t);
             ALOGV("%s: Camera %d: Creating recording heap with %d buffers of "
@@ -692,6 +706,7 @@ status_t StreamingProcessor::processRecordingFrame() {
             return NO_MEMORY;
         }
 
+        mLastRecordingFrameTimestamp = timestamp;
         heapIdx = mRecordingHeapHead;
         mRecordingHeapHead = (mRecordingHeapHead + 1) % mRecordingHeapCount;
         mRecordingHeapFree--;
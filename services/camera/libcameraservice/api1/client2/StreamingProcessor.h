@@ -111,6 +111,9 @@ class StreamingProcessor:
     int32_t mRecordingRequestId;
     int mRecordingStreamId;
     int mRecordingFrameCount;
+    // Timestamp of the last recording frame sent to the client, for
+    // Parameters::recordingFrameIntervalUs
+    nsecs_t mLastRecordingFrameTimestamp;
     sp<BufferItemConsumer> mRecordingConsumer;
     sp<ANativeWindow>  mRecordingWindow;
     CameraMetadata mRecordingRequest;
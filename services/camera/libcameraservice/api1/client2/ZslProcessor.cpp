@@ -49,11 +49,11 @@ ZslProcessor::ZslProcessor(
         mZslBufferAvailable(false),
         mZslStreamId(NO_STREAM),
         mZslReprocessStreamId(NO_STREAM),
-        mFrameListHead(0),
         mZslQueueHead(0),
         mZslQueueTail(0) {
     mZslQueue.insertAt(0, kZslBufferDepth);
-    mFrameList.insertAt(0, kFrameListDepth);
+    mFrameList.setCapacity(kFrameListDepth);
+    mUnmatchedBuffers.setCapacity(kZslBufferDepth);
     sp<CaptureSequencer> captureSequencer = mSequencer.promote();
     if (captureSequencer != 0) captureSequencer->setZslProcessor(this);
 }
@@ -71,21 +71,35 @@ void ZslProcessor::onFrameAvailable() {
     }
 }
 
-void ZslProcessor::onFrameAvailable(int32_t /*requestId*/,
-        const CameraMetadata &frame) {
+void ZslProcessor::onResultAvailable(int32_t /*requestId*/,
+        const sp<CaptureResult> &result) {
     Mutex::Autolock l(mInputMutex);
     camera_metadata_ro_entry_t entry;
-    entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
+    entry = result->metadata().find(ANDROID_SENSOR_TIMESTAMP);
+    if (entry.count == 0) {
+        ALOGE("%s: Can't find timestamp in frame!", __FUNCTION__);
+        return;
+    }
     nsecs_t timestamp = entry.data.i64[0];
-    (void)timestamp;
     ALOGVV("Got preview frame for timestamp %lld", timestamp);
 
     if (mState != RUNNING) return;
 
-    mFrameList.editItemAt(mFrameListHead) = frame;
-    mFrameListHead = (mFrameListHead + 1) % kFrameListDepth;
+    ssize_t match = findMatch(mUnmatchedBuffers, timestamp);
+    if (match >= 0) {
+        ALOGVV("%s: Found match for buffer %lld", __FUNCTION__,
+                mUnmatchedBuffers.keyAt(match));
+        mZslQueue.editItemAt(mUnmatchedBuffers.valueAt(match)).frame = result;
+        mUnmatchedBuffers.removeItemsAt(match);
+        return;
+    }
 
-    findMatchesLocked();
+    // No buffer for it yet; keep it around, forgetting the oldest frame
+    // if the list is full
+    if (mFrameList.size() >= kFrameListDepth) {
+        mFrameList.removeItemsAt(0);
+    }
+    mFrameList.add(timestamp, result);
 }
 
 void ZslProcessor::onBufferReleased(buffer_handle_t *handle) {
@@ -267,8 +281,8 @@ status_t ZslProcessor::pushToReprocess(int32_t requestId) {
         CameraMetadata request;
         size_t index = mZslQueueTail;
         while (index != mZslQueueHead) {
-            if (!mZslQueue[index].frame.isEmpty()) {
-                request = mZslQueue[index].frame;
+            if (mZslQueue[index].frame != 0) {
+                request = mZslQueue[index].frame->metadata();
                 break;
             }
             index = (index + 1) % kZslBufferDepth;
@@ -378,6 +392,7 @@ status_t ZslProcessor::clearZslQueueLocked() {
     }
     mZslQueueHead = 0;
     mZslQueueTail = 0;
+    mUnmatchedBuffers.clear();
     return OK;
 }
 
@@ -449,7 +464,11 @@ status_t ZslProcessor::processNewZslBuffer() {
 
     if ( (mZslQueueHead + 1) % kZslBufferDepth == mZslQueueTail) {
         ALOGVV("Releasing oldest buffer");
-        zslConsumer->releaseBuffer(mZslQueue[mZslQueueTail].buffer);
+        const ZslPair &queueTail = mZslQueue[mZslQueueTail];
+        if (queueTail.frame == 0) {
+            mUnmatchedBuffers.removeItem(queueTail.buffer.mTimestamp);
+        }
+        zslConsumer->releaseBuffer(queueTail.buffer);
         mZslQueue.replaceAt(mZslQueueTail);
         mZslQueueTail = (mZslQueueTail + 1) % kZslBufferDepth;
     }
@@ -457,66 +476,51 @@ status_t ZslProcessor::processNewZslBuffer() {
     ZslPair &queueHead = mZslQueue.editItemAt(mZslQueueHead);
 
     queueHead.buffer = item;
-    queueHead.frame.release();
+    queueHead.frame.clear();
+
+    ssize_t match = findMatch(mFrameList, item.mTimestamp);
+    if (match >= 0) {
+        ALOGVV("%s: Found match for buffer %lld: frame %lld", __FUNCTION__,
+                item.mTimestamp, mFrameList.keyAt(match));
+        queueHead.frame = mFrameList.valueAt(match);
+        mFrameList.removeItemsAt(match);
+    } else {
+        mUnmatchedBuffers.add(item.mTimestamp, mZslQueueHead);
+    }
 
     mZslQueueHead = (mZslQueueHead + 1) % kZslBufferDepth;
 
     ALOGVV("  Acquired buffer, timestamp %lld", queueHead.buffer.mTimestamp);
 
-    findMatchesLocked();
-
     return OK;
 }
 
-void ZslProcessor::findMatchesLocked() {
-    ALOGVV("Scanning");
-    for (size_t i = 0; i < mZslQueue.size(); i++) {
-        ZslPair &queueEntry = mZslQueue.editItemAt(i);
-        nsecs_t bufferTimestamp = queueEntry.buffer.mTimestamp;
-        IF_ALOGV() {
-            camera_metadata_entry_t entry;
-            nsecs_t frameTimestamp = 0;
-            if (!queueEntry.frame.isEmpty()) {
-                entry = queueEntry.frame.find(ANDROID_SENSOR_TIMESTAMP);
-                frameTimestamp = entry.data.i64[0];
-            }
-            ALOGVV("   %d: b: %lld\tf: %lld", i,
-                    bufferTimestamp, frameTimestamp );
-        }
-        if (queueEntry.frame.isEmpty() && bufferTimestamp != 0) {
-            // Have buffer, no matching frame. Look for one
-            for (size_t j = 0; j < mFrameList.size(); j++) {
-                bool match = false;
-                CameraMetadata &frame = mFrameList.editItemAt(j);
-                if (!frame.isEmpty()) {
-                    camera_metadata_entry_t entry;
-                    entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
-                    if (entry.count == 0) {
-                        ALOGE("%s: Can't find timestamp in frame!",
-                                __FUNCTION__);
-                        continue;
-                    }
-                    nsecs_t frameTimestamp = entry.data.i64[0];
-                    if (bufferTimestamp == frameTimestamp) {
-                        ALOGVV("%s: Found match %lld", __FUNCTION__,
-                                frameTimestamp);
-                        match = true;
-                    } else {
-                        int64_t delta = abs(bufferTimestamp - frameTimestamp);
-                        if ( delta < 1000000) {
-                            ALOGVV("%s: Found close match %lld (delta %lld)",
-                                    __FUNCTION__, bufferTimestamp, delta);
-                            match = true;
-                        }
-                    }
-                }
-                if (match) {
-                    queueEntry.frame.acquire(frame);
-                    break;
-                }
-            }
+template <typename T>
+ssize_t ZslProcessor::findMatch(const KeyedVector<nsecs_t, T> &list,
+        nsecs_t timestamp) {
+    // Find the first key no earlier than the timestamp; the closest key is
+    // either that one or the one just before it
+    size_t low = 0;
+    size_t high = list.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (list.keyAt(mid) < timestamp) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
+
+    ssize_t match = NAME_NOT_FOUND;
+    nsecs_t matchDelta = kMatchTolerance;
+    if (low < list.size() && list.keyAt(low) - timestamp < matchDelta) {
+        match = low;
+        matchDelta = list.keyAt(low) - timestamp;
+    }
+    if (low > 0 && timestamp - list.keyAt(low - 1) < matchDelta) {
+        match = low - 1;
+    }
+    return match;
 }
 
 void ZslProcessor::dumpZslQueue(int fd) const {
@@ -533,10 +537,11 @@ void ZslProcessor::dumpZslQueue(int fd) const {
         camera_metadata_ro_entry_t entry;
         nsecs_t frameTimestamp = 0;
         int frameAeState = -1;
-        if (!queueEntry.frame.isEmpty()) {
-            entry = queueEntry.frame.find(ANDROID_SENSOR_TIMESTAMP);
+        if (queueEntry.frame != 0) {
+            const CameraMetadata &frame = queueEntry.frame->metadata();
+            entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
             if (entry.count > 0) frameTimestamp = entry.data.i64[0];
-            entry = queueEntry.frame.find(ANDROID_CONTROL_AE_STATE);
+            entry = frame.find(ANDROID_CONTROL_AE_STATE);
             if (entry.count > 0) frameAeState = entry.data.u8[0];
         }
         String8 result =
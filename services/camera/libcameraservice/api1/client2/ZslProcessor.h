@@ -20,6 +20,7 @@
 #include <utils/Thread.h>
 #include <utils/String16.h>
 #include <utils/Vector.h>
+#include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/Condition.h>
 #include <gui/BufferItemConsumer.h>
@@ -54,7 +55,8 @@ class ZslProcessor:
     // From mZslConsumer
     virtual void onFrameAvailable();
     // From FrameProcessor
-    virtual void onFrameAvailable(int32_t requestId, const CameraMetadata &frame);
+    virtual void onResultAvailable(int32_t requestId,
+            const sp<CaptureResult> &result);
 
     virtual void onBufferReleased(buffer_handle_t *handle);
 
@@ -100,19 +102,25 @@ class ZslProcessor:
 
     struct ZslPair {
         BufferItemConsumer::BufferItem buffer;
-        CameraMetadata frame;
+        sp<CaptureResult> frame;
     };
 
     static const size_t kZslBufferDepth = 4;
     static const size_t kFrameListDepth = kZslBufferDepth * 2;
-    Vector<CameraMetadata> mFrameList;
-    size_t mFrameListHead;
+    // Largest difference between a buffer and a frame timestamp that still
+    // counts as a match
+    static const nsecs_t kMatchTolerance = 1000000; // 1 ms
+
+    // Frames not yet matched with a ZSL buffer, by sensor timestamp
+    KeyedVector<nsecs_t, sp<CaptureResult> > mFrameList;
 
     ZslPair mNextPair;
 
     Vector<ZslPair> mZslQueue;
     size_t mZslQueueHead;
     size_t mZslQueueTail;
+    // ZSL queue entries still waiting for their frame, by buffer timestamp
+    KeyedVector<nsecs_t, size_t> mUnmatchedBuffers;
 
     CameraMetadata mLatestCapturedRequest;
 
@@ -120,8 +128,11 @@ class ZslProcessor:
 
     status_t processNewZslBuffer();
 
-    // Match up entries from frame list to buffers in ZSL queue
-    void findMatchesLocked();
+    // Index of the key in the list closest to the timestamp, if within
+    // kMatchTolerance of it, or NAME_NOT_FOUND
+    template <typename T>
+    static ssize_t findMatch(const KeyedVector<nsecs_t, T> &list,
+            nsecs_t timestamp);
 
     status_t clearZslQueueLocked();
 
@@ -61,18 +61,24 @@ ZslProcessor3::~ZslProcessor3() {
     deleteStream();
 }
 
-void ZslProcessor3::onFrameAvailable(int32_t /*requestId*/,
-                                     const CameraMetadata &frame) {
+void ZslProcessor3::onResultAvailable(int32_t /*requestId*/,
+                                      const sp<CaptureResult> &result) {
     Mutex::Autolock l(mInputMutex);
     camera_metadata_ro_entry_t entry;
-    entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
+    entry = result->metadata().find(ANDROID_SENSOR_TIMESTAMP);
+    if (entry.count == 0) {
+        ALOGE("%s: Can't find timestamp in frame!", __FUNCTION__);
+        return;
+    }
     nsecs_t timestamp = entry.data.i64[0];
-    (void)timestamp;
     ALOGVV("Got preview metadata for timestamp %lld", timestamp);
 
     if (mState != RUNNING) return;
 
-    mFrameList.editItemAt(mFrameListHead) = frame;
+    ZslFrame &frame = mFrameList.editItemAt(mFrameListHead);
+    frame.result = result;
+    frame.timestamp = timestamp;
+    frame.score = scoreFrame(result->metadata());
     mFrameListHead = (mFrameListHead + 1) % kFrameListDepth;
 }
 
@@ -226,7 +232,7 @@ status_t ZslProcessor3::pushToReprocess(int32_t requestId) {
     }
 
     {
-        CameraMetadata request = mFrameList[metadataIdx];
+        CameraMetadata request = mFrameList[metadataIdx].result->metadata();
 
         // Verify that the frame is reasonable for reprocessing
 
@@ -366,56 +372,72 @@ void ZslProcessor3::dumpZslQueue(int fd) const {
     }
 }
 
+int ZslProcessor3::scoreFrame(const CameraMetadata &frame) {
+    camera_metadata_ro_entry_t entry;
+    entry = frame.find(ANDROID_CONTROL_AE_STATE);
+    if (entry.count == 0) {
+        /**
+         * This is most likely a HAL bug. The aeState field is
+         * mandatory, so it should always be in a metadata packet.
+         */
+        ALOGW("%s: ZSL queue frame has no AE state field!",
+                __FUNCTION__);
+        return -1;
+    }
+    if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
+            entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
+        ALOGVV("%s: ZSL queue frame AE state is %d, need "
+               "full capture",  __FUNCTION__, entry.data.u8[0]);
+        return -1;
+    }
+
+    /**
+     * There's no sharpness in the metadata, so go by what's known to blur a
+     * frame: focus still being searched for, and the lens moving.
+     */
+    int score = 0;
+    entry = frame.find(ANDROID_CONTROL_AF_STATE);
+    if (entry.count > 0 &&
+            (entry.data.u8[0] == ANDROID_CONTROL_AF_STATE_FOCUSED_LOCKED ||
+             entry.data.u8[0] == ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED)) {
+        score += 2;
+    }
+    entry = frame.find(ANDROID_LENS_STATE);
+    if (entry.count > 0 &&
+            entry.data.u8[0] == ANDROID_LENS_STATE_STATIONARY) {
+        score += 1;
+    }
+    return score;
+}
+
 nsecs_t ZslProcessor3::getCandidateTimestampLocked(size_t* metadataIdx) const {
     /**
-     * Find the smallest timestamp we know about so far
-     * - ensure that aeState is either converged or locked
+     * Find the frame with the best score, taking the oldest of equally
+     * good ones. Frames that AE hadn't converged for never qualify.
      */
 
     size_t idx = 0;
-    nsecs_t minTimestamp = -1;
+    nsecs_t bestTimestamp = -1;
+    int bestScore = -1;
 
     size_t emptyCount = mFrameList.size();
 
     for (size_t j = 0; j < mFrameList.size(); j++) {
-        const CameraMetadata &frame = mFrameList[j];
-        if (!frame.isEmpty()) {
+        const ZslFrame &frame = mFrameList[j];
+        if (frame.result == 0) continue;
 
-            emptyCount--;
+        emptyCount--;
 
-            camera_metadata_ro_entry_t entry;
-            entry = frame.find(ANDROID_SENSOR_TIMESTAMP);
-            if (entry.count == 0) {
-                ALOGE("%s: Can't find timestamp in frame!",
-                        __FUNCTION__);
-                continue;
-            }
-            nsecs_t frameTimestamp = entry.data.i64[0];
-            if (minTimestamp > frameTimestamp || minTimestamp == -1) {
-
-                entry = frame.find(ANDROID_CONTROL_AE_STATE);
-
-                if (entry.count == 0) {
-                    /**
-                     * This is most likely a HAL bug. The aeState field is
-                     * mandatory, so it should always be in a metadata packet.
-                     */
-                    ALOGW("%s: ZSL queue frame has no AE state field!",
-                            __FUNCTION__);
-                    continue;
-                }
-                if (entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_CONVERGED &&
-                        entry.data.u8[0] != ANDROID_CONTROL_AE_STATE_LOCKED) {
-                    ALOGVV("%s: ZSL queue frame AE state is %d, need "
-                           "full capture",  __FUNCTION__, entry.data.u8[0]);
-                    continue;
-                }
-
-                minTimestamp = frameTimestamp;
-                idx = j;
-            }
+        ALOGVV("%s: Saw timestamp %lld, score %d", __FUNCTION__,
+                frame.timestamp, frame.score);
 
-            ALOGVV("%s: Saw timestamp %lld", __FUNCTION__, frameTimestamp);
+        if (frame.score < 0) continue;
+        if (frame.score > bestScore ||
+                (frame.score == bestScore &&
+                 frame.timestamp < bestTimestamp)) {
+            bestScore = frame.score;
+            bestTimestamp = frame.timestamp;
+            idx = j;
         }
     }
 
@@ -435,14 +457,14 @@ nsecs_t ZslProcessor3::getCandidateTimestampLocked(size_t* metadataIdx) const {
         ALOGW("%s: ZSL queue has no metadata frames", __FUNCTION__);
     }
 
-    ALOGV("%s: Candidate timestamp %lld (idx %d), empty frames: %d",
-          __FUNCTION__, minTimestamp, idx, emptyCount);
+    ALOGV("%s: Candidate timestamp %lld (idx %d, score %d), empty frames: %d",
+          __FUNCTION__, bestTimestamp, idx, bestScore, emptyCount);
 
     if (metadataIdx) {
         *metadataIdx = idx;
     }
 
-    return minTimestamp;
+    return bestTimestamp;
 }
 
 void ZslProcessor3::onBufferAcquired(const BufferInfo& /*bufferInfo*/) {
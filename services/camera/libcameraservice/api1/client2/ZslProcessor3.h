@@ -51,7 +51,8 @@ class ZslProcessor3 :
     ~ZslProcessor3();
 
     // From FrameProcessor
-    virtual void onFrameAvailable(int32_t requestId, const CameraMetadata &frame);
+    virtual void onResultAvailable(int32_t requestId,
+            const sp<CaptureResult> &result);
 
     /**
      ****************************************
@@ -109,7 +110,18 @@ class ZslProcessor3 :
 
     static const size_t kZslBufferDepth = 4;
     static const size_t kFrameListDepth = kZslBufferDepth * 2;
-    Vector<CameraMetadata> mFrameList;
+
+    // A frame from the frame processor, with what candidate selection needs
+    // read out of its metadata once on arrival
+    struct ZslFrame {
+        sp<CaptureResult> result;
+        nsecs_t timestamp;
+        // How good a reprocessing candidate the frame is, see scoreFrame()
+        int score;
+
+        ZslFrame() : timestamp(-1), score(-1) {}
+    };
+    Vector<ZslFrame> mFrameList;
     size_t mFrameListHead;
 
     ZslPair mNextPair;
@@ -126,6 +138,11 @@ class ZslProcessor3 :
 
     void dumpZslQueue(int id) const;
 
+    // Negative if the frame can't be reprocessed (AE not converged),
+    // otherwise higher for frames that are more likely to be sharp
+    static int scoreFrame(const CameraMetadata &frame);
+
+    // Timestamp of the best frame to reprocess, or -1 if there's none
     nsecs_t getCandidateTimestampLocked(size_t* metadataIdx) const;
 };
 
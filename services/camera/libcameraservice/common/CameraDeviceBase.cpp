@@ -27,4 +27,13 @@ CameraDeviceBase::~CameraDeviceBase() {
 CameraDeviceBase::NotificationListener::~NotificationListener() {
 }
 
+status_t CameraDeviceBase::getNextResult(sp<CaptureResult> *result) {
+    CameraMetadata frame;
+    status_t res = getNextFrame(&frame);
+    if (res != OK) return res;
+
+    *result = new CaptureResult(frame);
+    return OK;
+}
+
 } // namespace android
@@ -25,6 +25,7 @@
 
 #include "hardware/camera2.h"
 #include "camera/CameraMetadata.h"
+#include "common/CaptureResult.h"
 
 namespace android {
 
@@ -185,6 +186,13 @@ class CameraDeviceBase : public virtual RefBase {
      */
     virtual status_t getNextFrame(CameraMetadata *frame) = 0;
 
+    /**
+     * Like getNextFrame, but returns the result shared instead of handing over
+     * the metadata buffer. The default implementation wraps getNextFrame.
+     * May be called concurrently to most methods, except for waitForNextFrame
+     */
+    virtual status_t getNextResult(sp<CaptureResult> *result);
+
     /**
      * Trigger auto-focus. The latest ID used in a trigger autofocus or cancel
      * autofocus call will be returned by the HAL in all subsequent AF
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_CAPTURERESULT_H
+#define ANDROID_SERVERS_CAMERA_CAPTURERESULT_H
+
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <camera/CameraMetadata.h>
+
+namespace android {
+
+/**
+ * Result metadata for one capture. Immutable once queued by the device, so
+ * the frame processor and all of its listeners can hold on to the same
+ * instance instead of copying the metadata.
+ */
+class CaptureResult : public LightRefBase<CaptureResult> {
+  public:
+    // Takes over the contents of metadata, leaving it empty
+    CaptureResult(CameraMetadata &metadata,
+            nsecs_t requestTime = 0, nsecs_t resultTime = 0) :
+            mRequestTime(requestTime),
+            mResultTime(resultTime) {
+        mMetadata.acquire(metadata);
+    }
+
+    const CameraMetadata& metadata() const { return mMetadata; }
+
+    // When the request was submitted to the HAL, and when its result metadata
+    // was complete. 0 if unknown.
+    nsecs_t requestTime() const { return mRequestTime; }
+    nsecs_t resultTime() const { return mResultTime; }
+
+  private:
+    CameraMetadata mMetadata;
+    const nsecs_t  mRequestTime;
+    const nsecs_t  mResultTime;
+};
+
+/**
+ * Running statistics for one stage of the capture pipeline. Not thread-safe.
+ */
+struct CaptureLatency {
+    size_t  count;
+    nsecs_t total;
+    nsecs_t max;
+    nsecs_t last;
+
+    CaptureLatency() :
+            count(0),
+            total(0),
+            max(0),
+            last(0) {
+    }
+
+    void add(nsecs_t latency) {
+        count++;
+        total += latency;
+        last = latency;
+        if (latency > max) max = latency;
+    }
+
+    void appendTo(String8 *lines, const char *name) const {
+        if (count == 0) {
+            lines->appendFormat("      %s: no samples\n", name);
+            return;
+        }
+        lines->appendFormat("      %s: %d samples, last %lld us, "
+                "average %lld us, max %lld us\n", name, count,
+                ns2us(last), ns2us(total / count), ns2us(max));
+    }
+};
+
+}; // namespace android
+
+#endif
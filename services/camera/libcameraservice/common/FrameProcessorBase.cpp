@@ -23,6 +23,7 @@
 
 #include "common/FrameProcessorBase.h"
 #include "common/CameraDeviceBase.h"
+#include "utils/CameraTraces.h"
 
 namespace android {
 namespace camera2 {
@@ -64,16 +65,22 @@ status_t FrameProcessorBase::removeListener(int32_t minId,
 }
 
 void FrameProcessorBase::dump(int fd, const Vector<String16>& /*args*/) {
-    String8 result("    Latest received frame:\n");
-    write(fd, result.string(), result.size());
+    String8 result("    Frame dispatch latency:\n");
 
-    CameraMetadata lastFrame;
+    sp<CaptureResult> lastFrame;
     {
-        // Don't race while dumping metadata
         Mutex::Autolock al(mLastFrameMutex);
-        lastFrame = CameraMetadata(mLastFrame);
+        mDispatchLatency.appendTo(&result, "HAL result to listeners done");
+        lastFrame = mLastFrame;
+    }
+
+    result.append("    Latest received frame:\n");
+    write(fd, result.string(), result.size());
+
+    // The result is immutable, so no need to hold the lock while dumping
+    if (lastFrame != 0) {
+        lastFrame->metadata().dump(fd, 2, 6);
     }
-    lastFrame.dump(fd, 2, 6);
 }
 
 bool FrameProcessorBase::threadLoop() {
@@ -99,13 +106,14 @@ bool FrameProcessorBase::threadLoop() {
 void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
     status_t res;
     ATRACE_CALL();
-    CameraMetadata frame;
+    sp<CaptureResult> result;
 
     ALOGV("%s: Camera %d: Process new frames", __FUNCTION__, device->getId());
 
-    while ( (res = device->getNextFrame(&frame)) == OK) {
+    while ( (res = device->getNextResult(&result)) == OK) {
 
-        camera_metadata_entry_t entry;
+        const CameraMetadata &frame = result->metadata();
+        camera_metadata_ro_entry_t entry;
 
         entry = frame.find(ANDROID_REQUEST_FRAME_COUNT);
         if (entry.count == 0) {
@@ -115,13 +123,21 @@ void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
         }
         ATRACE_INT("cam2_frame", entry.data.i32[0]);
 
-        if (!processSingleFrame(frame, device)) {
+        if (!processSingleFrame(result, device)) {
             break;
         }
+        camera3::CameraTraces::logFrameEvent(device->getId(),
+                camera3::CameraTraces::FRAME_RESULT_DELIVERED,
+                entry.data.i32[0]);
 
-        if (!frame.isEmpty()) {
+        {
             Mutex::Autolock al(mLastFrameMutex);
-            mLastFrame.acquire(frame);
+            if (result->resultTime() != 0) {
+                mDispatchLatency.add(systemTime() - result->resultTime());
+            }
+            if (!frame.isEmpty()) {
+                mLastFrame = result;
+            }
         }
     }
     if (res != NOT_ENOUGH_DATA) {
@@ -133,16 +149,17 @@ void FrameProcessorBase::processNewFrames(const sp<CameraDeviceBase> &device) {
     return;
 }
 
-bool FrameProcessorBase::processSingleFrame(CameraMetadata &frame,
+bool FrameProcessorBase::processSingleFrame(const sp<CaptureResult> &result,
                                            const sp<CameraDeviceBase> &device) {
     ALOGV("%s: Camera %d: Process single frame (is empty? %d)",
-          __FUNCTION__, device->getId(), frame.isEmpty());
-    return processListeners(frame, device) == OK;
+          __FUNCTION__, device->getId(), result->metadata().isEmpty());
+    return processListeners(result, device) == OK;
 }
 
-status_t FrameProcessorBase::processListeners(const CameraMetadata &frame,
+status_t FrameProcessorBase::processListeners(const sp<CaptureResult> &result,
         const sp<CameraDeviceBase> &device) {
     ATRACE_CALL();
+    const CameraMetadata &frame = result->metadata();
     camera_metadata_ro_entry_t entry;
 
     // Quirks: Don't deliver partial results to listeners that don't want them
@@ -186,7 +203,7 @@ status_t FrameProcessorBase::processListeners(const CameraMetadata &frame,
     ALOGV("Got %d range listeners out of %d", listeners.size(), mRangeListeners.size());
     List<sp<FilteredListener> >::iterator item = listeners.begin();
     for (; item != listeners.end(); item++) {
-        (*item)->onFrameAvailable(requestId, frame);
+        (*item)->onResultAvailable(requestId, result);
     }
     return OK;
 }
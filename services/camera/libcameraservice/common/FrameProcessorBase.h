@@ -24,6 +24,8 @@
 #include <utils/List.h>
 #include <camera/CameraMetadata.h>
 
+#include "common/CaptureResult.h"
+
 namespace android {
 
 class CameraDeviceBase;
@@ -39,8 +41,16 @@ class FrameProcessorBase: public Thread {
     virtual ~FrameProcessorBase();
 
     struct FilteredListener: virtual public RefBase {
-        virtual void onFrameAvailable(int32_t requestId,
-                                      const CameraMetadata &frame) = 0;
+        virtual void onFrameAvailable(int32_t /*requestId*/,
+                                      const CameraMetadata &/*frame*/) {}
+
+        // The result is shared with the other listeners and must not be
+        // modified. Listeners that keep frames around should override this
+        // and hold on to the result instead of copying its metadata.
+        virtual void onResultAvailable(int32_t requestId,
+                                       const sp<CaptureResult> &result) {
+            onFrameAvailable(requestId, result->metadata());
+        }
     };
 
     // Register a listener for a range of IDs [minId, maxId). Multiple listeners
@@ -72,13 +82,16 @@ class FrameProcessorBase: public Thread {
 
     void processNewFrames(const sp<CameraDeviceBase> &device);
 
-    virtual bool processSingleFrame(CameraMetadata &frame,
+    virtual bool processSingleFrame(const sp<CaptureResult> &result,
                                     const sp<CameraDeviceBase> &device);
 
-    status_t processListeners(const CameraMetadata &frame,
+    status_t processListeners(const sp<CaptureResult> &result,
                               const sp<CameraDeviceBase> &device);
 
-    CameraMetadata mLastFrame;
+    // Guarded by mLastFrameMutex
+    sp<CaptureResult> mLastFrame;
+    // Time from the HAL result until all listeners have seen it
+    CaptureLatency mDispatchLatency;
 };
 
 
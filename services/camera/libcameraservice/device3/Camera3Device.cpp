@@ -15,6 +15,7 @@
  */
 
 #define LOG_TAG "Camera3-Device"
+#define __STDC_LIMIT_MACROS
 #define ATRACE_TAG ATRACE_TAG_CAMERA
 //#define LOG_NDEBUG 0
 //#define LOG_NNDEBUG 0  // Per-frame verbose logging
@@ -56,6 +57,8 @@ Camera3Device::Camera3Device(int id):
         mHal3Device(NULL),
         mStatus(STATUS_UNINITIALIZED),
         mUsePartialResultQuirk(false),
+        mInFlightCount(0),
+        mInFlightMaxCount(0),
         mNextResultFrameNumber(0),
         mNextShutterFrameNumber(0),
         mListener(NULL)
@@ -276,6 +279,9 @@ status_t Camera3Device::disconnect() {
         mStatus = STATUS_UNINITIALIZED;
     }
 
+    // The HAL is closed, so nothing in flight will come back
+    clearInFlight(UINT32_MAX);
+
     ALOGV("%s: X", __FUNCTION__);
     return res;
 }
@@ -340,17 +346,25 @@ status_t Camera3Device::dump(int fd, const Vector<String16> &args) {
     }
 
     lines = String8("    In-flight requests:\n");
-    if (mInFlightMap.size() == 0) {
+    if (mInFlightCount == 0) {
         lines.append("      None\n");
     } else {
-        for (size_t i = 0; i < mInFlightMap.size(); i++) {
-            InFlightRequest r = mInFlightMap.valueAt(i);
+        for (size_t i = 0; i < kInFlightRingSize; i++) {
+            const InFlightRequest &r = mInFlightRing[i];
+            if (!r.inUse) continue;
             lines.appendFormat("      Frame %d |  Timestamp: %lld, metadata"
-                    " arrived: %s, buffers left: %d\n", mInFlightMap.keyAt(i),
+                    " arrived: %s, buffers left: %d\n", r.frameNumber,
                     r.captureTimestamp, r.haveResultMetadata ? "true" : "false",
                     r.numBuffersLeft);
         }
     }
+    lines.appendFormat("      Most in flight at once: %d\n",
+            mInFlightMaxCount);
+    lines.append("    Capture latency:\n");
+    mResultLatency.appendTo(&lines, "Request submitted to result metadata");
+    if (mRequestThread != NULL) {
+        mRequestThread->dumpStats(&lines);
+    }
     write(fd, lines.string(), lines.size());
 
     {
@@ -1027,6 +1041,20 @@ status_t Camera3Device::waitForNextFrame(nsecs_t timeout) {
 }
 
 status_t Camera3Device::getNextFrame(CameraMetadata *frame) {
+    ATRACE_CALL();
+    sp<CaptureResult> result;
+
+    status_t res = getNextResult(&result);
+    if (res != OK) {
+        return res;
+    }
+
+    *frame = result->metadata();
+
+    return OK;
+}
+
+status_t Camera3Device::getNextResult(sp<CaptureResult> *result) {
     ATRACE_CALL();
     Mutex::Autolock l(mOutputLock);
 
@@ -1034,8 +1062,7 @@ status_t Camera3Device::getNextFrame(CameraMetadata *frame) {
         return NOT_ENOUGH_DATA;
     }
 
-    CameraMetadata &result = *(mResultQueue.begin());
-    frame->acquire(result);
+    *result = *(mResultQueue.begin());
     mResultQueue.erase(mResultQueue.begin());
 
     return OK;
@@ -1117,10 +1144,27 @@ status_t Camera3Device::flush() {
     ATRACE_CALL();
     ALOGV("%s: Camera %d: Flushing all requests", __FUNCTION__, mId);
     Mutex::Autolock il(mInterfaceLock);
-    Mutex::Autolock l(mLock);
 
-    mRequestThread->clear();
-    return mHal3Device->ops->flush(mHal3Device);
+    status_t res;
+    uint32_t submittedFrameEnd;
+    {
+        Mutex::Autolock l(mLock);
+
+        mRequestThread->clear();
+        // Frames still being submitted may reach the HAL after its flush,
+        // and are then processed normally
+        submittedFrameEnd = mRequestThread->getSubmittedFrameEnd();
+        res = mHal3Device->ops->flush(mHal3Device);
+    }
+
+    // Everything the HAL had accepted before a successful flush has been
+    // returned by now. Not done under mLock, which errors found while
+    // holding the in-flight and output locks take.
+    if (res == OK) {
+        clearInFlight(submittedFrameEnd);
+    }
+
+    return res;
 }
 
 /**
@@ -1168,7 +1212,13 @@ sp<Camera3Device::CaptureRequest> Camera3Device::createCaptureRequest(
     status_t res;
 
     sp<CaptureRequest> newRequest = new CaptureRequest;
-    newRequest->mSettings = request;
+    // Leave room for the triggers the request thread may mix in, so that
+    // doing so never reallocates the settings. Their values are stored
+    // inline in the entries, so no extra data space is needed.
+    CameraMetadata settings(request.entryCount() + kMaxTriggerEntries,
+            /*dataCapacity*/0);
+    settings.append(request);
+    newRequest->mSettings.acquire(settings);
 
     camera_metadata_entry_t inputStreams =
             newRequest->mSettings.find(ANDROID_REQUEST_INPUT_STREAMS);
@@ -1393,13 +1443,96 @@ status_t Camera3Device::registerInFlight(int32_t frameNumber,
     ATRACE_CALL();
     Mutex::Autolock l(mInFlightLock);
 
-    ssize_t res;
-    res = mInFlightMap.add(frameNumber, InFlightRequest(requestId, numBuffers));
-    if (res < 0) return res;
+    InFlightRequest &slot =
+            mInFlightRing[frameNumber & (kInFlightRingSize - 1)];
+    while (slot.inUse) {
+        ALOGV("%s: Camera %d: Frame %d waiting for frame %d to complete",
+                __FUNCTION__, mId, frameNumber, slot.frameNumber);
+        status_t res = mInFlightSignal.waitRelative(mInFlightLock,
+                kInFlightSlotTimeout);
+        if (res != OK) {
+            ALOGE("%s: Camera %d: Frame %d still in flight, can't track "
+                    "frame %d: %s (%d)", __FUNCTION__, mId, slot.frameNumber,
+                    frameNumber, strerror(-res), res);
+            return res;
+        }
+    }
+
+    slot = InFlightRequest(frameNumber, requestId, numBuffers, systemTime());
+    mInFlightCount++;
+    if (mInFlightCount > mInFlightMaxCount) {
+        mInFlightMaxCount = mInFlightCount;
+    }
 
     return OK;
 }
 
+Camera3Device::InFlightRequest* Camera3Device::getInFlightLocked(
+        uint32_t frameNumber) {
+    InFlightRequest &slot =
+            mInFlightRing[frameNumber & (kInFlightRingSize - 1)];
+    if (!slot.inUse || slot.frameNumber != frameNumber) {
+        return NULL;
+    }
+    return &slot;
+}
+
+void Camera3Device::removeInFlightLocked(InFlightRequest *request) {
+    ATRACE_ASYNC_END("frame capture", request->frameNumber);
+    *request = InFlightRequest();
+    mInFlightCount--;
+    mInFlightSignal.signal();
+}
+
+void Camera3Device::clearInFlight(uint32_t frameEnd) {
+    Vector<uint32_t> noShutter;
+    Vector<uint32_t> noResult;
+    {
+        Mutex::Autolock l(mInFlightLock);
+        for (size_t i = 0; i < kInFlightRingSize && mInFlightCount > 0; i++) {
+            InFlightRequest &r = mInFlightRing[i];
+            if (!r.inUse || r.frameNumber >= frameEnd) continue;
+            ALOGW("%s: Camera %d: Frame %d never completed (metadata "
+                    "arrived: %s, buffers left: %d)", __FUNCTION__, mId,
+                    r.frameNumber, r.haveResultMetadata ? "true" : "false",
+                    r.numBuffersLeft);
+            if (r.captureTimestamp == 0) noShutter.push(r.frameNumber);
+            if (!r.haveResultMetadata) noResult.push(r.frameNumber);
+            removeInFlightLocked(&r);
+        }
+    }
+
+    Mutex::Autolock l(mOutputLock);
+    for (size_t i = 0; i < noShutter.size(); i++) {
+        skipShutterLocked(noShutter[i]);
+    }
+    for (size_t i = 0; i < noResult.size(); i++) {
+        skipResultLocked(noResult[i]);
+    }
+}
+
+// Moves the next expected frame number past frames that were skipped
+static void advancePastSkipped(uint32_t *next,
+        SortedVector<uint32_t> *skipped) {
+    while (!skipped->isEmpty() && skipped->itemAt(0) <= *next) {
+        if (skipped->itemAt(0) == *next) (*next)++;
+        skipped->removeAt(0);
+    }
+}
+
+void Camera3Device::skipShutterLocked(uint32_t frameNumber) {
+    // Nothing to do if the shutter was already sent
+    if (frameNumber < mNextShutterFrameNumber) return;
+    mSkippedShutterFrames.add(frameNumber);
+    advancePastSkipped(&mNextShutterFrameNumber, &mSkippedShutterFrames);
+}
+
+void Camera3Device::skipResultLocked(uint32_t frameNumber) {
+    if (frameNumber < mNextResultFrameNumber) return;
+    mSkippedResultFrames.add(frameNumber);
+    advancePastSkipped(&mNextResultFrameNumber, &mSkippedResultFrames);
+}
+
 /**
  * QUIRK(partial results)
  * Check if all 3A fields are ready, and send off a partial 3A-only result
@@ -1469,12 +1602,7 @@ bool Camera3Device::processPartial3AQuirk(
 
     const size_t kMinimal3AResultEntries = 10;
 
-    Mutex::Autolock l(mOutputLock);
-
-    CameraMetadata& min3AResult =
-            *mResultQueue.insert(
-                mResultQueue.end(),
-                CameraMetadata(kMinimal3AResultEntries, /*dataCapacity*/ 0));
+    CameraMetadata min3AResult(kMinimal3AResultEntries, /*dataCapacity*/ 0);
 
     if (!insert3AResult(min3AResult, ANDROID_REQUEST_FRAME_COUNT,
             &frameNumber, frameNumber)) {
@@ -1527,6 +1655,10 @@ bool Camera3Device::processPartial3AQuirk(
         return false;
     }
 
+    {
+        Mutex::Autolock l(mOutputLock);
+        mResultQueue.push_back(new CaptureResult(min3AResult));
+    }
     mResultSignal.signal();
 
     return true;
@@ -1561,7 +1693,6 @@ template<typename T>
 bool Camera3Device::insert3AResult(CameraMetadata& result, int32_t tag,
         const T* value, int32_t frameNumber) {
     if (result.update(tag, value, 1) != NO_ERROR) {
-        mResultQueue.erase(--mResultQueue.end(), mResultQueue.end());
         SET_ERR("Frame %d: Failed to set %s in partial metadata",
                 frameNumber, get_camera_metadata_tag_name(tag));
         return false;
@@ -1584,6 +1715,29 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                 frameNumber);
         return;
     }
+
+    // A request the HAL failed with ERROR_REQUEST no longer has an in-flight
+    // slot, but its buffers may still come back, marked as errors
+    if (result->result == NULL) {
+        bool allFailed = true;
+        for (size_t i = 0; i < result->num_output_buffers; i++) {
+            if (result->output_buffers[i].status !=
+                    CAMERA3_BUFFER_STATUS_ERROR) {
+                allFailed = false;
+                break;
+            }
+        }
+        bool inFlight = true;
+        if (allFailed) {
+            Mutex::Autolock l(mInFlightLock);
+            inFlight = (getInFlightLocked(frameNumber) != NULL);
+        }
+        if (!inFlight) {
+            returnOutputBuffers(result, 0);
+            return;
+        }
+    }
+
     bool partialResultQuirk = false;
     CameraMetadata collectedQuirkResult;
 
@@ -1592,15 +1746,16 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
     // status and remove the in-flight entry if all result data has been
     // received.
     nsecs_t timestamp = 0;
+    nsecs_t requestTime = 0;
+    nsecs_t resultTime = 0;
     {
         Mutex::Autolock l(mInFlightLock);
-        ssize_t idx = mInFlightMap.indexOfKey(frameNumber);
-        if (idx == NAME_NOT_FOUND) {
+        InFlightRequest *request = getInFlightLocked(frameNumber);
+        if (request == NULL) {
             SET_ERR("Unknown frame number for capture result: %d",
                     frameNumber);
             return;
         }
-        InFlightRequest &request = mInFlightMap.editValueAt(idx);
 
         // Check if this result carries only partial metadata
         if (mUsePartialResultQuirk && result->result != NULL) {
@@ -1614,28 +1769,28 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
                 // A partial result. Flag this as such, and collect this
                 // set of metadata into the in-flight entry.
                 partialResultQuirk = true;
-                request.partialResultQuirk.collectedResult.append(
+                request->partialResultQuirk.collectedResult.append(
                     result->result);
-                request.partialResultQuirk.collectedResult.erase(
+                request->partialResultQuirk.collectedResult.erase(
                     ANDROID_QUIRKS_PARTIAL_RESULT);
                 // Fire off a 3A-only result if possible
-                if (!request.partialResultQuirk.haveSent3A) {
-                    request.partialResultQuirk.haveSent3A =
+                if (!request->partialResultQuirk.haveSent3A) {
+                    request->partialResultQuirk.haveSent3A =
                             processPartial3AQuirk(frameNumber,
-                                    request.requestId,
-                                    request.partialResultQuirk.collectedResult);
+                                    request->requestId,
+                                    request->partialResultQuirk.collectedResult);
                 }
             }
         }
 
-        timestamp = request.captureTimestamp;
+        timestamp = request->captureTimestamp;
         /**
          * One of the following must happen before it's legal to call process_capture_result,
          * unless partial metadata is being provided:
          * - CAMERA3_MSG_SHUTTER (expected during normal operation)
          * - CAMERA3_MSG_ERROR (expected during flush)
          */
-        if (request.requestStatus == OK && timestamp == 0 && !partialResultQuirk) {
+        if (request->requestStatus == OK && timestamp == 0 && !partialResultQuirk) {
             SET_ERR("Called before shutter notify for frame %d",
                     frameNumber);
             return;
@@ -1643,56 +1798,55 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
 
         // Did we get the (final) result metadata for this capture?
         if (result->result != NULL && !partialResultQuirk) {
-            if (request.haveResultMetadata) {
+            if (request->haveResultMetadata) {
                 SET_ERR("Called multiple times with metadata for frame %d",
                         frameNumber);
                 return;
             }
             if (mUsePartialResultQuirk &&
-                    !request.partialResultQuirk.collectedResult.isEmpty()) {
+                    !request->partialResultQuirk.collectedResult.isEmpty()) {
                 collectedQuirkResult.acquire(
-                    request.partialResultQuirk.collectedResult);
+                    request->partialResultQuirk.collectedResult);
             }
-            request.haveResultMetadata = true;
+            request->haveResultMetadata = true;
+
+            requestTime = request->requestTime;
+            resultTime = systemTime();
+            mResultLatency.add(resultTime - requestTime);
+            CameraTraces::logFrameEvent(mId, CameraTraces::FRAME_RESULT,
+                    frameNumber, -1, resultTime);
         }
 
-        request.numBuffersLeft -= result->num_output_buffers;
+        request->numBuffersLeft -= result->num_output_buffers;
 
-        if (request.numBuffersLeft < 0) {
+        if (request->numBuffersLeft < 0) {
             SET_ERR("Too many buffers returned for frame %d",
                     frameNumber);
             return;
         }
 
-        // Check if everything has arrived for this result (buffers and metadata)
-        if (request.haveResultMetadata && request.numBuffersLeft == 0) {
-            ATRACE_ASYNC_END("frame capture", frameNumber);
-            mInFlightMap.removeItemsAt(idx, 1);
+        // Check if everything has arrived for this result (buffers and
+        // metadata, unless the HAL said there won't be any)
+        if ((request->haveResultMetadata || request->skipResultMetadata) &&
+                request->numBuffersLeft == 0) {
+            removeInFlightLocked(request);
         }
 
         // Sanity check - if we have too many in-flight frames, something has
         // likely gone wrong
-        if (mInFlightMap.size() > kInFlightWarnLimit) {
-            CLOGE("In-flight list too large: %d", mInFlightMap.size());
+        if (mInFlightCount > kInFlightWarnLimit) {
+            CLOGE("In-flight list too large: %d", mInFlightCount);
         }
 
     }
 
-    // Process the result metadata, if provided
+    // Process the result metadata, if provided. It's copied out of the HAL's
+    // buffer and completed before taking mOutputLock, which only needs to
+    // cover the ordering check and the queue.
     bool gotResult = false;
     if (result->result != NULL && !partialResultQuirk) {
-        Mutex::Autolock l(mOutputLock);
-
         gotResult = true;
 
-        if (frameNumber != mNextResultFrameNumber) {
-            SET_ERR("Out-of-order capture result metadata submitted! "
-                    "(got frame number %d, expecting %d)",
-                    frameNumber, mNextResultFrameNumber);
-            return;
-        }
-        mNextResultFrameNumber++;
-
         CameraMetadata captureResult;
         captureResult = result->result;
 
@@ -1728,34 +1882,57 @@ void Camera3Device::processCaptureResult(const camera3_capture_result *result) {
             gotResult = false;
         }
 
+        sp<CaptureResult> queuedResult;
+        if (gotResult) {
+            queuedResult =
+                    new CaptureResult(captureResult, requestTime, resultTime);
+        }
+
+        Mutex::Autolock l(mOutputLock);
+
+        if (frameNumber != mNextResultFrameNumber) {
+            SET_ERR("Out-of-order capture result metadata submitted! "
+                    "(got frame number %d, expecting %d)",
+                    frameNumber, mNextResultFrameNumber);
+            return;
+        }
+        mNextResultFrameNumber++;
+        advancePastSkipped(&mNextResultFrameNumber, &mSkippedResultFrames);
+
         if (gotResult) {
             // Valid result, insert into queue
-            CameraMetadata& queuedResult =
-                *mResultQueue.insert(mResultQueue.end(), CameraMetadata());
-            queuedResult.swap(captureResult);
+            mResultQueue.push_back(queuedResult);
         }
     } // scope for mOutputLock
 
     // Return completed buffers to their streams with the timestamp
 
+    returnOutputBuffers(result, timestamp);
+
+    // Finally, signal any waiters for new frames
+
+    if (gotResult) {
+        mResultSignal.signal();
+    }
+
+}
+
+void Camera3Device::returnOutputBuffers(const camera3_capture_result *result,
+        nsecs_t timestamp) {
     for (size_t i = 0; i < result->num_output_buffers; i++) {
         Camera3Stream *stream =
                 Camera3Stream::cast(result->output_buffers[i].stream);
-        res = stream->returnBuffer(result->output_buffers[i], timestamp);
+        CameraTraces::logFrameEvent(mId, CameraTraces::FRAME_BUFFER_RETURNED,
+                result->frame_number, stream->getId());
+        status_t res = stream->returnBuffer(result->output_buffers[i],
+                timestamp);
         // Note: stream may be deallocated at this point, if this buffer was the
         // last reference to it.
         if (res != OK) {
             ALOGE("Can't return buffer %d for frame %d to its stream: "
-                    " %s (%d)", i, frameNumber, strerror(-res), res);
+                    " %s (%d)", i, result->frame_number, strerror(-res), res);
         }
     }
-
-    // Finally, signal any waiters for new frames
-
-    if (gotResult) {
-        mResultSignal.signal();
-    }
-
 }
 
 
@@ -1786,14 +1963,41 @@ void Camera3Device::notify(const camera3_notify_msg *msg) {
                     mId, __FUNCTION__, msg->message.error.frame_number,
                     streamId, msg->message.error.error_code);
 
-            // Set request error status for the request in the in-flight tracking
+            // Set request error status for the request in the in-flight
+            // tracking. A failed request frees its slot right away, and a
+            // failed result once its buffers are back, since neither will
+            // see its metadata.
+            uint32_t frameNumber = msg->message.error.frame_number;
+            bool skipShutter = false;
+            bool skipResult = false;
             {
                 Mutex::Autolock l(mInFlightLock);
-                ssize_t idx = mInFlightMap.indexOfKey(msg->message.error.frame_number);
-                if (idx >= 0) {
-                    mInFlightMap.editValueAt(idx).requestStatus = msg->message.error.error_code;
+                InFlightRequest *r = getInFlightLocked(frameNumber);
+                if (r != NULL) {
+                    r->requestStatus = msg->message.error.error_code;
+                    switch (msg->message.error.error_code) {
+                        case CAMERA3_MSG_ERROR_REQUEST:
+                            skipShutter = (r->captureTimestamp == 0);
+                            skipResult = !r->haveResultMetadata;
+                            removeInFlightLocked(r);
+                            break;
+                        case CAMERA3_MSG_ERROR_RESULT:
+                            skipResult = !r->haveResultMetadata;
+                            r->skipResultMetadata = true;
+                            if (r->numBuffersLeft == 0) {
+                                removeInFlightLocked(r);
+                            }
+                            break;
+                        default:
+                            break;
+                    }
                 }
             }
+            if (skipShutter || skipResult) {
+                Mutex::Autolock l(mOutputLock);
+                if (skipShutter) skipShutterLocked(frameNumber);
+                if (skipResult) skipResultLocked(frameNumber);
+            }
 
             if (listener != NULL) {
                 listener->notifyError(msg->message.error.error_code,
@@ -1802,7 +2006,7 @@ void Camera3Device::notify(const camera3_notify_msg *msg) {
             break;
         }
         case CAMERA3_MSG_SHUTTER: {
-            ssize_t idx;
+            bool found = false;
             uint32_t frameNumber = msg->message.shutter.frame_number;
             nsecs_t timestamp = msg->message.shutter.timestamp;
             // Verify ordering of shutter notifications
@@ -1815,6 +2019,8 @@ void Camera3Device::notify(const camera3_notify_msg *msg) {
                     break;
                 }
                 mNextShutterFrameNumber++;
+                advancePastSkipped(&mNextShutterFrameNumber,
+                        &mSkippedShutterFrames);
             }
 
             int32_t requestId = -1;
@@ -1823,20 +2029,22 @@ void Camera3Device::notify(const camera3_notify_msg *msg) {
             // and get the request ID to send upstream
             {
                 Mutex::Autolock l(mInFlightLock);
-                idx = mInFlightMap.indexOfKey(frameNumber);
-                if (idx >= 0) {
-                    InFlightRequest &r = mInFlightMap.editValueAt(idx);
-                    r.captureTimestamp = timestamp;
-                    requestId = r.requestId;
+                InFlightRequest *r = getInFlightLocked(frameNumber);
+                if (r != NULL) {
+                    r->captureTimestamp = timestamp;
+                    requestId = r->requestId;
+                    found = true;
                 }
             }
-            if (idx < 0) {
+            if (!found) {
                 SET_ERR("Shutter notification for non-existent frame number %d",
                         frameNumber);
                 break;
             }
             ALOGVV("Camera %d: %s: Shutter fired for frame %d (id %d) at %lld",
                     mId, __FUNCTION__, frameNumber, requestId, timestamp);
+            CameraTraces::logFrameEvent(mId, CameraTraces::FRAME_SHUTTER,
+                    frameNumber);
             // Call listener, if any
             if (listener != NULL) {
                 listener->notifyShutter(requestId, timestamp);
@@ -1877,7 +2085,11 @@ Camera3Device::RequestThread::RequestThread(wp<Camera3Device> parent,
         mDoPause(false),
         mPaused(true),
         mFrameNumber(0),
-        mLatestRequestId(NAME_NOT_FOUND) {
+        mLatestRequestId(NAME_NOT_FOUND),
+        mSubmittedFrameEnd(0),
+        mSettingsSent(0),
+        mSettingsRepeated(0),
+        mSettingsUnchanged(0) {
     mStatusId = statusTracker->addComponent();
 }
 
@@ -1889,6 +2101,7 @@ void Camera3Device::RequestThread::configurationComplete() {
 status_t Camera3Device::RequestThread::queueRequest(
          sp<CaptureRequest> request) {
     Mutex::Autolock l(mRequestLock);
+    request->mQueueTime = systemTime();
     mRequestQueue.push_back(request);
 
     unpauseForNewRequests();
@@ -2008,6 +2221,36 @@ void Camera3Device::RequestThread::requestExit() {
     mRequestSignal.signal();
 }
 
+/**
+ * Whether two settings buffers hold the same entries in the same order.
+ * Compares entries rather than the raw buffers, which may differ in capacity.
+ */
+static bool isSameSettings(const camera_metadata_t *a,
+        const camera_metadata_t *b) {
+    if (a == NULL || b == NULL) return a == b;
+
+    size_t count = get_camera_metadata_entry_count(a);
+    if (count != get_camera_metadata_entry_count(b)) return false;
+
+    for (size_t i = 0; i < count; i++) {
+        camera_metadata_ro_entry_t entryA, entryB;
+        if (get_camera_metadata_ro_entry(a, i, &entryA) != OK ||
+                get_camera_metadata_ro_entry(b, i, &entryB) != OK) {
+            return false;
+        }
+        if (entryA.tag != entryB.tag ||
+                entryA.type != entryB.type ||
+                entryA.count != entryB.count) {
+            return false;
+        }
+        if (memcmp(entryA.data.u8, entryB.data.u8,
+                entryA.count * camera_metadata_type_size[entryA.type]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool Camera3Device::RequestThread::threadLoop() {
 
     status_t res;
@@ -2024,6 +2267,8 @@ bool Camera3Device::RequestThread::threadLoop() {
         return true;
     }
 
+    nsecs_t cpuTimeStart = systemTime(SYSTEM_TIME_THREAD);
+
     // Create request to HAL
     camera3_capture_request_t request = camera3_capture_request_t();
     Vector<camera3_stream_buffer_t> outputBuffers;
@@ -2053,6 +2298,7 @@ bool Camera3Device::RequestThread::threadLoop() {
     triggerCount = res;
 
     bool triggersMixedIn = (triggerCount > 0 || mPrevTriggers > 0);
+    bool settingsUnchanged = false;
 
     // If the request is the same as last, or we had triggers last time
     if (mPrevRequest != nextRequest || triggersMixedIn) {
@@ -2075,21 +2321,38 @@ bool Camera3Device::RequestThread::threadLoop() {
          */
         nextRequest->mSettings.sort();
         request.settings = nextRequest->mSettings.getAndLock();
+
+        // A different request with the same settings as the last one, such
+        // as a repeating request that was just set again, doesn't need the
+        // HAL to parse them again either.
+        if (!triggersMixedIn && mPrevRequest != NULL) {
+            const camera_metadata_t *prevSettings =
+                    mPrevRequest->mSettings.getAndLock();
+            settingsUnchanged = isSameSettings(request.settings, prevSettings);
+            mPrevRequest->mSettings.unlock(prevSettings);
+        }
         mPrevRequest = nextRequest;
-        ALOGVV("%s: Request settings are NEW", __FUNCTION__);
-
-        IF_ALOGV() {
-            camera_metadata_ro_entry_t e = camera_metadata_ro_entry_t();
-            find_camera_metadata_ro_entry(
-                    request.settings,
-                    ANDROID_CONTROL_AF_TRIGGER,
-                    &e
-            );
-            if (e.count > 0) {
-                ALOGV("%s: Request (frame num %d) had AF trigger 0x%x",
-                      __FUNCTION__,
-                      mFrameNumber+1,
-                      e.data.u8[0]);
+
+        if (settingsUnchanged) {
+            nextRequest->mSettings.unlock(request.settings);
+            request.settings = NULL;
+            ALOGVV("%s: Request settings are UNCHANGED", __FUNCTION__);
+        } else {
+            ALOGVV("%s: Request settings are NEW", __FUNCTION__);
+
+            IF_ALOGV() {
+                camera_metadata_ro_entry_t e = camera_metadata_ro_entry_t();
+                find_camera_metadata_ro_entry(
+                        request.settings,
+                        ANDROID_CONTROL_AF_TRIGGER,
+                        &e
+                );
+                if (e.count > 0) {
+                    ALOGV("%s: Request (frame num %d) had AF trigger 0x%x",
+                          __FUNCTION__,
+                          mFrameNumber+1,
+                          e.data.u8[0]);
+                }
             }
         }
     } else {
@@ -2157,6 +2420,11 @@ bool Camera3Device::RequestThread::threadLoop() {
         mLatestRequestSignal.signal();
     }
 
+    CameraTraces::logFrameEvent(mId, CameraTraces::FRAME_REQUEST_QUEUED,
+            request.frame_number, -1, nextRequest->mQueueTime);
+    CameraTraces::logFrameEvent(mId, CameraTraces::FRAME_REQUEST_SENT,
+            request.frame_number);
+
     // Submit request and block until ready for next one
     ATRACE_ASYNC_BEGIN("frame capture", request.frame_number);
     ATRACE_BEGIN("camera3->process_capture_request");
@@ -2171,11 +2439,20 @@ bool Camera3Device::RequestThread::threadLoop() {
     }
 
     // Update the latest request sent to HAL
-    if (request.settings != NULL) { // Don't update them if they were unchanged
+    {
         Mutex::Autolock al(mLatestRequestMutex);
 
-        camera_metadata_t* cloned = clone_camera_metadata(request.settings);
-        mLatestRequest.acquire(cloned);
+        mSubmittedFrameEnd = request.frame_number + 1;
+
+        if (request.settings != NULL) { // Don't update them if they were unchanged
+            camera_metadata_t* cloned = clone_camera_metadata(request.settings);
+            mLatestRequest.acquire(cloned);
+            mSettingsSent++;
+        } else if (settingsUnchanged) {
+            mSettingsUnchanged++;
+        } else {
+            mSettingsRepeated++;
+        }
     }
 
     if (request.settings != NULL) {
@@ -2207,6 +2484,11 @@ bool Camera3Device::RequestThread::threadLoop() {
         }
     }
 
+    {
+        Mutex::Autolock al(mLatestRequestMutex);
+        mRequestCpuTime.add(systemTime(SYSTEM_TIME_THREAD) - cpuTimeStart);
+    }
+
     return true;
 }
 
@@ -2218,6 +2500,21 @@ CameraMetadata Camera3Device::RequestThread::getLatestRequest() const {
     return mLatestRequest;
 }
 
+uint32_t Camera3Device::RequestThread::getSubmittedFrameEnd() const {
+    Mutex::Autolock al(mLatestRequestMutex);
+    return mSubmittedFrameEnd;
+}
+
+void Camera3Device::RequestThread::dumpStats(String8 *lines) const {
+    Mutex::Autolock al(mLatestRequestMutex);
+
+    lines->append("    Request thread:\n");
+    lines->appendFormat("      Settings sent: %d, repeated: %d, "
+            "unchanged: %d\n", mSettingsSent, mSettingsRepeated,
+            mSettingsUnchanged);
+    mRequestCpuTime.appendTo(lines, "CPU time per request");
+}
+
 void Camera3Device::RequestThread::cleanUpFailedRequest(
         camera3_capture_request_t &request,
         sp<CaptureRequest> &nextRequest,
@@ -2252,6 +2549,11 @@ sp<Camera3Device::CaptureRequest>
             // list. Guarantees a complete in-sequence set of captures to
             // application.
             const RequestList &requests = mRepeatingRequests;
+            nsecs_t queueTime = systemTime();
+            for (RequestList::const_iterator it = requests.begin();
+                    it != requests.end(); ++it) {
+                (*it)->mQueueTime = queueTime;
+            }
             RequestList::const_iterator firstRequest =
                     requests.begin();
             nextRequest = *firstRequest;
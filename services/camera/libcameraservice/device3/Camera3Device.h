@@ -23,6 +23,7 @@
 #include <utils/Mutex.h>
 #include <utils/Thread.h>
 #include <utils/KeyedVector.h>
+#include <utils/SortedVector.h>
 #include <hardware/camera3.h>
 
 #include "common/CameraDeviceBase.h"
@@ -117,6 +118,7 @@ class Camera3Device :
     virtual bool     willNotify3A();
     virtual status_t waitForNextFrame(nsecs_t timeout);
     virtual status_t getNextFrame(CameraMetadata *frame);
+    virtual status_t getNextResult(sp<CaptureResult> *result);
 
     virtual status_t triggerAutofocus(uint32_t id);
     virtual status_t triggerCancelAutofocus(uint32_t id);
@@ -136,6 +138,9 @@ class Camera3Device :
     static const size_t        kInFlightWarnLimit = 20;
     static const nsecs_t       kShutdownTimeout   = 5000000000; // 5 sec
     static const nsecs_t       kActiveTimeout     = 500000000;  // 500 ms
+    static const nsecs_t       kInFlightSlotTimeout = 1000000000; // 1 sec
+    // Trigger tags the request thread may add to a request's settings
+    static const size_t        kMaxTriggerEntries = 4;
     struct                     RequestTrigger;
 
     // A lock to enforce serialization on the input/configure side
@@ -195,10 +200,15 @@ class Camera3Device :
 
     class CaptureRequest : public LightRefBase<CaptureRequest> {
       public:
+        CaptureRequest() : mQueueTime(0) {}
+
         CameraMetadata                      mSettings;
         sp<camera3::Camera3Stream>          mInputStream;
         Vector<sp<camera3::Camera3OutputStreamInterface> >
                                             mOutputStreams;
+        // When the request was last put in the request queue, for
+        // CameraTraces. Only touched by the request thread once queued.
+        nsecs_t                             mQueueTime;
     };
     typedef List<sp<CaptureRequest> > RequestList;
 
@@ -353,6 +363,17 @@ class Camera3Device :
          */
         CameraMetadata getLatestRequest() const;
 
+        /**
+         * Get the number of the first frame process_capture_request hasn't
+         * returned for yet; the HAL has accepted all frames before it.
+         */
+        uint32_t getSubmittedFrameEnd() const;
+
+        /**
+         * Append settings reuse and per-request CPU time statistics
+         */
+        void     dumpStats(String8 *lines) const;
+
       protected:
 
         virtual bool threadLoop();
@@ -423,6 +444,17 @@ class Camera3Device :
         // android.request.id for latest process_capture_request
         int32_t            mLatestRequestId;
         CameraMetadata     mLatestRequest;
+        // Frames before this one have been accepted by the HAL
+        uint32_t           mSubmittedFrameEnd;
+
+        // Statistics, guarded by mLatestRequestMutex
+        size_t             mSettingsSent;
+        // Requests sent with NULL settings, because they were the same
+        // request as last time, or a different one with the same settings
+        size_t             mSettingsRepeated;
+        size_t             mSettingsUnchanged;
+        // Thread CPU time spent per request, including the HAL's
+        CaptureLatency     mRequestCpuTime;
 
         typedef KeyedVector<uint32_t/*tag*/, RequestTrigger> TriggerMap;
         Mutex              mTriggerMutex;
@@ -437,13 +469,20 @@ class Camera3Device :
      */
 
     struct InFlightRequest {
+        // Whether this ring slot holds a request, and for which frame
+        bool     inUse;
+        uint32_t frameNumber;
         // android.request.id for the request
         int     requestId;
+        // When the request was submitted to the HAL
+        nsecs_t requestTime;
         // Set by notify() SHUTTER call.
         nsecs_t captureTimestamp;
         int     requestStatus;
         // Set by process_capture_result call with valid metadata
         bool    haveResultMetadata;
+        // Set by notify() ERROR_RESULT call; no metadata will arrive
+        bool    skipResultMetadata;
         // Decremented by calls to process_capture_result with valid output
         // buffers
         int     numBuffersLeft;
@@ -460,32 +499,68 @@ class Camera3Device :
             }
         } partialResultQuirk;
 
-        // Default constructor needed by KeyedVector
+        // An unused ring slot
         InFlightRequest() :
+                inUse(false),
+                frameNumber(0),
                 requestId(0),
+                requestTime(0),
                 captureTimestamp(0),
                 requestStatus(OK),
                 haveResultMetadata(false),
+                skipResultMetadata(false),
                 numBuffersLeft(0) {
         }
 
-        InFlightRequest(int id, int numBuffers) :
+        InFlightRequest(uint32_t frame, int id, int numBuffers,
+                nsecs_t submitted) :
+                inUse(true),
+                frameNumber(frame),
                 requestId(id),
+                requestTime(submitted),
                 captureTimestamp(0),
                 requestStatus(OK),
                 haveResultMetadata(false),
+                skipResultMetadata(false),
                 numBuffersLeft(numBuffers) {
         }
     };
-    // Map from frame number to the in-flight request state
-    typedef KeyedVector<uint32_t, InFlightRequest> InFlightMap;
-
-    Mutex                  mInFlightLock; // Protects mInFlightMap
-    InFlightMap            mInFlightMap;
 
+    // In-flight requests, in the slot given by their frame number modulo the
+    // ring size. Frame numbers are consecutive and the HAL can only hold a
+    // few requests at a time, so lookups never have to search.
+    static const size_t    kInFlightRingSize = 64; // Must be a power of two
+
+    Mutex                  mInFlightLock; // Protects the fields below
+    InFlightRequest        mInFlightRing[kInFlightRingSize];
+    size_t                 mInFlightCount;
+    size_t                 mInFlightMaxCount;
+    // Signaled when a request completes and frees up its slot
+    Condition              mInFlightSignal;
+    // Time from submitting a request to the HAL until its result metadata
+    CaptureLatency         mResultLatency;
+
+    // Waits for the frame's slot if it is still taken by an older request,
+    // so that the request thread can keep as many requests in flight as the
+    // HAL accepts, up to the ring size.
     status_t registerInFlight(int32_t frameNumber, int32_t requestId,
             int32_t numBuffers);
 
+    // Returns NULL if the frame isn't in flight. Needs mInFlightLock.
+    InFlightRequest* getInFlightLocked(uint32_t frameNumber);
+    void removeInFlightLocked(InFlightRequest *request);
+
+    // Drops the requests before the given frame number that are still in
+    // flight once the HAL has no more to return for them, after a flush or
+    // when the device is closed.
+    void clearInFlight(uint32_t frameEnd);
+
+    // Records that the HAL won't send the shutter notification or the
+    // result metadata of a frame, so the ordering checks skip it. Needs
+    // mOutputLock.
+    void skipShutterLocked(uint32_t frameNumber);
+    void skipResultLocked(uint32_t frameNumber);
+
     /**
      * For the partial result quirk, check if all 3A state fields are available
      * and if so, queue up 3A-only result to the client. Returns true if 3A
@@ -518,7 +593,11 @@ class Camera3Device :
 
     uint32_t               mNextResultFrameNumber;
     uint32_t               mNextShutterFrameNumber;
-    List<CameraMetadata>   mResultQueue;
+    // Frames past the above that failed with a HAL error, whose shutter or
+    // result metadata will never arrive
+    SortedVector<uint32_t> mSkippedShutterFrames;
+    SortedVector<uint32_t> mSkippedResultFrames;
+    List<sp<CaptureResult> > mResultQueue;
     Condition              mResultSignal;
     NotificationListener  *mListener;
 
@@ -531,6 +610,10 @@ class Camera3Device :
 
     void notify(const camera3_notify_msg *msg);
 
+    // Hands the result's output buffers back to their streams
+    void returnOutputBuffers(const camera3_capture_result *result,
+            nsecs_t timestamp);
+
     /**
      * Static callback forwarding methods from HAL to instance
      */
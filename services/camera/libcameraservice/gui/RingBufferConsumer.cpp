@@ -44,9 +44,17 @@ RingBufferConsumer::RingBufferConsumer(const sp<IGraphicBufferConsumer>& consume
     mConsumer->setMaxAcquiredBufferCount(bufferCount);
 
     assert(bufferCount > 0);
+
+    mBufferItems.setCapacity(bufferCount + 1);
+    for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+        mSlotItems[i] = NULL;
+    }
 }
 
 RingBufferConsumer::~RingBufferConsumer() {
+    for (size_t i = 0; i < mBufferItems.size(); i++) {
+        delete mBufferItems[i];
+    }
 }
 
 void RingBufferConsumer::setName(const String8& name) {
@@ -62,17 +70,15 @@ sp<PinnedBufferItem> RingBufferConsumer::pinSelectedBuffer(
     sp<PinnedBufferItem> pinnedBuffer;
 
     {
-        List<RingBufferItem>::iterator it, end, accIt;
+        size_t accIndex = 0;
         BufferInfo acc, cur;
         BufferInfo* accPtr = NULL;
 
         Mutex::Autolock _l(mMutex);
 
-        for (it = mBufferItemList.begin(), end = mBufferItemList.end();
-             it != end;
-             ++it) {
+        for (size_t i = 0; i < mBufferItems.size(); i++) {
 
-            const RingBufferItem& item = *it;
+            const RingBufferItem& item = *mBufferItems[i];
 
             cur.mCrop = item.mCrop;
             cur.mTransform = item.mTransform;
@@ -88,7 +94,7 @@ sp<PinnedBufferItem> RingBufferConsumer::pinSelectedBuffer(
             } else if (ret > 0) {
                 acc = cur;
                 accPtr = &acc;
-                accIt = it;
+                accIndex = i;
             } // else acc = acc
         }
 
@@ -96,7 +102,7 @@ sp<PinnedBufferItem> RingBufferConsumer::pinSelectedBuffer(
             return NULL;
         }
 
-        pinnedBuffer = new PinnedBufferItem(this, *accIt);
+        pinnedBuffer = new PinnedBufferItem(this, *mBufferItems[accIndex]);
         pinBufferLocked(pinnedBuffer->getBufferItem());
 
     } // end scope of mMutex autolock
@@ -113,6 +119,46 @@ sp<PinnedBufferItem> RingBufferConsumer::pinSelectedBuffer(
     return pinnedBuffer;
 }
 
+sp<PinnedBufferItem> RingBufferConsumer::pinBufferByTimestamp(
+        nsecs_t timestamp,
+        bool waitForFence) {
+
+    sp<PinnedBufferItem> pinnedBuffer;
+
+    {
+        Mutex::Autolock _l(mMutex);
+
+        if (mBufferItems.isEmpty()) {
+            return NULL;
+        }
+
+        size_t index = lowerBoundLocked(timestamp);
+        if (index == mBufferItems.size() ||
+                mBufferItems[index]->mTimestamp != timestamp) {
+            // No exact match; prefer the closest earlier buffer, then the
+            // closest later one
+            if (index > 0) {
+                index--;
+            }
+        }
+
+        pinnedBuffer = new PinnedBufferItem(this, *mBufferItems[index]);
+        pinBufferLocked(pinnedBuffer->getBufferItem());
+
+    } // end scope of mMutex autolock
+
+    if (waitForFence) {
+        status_t err = pinnedBuffer->getBufferItem().mFence->waitForever(
+                "RingBufferConsumer::pinBufferByTimestamp");
+        if (err != OK) {
+            BI_LOGE("Failed to wait for fence of acquired buffer: %s (%d)",
+                    strerror(-err), err);
+        }
+    }
+
+    return pinnedBuffer;
+}
+
 status_t RingBufferConsumer::clear() {
 
     status_t err;
@@ -121,7 +167,7 @@ status_t RingBufferConsumer::clear() {
     BI_LOGV("%s", __FUNCTION__);
 
     // Avoid annoying log warnings by returning early
-    if (mBufferItemList.size() == 0) {
+    if (mBufferItems.size() == 0) {
         return OK;
     }
 
@@ -130,7 +176,7 @@ status_t RingBufferConsumer::clear() {
         err = releaseOldestBufferLocked(&pinnedFrames);
 
         if (err == NO_BUFFER_AVAILABLE) {
-            assert(pinnedFrames == mBufferItemList.size());
+            assert(pinnedFrames == mBufferItems.size());
             break;
         }
 
@@ -149,24 +195,40 @@ status_t RingBufferConsumer::clear() {
     return OK;
 }
 
-void RingBufferConsumer::pinBufferLocked(const BufferItem& item) {
-    List<RingBufferItem>::iterator it, end;
-
-    for (it = mBufferItemList.begin(), end = mBufferItemList.end();
-         it != end;
-         ++it) {
-
-        RingBufferItem& find = *it;
-        if (item.mGraphicBuffer == find.mGraphicBuffer) {
-            find.mPinCount++;
-            break;
+size_t RingBufferConsumer::lowerBoundLocked(nsecs_t timestamp) const {
+    size_t low = 0;
+    size_t high = mBufferItems.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (mBufferItems[mid]->mTimestamp < timestamp) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
+    return low;
+}
 
-    if (it == end) {
+RingBufferConsumer::RingBufferItem* RingBufferConsumer::findItemLocked(
+        const BufferItem& item) const {
+    if (item.mBuf < 0 || item.mBuf >= BufferQueue::NUM_BUFFER_SLOTS) {
+        return NULL;
+    }
+    RingBufferItem* find = mSlotItems[item.mBuf];
+    if (find == NULL || find->mGraphicBuffer != item.mGraphicBuffer) {
+        return NULL;
+    }
+    return find;
+}
+
+void RingBufferConsumer::pinBufferLocked(const BufferItem& item) {
+    RingBufferItem* find = findItemLocked(item);
+
+    if (find == NULL) {
         BI_LOGE("Failed to pin buffer (timestamp %lld, framenumber %lld)",
                  item.mTimestamp, item.mFrameNumber);
     } else {
+        find->mPinCount++;
         BI_LOGV("Pinned buffer (frame %lld, timestamp %lld)",
                 item.mFrameNumber, item.mTimestamp);
     }
@@ -175,13 +237,7 @@ void RingBufferConsumer::pinBufferLocked(const BufferItem& item) {
 status_t RingBufferConsumer::releaseOldestBufferLocked(size_t* pinnedFrames) {
     status_t err = OK;
 
-    List<RingBufferItem>::iterator it, end, accIt;
-
-    it = mBufferItemList.begin();
-    end = mBufferItemList.end();
-    accIt = end;
-
-    if (it == end) {
+    if (mBufferItems.isEmpty()) {
         /**
          * This is fine. We really care about being able to acquire a buffer
          * successfully after this function completes, not about it releasing
@@ -192,24 +248,20 @@ status_t RingBufferConsumer::releaseOldestBufferLocked(size_t* pinnedFrames) {
         return NOT_ENOUGH_DATA;
     }
 
-    for (; it != end; ++it) {
-        RingBufferItem& find = *it;
-
-        if (find.mPinCount > 0) {
-            if (pinnedFrames != NULL) {
-                ++(*pinnedFrames);
-            }
-            // Filter out pinned frame when searching for buffer to release
-            continue;
+    // Buffers are sorted by timestamp, so the oldest one that isn't pinned
+    // is the first one that isn't
+    size_t index = 0;
+    for (; index < mBufferItems.size(); index++) {
+        if (mBufferItems[index]->mPinCount == 0) {
+            break;
         }
-
-        if (find.mTimestamp < accIt->mTimestamp || accIt == end) {
-            accIt = it;
+        if (pinnedFrames != NULL) {
+            ++(*pinnedFrames);
         }
     }
 
-    if (accIt != end) {
-        RingBufferItem& item = *accIt;
+    if (index < mBufferItems.size()) {
+        RingBufferItem& item = *mBufferItems[index];
 
         // In case the object was never pinned, pass the acquire fence
         // back to the release fence. If the fence was already waited on,
@@ -244,9 +296,9 @@ status_t RingBufferConsumer::releaseOldestBufferLocked(size_t* pinnedFrames) {
         BI_LOGV("Buffer timestamp %lld, frame %lld evicted",
                 item.mTimestamp, item.mFrameNumber);
 
-        size_t currentSize = mBufferItemList.size();
-        mBufferItemList.erase(accIt);
-        assert(mBufferItemList.size() == currentSize - 1);
+        mSlotItems[item.mBuf] = NULL;
+        delete &item;
+        mBufferItems.removeAt(index);
     } else {
         BI_LOGW("All buffers pinned, could not find any to release");
         return NO_BUFFER_AVAILABLE;
@@ -265,7 +317,7 @@ void RingBufferConsumer::onFrameAvailable() {
         /**
          * Release oldest frame
          */
-        if (mBufferItemList.size() >= (size_t)mBufferCount) {
+        if (mBufferItems.size() >= (size_t)mBufferCount) {
             err = releaseOldestBufferLocked(/*pinnedFrames*/NULL);
             assert(err != NOT_ENOUGH_DATA);
 
@@ -278,28 +330,32 @@ void RingBufferConsumer::onFrameAvailable() {
             // we could've locked but didn't because there was no space
         }
 
-        RingBufferItem& item = *mBufferItemList.insert(mBufferItemList.end(),
-                                                       RingBufferItem());
+        RingBufferItem* item = new RingBufferItem();
 
         /**
          * Acquire new frame
          */
-        err = acquireBufferLocked(&item, 0);
+        err = acquireBufferLocked(item, 0);
         if (err != OK) {
             if (err != NO_BUFFER_AVAILABLE) {
                 BI_LOGE("Error acquiring buffer: %s (%d)", strerror(err), err);
             }
 
-            mBufferItemList.erase(--mBufferItemList.end());
+            delete item;
             return;
         }
 
+        item->mGraphicBuffer = mSlots[item->mBuf].mGraphicBuffer;
+
+        // Frames normally arrive in timestamp order, making this an append
+        size_t index = lowerBoundLocked(item->mTimestamp + 1);
+        mBufferItems.insertAt(item, index);
+        mSlotItems[item->mBuf] = item;
+
         BI_LOGV("New buffer acquired (timestamp %lld), "
                 "buffer items %u out of %d",
-                item.mTimestamp,
-                mBufferItemList.size(), mBufferCount);
-
-        item.mGraphicBuffer = mSlots[item.mBuf].mGraphicBuffer;
+                item->mTimestamp,
+                mBufferItems.size(), mBufferCount);
     } // end of mMutex lock
 
     ConsumerBase::onFrameAvailable();
@@ -308,37 +364,28 @@ void RingBufferConsumer::onFrameAvailable() {
 void RingBufferConsumer::unpinBuffer(const BufferItem& item) {
     Mutex::Autolock _l(mMutex);
 
-    List<RingBufferItem>::iterator it, end, accIt;
+    RingBufferItem* find = findItemLocked(item);
 
-    for (it = mBufferItemList.begin(), end = mBufferItemList.end();
-         it != end;
-         ++it) {
-
-        RingBufferItem& find = *it;
-        if (item.mGraphicBuffer == find.mGraphicBuffer) {
-            status_t res = addReleaseFenceLocked(item.mBuf,
-                    item.mGraphicBuffer, item.mFence);
-
-            if (res != OK) {
-                BI_LOGE("Failed to add release fence to buffer "
-                        "(timestamp %lld, framenumber %lld",
-                        item.mTimestamp, item.mFrameNumber);
-                return;
-            }
-
-            find.mPinCount--;
-            break;
-        }
-    }
-
-    if (it == end) {
+    if (find == NULL) {
         // This should never happen. If it happens, we have a bug.
         BI_LOGE("Failed to unpin buffer (timestamp %lld, framenumber %lld)",
                  item.mTimestamp, item.mFrameNumber);
-    } else {
-        BI_LOGV("Unpinned buffer (timestamp %lld, framenumber %lld)",
-                 item.mTimestamp, item.mFrameNumber);
+        return;
+    }
+
+    status_t res = addReleaseFenceLocked(item.mBuf,
+            item.mGraphicBuffer, item.mFence);
+
+    if (res != OK) {
+        BI_LOGE("Failed to add release fence to buffer "
+                "(timestamp %lld, framenumber %lld",
+                item.mTimestamp, item.mFrameNumber);
+        return;
     }
+
+    find->mPinCount--;
+    BI_LOGV("Unpinned buffer (timestamp %lld, framenumber %lld)",
+             item.mTimestamp, item.mFrameNumber);
 }
 
 status_t RingBufferConsumer::setDefaultBufferSize(uint32_t w, uint32_t h) {
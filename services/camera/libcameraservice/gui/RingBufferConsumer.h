@@ -24,7 +24,6 @@
 #include <utils/String8.h>
 #include <utils/Vector.h>
 #include <utils/threads.h>
-#include <utils/List.h>
 
 #define ANDROID_GRAPHICS_RINGBUFFERCONSUMER_JNI_ID "mRingBufferConsumer"
 
@@ -156,6 +155,15 @@ class RingBufferConsumer : public ConsumerBase,
     sp<PinnedBufferItem> pinSelectedBuffer(const RingBufferComparator& filter,
                                            bool waitForFence = true);
 
+    // Find the buffer best matching the timestamp, then pin it before
+    // returning it. Prefers, in order: the exact timestamp, the closest
+    // earlier one, the closest later one. Returns NULL only if the ring
+    // buffer is empty.
+    //
+    // Unlike pinSelectedBuffer, this doesn't visit every buffer.
+    sp<PinnedBufferItem> pinBufferByTimestamp(nsecs_t timestamp,
+                                              bool waitForFence = true);
+
     // Release all the non-pinned buffers in the ring buffer
     status_t clear();
 
@@ -177,8 +185,18 @@ class RingBufferConsumer : public ConsumerBase,
         int mPinCount;
     };
 
-    // List of acquired buffers in our ring buffer
-    List<RingBufferItem>       mBufferItemList;
+    // Index of the first buffer in mBufferItems with a timestamp no
+    // earlier than the given one
+    size_t lowerBoundLocked(nsecs_t timestamp) const;
+
+    // Acquired buffer for the slot of a buffer item, or NULL. Pinned
+    // buffers are never released, so they always have their slot.
+    RingBufferItem* findItemLocked(const BufferItem& item) const;
+
+    // Acquired buffers in our ring buffer, oldest timestamp first
+    Vector<RingBufferItem*>    mBufferItems;
+    // The same buffers by BufferQueue slot
+    RingBufferItem*            mSlotItems[BufferQueue::NUM_BUFFER_SLOTS];
     const int                  mBufferCount;
 };
 
@@ -0,0 +1,134 @@
+LOCAL_PATH:= $(call my-dir)
+
+# Settings shared by all the benchmarks below
+camera_bench_c_includes := \
+    system/media/camera/include \
+    frameworks/av/services/camera/libcameraservice \
+
+camera_bench_cflags := -Wall -Wextra
+
+camera_bench_shared_libraries := \
+    liblog \
+    libutils \
+
+#
+# libcamera2benchutils: command line and latency helpers of the benchmarks
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    BenchUtils.cpp \
+
+LOCAL_C_INCLUDES += $(camera_bench_c_includes)
+LOCAL_CFLAGS += $(camera_bench_cflags)
+
+LOCAL_MODULE:= libcamera2benchutils
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_STATIC_LIBRARY)
+
+#
+# camera3bench: Camera3Device and Camera2Client throughput against a fake
+# camera3 HAL
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    FakeCamera3Hal.cpp \
+    LocalServices.cpp \
+    camera3bench.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    $(camera_bench_shared_libraries) \
+    libui \
+    libbinder \
+    libcutils \
+    libcamera_client \
+    libcameraservice \
+    libgui \
+    libhardware \
+    libsync \
+    libcamera_metadata \
+
+LOCAL_STATIC_LIBRARIES:= libcamera2benchutils
+LOCAL_C_INCLUDES += $(camera_bench_c_includes)
+LOCAL_CFLAGS += $(camera_bench_cflags)
+
+LOCAL_MODULE:= camera3bench
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
+
+#
+# jpegbench: software JPEG shot latency by resolution and thread count
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    jpegbench.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    $(camera_bench_shared_libraries) \
+    libgui \
+    libcameraservice \
+    libjpeg \
+
+LOCAL_STATIC_LIBRARIES:= libcamera2benchutils
+LOCAL_C_INCLUDES += $(camera_bench_c_includes) external/jpeg
+LOCAL_CFLAGS += $(camera_bench_cflags)
+
+LOCAL_MODULE:= camera2jpegbench
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
+
+#
+# paramsbench: api1 setParameters() latency
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    paramsbench.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    $(camera_bench_shared_libraries) \
+    libcamera_client \
+    libcameraservice \
+    libcamera_metadata \
+
+LOCAL_STATIC_LIBRARIES:= libcamera2benchutils
+LOCAL_C_INCLUDES += $(camera_bench_c_includes)
+LOCAL_CFLAGS += $(camera_bench_cflags)
+
+LOCAL_MODULE:= camera2paramsbench
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
+
+#
+# metadatabench: capture result parceling cost, inline and pooled
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    metadatabench.cpp \
+
+LOCAL_SHARED_LIBRARIES:= \
+    $(camera_bench_shared_libraries) \
+    libbinder \
+    libcamera_client \
+    libcamera_metadata \
+
+LOCAL_STATIC_LIBRARIES:= libcamera2benchutils
+LOCAL_C_INCLUDES += $(camera_bench_c_includes)
+LOCAL_CFLAGS += $(camera_bench_cflags)
+
+LOCAL_MODULE:= camera2metadatabench
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
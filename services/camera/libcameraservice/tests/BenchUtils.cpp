@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <utils/String8.h>
+
+#include "BenchUtils.h"
+
+namespace android {
+
+BenchOptions::BenchOptions(const char *operands, const char *operandsHelp) :
+        mOperands(operands),
+        mOperandsHelp(operandsHelp),
+        mName("bench") {
+}
+
+void BenchOptions::addInt(char letter, const char *argName, const char *help,
+        int *value, int minValue) {
+    Option option = { letter, argName, help, value, minValue, NULL };
+    mOptions.push_back(option);
+}
+
+void BenchOptions::addString(char letter, const char *argName,
+        const char *help, const char **value) {
+    Option option = { letter, argName, help, NULL, 0, value };
+    mOptions.push_back(option);
+}
+
+bool BenchOptions::parse(int argc, char **argv) {
+    mName = argv[0];
+
+    String8 optString("h");
+    for (size_t i = 0; i < mOptions.size(); i++) {
+        optString.appendFormat("%c:", mOptions[i].letter);
+    }
+
+    int res;
+    while ((res = getopt(argc, argv, optString.string())) >= 0) {
+        size_t i;
+        for (i = 0; i < mOptions.size(); i++) {
+            if (mOptions[i].letter == res) break;
+        }
+        if (i == mOptions.size()) {
+            usage();
+            return false;
+        }
+
+        const Option &option = mOptions[i];
+        if (option.stringValue != NULL) {
+            *option.stringValue = optarg;
+            continue;
+        }
+        char *end;
+        long value = strtol(optarg, &end, 10);
+        if (*optarg == '\0' || *end != '\0' || value < option.minValue ||
+                value > INT_MAX) {
+            usage();
+            return false;
+        }
+        *option.intValue = value;
+    }
+
+    if (mOperands == NULL && optind != argc) {
+        usage();
+        return false;
+    }
+    return true;
+}
+
+void BenchOptions::usage() const {
+    String8 synopsis = String8::format("usage: %s", mName);
+    for (size_t i = 0; i < mOptions.size(); i++) {
+        synopsis.appendFormat(" [-%c %s]", mOptions[i].letter,
+                mOptions[i].argName);
+    }
+    if (mOperands != NULL) {
+        synopsis.appendFormat(" %s", mOperands);
+    }
+    fprintf(stderr, "%s\n", synopsis.string());
+
+    for (size_t i = 0; i < mOptions.size(); i++) {
+        fprintf(stderr, "       -%c  %s\n", mOptions[i].letter,
+                mOptions[i].help);
+    }
+    if (mOperandsHelp != NULL) {
+        fprintf(stderr, "       %s\n", mOperandsHelp);
+    }
+}
+
+static int compareLatency(const nsecs_t *a, const nsecs_t *b) {
+    return (*a > *b) - (*a < *b);
+}
+
+void sortLatencies(Vector<nsecs_t> &latencies) {
+    latencies.sort(compareLatency);
+}
+
+nsecs_t latencyPercentile(const Vector<nsecs_t> &sorted, int percentile) {
+    if (sorted.isEmpty()) return 0;
+    return sorted[(sorted.size() - 1) * percentile / 100];
+}
+
+}; // namespace android
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_BENCHUTILS_H
+#define ANDROID_SERVERS_CAMERA_BENCHUTILS_H
+
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+/**
+ * Command line handling shared by the camera benchmarks. Each option takes
+ * an argument; -h prints the usage.
+ */
+class BenchOptions {
+  public:
+    /**
+     * operands describes the arguments after the options for the usage,
+     * e.g. "[scenario...]", and operandsHelp explains them. With no
+     * operands, any argument after the options is an error.
+     */
+    BenchOptions(const char *operands = NULL, const char *operandsHelp = NULL);
+
+    // An option with an integer argument of at least minValue
+    void addInt(char letter, const char *argName, const char *help,
+            int *value, int minValue);
+
+    // An option with a string argument, checked by the caller
+    void addString(char letter, const char *argName, const char *help,
+            const char **value);
+
+    /**
+     * Parses the options, leaving optind at the first operand. Prints the
+     * usage and returns false if they aren't valid.
+     */
+    bool parse(int argc, char **argv);
+
+    // Prints the usage, for arguments the caller finds invalid
+    void usage() const;
+
+  private:
+    struct Option {
+        char letter;
+        const char *argName;
+        const char *help;
+        int *intValue;
+        int minValue;
+        const char **stringValue;
+    };
+
+    const char *mOperands;
+    const char *mOperandsHelp;
+    const char *mName;
+    Vector<Option> mOptions;
+};
+
+// Sorts latencies, shortest first
+void sortLatencies(Vector<nsecs_t> &latencies);
+
+// Returns the given percentile of latencies sorted by sortLatencies()
+nsecs_t latencyPercentile(const Vector<nsecs_t> &sorted, int percentile);
+
+}; // namespace android
+
+#endif
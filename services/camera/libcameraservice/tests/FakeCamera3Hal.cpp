@@ -0,0 +1,613 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FakeCamera3Hal"
+//#define LOG_NDEBUG 0
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/String8.h>
+#include <hardware/gralloc.h>
+#include <sync/sync.h>
+
+#include "FakeCamera3Hal.h"
+
+namespace android {
+
+static const int kFenceTimeoutMs = 1000;
+
+static Mutex sModuleLock;
+static camera_module_t sModule;
+static hw_module_methods_t sModuleMethods;
+static FakeCamera3Hal::Config sConfig;
+static camera_metadata_t *sStaticInfo = NULL;
+// The open device, if any. Guarded by sModuleLock
+static FakeCamera3Hal *sOpenDevice = NULL;
+
+camera3_device_ops_t FakeCamera3Hal::sOps = {
+    FakeCamera3Hal::sInitialize,
+    FakeCamera3Hal::sConfigureStreams,
+    FakeCamera3Hal::sRegisterStreamBuffers,
+    FakeCamera3Hal::sConstructDefaultRequestSettings,
+    FakeCamera3Hal::sProcessCaptureRequest,
+    FakeCamera3Hal::sGetMetadataVendorTagOps,
+    FakeCamera3Hal::sDump,
+    FakeCamera3Hal::sFlush,
+    {0}
+};
+
+camera_module_t* FakeCamera3Hal::getModule(const Config &config) {
+    Mutex::Autolock l(sModuleLock);
+
+    sConfig = config;
+
+    CameraMetadata info;
+    uint8_t facing = ANDROID_LENS_FACING_BACK;
+    info.update(ANDROID_LENS_FACING, &facing, 1);
+    int32_t orientation = 90;
+    info.update(ANDROID_SENSOR_ORIENTATION, &orientation, 1);
+    int32_t sizes[] = { (int32_t)config.width, (int32_t)config.height };
+    info.update(ANDROID_SCALER_AVAILABLE_PROCESSED_SIZES, sizes, 2);
+    info.update(ANDROID_SCALER_AVAILABLE_JPEG_SIZES, sizes, 2);
+    int64_t minDuration = config.frameDuration;
+    info.update(ANDROID_SCALER_AVAILABLE_PROCESSED_MIN_DURATIONS,
+            &minDuration, 1);
+    info.update(ANDROID_SCALER_AVAILABLE_JPEG_MIN_DURATIONS, &minDuration, 1);
+    int32_t maxJpegSize = config.width * config.height * 3 / 2;
+    info.update(ANDROID_JPEG_MAX_SIZE, &maxJpegSize, 1);
+    uint8_t partialQuirk = 0;
+    info.update(ANDROID_QUIRKS_USE_PARTIAL_RESULT, &partialQuirk, 1);
+
+    // The rest is what api1 clients need to build their parameters; the
+    // sensor is exactly as large as the configured frame size
+    int32_t activeArray[] = {
+        0, 0, (int32_t)config.width, (int32_t)config.height
+    };
+    info.update(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE, activeArray, 4);
+    float physicalSize[] = { 4.69f, 3.52f };
+    info.update(ANDROID_SENSOR_INFO_PHYSICAL_SIZE, physicalSize, 2);
+    int32_t formats[] = {
+        HAL_PIXEL_FORMAT_YCrCb_420_SP,
+        HAL_PIXEL_FORMAT_YV12,
+        HAL_PIXEL_FORMAT_BLOB,
+        HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+    };
+    info.update(ANDROID_SCALER_AVAILABLE_FORMATS, formats,
+            sizeof(formats) / sizeof(formats[0]));
+    float maxZoom = 4.f;
+    info.update(ANDROID_SCALER_AVAILABLE_MAX_DIGITAL_ZOOM, &maxZoom, 1);
+    int32_t thumbSizes[] = { 0, 0,  320, 240 };
+    info.update(ANDROID_JPEG_AVAILABLE_THUMBNAIL_SIZES, thumbSizes,
+            sizeof(thumbSizes) / sizeof(thumbSizes[0]));
+
+    int32_t fps = (int32_t)(1000000000LL / config.frameDuration);
+    int32_t fpsRange[] = { fps, fps };
+    info.update(ANDROID_CONTROL_AE_AVAILABLE_TARGET_FPS_RANGES, fpsRange, 2);
+    int32_t compensationRange[] = { -6, 6 };
+    info.update(ANDROID_CONTROL_AE_COMPENSATION_RANGE, compensationRange, 2);
+    camera_metadata_rational_t compensationStep = { 1, 3 };
+    info.update(ANDROID_CONTROL_AE_COMPENSATION_STEP, &compensationStep, 1);
+    int32_t maxRegions = 1;
+    info.update(ANDROID_CONTROL_MAX_REGIONS, &maxRegions, 1);
+    uint8_t aeModes[] = {
+        ANDROID_CONTROL_AE_MODE_OFF,
+        ANDROID_CONTROL_AE_MODE_ON,
+    };
+    info.update(ANDROID_CONTROL_AE_AVAILABLE_MODES, aeModes,
+            sizeof(aeModes) / sizeof(aeModes[0]));
+    uint8_t afModes[] = {
+        ANDROID_CONTROL_AF_MODE_OFF,
+        ANDROID_CONTROL_AF_MODE_AUTO,
+        ANDROID_CONTROL_AF_MODE_CONTINUOUS_VIDEO,
+        ANDROID_CONTROL_AF_MODE_CONTINUOUS_PICTURE,
+    };
+    info.update(ANDROID_CONTROL_AF_AVAILABLE_MODES, afModes,
+            sizeof(afModes) / sizeof(afModes[0]));
+    uint8_t awbModes[] = {
+        ANDROID_CONTROL_AWB_MODE_AUTO,
+        ANDROID_CONTROL_AWB_MODE_DAYLIGHT,
+    };
+    info.update(ANDROID_CONTROL_AWB_AVAILABLE_MODES, awbModes,
+            sizeof(awbModes) / sizeof(awbModes[0]));
+    uint8_t effect = ANDROID_CONTROL_EFFECT_MODE_OFF;
+    info.update(ANDROID_CONTROL_AVAILABLE_EFFECTS, &effect, 1);
+    uint8_t antibanding = ANDROID_CONTROL_AE_ANTIBANDING_MODE_AUTO;
+    info.update(ANDROID_CONTROL_AE_AVAILABLE_ANTIBANDING_MODES,
+            &antibanding, 1);
+    uint8_t stabilization = ANDROID_CONTROL_VIDEO_STABILIZATION_MODE_OFF;
+    info.update(ANDROID_CONTROL_AVAILABLE_VIDEO_STABILIZATION_MODES,
+            &stabilization, 1);
+
+    uint8_t flash = 0;
+    info.update(ANDROID_FLASH_INFO_AVAILABLE, &flash, 1);
+    float focalLength = 3.97f;
+    info.update(ANDROID_LENS_INFO_AVAILABLE_FOCAL_LENGTHS, &focalLength, 1);
+    float minFocusDistance = 10.f;
+    info.update(ANDROID_LENS_INFO_MINIMUM_FOCUS_DISTANCE,
+            &minFocusDistance, 1);
+    uint8_t faceMode = ANDROID_STATISTICS_FACE_DETECT_MODE_OFF;
+    info.update(ANDROID_STATISTICS_INFO_AVAILABLE_FACE_DETECT_MODES,
+            &faceMode, 1);
+    int32_t maxFaces = 0;
+    info.update(ANDROID_STATISTICS_INFO_MAX_FACE_COUNT, &maxFaces, 1);
+
+    // Devices opened earlier keep pointing at the old static info, so it's
+    // never freed; there is only one per configuration.
+    sStaticInfo = info.release();
+
+    memset(&sModuleMethods, 0, sizeof(sModuleMethods));
+    sModuleMethods.open = sOpen;
+
+    memset(&sModule, 0, sizeof(sModule));
+    sModule.common.tag = HARDWARE_MODULE_TAG;
+    sModule.common.module_api_version = CAMERA_MODULE_API_VERSION_2_0;
+    sModule.common.hal_api_version = HARDWARE_HAL_API_VERSION;
+    sModule.common.id = CAMERA_HARDWARE_MODULE_ID;
+    sModule.common.name = "Fake camera3 HAL";
+    sModule.common.author = "The Android Open Source Project";
+    sModule.common.methods = &sModuleMethods;
+    sModule.get_number_of_cameras = sGetNumberOfCameras;
+    sModule.get_camera_info = sGetCameraInfo;
+
+    return &sModule;
+}
+
+nsecs_t FakeCamera3Hal::getCpuTime() {
+    Mutex::Autolock l(sModuleLock);
+    if (sOpenDevice == NULL) return 0;
+
+    Mutex::Autolock dl(sOpenDevice->mLock);
+    return sOpenDevice->mCpuTime;
+}
+
+FakeCamera3Hal::FakeCamera3Hal(const Config &config,
+        const hw_module_t *module) :
+        Thread(/*canCallJava*/false),
+        mConfig(config),
+        mCallbackOps(NULL),
+        mInFlight(0),
+        mFlushing(false),
+        mCpuTime(0),
+        mNextFrameTime(0) {
+    memset(&mDevice, 0, sizeof(mDevice));
+    mDevice.common.tag = HARDWARE_DEVICE_TAG;
+    mDevice.common.version = CAMERA_DEVICE_API_VERSION_3_0;
+    mDevice.common.module = const_cast<hw_module_t*>(module);
+    mDevice.common.close = sClose;
+    mDevice.ops = &sOps;
+    mDevice.priv = this;
+
+    memset(mTemplates, 0, sizeof(mTemplates));
+}
+
+FakeCamera3Hal::~FakeCamera3Hal() {
+    for (size_t i = 0; i < CAMERA3_TEMPLATE_COUNT; i++) {
+        if (mTemplates[i] != NULL) free_camera_metadata(mTemplates[i]);
+    }
+}
+
+bool FakeCamera3Hal::threadLoop() {
+    Capture capture;
+    bool flushing;
+    {
+        Mutex::Autolock l(mLock);
+        while (mQueue.empty()) {
+            mQueueSignal.waitRelative(mLock, kWaitDuration);
+            if (exitPending()) return false;
+        }
+        List<Capture>::iterator next = mQueue.begin();
+        capture.frameNumber = next->frameNumber;
+        capture.settings.acquire(next->settings);
+        capture.buffers = next->buffers;
+        mQueue.erase(next);
+        flushing = mFlushing;
+    }
+
+    // Frames come out at the sensor's rate. After an idle period or a
+    // hiccup the sensor doesn't burst to catch up, and while flushing there
+    // is no point in waiting at all.
+    nsecs_t now = systemTime();
+    if (mNextFrameTime > now && !flushing) {
+        nsecs_t wait = mNextFrameTime - now;
+        struct timespec t;
+        t.tv_sec = wait / 1000000000LL;
+        t.tv_nsec = wait % 1000000000LL;
+        nanosleep(&t, NULL);
+    } else {
+        mNextFrameTime = now;
+    }
+    nsecs_t timestamp = mNextFrameTime;
+    mNextFrameTime += mConfig.frameDuration;
+
+    nsecs_t cpuTime;
+    if (mConfig.errorInterval > 0 &&
+            (capture.frameNumber + 1) % mConfig.errorInterval == 0) {
+        cpuTime = failFrame(capture);
+    } else {
+        cpuTime = produceFrame(capture, timestamp);
+    }
+
+    {
+        Mutex::Autolock l(mLock);
+        mInFlight--;
+        mCpuTime += cpuTime;
+        // Both process_capture_request and flush wait on this
+        mSpaceSignal.broadcast();
+    }
+    return true;
+}
+
+nsecs_t FakeCamera3Hal::produceFrame(Capture &capture, nsecs_t timestamp) {
+    // The callbacks run framework code, which doesn't count as HAL time
+    nsecs_t cpuTime = -systemTime(SYSTEM_TIME_THREAD);
+
+    if (!capture.settings.isEmpty()) {
+        mCurrentSettings.acquire(capture.settings);
+    }
+
+    camera3_notify_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CAMERA3_MSG_SHUTTER;
+    msg.message.shutter.frame_number = capture.frameNumber;
+    msg.message.shutter.timestamp = timestamp;
+    cpuTime += systemTime(SYSTEM_TIME_THREAD);
+    mCallbackOps->notify(mCallbackOps, &msg);
+    cpuTime -= systemTime(SYSTEM_TIME_THREAD);
+
+    // The result echoes the settings, plus what the sensor and 3A did
+    CameraMetadata result(mCurrentSettings);
+    result.update(ANDROID_SENSOR_TIMESTAMP, &timestamp, 1);
+    int64_t frameDuration = mConfig.frameDuration;
+    result.update(ANDROID_SENSOR_FRAME_DURATION, &frameDuration, 1);
+    uint8_t aeState = ANDROID_CONTROL_AE_STATE_CONVERGED;
+    result.update(ANDROID_CONTROL_AE_STATE, &aeState, 1);
+    uint8_t afState = ANDROID_CONTROL_AF_STATE_INACTIVE;
+    result.update(ANDROID_CONTROL_AF_STATE, &afState, 1);
+    uint8_t awbState = ANDROID_CONTROL_AWB_STATE_CONVERGED;
+    result.update(ANDROID_CONTROL_AWB_STATE, &awbState, 1);
+
+    // The buffers are handed back as they came; only the fences need care
+    releaseBuffers(capture, CAMERA3_BUFFER_STATUS_OK);
+
+    camera3_capture_result_t captureResult;
+    memset(&captureResult, 0, sizeof(captureResult));
+    captureResult.frame_number = capture.frameNumber;
+    captureResult.result = result.getAndLock();
+    captureResult.num_output_buffers = capture.buffers.size();
+    captureResult.output_buffers = capture.buffers.array();
+    cpuTime += systemTime(SYSTEM_TIME_THREAD);
+    mCallbackOps->process_capture_result(mCallbackOps, &captureResult);
+    cpuTime -= systemTime(SYSTEM_TIME_THREAD);
+    result.unlock(captureResult.result);
+
+    return cpuTime + systemTime(SYSTEM_TIME_THREAD);
+}
+
+nsecs_t FakeCamera3Hal::failFrame(Capture &capture) {
+    nsecs_t cpuTime = -systemTime(SYSTEM_TIME_THREAD);
+
+    if (!capture.settings.isEmpty()) {
+        mCurrentSettings.acquire(capture.settings);
+    }
+
+    // No shutter and no metadata, only the buffers come back
+    camera3_notify_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = CAMERA3_MSG_ERROR;
+    msg.message.error.frame_number = capture.frameNumber;
+    msg.message.error.error_stream = NULL;
+    msg.message.error.error_code = CAMERA3_MSG_ERROR_REQUEST;
+    cpuTime += systemTime(SYSTEM_TIME_THREAD);
+    mCallbackOps->notify(mCallbackOps, &msg);
+    cpuTime -= systemTime(SYSTEM_TIME_THREAD);
+
+    releaseBuffers(capture, CAMERA3_BUFFER_STATUS_ERROR);
+
+    camera3_capture_result_t captureResult;
+    memset(&captureResult, 0, sizeof(captureResult));
+    captureResult.frame_number = capture.frameNumber;
+    captureResult.result = NULL;
+    captureResult.num_output_buffers = capture.buffers.size();
+    captureResult.output_buffers = capture.buffers.array();
+    cpuTime += systemTime(SYSTEM_TIME_THREAD);
+    mCallbackOps->process_capture_result(mCallbackOps, &captureResult);
+    cpuTime -= systemTime(SYSTEM_TIME_THREAD);
+
+    return cpuTime + systemTime(SYSTEM_TIME_THREAD);
+}
+
+void FakeCamera3Hal::releaseBuffers(Capture &capture, int status) {
+    for (size_t i = 0; i < capture.buffers.size(); i++) {
+        camera3_stream_buffer_t &buffer = capture.buffers.editItemAt(i);
+        buffer.status = status;
+        if (buffer.acquire_fence != -1) {
+            if (sync_wait(buffer.acquire_fence, kFenceTimeoutMs) != 0) {
+                ALOGE("%s: Timed out waiting on acquire fence for frame %d",
+                        __FUNCTION__, capture.frameNumber);
+                buffer.status = CAMERA3_BUFFER_STATUS_ERROR;
+            }
+            ::close(buffer.acquire_fence);
+            buffer.acquire_fence = -1;
+        }
+        buffer.release_fence = -1;
+    }
+}
+
+int FakeCamera3Hal::initialize(const camera3_callback_ops_t *callbackOps) {
+    if (callbackOps == NULL) return -EINVAL;
+    mCallbackOps = callbackOps;
+    return OK;
+}
+
+int FakeCamera3Hal::configureStreams(
+        camera3_stream_configuration_t *streamList) {
+    if (streamList == NULL || streamList->num_streams == 0) return -EINVAL;
+
+    // Nothing is ever drawn into the buffers, so any format and size goes
+    for (size_t i = 0; i < streamList->num_streams; i++) {
+        camera3_stream_t *stream = streamList->streams[i];
+        switch (stream->stream_type) {
+            case CAMERA3_STREAM_OUTPUT:
+                stream->usage = GRALLOC_USAGE_HW_CAMERA_WRITE;
+                break;
+            case CAMERA3_STREAM_INPUT:
+                stream->usage = GRALLOC_USAGE_HW_CAMERA_READ;
+                break;
+            case CAMERA3_STREAM_BIDIRECTIONAL:
+                stream->usage = GRALLOC_USAGE_HW_CAMERA_READ |
+                        GRALLOC_USAGE_HW_CAMERA_WRITE;
+                break;
+            default:
+                ALOGE("%s: Unknown type %d for stream %d", __FUNCTION__,
+                        stream->stream_type, i);
+                return -EINVAL;
+        }
+        stream->max_buffers = mConfig.pipelineDepth;
+    }
+    return OK;
+}
+
+const camera_metadata_t* FakeCamera3Hal::constructDefaultRequestSettings(
+        int type) {
+    if (type < CAMERA3_TEMPLATE_PREVIEW || type >= CAMERA3_TEMPLATE_COUNT) {
+        return NULL;
+    }
+    if (mTemplates[type] != NULL) return mTemplates[type];
+
+    uint8_t intent;
+    uint8_t afMode = ANDROID_CONTROL_AF_MODE_CONTINUOUS_PICTURE;
+    switch (type) {
+        case CAMERA3_TEMPLATE_PREVIEW:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW;
+            break;
+        case CAMERA3_TEMPLATE_STILL_CAPTURE:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_STILL_CAPTURE;
+            break;
+        case CAMERA3_TEMPLATE_VIDEO_RECORD:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_VIDEO_RECORD;
+            afMode = ANDROID_CONTROL_AF_MODE_CONTINUOUS_VIDEO;
+            break;
+        case CAMERA3_TEMPLATE_VIDEO_SNAPSHOT:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_VIDEO_SNAPSHOT;
+            afMode = ANDROID_CONTROL_AF_MODE_CONTINUOUS_VIDEO;
+            break;
+        default:
+            intent = ANDROID_CONTROL_CAPTURE_INTENT_ZERO_SHUTTER_LAG;
+            break;
+    }
+
+    CameraMetadata settings;
+    int32_t requestId = 0;
+    settings.update(ANDROID_REQUEST_ID, &requestId, 1);
+    uint8_t metadataMode = ANDROID_REQUEST_METADATA_MODE_FULL;
+    settings.update(ANDROID_REQUEST_METADATA_MODE, &metadataMode, 1);
+    settings.update(ANDROID_CONTROL_CAPTURE_INTENT, &intent, 1);
+    uint8_t controlMode = ANDROID_CONTROL_MODE_AUTO;
+    settings.update(ANDROID_CONTROL_MODE, &controlMode, 1);
+    uint8_t aeMode = ANDROID_CONTROL_AE_MODE_ON;
+    settings.update(ANDROID_CONTROL_AE_MODE, &aeMode, 1);
+    settings.update(ANDROID_CONTROL_AF_MODE, &afMode, 1);
+    uint8_t awbMode = ANDROID_CONTROL_AWB_MODE_AUTO;
+    settings.update(ANDROID_CONTROL_AWB_MODE, &awbMode, 1);
+    int32_t triggerId = 0;
+    settings.update(ANDROID_CONTROL_AF_TRIGGER_ID, &triggerId, 1);
+    settings.update(ANDROID_CONTROL_AE_PRECAPTURE_ID, &triggerId, 1);
+    int64_t exposureTime = mConfig.frameDuration / 2;
+    settings.update(ANDROID_SENSOR_EXPOSURE_TIME, &exposureTime, 1);
+    int64_t frameDuration = mConfig.frameDuration;
+    settings.update(ANDROID_SENSOR_FRAME_DURATION, &frameDuration, 1);
+    int32_t sensitivity = 100;
+    settings.update(ANDROID_SENSOR_SENSITIVITY, &sensitivity, 1);
+
+    mTemplates[type] = settings.release();
+    return mTemplates[type];
+}
+
+int FakeCamera3Hal::processCaptureRequest(
+        camera3_capture_request_t *request) {
+    if (request == NULL || request->num_output_buffers == 0) return -EINVAL;
+    if (request->input_buffer != NULL) {
+        ALOGE("%s: Reprocessing is not supported", __FUNCTION__);
+        return -EINVAL;
+    }
+
+    Mutex::Autolock l(mLock);
+
+    // Like a real pipeline, only so many requests fit in at once
+    while (mInFlight >= mConfig.pipelineDepth) {
+        mSpaceSignal.waitRelative(mLock, kWaitDuration);
+        if (exitPending()) return -ENODEV;
+    }
+
+    List<Capture>::iterator capture = mQueue.insert(mQueue.end(), Capture());
+    capture->frameNumber = request->frame_number;
+    if (request->settings != NULL) {
+        capture->settings = request->settings;
+    }
+    capture->buffers.appendArray(request->output_buffers,
+            request->num_output_buffers);
+    mInFlight++;
+    mQueueSignal.signal();
+
+    return OK;
+}
+
+void FakeCamera3Hal::dump(int fd) {
+    String8 lines;
+    Mutex::Autolock l(mLock);
+    lines.appendFormat("    Fake camera3 HAL: %dx%d, frame duration %lld us, "
+            "pipeline depth %d\n", mConfig.width, mConfig.height,
+            ns2us(mConfig.frameDuration), mConfig.pipelineDepth);
+    if (mConfig.errorInterval > 0) {
+        lines.appendFormat("      Failing every %d requests\n",
+                mConfig.errorInterval);
+    }
+    lines.appendFormat("      %d requests in flight, producer CPU %lld us\n",
+            mInFlight, ns2us(mCpuTime));
+    write(fd, lines.string(), lines.size());
+}
+
+int FakeCamera3Hal::flush() {
+    Mutex::Autolock l(mLock);
+
+    // Everything queued comes out as fast as the framework takes it
+    mFlushing = true;
+    while (mInFlight > 0) {
+        mSpaceSignal.waitRelative(mLock, kWaitDuration);
+    }
+    mFlushing = false;
+
+    return OK;
+}
+
+int FakeCamera3Hal::close() {
+    {
+        Mutex::Autolock l(sModuleLock);
+        if (sOpenDevice == this) sOpenDevice = NULL;
+    }
+
+    requestExit();
+    {
+        Mutex::Autolock l(mLock);
+        mQueueSignal.signal();
+        mSpaceSignal.broadcast();
+    }
+    join();
+
+    // Drop the reference taken in sOpen; this may delete the device
+    decStrong(&sModule);
+    return OK;
+}
+
+FakeCamera3Hal* FakeCamera3Hal::getInstance(const camera3_device *device) {
+    return static_cast<FakeCamera3Hal*>(device->priv);
+}
+
+/**
+ * Static trampolines
+ */
+
+int FakeCamera3Hal::sOpen(const hw_module_t *module, const char *name,
+        hw_device_t **device) {
+    if (name == NULL || atoi(name) != 0) return -EINVAL;
+
+    Mutex::Autolock l(sModuleLock);
+    if (sOpenDevice != NULL) {
+        ALOGE("%s: Camera 0 is already open", __FUNCTION__);
+        return -EBUSY;
+    }
+
+    FakeCamera3Hal *hal = new FakeCamera3Hal(sConfig, module);
+    // The framework owns the device until it calls close()
+    hal->incStrong(&sModule);
+    status_t res = hal->run("FakeCamera3Hal");
+    if (res != OK) {
+        ALOGE("%s: Unable to start frame thread: %s (%d)", __FUNCTION__,
+                strerror(-res), res);
+        hal->decStrong(&sModule);
+        return res;
+    }
+    sOpenDevice = hal;
+
+    *device = &hal->mDevice.common;
+    return OK;
+}
+
+int FakeCamera3Hal::sGetNumberOfCameras() {
+    return 1;
+}
+
+int FakeCamera3Hal::sGetCameraInfo(int id, camera_info *info) {
+    if (id != 0 || info == NULL) return -EINVAL;
+
+    Mutex::Autolock l(sModuleLock);
+    info->facing = CAMERA_FACING_BACK;
+    info->orientation = 90;
+    info->device_version = CAMERA_DEVICE_API_VERSION_3_0;
+    info->static_camera_characteristics = sStaticInfo;
+    return OK;
+}
+
+int FakeCamera3Hal::sClose(hw_device_t *device) {
+    camera3_device_t *dev = reinterpret_cast<camera3_device_t*>(device);
+    return getInstance(dev)->close();
+}
+
+int FakeCamera3Hal::sInitialize(const camera3_device *device,
+        const camera3_callback_ops_t *callbackOps) {
+    return getInstance(device)->initialize(callbackOps);
+}
+
+int FakeCamera3Hal::sConfigureStreams(const camera3_device *device,
+        camera3_stream_configuration_t *streamList) {
+    return getInstance(device)->configureStreams(streamList);
+}
+
+int FakeCamera3Hal::sRegisterStreamBuffers(const camera3_device * /*device*/,
+        const camera3_stream_buffer_set_t * /*bufferSet*/) {
+    // The buffers are never mapped, so there is nothing to register
+    return OK;
+}
+
+const camera_metadata_t* FakeCamera3Hal::sConstructDefaultRequestSettings(
+        const camera3_device *device, int type) {
+    return getInstance(device)->constructDefaultRequestSettings(type);
+}
+
+int FakeCamera3Hal::sProcessCaptureRequest(const camera3_device *device,
+        camera3_capture_request_t *request) {
+    return getInstance(device)->processCaptureRequest(request);
+}
+
+void FakeCamera3Hal::sGetMetadataVendorTagOps(
+        const camera3_device * /*device*/, vendor_tag_query_ops_t * /*ops*/) {
+    // No vendor tags
+}
+
+void FakeCamera3Hal::sDump(const camera3_device *device, int fd) {
+    getInstance(device)->dump(fd);
+}
+
+int FakeCamera3Hal::sFlush(const camera3_device *device) {
+    return getInstance(device)->flush();
+}
+
+}; // namespace android
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_FAKECAMERA3HAL_H
+#define ANDROID_SERVERS_CAMERA_FAKECAMERA3HAL_H
+
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <hardware/camera3.h>
+#include <camera/CameraMetadata.h>
+
+namespace android {
+
+/**
+ * An in-process camera3 HAL device without any hardware behind it, for
+ * load-testing the camera service. Frames are produced at a fixed rate with
+ * plausible result metadata. Output buffers are handed back untouched - they
+ * are never mapped or written - so the HAL itself costs next to nothing and
+ * a benchmark measures the service. Any buffer handle will do, including
+ * the ones LocalServices allocates without gralloc. The static metadata is
+ * complete enough for Camera2Client to build its parameters.
+ */
+class FakeCamera3Hal : public Thread {
+  public:
+    struct Config {
+        uint32_t width;
+        uint32_t height;
+        nsecs_t  frameDuration;
+        // How many requests process_capture_request() accepts before it
+        // blocks, and the max_buffers of every stream
+        uint32_t pipelineDepth;
+        // Every this many frames, the request fails with ERROR_REQUEST and
+        // its buffers come back as errors. 0 for no failures.
+        uint32_t errorInterval;
+
+        Config() :
+                width(1920),
+                height(1080),
+                frameDuration(33333333), // 30 fps
+                pipelineDepth(4),
+                errorInterval(0) {
+        }
+    };
+
+    /**
+     * Returns a HAL module with a single camera, ID 0, whose devices are
+     * opened with the given configuration. The module is shared, so only the
+     * last configuration given takes effect.
+     */
+    static camera_module_t* getModule(const Config &config);
+
+    /**
+     * CPU time the currently open device has spent on its own work, not
+     * counting the framework code its callbacks run, to subtract from the
+     * process CPU time. 0 if no device is open.
+     */
+    static nsecs_t getCpuTime();
+
+    virtual ~FakeCamera3Hal();
+
+  private:
+    FakeCamera3Hal(const Config &config, const hw_module_t *module);
+
+    static const nsecs_t kWaitDuration = 10000000; // 10 ms
+
+    // A capture request accepted from the framework
+    struct Capture {
+        uint32_t frameNumber;
+        // Empty if the request had NULL settings, i.e. the last ones apply
+        CameraMetadata settings;
+        Vector<camera3_stream_buffer_t> buffers;
+    };
+
+    const Config               mConfig;
+    camera3_device_t           mDevice;
+    const camera3_callback_ops_t *mCallbackOps;
+
+    camera_metadata_t         *mTemplates[CAMERA3_TEMPLATE_COUNT];
+
+    Mutex                      mLock;
+    Condition                  mQueueSignal;
+    Condition                  mSpaceSignal;
+    List<Capture>              mQueue;
+    // Accepted requests whose results haven't been sent yet
+    uint32_t                   mInFlight;
+    bool                       mFlushing;
+    // See getCpuTime()
+    nsecs_t                    mCpuTime;
+
+    /**** Only used by the frame producing thread ****/
+    CameraMetadata             mCurrentSettings;
+    nsecs_t                    mNextFrameTime;
+
+    virtual bool threadLoop();
+
+    // Sends the shutter notification and the result for a capture. Returns
+    // the CPU time spent outside of the framework callbacks.
+    nsecs_t produceFrame(Capture &capture, nsecs_t timestamp);
+    // Sends ERROR_REQUEST for a capture instead, and returns its buffers
+    nsecs_t failFrame(Capture &capture);
+    // Waits on the acquire fences of a capture's buffers before they go
+    // back, marking the buffers with the given status
+    void releaseBuffers(Capture &capture, int status);
+
+    int initialize(const camera3_callback_ops_t *callbackOps);
+    int configureStreams(camera3_stream_configuration_t *streamList);
+    const camera_metadata_t* constructDefaultRequestSettings(int type);
+    int processCaptureRequest(camera3_capture_request_t *request);
+    void dump(int fd);
+    int flush();
+    int close();
+
+    static FakeCamera3Hal* getInstance(const camera3_device *device);
+
+    /**
+     * Static trampolines for the camera3 HAL and module interfaces
+     */
+    static int sOpen(const hw_module_t *module, const char *name,
+            hw_device_t **device);
+    static int sGetNumberOfCameras();
+    static int sGetCameraInfo(int id, camera_info *info);
+    static int sClose(hw_device_t *device);
+
+    static int sInitialize(const camera3_device *device,
+            const camera3_callback_ops_t *callbackOps);
+    static int sConfigureStreams(const camera3_device *device,
+            camera3_stream_configuration_t *streamList);
+    static int sRegisterStreamBuffers(const camera3_device *device,
+            const camera3_stream_buffer_set_t *bufferSet);
+    static const camera_metadata_t* sConstructDefaultRequestSettings(
+            const camera3_device *device, int type);
+    static int sProcessCaptureRequest(const camera3_device *device,
+            camera3_capture_request_t *request);
+    static void sGetMetadataVendorTagOps(const camera3_device *device,
+            vendor_tag_query_ops_t *ops);
+    static void sDump(const camera3_device *device, int fd);
+    static int sFlush(const camera3_device *device);
+
+    static camera3_device_ops_t sOps;
+};
+
+}; // namespace android
+
+#endif
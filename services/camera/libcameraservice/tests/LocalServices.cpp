@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LocalServices"
+//#define LOG_NDEBUG 0
+
+#include <utils/Log.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/String16.h>
+#include <utils/Vector.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <private/binder/Static.h>
+#include <cutils/ashmem.h>
+#include <cutils/native_handle.h>
+#include <gui/IGraphicBufferAlloc.h>
+#include <gui/ISurfaceComposer.h>
+#include <ui/GraphicBuffer.h>
+
+#include "LocalServices.h"
+
+namespace android {
+
+/**
+ * Allocates graphic buffers from ashmem instead of gralloc, the way the
+ * software gralloc does, but without registering them anywhere. It keeps a
+ * reference to every buffer so it can free the handle once nobody else
+ * holds the buffer anymore.
+ */
+class HeapGraphicBufferAlloc : public BnGraphicBufferAlloc {
+  public:
+    virtual ~HeapGraphicBufferAlloc() {
+        // Only reached at exit, when no buffers are in use anymore
+        for (size_t i = 0; i < mAllocations.size(); i++) {
+            native_handle_close(mAllocations[i].handle);
+            native_handle_delete(mAllocations[i].handle);
+        }
+    }
+
+    virtual sp<GraphicBuffer> createGraphicBuffer(uint32_t w, uint32_t h,
+            PixelFormat format, uint32_t usage, status_t *error) {
+        uint32_t stride;
+        size_t size = getBufferSize(w, h, format, &stride);
+
+        Mutex::Autolock l(mLock);
+        reclaimLocked();
+
+        int fd = ashmem_create_region("camera-bench-buffer", size);
+        if (fd < 0) {
+            ALOGE("%s: Unable to allocate %zu bytes for a %dx%d buffer",
+                    __FUNCTION__, size, w, h);
+            *error = NO_MEMORY;
+            return NULL;
+        }
+        native_handle_t *handle = native_handle_create(/*numFds*/1,
+                /*numInts*/1);
+        handle->data[0] = fd;
+        handle->data[1] = size;
+
+        // The buffer doesn't own the handle, so it never asks gralloc to
+        // unregister it
+        Allocation allocation;
+        allocation.buffer = new GraphicBuffer(w, h, format, usage, stride,
+                handle, /*keepOwnership*/false);
+        allocation.handle = handle;
+        allocation.size = size;
+        mAllocations.push(allocation);
+
+        ALOGV("%s: %dx%d format 0x%x usage 0x%x, %zu bytes, %zu buffers",
+                __FUNCTION__, w, h, format, usage, size,
+                mAllocations.size());
+        *error = OK;
+        return allocation.buffer;
+    }
+
+    size_t getBufferCount(size_t *totalSize) {
+        Mutex::Autolock l(mLock);
+        reclaimLocked();
+
+        *totalSize = 0;
+        for (size_t i = 0; i < mAllocations.size(); i++) {
+            *totalSize += mAllocations[i].size;
+        }
+        return mAllocations.size();
+    }
+
+  private:
+    struct Allocation {
+        sp<GraphicBuffer> buffer;
+        native_handle_t *handle;
+        size_t size;
+    };
+
+    Mutex mLock;
+    Vector<Allocation> mAllocations;
+
+    // Frees the buffers only this allocator still refers to. Once a buffer
+    // is down to that one reference nobody can take a new one, so the
+    // count can be trusted.
+    void reclaimLocked() {
+        size_t i = 0;
+        while (i < mAllocations.size()) {
+            if (mAllocations[i].buffer->getStrongCount() > 1) {
+                i++;
+                continue;
+            }
+            native_handle_t *handle = mAllocations[i].handle;
+            mAllocations.removeAt(i);
+            native_handle_close(handle);
+            native_handle_delete(handle);
+        }
+    }
+
+    // Enough for any of the formats the camera service asks for
+    static size_t getBufferSize(uint32_t w, uint32_t h, PixelFormat format,
+            uint32_t *stride) {
+        if (format == HAL_PIXEL_FORMAT_BLOB) {
+            // Compressed data, sized by the width
+            *stride = w;
+            return w * h;
+        }
+        *stride = (w + 15) & ~15;
+        switch (format) {
+            case HAL_PIXEL_FORMAT_RGBA_8888:
+            case HAL_PIXEL_FORMAT_RGBX_8888:
+            case HAL_PIXEL_FORMAT_BGRA_8888:
+                return *stride * h * 4;
+            case HAL_PIXEL_FORMAT_RGB_888:
+                return *stride * h * 3;
+            case HAL_PIXEL_FORMAT_RGB_565:
+            case HAL_PIXEL_FORMAT_YCbCr_422_SP:
+            case HAL_PIXEL_FORMAT_YCbCr_422_I:
+            case HAL_PIXEL_FORMAT_RAW_SENSOR:
+                return *stride * h * 2;
+            default:
+                // YUV 4:2:0, which the implementation-defined format is
+                // assumed to be as well. The chroma planes of YV12 are
+                // aligned to 16 bytes too.
+                return *stride * h + 2 * (((*stride / 2) + 15) & ~15) *
+                        ((h + 1) / 2);
+        }
+    }
+};
+
+/**
+ * Stands in for SurfaceFlinger. It only answers the request BufferQueue
+ * makes for an allocator; everything else is an unknown transaction.
+ */
+class LocalComposer : public BBinder {
+  public:
+    LocalComposer(const sp<HeapGraphicBufferAlloc> &allocator) :
+            mAllocator(allocator) {
+    }
+
+    virtual const String16& getInterfaceDescriptor() const {
+        return ISurfaceComposer::descriptor;
+    }
+
+  protected:
+    virtual status_t onTransact(uint32_t code, const Parcel &data,
+            Parcel *reply, uint32_t flags) {
+        if (code != BnSurfaceComposer::CREATE_GRAPHIC_BUFFER_ALLOC) {
+            ALOGW("%s: Transaction %d not supported", __FUNCTION__, code);
+            return BBinder::onTransact(code, data, reply, flags);
+        }
+        if (!data.enforceInterface(ISurfaceComposer::descriptor)) {
+            return PERMISSION_DENIED;
+        }
+        // One allocator for the whole process, so buffers outlive the
+        // queue they came from without any trouble
+        reply->writeStrongBinder(mAllocator->asBinder());
+        return NO_ERROR;
+    }
+
+  private:
+    sp<HeapGraphicBufferAlloc> mAllocator;
+};
+
+/**
+ * Serves the local services, and passes the lookups of all others on to
+ * the system service manager.
+ */
+class LocalServiceManager : public BnServiceManager {
+  public:
+    LocalServiceManager(const sp<IServiceManager> &system) :
+            mSystem(system) {
+    }
+
+    virtual sp<IBinder> getService(const String16 &name) const {
+        sp<IBinder> service = getLocalService(name);
+        if (service != 0) return service;
+        return mSystem->getService(name);
+    }
+
+    virtual sp<IBinder> checkService(const String16 &name) const {
+        sp<IBinder> service = getLocalService(name);
+        if (service != 0) return service;
+        return mSystem->checkService(name);
+    }
+
+    virtual status_t addService(const String16 &name,
+            const sp<IBinder> &service, bool /*allowIsolated*/) {
+        Mutex::Autolock l(mLock);
+        mServices.add(name, service);
+        return NO_ERROR;
+    }
+
+    virtual Vector<String16> listServices() {
+        Vector<String16> names = mSystem->listServices();
+        Mutex::Autolock l(mLock);
+        for (size_t i = 0; i < mServices.size(); i++) {
+            names.push(mServices.keyAt(i));
+        }
+        return names;
+    }
+
+  private:
+    sp<IServiceManager> mSystem;
+
+    mutable Mutex mLock;
+    KeyedVector<String16, sp<IBinder> > mServices;
+
+    sp<IBinder> getLocalService(const String16 &name) const {
+        Mutex::Autolock l(mLock);
+        ssize_t index = mServices.indexOfKey(name);
+        if (index < 0) return NULL;
+        return mServices.valueAt(index);
+    }
+};
+
+static Mutex sLock;
+static sp<HeapGraphicBufferAlloc> sAllocator;
+
+void LocalServices::install() {
+    Mutex::Autolock l(sLock);
+    if (sAllocator != 0) return;
+
+    sp<LocalServiceManager> serviceManager =
+            new LocalServiceManager(defaultServiceManager());
+    sAllocator = new HeapGraphicBufferAlloc();
+    serviceManager->addService(String16("SurfaceFlinger"),
+            new LocalComposer(sAllocator), false);
+
+    AutoMutex _l(gDefaultServiceManagerLock);
+    gDefaultServiceManager = serviceManager;
+}
+
+size_t LocalServices::getBufferCount(size_t *totalSize) {
+    Mutex::Autolock l(sLock);
+    if (sAllocator == 0) {
+        *totalSize = 0;
+        return 0;
+    }
+    return sAllocator->getBufferCount(totalSize);
+}
+
+}; // namespace android
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SERVERS_CAMERA_LOCALSERVICES_H
+#define ANDROID_SERVERS_CAMERA_LOCALSERVICES_H
+
+#include <stddef.h>
+
+namespace android {
+
+/**
+ * Lets the camera service run in a benchmark process without SurfaceFlinger
+ * or gralloc. Every BufferQueue created without an allocator - the
+ * benchmark's own consumers as well as the ones Camera3Device and the api1
+ * processors create internally - gets its buffers from an in-process
+ * allocator instead, backed by ashmem. The buffers are never registered
+ * with gralloc, so they can't be locked; consumers have to pass them on
+ * untouched, like FakeCamera3Hal does.
+ *
+ * Other services are still looked up through the system service manager.
+ */
+class LocalServices {
+  public:
+    /**
+     * Puts a local service manager in front of the system one, serving
+     * the local allocator as "SurfaceFlinger". Has to be called before
+     * anything in the process has connected to SurfaceFlinger.
+     */
+    static void install();
+
+    /**
+     * Number of buffers the local allocator has handed out that are still
+     * in use, and the memory they take up.
+     */
+    static size_t getBufferCount(size_t *totalSize);
+};
+
+}; // namespace android
+
+#endif
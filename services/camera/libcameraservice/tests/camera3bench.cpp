@@ -0,0 +1,781 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "camera3bench"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
+#include <binder/IMemory.h>
+#include <binder/ProcessState.h>
+#include <camera/ICameraClient.h>
+#include <gui/BufferItemConsumer.h>
+#include <gui/Surface.h>
+#include <hardware/gralloc.h>
+
+#include "CameraService.h"
+#include "api1/Camera2Client.h"
+#include "common/CaptureResult.h"
+#include "common/FrameProcessorBase.h"
+#include "device3/Camera3Device.h"
+#include "BenchUtils.h"
+#include "FakeCamera3Hal.h"
+#include "LocalServices.h"
+
+/**
+ * Runs Camera3Device against FakeCamera3Hal and reports how well the camera
+ * service keeps up: sustained frame rate, latency percentiles and the CPU
+ * time it spends, for preview, recording, ZSL and burst capture use cases.
+ * Frames go to consumers that return them right away, so neither the HAL nor
+ * the consumers hold anything up. The errors scenario streams preview while
+ * the HAL fails some of the requests, and checks that the device keeps going.
+ *
+ * Those scenarios drive Camera3Device directly and measure the device layer
+ * only. The client scenario runs the whole api1 path instead: a
+ * Camera2Client with its StreamingProcessor, CallbackProcessor and
+ * ZslProcessor3 streams preview, preview callbacks and ZSL, and then
+ * records, with a stub in place of the app.
+ *
+ * Buffers come from LocalServices rather than SurfaceFlinger and gralloc,
+ * so no camera or graphics hardware is needed. The client scenario still
+ * looks up the app ops and media player services the camera service uses,
+ * so it needs a running system.
+ */
+
+namespace android {
+
+using camera2::FrameProcessorBase;
+using camera3::Camera3ZslStream;
+
+static const int32_t kStreamingRequestId = 1;
+static const int32_t kBurstRequestIdStart = 1000;
+static const int32_t kBurstRequestIdEnd = 2000;
+
+static const int kZslDepth = 4;
+static const nsecs_t kWarmUpDuration = 1000000000LL; // 1 s
+static const nsecs_t kBurstTimeout = 10000000000LL; // 10 s
+
+// The errors scenario fails every kErrorInterval-th request and waits for
+// this many results, several times the number of requests Camera3Device
+// tracks at once, so that a failed request still holding its tracking slot
+// would stall the stream.
+static const uint32_t kErrorInterval = 8;
+static const size_t kErrorResults = 256;
+
+/**
+ * Buffer consumer that releases every frame as soon as it arrives, like a
+ * display or encoder that never falls behind. Its CPU time is tracked so it
+ * can be left out of the service's.
+ */
+class BufferSink : public BufferItemConsumer::FrameAvailableListener {
+  public:
+    BufferSink(const char *name, uint32_t usage) :
+            mFrames(0),
+            mCpuTime(0) {
+        mQueue = new BufferQueue();
+        mConsumer = new BufferItemConsumer(mQueue, usage, kBufferCount);
+        mConsumer->setName(String8(name));
+        mWindow = new Surface(mQueue);
+    }
+
+    void start() {
+        mConsumer->setFrameAvailableListener(this);
+    }
+
+    sp<ANativeWindow> window() const { return mWindow; }
+
+    // For clients that make their own window, like Camera2Client does
+    sp<IGraphicBufferProducer> producer() const { return mQueue; }
+
+    size_t frames() {
+        Mutex::Autolock l(mLock);
+        return mFrames;
+    }
+
+    nsecs_t cpuTime() {
+        Mutex::Autolock l(mLock);
+        return mCpuTime;
+    }
+
+    virtual void onFrameAvailable() {
+        nsecs_t start = systemTime(SYSTEM_TIME_THREAD);
+        size_t frames = 0;
+        BufferItemConsumer::BufferItem item;
+        while (mConsumer->acquireBuffer(&item, 0) == OK) {
+            mConsumer->releaseBuffer(item);
+            frames++;
+        }
+
+        Mutex::Autolock l(mLock);
+        mFrames += frames;
+        mCpuTime += systemTime(SYSTEM_TIME_THREAD) - start;
+    }
+
+  private:
+    static const int kBufferCount = 2;
+
+    sp<BufferQueue> mQueue;
+    sp<BufferItemConsumer> mConsumer;
+    sp<ANativeWindow> mWindow;
+
+    Mutex mLock;
+    size_t mFrames;
+    nsecs_t mCpuTime;
+};
+
+/**
+ * Collects the latency of every result the frame processor dispatches while
+ * a measurement is running.
+ */
+class ResultCollector : public FrameProcessorBase::FilteredListener {
+  public:
+    ResultCollector() :
+            mRecording(false),
+            mBurstResults(0),
+            mLastBurstResult(0) {
+    }
+
+    void start(size_t expectedResults) {
+        Mutex::Autolock l(mLock);
+        mStreamingLatencies.clear();
+        mStreamingLatencies.setCapacity(expectedResults);
+        mBurstLatencies.clear();
+        mBurstResults = 0;
+        mRecording = true;
+    }
+
+    void stop() {
+        Mutex::Autolock l(mLock);
+        mRecording = false;
+    }
+
+    // Waits for results to count burst requests. Returns the time the last
+    // one arrived, or 0 on timeout.
+    nsecs_t waitForBurst(size_t count, nsecs_t timeout) {
+        Mutex::Autolock l(mLock);
+        nsecs_t deadline = systemTime() + timeout;
+        while (mBurstResults < count) {
+            nsecs_t now = systemTime();
+            if (now >= deadline) return 0;
+            mResultSignal.waitRelative(mLock, deadline - now);
+        }
+        return mLastBurstResult;
+    }
+
+    // Waits for results to count streaming requests since start(). Returns
+    // false on timeout.
+    bool waitForStreaming(size_t count, nsecs_t timeout) {
+        Mutex::Autolock l(mLock);
+        nsecs_t deadline = systemTime() + timeout;
+        while (mStreamingLatencies.size() < count) {
+            nsecs_t now = systemTime();
+            if (now >= deadline) return false;
+            mResultSignal.waitRelative(mLock, deadline - now);
+        }
+        return true;
+    }
+
+    // Latencies are sorted in place
+    Vector<nsecs_t>& streamingLatencies() { return mStreamingLatencies; }
+    Vector<nsecs_t>& burstLatencies() { return mBurstLatencies; }
+
+    virtual void onResultAvailable(int32_t requestId,
+            const sp<CaptureResult> &result) {
+        nsecs_t now = systemTime();
+
+        Mutex::Autolock l(mLock);
+        if (!mRecording) return;
+
+        nsecs_t latency = now - result->requestTime();
+        if (requestId >= kBurstRequestIdStart &&
+                requestId < kBurstRequestIdEnd) {
+            mBurstLatencies.push(latency);
+            mBurstResults++;
+            mLastBurstResult = now;
+        } else {
+            mStreamingLatencies.push(latency);
+        }
+        mResultSignal.signal();
+    }
+
+  private:
+    Mutex mLock;
+    Condition mResultSignal;
+    bool mRecording;
+    Vector<nsecs_t> mStreamingLatencies;
+    Vector<nsecs_t> mBurstLatencies;
+    size_t mBurstResults;
+    nsecs_t mLastBurstResult;
+};
+
+/**
+ * The app end of an api1 camera. It counts the callbacks it gets and hands
+ * recording frames back from a thread of its own, like a recorder in
+ * another process would; releasing them from the callback itself could
+ * deadlock against a client call that waits for the callback thread.
+ */
+class CameraClientStub : public BnCameraClient, public Thread {
+  public:
+    CameraClientStub() :
+            Thread(/*canCallJava*/false),
+            mRecordingFrames(0),
+            mErrors(0) {
+    }
+
+    // Recording frames go back to camera until stop()
+    void start(const sp<ICamera> &camera) {
+        {
+            Mutex::Autolock l(mLock);
+            mCamera = camera;
+        }
+        run("camera3bench-App");
+    }
+
+    // Returns the frames still outstanding and lets go of the camera
+    void stop() {
+        requestExit();
+        {
+            Mutex::Autolock l(mLock);
+            mFrameSignal.signal();
+        }
+        join();
+
+        Mutex::Autolock l(mLock);
+        mCamera.clear();
+    }
+
+    size_t recordingFrames() {
+        Mutex::Autolock l(mLock);
+        return mRecordingFrames;
+    }
+
+    size_t errors() {
+        Mutex::Autolock l(mLock);
+        return mErrors;
+    }
+
+    virtual void notifyCallback(int32_t msgType, int32_t ext1,
+            int32_t /*ext2*/) {
+        if (msgType != CAMERA_MSG_ERROR) return;
+        ALOGE("%s: Camera error %d", __FUNCTION__, ext1);
+        Mutex::Autolock l(mLock);
+        mErrors++;
+    }
+
+    virtual void dataCallback(int32_t /*msgType*/,
+            const sp<IMemory> & /*data*/,
+            camera_frame_metadata_t * /*metadata*/) {
+    }
+
+    virtual void dataCallbackTimestamp(nsecs_t /*timestamp*/,
+            int32_t msgType, const sp<IMemory> &data) {
+        if (msgType != CAMERA_MSG_VIDEO_FRAME) return;
+        Mutex::Autolock l(mLock);
+        mPendingFrames.push(data);
+        mRecordingFrames++;
+        mFrameSignal.signal();
+    }
+
+  private:
+    static const nsecs_t kWaitDuration = 10000000; // 10 ms
+
+    Mutex mLock;
+    Condition mFrameSignal;
+    sp<ICamera> mCamera;
+    Vector<sp<IMemory> > mPendingFrames;
+    size_t mRecordingFrames;
+    size_t mErrors;
+
+    virtual bool threadLoop() {
+        sp<ICamera> camera;
+        Vector<sp<IMemory> > frames;
+        {
+            // Whatever is pending still goes back after requestExit()
+            Mutex::Autolock l(mLock);
+            while (mPendingFrames.isEmpty()) {
+                if (exitPending()) return false;
+                mFrameSignal.waitRelative(mLock, kWaitDuration);
+            }
+            frames = mPendingFrames;
+            mPendingFrames.clear();
+            camera = mCamera;
+        }
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            camera->releaseRecordingFrame(frames[i]);
+        }
+        return true;
+    }
+};
+
+enum Scenario {
+    SCENARIO_PREVIEW,
+    SCENARIO_RECORD,
+    SCENARIO_ZSL,
+    SCENARIO_BURST,
+    SCENARIO_ERRORS,
+    SCENARIO_CLIENT,
+    SCENARIO_COUNT
+};
+
+static const char *kScenarioNames[SCENARIO_COUNT] = {
+    "preview",
+    "record",
+    "zsl",
+    "burst",
+    "errors",
+    "client"
+};
+
+struct Options {
+    FakeCamera3Hal::Config config;
+    nsecs_t duration;
+    size_t burstCount;
+};
+
+static void printLatencies(const char *name, Vector<nsecs_t> &latencies) {
+    if (latencies.isEmpty()) {
+        printf("  %s latency: no samples\n", name);
+        return;
+    }
+    sortLatencies(latencies);
+    printf("  %s latency: p50 %lld us, p90 %lld us, p99 %lld us, "
+            "max %lld us\n", name,
+            ns2us(latencyPercentile(latencies, 50)),
+            ns2us(latencyPercentile(latencies, 90)),
+            ns2us(latencyPercentile(latencies, 99)),
+            ns2us(latencyPercentile(latencies, 100)));
+}
+
+static void printBuffers() {
+    size_t bufferBytes;
+    size_t buffers = LocalServices::getBufferCount(&bufferBytes);
+    printf("  %zu buffers allocated, %zu KB\n", buffers, bufferBytes / 1024);
+}
+
+static status_t runScenario(Scenario scenario, const Options &options) {
+    status_t res;
+    FakeCamera3Hal::Config config = options.config;
+    if (scenario == SCENARIO_ERRORS) {
+        config.errorInterval = kErrorInterval;
+    }
+
+    sp<Camera3Device> device = new Camera3Device(0);
+    res = device->initialize(FakeCamera3Hal::getModule(config));
+    if (res != OK) {
+        fprintf(stderr, "Unable to open fake camera: %s (%d)\n",
+                strerror(-res), res);
+        return res;
+    }
+
+    sp<FrameProcessorBase> frameProcessor = new FrameProcessorBase(device);
+    frameProcessor->run("camera3bench-Frames");
+    sp<ResultCollector> collector = new ResultCollector();
+    frameProcessor->registerListener(kStreamingRequestId, kBurstRequestIdEnd,
+            collector);
+
+    Vector<sp<BufferSink> > sinks;
+    Vector<int32_t> outputStreams;
+    int streamId;
+    int stillStreamId = -1;
+    int templateId = CAMERA3_TEMPLATE_PREVIEW;
+
+    sp<BufferSink> previewSink = new BufferSink("camera3bench-Preview",
+            GRALLOC_USAGE_HW_TEXTURE);
+    sinks.push(previewSink);
+    res = device->createStream(previewSink->window(), config.width,
+            config.height, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED, 0,
+            &streamId);
+    if (res != OK) goto cleanup;
+    outputStreams.push(streamId);
+
+    if (scenario == SCENARIO_RECORD) {
+        sp<BufferSink> recordSink = new BufferSink("camera3bench-Record",
+                GRALLOC_USAGE_HW_VIDEO_ENCODER);
+        sinks.push(recordSink);
+        res = device->createStream(recordSink->window(), config.width,
+                config.height, HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED, 0,
+                &streamId);
+        if (res != OK) goto cleanup;
+        outputStreams.push(streamId);
+        templateId = CAMERA3_TEMPLATE_VIDEO_RECORD;
+    } else if (scenario == SCENARIO_ZSL) {
+        // The ZSL stream is its own consumer, holding on to the most
+        // recent frames. ZslProcessor3's work on top of it only happens in
+        // the client scenario.
+        sp<Camera3ZslStream> zslStream;
+        res = device->createZslStream(config.width, config.height, kZslDepth,
+                &streamId, &zslStream);
+        if (res != OK) goto cleanup;
+        outputStreams.push(streamId);
+        templateId = CAMERA3_TEMPLATE_ZERO_SHUTTER_LAG;
+    }
+
+    if (scenario == SCENARIO_BURST) {
+        sp<BufferSink> stillSink = new BufferSink("camera3bench-Still",
+                GRALLOC_USAGE_SW_READ_OFTEN);
+        sinks.push(stillSink);
+        res = device->createStream(stillSink->window(), config.width,
+                config.height, HAL_PIXEL_FORMAT_BLOB,
+                config.width * config.height * 3 / 2, &stillStreamId);
+        if (res != OK) goto cleanup;
+    }
+
+    for (size_t i = 0; i < sinks.size(); i++) {
+        sinks[i]->start();
+    }
+
+    {
+        CameraMetadata request;
+        res = device->createDefaultRequest(templateId, &request);
+        if (res != OK) goto cleanup;
+        request.update(ANDROID_REQUEST_OUTPUT_STREAMS, outputStreams.array(),
+                outputStreams.size());
+        request.update(ANDROID_REQUEST_ID, &kStreamingRequestId, 1);
+        res = device->setStreamingRequest(request);
+        if (res != OK) goto cleanup;
+
+        // Let stream configuration and buffer allocation settle first
+        usleep(ns2us(kWarmUpDuration));
+
+        size_t expectedFrames = options.duration / config.frameDuration + 1;
+        collector->start(expectedFrames);
+        Vector<size_t> startFrames;
+        nsecs_t sinkCpuTime = 0;
+        for (size_t i = 0; i < sinks.size(); i++) {
+            startFrames.push(sinks[i]->frames());
+            sinkCpuTime -= sinks[i]->cpuTime();
+        }
+        nsecs_t halCpuTime = -FakeCamera3Hal::getCpuTime();
+        nsecs_t processCpuTime = -systemTime(SYSTEM_TIME_PROCESS);
+        nsecs_t startTime = systemTime();
+        nsecs_t endTime;
+
+        if (scenario == SCENARIO_BURST) {
+            CameraMetadata still;
+            res = device->createDefaultRequest(CAMERA3_TEMPLATE_STILL_CAPTURE,
+                    &still);
+            if (res != OK) goto cleanup;
+            int32_t stillStreams[] = { outputStreams[0], stillStreamId };
+            still.update(ANDROID_REQUEST_OUTPUT_STREAMS, stillStreams, 2);
+            for (size_t i = 0; i < options.burstCount; i++) {
+                int32_t requestId = kBurstRequestIdStart + i;
+                still.update(ANDROID_REQUEST_ID, &requestId, 1);
+                CameraMetadata capture(still);
+                res = device->capture(capture);
+                if (res != OK) goto cleanup;
+            }
+            endTime = collector->waitForBurst(options.burstCount,
+                    kBurstTimeout);
+            if (endTime == 0) {
+                fprintf(stderr, "Timed out waiting for burst results\n");
+                res = TIMED_OUT;
+                goto cleanup;
+            }
+        } else if (scenario == SCENARIO_ERRORS) {
+            // Failed requests have no results, so this takes a bit longer
+            // than kErrorResults frames
+            if (!collector->waitForStreaming(kErrorResults,
+                    kErrorResults * config.frameDuration * 2)) {
+                collector->stop();
+                fprintf(stderr, "Device stalled after %d results\n",
+                        collector->streamingLatencies().size());
+                res = TIMED_OUT;
+                goto cleanup;
+            }
+            endTime = systemTime();
+        } else {
+            usleep(ns2us(options.duration));
+            endTime = systemTime();
+        }
+
+        processCpuTime += systemTime(SYSTEM_TIME_PROCESS);
+        halCpuTime += FakeCamera3Hal::getCpuTime();
+        collector->stop();
+        for (size_t i = 0; i < sinks.size(); i++) {
+            sinkCpuTime += sinks[i]->cpuTime();
+        }
+
+        nsecs_t elapsed = endTime - startTime;
+        nsecs_t serviceCpuTime = processCpuTime - halCpuTime - sinkCpuTime;
+        size_t previewFrames = sinks[0]->frames() - startFrames[0];
+
+        printf("%s: %dx%d, %.1f fps requested, pipeline depth %d\n",
+                kScenarioNames[scenario], config.width, config.height,
+                1e9 / config.frameDuration, config.pipelineDepth);
+        for (size_t i = 0; i < sinks.size(); i++) {
+            size_t frames = sinks[i]->frames() - startFrames[i];
+            printf("  stream %d: %d frames, %.2f fps\n", i, frames,
+                    frames * 1e9 / elapsed);
+        }
+        if (scenario == SCENARIO_ERRORS) {
+            printf("  every %d requests failed, %d results\n",
+                    kErrorInterval, collector->streamingLatencies().size());
+        }
+        if (scenario == SCENARIO_BURST) {
+            printf("  burst of %d captures in %lld ms, %.2f captures/s\n",
+                    options.burstCount, ns2ms(elapsed),
+                    options.burstCount * 1e9 / elapsed);
+            printLatencies("burst", collector->burstLatencies());
+        }
+        printLatencies("result", collector->streamingLatencies());
+        printf("  service CPU: %.1f %% of one core, %lld us per frame "
+                "(process %lld us, fake HAL %lld us, consumers %lld us)\n",
+                serviceCpuTime * 100.0 / elapsed,
+                previewFrames > 0 ?
+                        ns2us(serviceCpuTime) / (nsecs_t)previewFrames : 0,
+                ns2us(processCpuTime), ns2us(halCpuTime),
+                ns2us(sinkCpuTime));
+        printBuffers();
+    }
+
+cleanup:
+    if (res != OK) {
+        fprintf(stderr, "%s: failed: %s (%d)\n", kScenarioNames[scenario],
+                strerror(-res), res);
+    }
+    device->clearStreamingRequest();
+    device->waitUntilDrained();
+    frameProcessor->removeListener(kStreamingRequestId, kBurstRequestIdEnd,
+            collector);
+    frameProcessor->requestExit();
+    frameProcessor->join();
+    device->disconnect();
+
+    return res;
+}
+
+/**
+ * Measures one phase of the client scenario, with Camera2Client already
+ * streaming. The app stub's recording frames count as frames of a stream
+ * of their own.
+ */
+static void measureClientPhase(const char *phase, const Options &options,
+        const Vector<sp<BufferSink> > &sinks, const char **sinkNames,
+        const sp<CameraClientStub> &app, const sp<ResultCollector> &collector) {
+    const FakeCamera3Hal::Config &config = options.config;
+
+    // Let stream configuration and buffer allocation settle first
+    usleep(ns2us(kWarmUpDuration));
+
+    collector->start(options.duration / config.frameDuration + 1);
+    Vector<size_t> startFrames;
+    nsecs_t sinkCpuTime = 0;
+    for (size_t i = 0; i < sinks.size(); i++) {
+        startFrames.push(sinks[i]->frames());
+        sinkCpuTime -= sinks[i]->cpuTime();
+    }
+    size_t startRecordingFrames = app->recordingFrames();
+    nsecs_t halCpuTime = -FakeCamera3Hal::getCpuTime();
+    nsecs_t processCpuTime = -systemTime(SYSTEM_TIME_PROCESS);
+    nsecs_t startTime = systemTime();
+
+    usleep(ns2us(options.duration));
+
+    nsecs_t endTime = systemTime();
+    processCpuTime += systemTime(SYSTEM_TIME_PROCESS);
+    halCpuTime += FakeCamera3Hal::getCpuTime();
+    collector->stop();
+    for (size_t i = 0; i < sinks.size(); i++) {
+        sinkCpuTime += sinks[i]->cpuTime();
+    }
+
+    nsecs_t elapsed = endTime - startTime;
+    nsecs_t serviceCpuTime = processCpuTime - halCpuTime - sinkCpuTime;
+    size_t previewFrames = sinks[0]->frames() - startFrames[0];
+
+    printf("client %s: %dx%d, %.1f fps requested, pipeline depth %d\n",
+            phase, config.width, config.height, 1e9 / config.frameDuration,
+            config.pipelineDepth);
+    for (size_t i = 0; i < sinks.size(); i++) {
+        size_t frames = sinks[i]->frames() - startFrames[i];
+        printf("  %s: %zu frames, %.2f fps\n", sinkNames[i], frames,
+                frames * 1e9 / elapsed);
+    }
+    size_t recordingFrames = app->recordingFrames() - startRecordingFrames;
+    if (recordingFrames > 0) {
+        printf("  recording: %zu frames, %.2f fps\n", recordingFrames,
+                recordingFrames * 1e9 / elapsed);
+    }
+    printLatencies("result", collector->streamingLatencies());
+    printf("  service CPU: %.1f %% of one core, %lld us per frame "
+            "(process %lld us, fake HAL %lld us, consumers %lld us)\n",
+            serviceCpuTime * 100.0 / elapsed,
+            previewFrames > 0 ?
+                    ns2us(serviceCpuTime) / (nsecs_t)previewFrames : 0,
+            ns2us(processCpuTime), ns2us(halCpuTime), ns2us(sinkCpuTime));
+    printBuffers();
+}
+
+/**
+ * Runs preview with a preview callback target and ZSL through
+ * Camera2Client, then records. The client is created directly rather than
+ * through CameraService::connect(), in this process, so the app stub's
+ * calls need no binder transactions.
+ */
+static status_t runClientScenario(const Options &options) {
+    status_t res;
+    const char *sinkNames[] = { "preview", "callback" };
+
+    camera_module_t *module = FakeCamera3Hal::getModule(options.config);
+    sp<CameraService> service = new CameraService(module);
+    sp<CameraClientStub> app = new CameraClientStub();
+    sp<Camera2Client> client = new Camera2Client(service, app,
+            String16("camera3bench"), /*cameraId*/0, CAMERA_FACING_BACK,
+            getpid(), getuid(), getpid(), CAMERA_DEVICE_API_VERSION_3_0);
+    sp<ResultCollector> collector = new ResultCollector();
+    Vector<sp<BufferSink> > sinks;
+
+    res = client->initialize(module);
+    if (res != OK) {
+        fprintf(stderr, "Unable to open fake camera through Camera2Client: "
+                "%s (%d)\n", strerror(-res), res);
+        client->disconnect();
+        return res;
+    }
+    app->start(client);
+    client->registerFrameListener(Camera2Client::kPreviewRequestIdStart,
+            Camera2Client::kRecordingRequestIdEnd, collector);
+
+    // The callback target takes the place of the CpuConsumer that
+    // CallbackProcessor would otherwise copy the frames out of
+    sinks.push(new BufferSink("camera3bench-Preview",
+            GRALLOC_USAGE_HW_TEXTURE));
+    sinks.push(new BufferSink("camera3bench-Callback",
+            GRALLOC_USAGE_SW_READ_OFTEN));
+    for (size_t i = 0; i < sinks.size(); i++) {
+        sinks[i]->start();
+    }
+
+    res = client->setPreviewTarget(sinks[0]->producer());
+    if (res != OK) goto cleanup;
+    res = client->setPreviewCallbackTarget(sinks[1]->producer());
+    if (res != OK) goto cleanup;
+    res = client->startPreview();
+    if (res != OK) goto cleanup;
+
+    measureClientPhase("preview", options, sinks, sinkNames, app, collector);
+
+    // Recording replaces the callback stream
+    res = client->storeMetaDataInBuffers(true);
+    if (res != OK) goto cleanup;
+    res = client->startRecording();
+    if (res != OK) goto cleanup;
+
+    measureClientPhase("record", options, sinks, sinkNames, app, collector);
+
+    client->stopRecording();
+    if (app->errors() > 0) {
+        fprintf(stderr, "%zu camera errors\n", app->errors());
+        res = UNKNOWN_ERROR;
+    }
+
+cleanup:
+    if (res != OK) {
+        fprintf(stderr, "%s: failed: %s (%d)\n",
+                kScenarioNames[SCENARIO_CLIENT], strerror(-res), res);
+    }
+    client->stopPreview();
+    app->stop();
+    client->removeFrameListener(Camera2Client::kPreviewRequestIdStart,
+            Camera2Client::kRecordingRequestIdEnd, collector);
+    client->disconnect();
+
+    return res;
+}
+
+}; // namespace android
+
+using namespace android;
+
+int main(int argc, char **argv) {
+    Options options;
+    const char *size = NULL;
+    int fps = 30;
+    int durationSecs = 10;
+    int burstCount = 10;
+    int depth = options.config.pipelineDepth;
+
+    BenchOptions benchOptions("[scenario...]",
+            "scenarios: preview, record, zsl, burst, errors, client "
+            "(default all)");
+    benchOptions.addString('s', "WxH", "frame size (default 1920x1080)",
+            &size);
+    benchOptions.addInt('r', "fps", "frames per second (default 30)", &fps,
+            1);
+    benchOptions.addInt('p', "depth", "HAL pipeline depth (default 4)",
+            &depth, 1);
+    benchOptions.addInt('d', "duration",
+            "seconds to measure each scenario (default 10)", &durationSecs,
+            1);
+    benchOptions.addInt('n', "count", "captures per burst (default 10)",
+            &burstCount, 1);
+    if (!benchOptions.parse(argc, argv)) return 1;
+
+    if ((size != NULL && sscanf(size, "%ux%u", &options.config.width,
+                    &options.config.height) != 2) ||
+            burstCount > kBurstRequestIdEnd - kBurstRequestIdStart ||
+            options.config.width == 0 || options.config.height == 0) {
+        benchOptions.usage();
+        return 1;
+    }
+    options.config.frameDuration = 1000000000LL / fps;
+    options.config.pipelineDepth = depth;
+    options.duration = seconds_to_nanoseconds(durationSecs);
+    options.burstCount = burstCount;
+
+    bool run[SCENARIO_COUNT];
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        run[i] = (optind == argc);
+    }
+    for (int arg = optind; arg < argc; arg++) {
+        int i;
+        for (i = 0; i < SCENARIO_COUNT; i++) {
+            if (strcmp(argv[arg], kScenarioNames[i]) == 0) break;
+        }
+        if (i == SCENARIO_COUNT) {
+            benchOptions.usage();
+            return 1;
+        }
+        run[i] = true;
+    }
+
+    // Before any BufferQueue looks for SurfaceFlinger
+    LocalServices::install();
+    // The system services the client scenario uses call back into it
+    ProcessState::self()->startThreadPool();
+
+    int failures = 0;
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        if (!run[i]) continue;
+        status_t res;
+        if (i == SCENARIO_CLIENT) {
+            res = runClientScenario(options);
+        } else {
+            res = runScenario((Scenario)i, options);
+        }
+        if (res != OK) failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "jpegbench"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/Vector.h>
+
+#include "api1/client2/JpegCompressor.h"
+#include "BenchUtils.h"
+
+/**
+ * Measures shot latency of the software JPEG compressor at common sensor
+ * resolutions, with one thread and with more, and checks that the output
+ * is the same whatever the thread count.
+ */
+
+namespace android {
+
+using camera2::JpegCompressor;
+
+struct Resolution {
+    const char *name;
+    uint32_t width;
+    uint32_t height;
+};
+
+static const Resolution kResolutions[] = {
+    { "VGA",   640,  480 },
+    { "1080p", 1920, 1080 },
+    { "8MP",   3264, 2448 },
+    { "13MP",  4160, 3120 },
+};
+
+static const nsecs_t kShotTimeout = 10000000000LL; // 10 s
+
+// Compresses the input once. Returns the shot latency, or 0 on failure
+static nsecs_t compress(CpuConsumer::LockedBuffer *input,
+        CpuConsumer::LockedBuffer *output, size_t maxJpegSize,
+        size_t threadCount, size_t *jpegSize) {
+    Vector<CpuConsumer::LockedBuffer*> buffers;
+    buffers.push_back(input);
+    buffers.push_back(output);
+
+    sp<JpegCompressor> jpeg = new JpegCompressor();
+    jpeg->setThreadCount(threadCount);
+    jpeg->setMaxJpegSize(maxJpegSize);
+
+    nsecs_t start = systemTime();
+    if (jpeg->start(buffers, 0) != OK) return 0;
+    if (!jpeg->waitForDone(kShotTimeout)) return 0;
+    nsecs_t latency = systemTime() - start;
+
+    *jpegSize = jpeg->getJpegSize();
+    return *jpegSize > 0 ? latency : 0;
+}
+
+}; // namespace android
+
+using namespace android;
+
+int main(int argc, char **argv) {
+    int shots = 5;
+    int maxThreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    BenchOptions options;
+    options.addInt('n', "shots", "shots per measurement (default 5)",
+            &shots, 1);
+    options.addInt('t', "threads",
+            "largest thread count to try (default: one per CPU core)",
+            &maxThreads, 1);
+    if (!options.parse(argc, argv)) return 1;
+
+    int failures = 0;
+    for (size_t r = 0; r < sizeof(kResolutions) / sizeof(kResolutions[0]);
+            r++) {
+        const Resolution &resolution = kResolutions[r];
+
+        // A smooth pattern with some detail, and a padded stride
+        size_t stride = resolution.width + 64;
+        uint8_t *pixels = new uint8_t[stride * resolution.height];
+        for (size_t y = 0; y < resolution.height; y++) {
+            for (size_t x = 0; x < stride; x++) {
+                pixels[y * stride + x] =
+                        ((x >> 4) + (y >> 4)) * 3 + ((x * y) >> 12);
+            }
+        }
+
+        CpuConsumer::LockedBuffer input;
+        input.data = pixels;
+        input.width = resolution.width;
+        input.height = resolution.height;
+        input.stride = stride;
+
+        size_t maxJpegSize = resolution.width * resolution.height;
+        uint8_t *reference = new uint8_t[maxJpegSize];
+        uint8_t *jpeg = new uint8_t[maxJpegSize];
+        CpuConsumer::LockedBuffer output;
+        size_t referenceSize = 0;
+
+        // 1, 2, 4... threads, and always the largest count
+        long threads = 1;
+        for (;;) {
+            output.data = (threads == 1) ? reference : jpeg;
+
+            Vector<nsecs_t> latencies;
+            size_t jpegSize = 0;
+            for (int i = 0; i < shots; i++) {
+                nsecs_t latency = compress(&input, &output, maxJpegSize,
+                        threads, &jpegSize);
+                if (latency == 0) break;
+                latencies.push_back(latency);
+            }
+            if (latencies.size() != (size_t)shots) {
+                printf("%s: compression failed with %ld threads\n",
+                        resolution.name, threads);
+                failures++;
+                break;
+            }
+            sortLatencies(latencies);
+
+            const char *match = "";
+            if (threads == 1) {
+                referenceSize = jpegSize;
+            } else if (jpegSize != referenceSize ||
+                    memcmp(reference, jpeg, jpegSize) != 0) {
+                match = ", OUTPUT DIFFERS";
+                failures++;
+            }
+            printf("%s (%dx%d): %ld threads, %d bytes, median %lld ms, "
+                    "best %lld ms%s\n", resolution.name, resolution.width,
+                    resolution.height, threads, jpegSize,
+                    ns2ms(latencyPercentile(latencies, 50)),
+                    ns2ms(latencyPercentile(latencies, 0)), match);
+
+            if (threads == maxThreads) break;
+            threads = (threads * 2 < maxThreads) ? threads * 2 : maxThreads;
+        }
+
+        delete[] jpeg;
+        delete[] reference;
+        delete[] pixels;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
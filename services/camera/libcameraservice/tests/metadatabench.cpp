@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "metadatabench"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <binder/Parcel.h>
+#include <camera/CameraMetadata.h>
+#include <camera/CameraMetadataPool.h>
+
+#include "BenchUtils.h"
+
+/**
+ * Measures the cost of parceling capture results at 60 fps, inline and
+ * through a CameraMetadataPool: Parcel bytes per second, and the latency of
+ * writing a result to a Parcel and reading it back. Results are read back
+ * in the same process, so binder's own copy of the Parcel isn't included;
+ * its cost is proportional to the bytes reported.
+ */
+
+namespace android {
+
+struct ResultShape {
+    const char *name;
+    // Lens shading map grid; dominates the result size
+    int32_t shadingWidth;
+    int32_t shadingHeight;
+};
+
+static const ResultShape kShapes[] = {
+    { "small result", 17, 13 },
+    { "large result", 64, 48 },
+};
+
+static const nsecs_t kFrameInterval = 1000000000LL / 60;
+
+// A capture result of typical contents, with a lens shading map
+static void buildResult(const ResultShape &shape, int32_t frameNumber,
+        CameraMetadata *result) {
+    result->update(ANDROID_REQUEST_FRAME_COUNT, &frameNumber, 1);
+
+    int64_t timestamp = systemTime();
+    result->update(ANDROID_SENSOR_TIMESTAMP, &timestamp, 1);
+    int64_t exposureTime = 10000000LL;
+    result->update(ANDROID_SENSOR_EXPOSURE_TIME, &exposureTime, 1);
+    int32_t sensitivity = 100;
+    result->update(ANDROID_SENSOR_SENSITIVITY, &sensitivity, 1);
+
+    uint8_t aeState = ANDROID_CONTROL_AE_STATE_CONVERGED;
+    result->update(ANDROID_CONTROL_AE_STATE, &aeState, 1);
+    uint8_t afState = ANDROID_CONTROL_AF_STATE_PASSIVE_FOCUSED;
+    result->update(ANDROID_CONTROL_AF_STATE, &afState, 1);
+    uint8_t awbState = ANDROID_CONTROL_AWB_STATE_CONVERGED;
+    result->update(ANDROID_CONTROL_AWB_STATE, &awbState, 1);
+
+    float gains[] = { 1.5f, 1.0f, 1.0f, 1.8f };
+    result->update(ANDROID_COLOR_CORRECTION_GAINS, gains, 4);
+
+    Vector<float> shadingMap;
+    size_t shadingSize = 4 * shape.shadingWidth * shape.shadingHeight;
+    shadingMap.insertAt(1.0f, 0, shadingSize);
+    for (size_t i = 0; i < shadingSize; i++) {
+        shadingMap.editItemAt(i) = 1.0f + (i % 97) / 97.f;
+    }
+    result->update(ANDROID_STATISTICS_LENS_SHADING_MAP, shadingMap.array(),
+            shadingSize);
+}
+
+/**
+ * Parcels one result per frame at 60 fps. Returns false if a result didn't
+ * come back intact.
+ */
+static bool run(const ResultShape &shape, CameraMetadataPool *pool,
+        int frames) {
+    CameraMetadata result;
+    Vector<nsecs_t> latencies;
+    size_t parcelBytes = 0;
+
+    nsecs_t frameTime = systemTime();
+    for (int i = 0; i < frames; i++) {
+        buildResult(shape, i, &result);
+        const camera_metadata_t *buffer = result.getAndLock();
+        size_t resultSize = get_camera_metadata_compact_size(buffer);
+        result.unlock(buffer);
+
+        nsecs_t start = systemTime();
+        Parcel parcel;
+        if (result.writeToParcel(&parcel, pool) != OK) {
+            printf("%s: writing frame %d failed\n", shape.name, i);
+            return false;
+        }
+        parcelBytes += parcel.dataSize();
+        parcel.setDataPosition(0);
+        CameraMetadata received;
+        if (received.readFromParcel(&parcel) != OK) {
+            printf("%s: reading frame %d failed\n", shape.name, i);
+            return false;
+        }
+        latencies.push_back(systemTime() - start);
+
+        camera_metadata_ro_entry_t frameCount =
+                received.find(ANDROID_REQUEST_FRAME_COUNT);
+        if (frameCount.count != 1 || frameCount.data.i32[0] != i ||
+                received.entryCount() != result.entryCount()) {
+            printf("%s: frame %d came back wrong\n", shape.name, i);
+            return false;
+        }
+
+        if (i == 0) {
+            printf("%s (%d bytes), %s:\n", shape.name, resultSize,
+                    pool != NULL ? "pooled" : "inline");
+        }
+
+        frameTime += kFrameInterval;
+        nsecs_t now = systemTime();
+        if (frameTime > now) usleep(ns2us(frameTime - now));
+    }
+
+    sortLatencies(latencies);
+    printf("    %d parcel bytes/s, latency median %lld us, max %lld us\n",
+            parcelBytes * 60 / frames,
+            ns2us(latencyPercentile(latencies, 50)),
+            ns2us(latencyPercentile(latencies, 100)));
+    return true;
+}
+
+}; // namespace android
+
+using namespace android;
+
+int main(int argc, char **argv) {
+    int frames = 300;
+
+    BenchOptions options;
+    options.addInt('n', "frames", "frames per measurement (default 300)",
+            &frames, 1);
+    if (!options.parse(argc, argv)) return 1;
+
+    int failures = 0;
+    for (size_t s = 0; s < sizeof(kShapes) / sizeof(kShapes[0]); s++) {
+        if (!run(kShapes[s], NULL, frames)) failures++;
+
+        sp<CameraMetadataPool> pool = new CameraMetadataPool();
+        if (!run(kShapes[s], pool.get(), frames)) failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
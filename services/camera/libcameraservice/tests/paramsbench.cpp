@@ -0,0 +1,571 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "paramsbench"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utils/Log.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <system/camera.h>
+#include <camera/CameraMetadata.h>
+#include <camera/CameraParameters.h>
+
+#include "api1/client2/Parameters.h"
+#include "BenchUtils.h"
+
+/**
+ * Measures the latency of api1 setParameters() parsing for the ways apps
+ * typically call it: with unchanged parameters, changing only the zoom or the
+ * focus areas every frame, and changing many keys at once.
+ *
+ * First checks that set(), which only parses the keys that changed, ends up
+ * in the same state as parsing every key, over a series of random edits.
+ */
+
+namespace android {
+
+using camera2::Parameters;
+
+// Static metadata of a typical back camera, with everything
+// Parameters::initialize() needs
+static void buildStaticInfo(CameraMetadata *info) {
+    int32_t activeArray[] = { 0, 0, 4160, 3120 };
+    info->update(ANDROID_SENSOR_INFO_ACTIVE_ARRAY_SIZE, activeArray, 4);
+    float physicalSize[] = { 4.69f, 3.52f };
+    info->update(ANDROID_SENSOR_INFO_PHYSICAL_SIZE, physicalSize, 2);
+
+    int32_t processedSizes[] = {
+        1920, 1080,  1280, 720,  960, 720,  640, 480,  320, 240,
+    };
+    info->update(ANDROID_SCALER_AVAILABLE_PROCESSED_SIZES, processedSizes,
+            sizeof(processedSizes) / sizeof(processedSizes[0]));
+    int32_t jpegSizes[] = {
+        4160, 3120,  3264, 2448,  1920, 1080,  640, 480,
+    };
+    info->update(ANDROID_SCALER_AVAILABLE_JPEG_SIZES, jpegSizes,
+            sizeof(jpegSizes) / sizeof(jpegSizes[0]));
+    int32_t formats[] = {
+        HAL_PIXEL_FORMAT_YCrCb_420_SP,
+        HAL_PIXEL_FORMAT_YV12,
+        HAL_PIXEL_FORMAT_BLOB,
+        HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED,
+    };
+    info->update(ANDROID_SCALER_AVAILABLE_FORMATS, formats,
+            sizeof(formats) / sizeof(formats[0]));
+    float maxZoom = 4.f;
+    info->update(ANDROID_SCALER_AVAILABLE_MAX_DIGITAL_ZOOM, &maxZoom, 1);
+
+    int32_t thumbSizes[] = { 0, 0,  160, 120,  320, 240 };
+    info->update(ANDROID_JPEG_AVAILABLE_THUMBNAIL_SIZES, thumbSizes,
+            sizeof(thumbSizes) / sizeof(thumbSizes[0]));
+
+    int32_t fpsRanges[] = { 15, 15,  7, 30,  15, 30,  30, 30 };
+    info->update(ANDROID_CONTROL_AE_AVAILABLE_TARGET_FPS_RANGES, fpsRanges,
+            sizeof(fpsRanges) / sizeof(fpsRanges[0]));
+    int32_t compensationRange[] = { -6, 6 };
+    info->update(ANDROID_CONTROL_AE_COMPENSATION_RANGE, compensationRange, 2);
+    camera_metadata_rational_t compensationStep = { 1, 3 };
+    info->update(ANDROID_CONTROL_AE_COMPENSATION_STEP, &compensationStep, 1);
+    int32_t maxRegions = 1;
+    info->update(ANDROID_CONTROL_MAX_REGIONS, &maxRegions, 1);
+
+    uint8_t aeModes[] = {
+        ANDROID_CONTROL_AE_MODE_OFF,
+        ANDROID_CONTROL_AE_MODE_ON,
+        ANDROID_CONTROL_AE_MODE_ON_AUTO_FLASH,
+        ANDROID_CONTROL_AE_MODE_ON_ALWAYS_FLASH,
+    };
+    info->update(ANDROID_CONTROL_AE_AVAILABLE_MODES, aeModes,
+            sizeof(aeModes) / sizeof(aeModes[0]));
+    uint8_t afModes[] = {
+        ANDROID_CONTROL_AF_MODE_OFF,
+        ANDROID_CONTROL_AF_MODE_AUTO,
+        ANDROID_CONTROL_AF_MODE_CONTINUOUS_VIDEO,
+        ANDROID_CONTROL_AF_MODE_CONTINUOUS_PICTURE,
+    };
+    info->update(ANDROID_CONTROL_AF_AVAILABLE_MODES, afModes,
+            sizeof(afModes) / sizeof(afModes[0]));
+    uint8_t awbModes[] = {
+        ANDROID_CONTROL_AWB_MODE_AUTO,
+        ANDROID_CONTROL_AWB_MODE_INCANDESCENT,
+        ANDROID_CONTROL_AWB_MODE_FLUORESCENT,
+        ANDROID_CONTROL_AWB_MODE_DAYLIGHT,
+        ANDROID_CONTROL_AWB_MODE_CLOUDY_DAYLIGHT,
+    };
+    info->update(ANDROID_CONTROL_AWB_AVAILABLE_MODES, awbModes,
+            sizeof(awbModes) / sizeof(awbModes[0]));
+    uint8_t effects[] = {
+        ANDROID_CONTROL_EFFECT_MODE_OFF,
+        ANDROID_CONTROL_EFFECT_MODE_MONO,
+        ANDROID_CONTROL_EFFECT_MODE_SEPIA,
+    };
+    info->update(ANDROID_CONTROL_AVAILABLE_EFFECTS, effects,
+            sizeof(effects) / sizeof(effects[0]));
+    uint8_t antibanding[] = {
+        ANDROID_CONTROL_AE_ANTIBANDING_MODE_OFF,
+        ANDROID_CONTROL_AE_ANTIBANDING_MODE_AUTO,
+    };
+    info->update(ANDROID_CONTROL_AE_AVAILABLE_ANTIBANDING_MODES, antibanding,
+            sizeof(antibanding) / sizeof(antibanding[0]));
+    uint8_t stabilization[] = {
+        ANDROID_CONTROL_VIDEO_STABILIZATION_MODE_OFF,
+        ANDROID_CONTROL_VIDEO_STABILIZATION_MODE_ON,
+    };
+    info->update(ANDROID_CONTROL_AVAILABLE_VIDEO_STABILIZATION_MODES,
+            stabilization, sizeof(stabilization) / sizeof(stabilization[0]));
+
+    uint8_t flash = 1;
+    info->update(ANDROID_FLASH_INFO_AVAILABLE, &flash, 1);
+    float focalLength = 3.97f;
+    info->update(ANDROID_LENS_INFO_AVAILABLE_FOCAL_LENGTHS, &focalLength, 1);
+    float minFocusDistance = 10.f;
+    info->update(ANDROID_LENS_INFO_MINIMUM_FOCUS_DISTANCE,
+            &minFocusDistance, 1);
+
+    uint8_t faceModes[] = {
+        ANDROID_STATISTICS_FACE_DETECT_MODE_OFF,
+        ANDROID_STATISTICS_FACE_DETECT_MODE_SIMPLE,
+    };
+    info->update(ANDROID_STATISTICS_INFO_AVAILABLE_FACE_DETECT_MODES,
+            faceModes, sizeof(faceModes) / sizeof(faceModes[0]));
+    int32_t maxFaces = 5;
+    info->update(ANDROID_STATISTICS_INFO_MAX_FACE_COUNT, &maxFaces, 1);
+}
+
+// Returns where the first entry for key starts in flattened parameters, or
+// NULL if there is none
+static const char* findKey(const String8 &params, const char *key) {
+    String8 needle = String8::format("%s=", key);
+    const char *start = params.string();
+    const char *found = start;
+    for (;;) {
+        found = strstr(found, needle.string());
+        if (found == NULL || found == start || found[-1] == ';') break;
+        found++;
+    }
+    return found;
+}
+
+// Appends an entry for key, after any existing one
+static String8 withEntry(const String8 &params, const char *key,
+        const char *value) {
+    String8 result(params);
+    if (!result.isEmpty()) result.append(";");
+    result.appendFormat("%s=%s", key, value);
+    return result;
+}
+
+// Replaces the value of key in flattened parameters without reordering the
+// keys, the way an app editing the result of getParameters() would. The key
+// is added at the end if it isn't there.
+static String8 withValue(const String8 &params, const char *key,
+        const char *value) {
+    const char *found = findKey(params, key);
+    if (found == NULL) return withEntry(params, key, value);
+
+    const char *start = params.string();
+    const char *valueStart = found + strlen(key) + 1;
+    const char *valueEnd = strchr(valueStart, ';');
+    if (valueEnd == NULL) valueEnd = valueStart + strlen(valueStart);
+
+    String8 result(start, valueStart - start);
+    result.append(value);
+    result.append(valueEnd);
+    return result;
+}
+
+// Removes the first entry for key, if any
+static String8 withoutKey(const String8 &params, const char *key) {
+    const char *found = findKey(params, key);
+    if (found == NULL) return params;
+
+    const char *start = params.string();
+    const char *end = strchr(found, ';');
+    if (end != NULL) {
+        end++;
+    } else {
+        end = found + strlen(found);
+        // Drop the separator before the last entry instead
+        if (found > start) found--;
+    }
+
+    String8 result(start, found - start);
+    result.append(end);
+    return result;
+}
+
+// Keys the consistency check edits, with values to pick from. Some of the
+// values are invalid, or conflict with other keys.
+struct KeyValues {
+    const char *key;
+    const char *values[5];
+};
+
+static const KeyValues kEditedKeys[] = {
+    { CameraParameters::KEY_PREVIEW_SIZE,
+        { "1920x1080", "1280x720", "640x480", "123x45", NULL } },
+    { CameraParameters::KEY_PREVIEW_FPS_RANGE,
+        { "15000,30000", "30000,30000", "7000,30000", "30000,15000", NULL } },
+    { CameraParameters::KEY_PREVIEW_FRAME_RATE,
+        { "15", "30", "60", NULL } },
+    { CameraParameters::KEY_PREVIEW_FORMAT,
+        { "yuv420sp", "yuv420p", "rgb565", NULL } },
+    { CameraParameters::KEY_PICTURE_SIZE,
+        { "4160x3120", "3264x2448", "1920x1080", "100x100", NULL } },
+    { CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH,
+        { "0", "160", "320", "333", NULL } },
+    { CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT,
+        { "0", "120", "240", NULL } },
+    { CameraParameters::KEY_JPEG_QUALITY,
+        { "90", "95", "100", "101", NULL } },
+    { CameraParameters::KEY_ROTATION,
+        { "0", "90", "180", "45", NULL } },
+    { CameraParameters::KEY_GPS_LATITUDE,
+        { "37.42", "-12.5", NULL } },
+    { CameraParameters::KEY_GPS_TIMESTAMP,
+        { "1380000000", NULL } },
+    { CameraParameters::KEY_WHITE_BALANCE,
+        { "auto", "daylight", "cloudy-daylight", "twilight", NULL } },
+    { CameraParameters::KEY_EFFECT,
+        { "none", "mono", "sepia", "posterize", NULL } },
+    { CameraParameters::KEY_ANTIBANDING,
+        { "off", "auto", "50hz", NULL } },
+    { CameraParameters::KEY_SCENE_MODE,
+        { "auto", "night", "hdr", NULL } },
+    { CameraParameters::KEY_FLASH_MODE,
+        { "off", "auto", "on", "torch", "red-eye" } },
+    { CameraParameters::KEY_FOCUS_MODE,
+        { "auto", "continuous-picture", "continuous-video", "infinity",
+          "macro" } },
+    { CameraParameters::KEY_FOCUS_AREAS,
+        { "(-100,-100,100,100,1000)", "(0,0,200,200,1000)", "(0,0,0,0,0)",
+          "(0,0,10,10,1000),(20,20,30,30,1000)", NULL } },
+    { CameraParameters::KEY_METERING_AREAS,
+        { "(-100,-100,100,100,1000)", "(0,0,0,0,0)", "(5,5,1,1,10)",
+          NULL } },
+    { CameraParameters::KEY_EXPOSURE_COMPENSATION,
+        { "-6", "0", "1", "7", NULL } },
+    { CameraParameters::KEY_AUTO_EXPOSURE_LOCK,
+        { "true", "false", NULL } },
+    { CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK,
+        { "true", "false", NULL } },
+    { CameraParameters::KEY_ZOOM,
+        { "0", "1", "5", "10", "1000" } },
+    { CameraParameters::KEY_VIDEO_SIZE,
+        { "1920x1080", "1280x720", "640x480", NULL } },
+    { CameraParameters::KEY_RECORDING_HINT,
+        { "true", "false", NULL } },
+    { CameraParameters::KEY_VIDEO_STABILIZATION,
+        { "true", "false", NULL } },
+};
+
+static const size_t kEditedKeyCount =
+        sizeof(kEditedKeys) / sizeof(kEditedKeys[0]);
+
+static const char* randomValue(const KeyValues &kv) {
+    size_t count = 0;
+    while (count < 5 && kv.values[count] != NULL) count++;
+    return kv.values[lrand48() % count];
+}
+
+// Applies one to three random edits: changing a value, removing a key,
+// adding a second entry for a key, or moving a key to the end, which
+// changes its set order
+static String8 randomEdit(const String8 &params) {
+    String8 result(params);
+    int edits = 1 + lrand48() % 3;
+    for (int i = 0; i < edits; i++) {
+        const KeyValues &kv = kEditedKeys[lrand48() % kEditedKeyCount];
+        int kind = lrand48() % 10;
+        if (kind < 7) {
+            result = withValue(result, kv.key, randomValue(kv));
+        } else if (kind == 7) {
+            result = withoutKey(result, kv.key);
+        } else if (kind == 8) {
+            result = withEntry(result, kv.key, randomValue(kv));
+        } else {
+            const char *found = findKey(result, kv.key);
+            if (found == NULL) continue;
+            const char *valueStart = found + strlen(kv.key) + 1;
+            const char *valueEnd = strchr(valueStart, ';');
+            String8 value = (valueEnd == NULL) ? String8(valueStart) :
+                    String8(valueStart, valueEnd - valueStart);
+            result = withEntry(withoutKey(result, kv.key), kv.key,
+                    value.string());
+        }
+    }
+    return result;
+}
+
+static bool sameAreas(const Vector<Parameters::Area> &a,
+        const Vector<Parameters::Area> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].left != b[i].left || a[i].top != b[i].top ||
+                a[i].right != b[i].right || a[i].bottom != b[i].bottom ||
+                a[i].weight != b[i].weight) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the first tag whose entry differs between a and b, or -1 if the
+// metadata is the same
+static int64_t differingTag(CameraMetadata &a, const CameraMetadata &b) {
+    int64_t tag = -1;
+    const camera_metadata_t *buffer = a.getAndLock();
+    size_t count = get_camera_metadata_entry_count(buffer);
+    for (size_t i = 0; i < count && tag < 0; i++) {
+        camera_metadata_ro_entry_t entry;
+        get_camera_metadata_ro_entry(buffer, i, &entry);
+        camera_metadata_ro_entry_t other = b.find(entry.tag);
+        if (other.count != entry.count || other.type != entry.type ||
+                memcmp(other.data.u8, entry.data.u8,
+                        entry.count * camera_metadata_type_size[entry.type])
+                        != 0) {
+            tag = entry.tag;
+        }
+    }
+    a.unlock(buffer);
+    if (tag < 0 && count != b.entryCount()) tag = 0;
+    return tag;
+}
+
+// Names the first field that differs between a and b, or returns NULL
+static const char* differingField(const Parameters &a, const Parameters &b) {
+#define COMPARE_FIELD(f) if (!(a.f == b.f)) return #f
+    COMPARE_FIELD(paramsFlattened);
+    COMPARE_FIELD(previewWidth);
+    COMPARE_FIELD(previewHeight);
+    COMPARE_FIELD(previewFpsRange[0]);
+    COMPARE_FIELD(previewFpsRange[1]);
+    COMPARE_FIELD(previewFormat);
+    COMPARE_FIELD(pictureWidth);
+    COMPARE_FIELD(pictureHeight);
+    COMPARE_FIELD(jpegThumbSize[0]);
+    COMPARE_FIELD(jpegThumbSize[1]);
+    COMPARE_FIELD(jpegQuality);
+    COMPARE_FIELD(jpegThumbQuality);
+    COMPARE_FIELD(jpegRotation);
+    COMPARE_FIELD(gpsEnabled);
+    COMPARE_FIELD(gpsCoordinates[0]);
+    COMPARE_FIELD(gpsCoordinates[1]);
+    COMPARE_FIELD(gpsCoordinates[2]);
+    COMPARE_FIELD(gpsTimestamp);
+    COMPARE_FIELD(gpsProcessingMethod);
+    COMPARE_FIELD(wbMode);
+    COMPARE_FIELD(effectMode);
+    COMPARE_FIELD(antibandingMode);
+    COMPARE_FIELD(sceneMode);
+    COMPARE_FIELD(flashMode);
+    COMPARE_FIELD(focusMode);
+    COMPARE_FIELD(shadowFocusMode);
+    COMPARE_FIELD(exposureCompensation);
+    COMPARE_FIELD(autoExposureLock);
+    COMPARE_FIELD(autoWhiteBalanceLock);
+    COMPARE_FIELD(zoom);
+    COMPARE_FIELD(videoWidth);
+    COMPARE_FIELD(videoHeight);
+    COMPARE_FIELD(recordingHint);
+    COMPARE_FIELD(videoStabilization);
+    COMPARE_FIELD(lightFx);
+#undef COMPARE_FIELD
+    if (!sameAreas(a.focusingAreas, b.focusingAreas)) return "focusingAreas";
+    if (!sameAreas(a.meteringAreas, b.meteringAreas)) return "meteringAreas";
+    return NULL;
+}
+
+/**
+ * Applies rounds of random edits with set(), and after each compares the
+ * result with parsing every key: set() on a copy of the previous state
+ * whose parameters were cleared, so that all keys count as changed. Both
+ * must accept or reject the edit, and end up with the same fields and
+ * requests. When set() says the requests don't need updating, they must
+ * indeed come out the same as before. Returns false on the first mismatch.
+ */
+static bool checkIncrementalSet(const Parameters &initial, int rounds) {
+    Parameters incremental(initial);
+    srand48(1);
+
+    for (int round = 0; round < rounds; round++) {
+        String8 edited = randomEdit(incremental.get());
+
+        Parameters full(incremental);
+        full.params = CameraParameters2();
+
+        CameraMetadata requestBefore;
+        incremental.updateRequest(&requestBefore);
+
+        bool requestChanged;
+        status_t res = incremental.set(edited, &requestChanged);
+        status_t fullRes = full.set(edited);
+        if ((res == OK) != (fullRes == OK)) {
+            printf("round %d: set() returned %d, parsing all keys %d, for\n"
+                    "%s\n", round, res, fullRes, edited.string());
+            return false;
+        }
+        if (res != OK) continue;
+
+        const char *field = differingField(incremental, full);
+        if (field != NULL) {
+            printf("round %d: %s differs from parsing all keys, for\n%s\n",
+                    round, field, edited.string());
+            return false;
+        }
+
+        CameraMetadata request, fullRequest;
+        incremental.updateRequest(&request);
+        incremental.updateRequestJpeg(&request);
+        full.updateRequest(&fullRequest);
+        full.updateRequestJpeg(&fullRequest);
+        int64_t tag = differingTag(request, fullRequest);
+        if (tag >= 0) {
+            printf("round %d: request tag 0x%llx differs from parsing all "
+                    "keys, for\n%s\n", round, tag, edited.string());
+            return false;
+        }
+
+        if (!requestChanged) {
+            request.clear();
+            incremental.updateRequest(&request);
+            tag = differingTag(request, requestBefore);
+            if (tag >= 0) {
+                printf("round %d: request tag 0x%llx changed, but set() "
+                        "said it didn't, for\n%s\n", round, tag,
+                        edited.string());
+                return false;
+            }
+        }
+    }
+
+    printf("incremental set() matched parsing all keys in %d rounds\n",
+            rounds);
+    return true;
+}
+
+// Calls set() with each of the settings in turn, iterations times in total,
+// and prints the latency
+static int runScenario(Parameters *params, const char *name,
+        const Vector<String8> &settings, int iterations) {
+    Vector<nsecs_t> latencies;
+    latencies.setCapacity(iterations);
+    for (int i = 0; i < iterations; i++) {
+        const String8 &setting = settings[i % settings.size()];
+        bool requestChanged;
+        nsecs_t start = systemTime();
+        status_t res = params->set(setting, &requestChanged);
+        latencies.push_back(systemTime() - start);
+        if (res != OK) {
+            printf("%s: set() failed: %s (%d)\n", name, strerror(-res), res);
+            return 1;
+        }
+    }
+    sortLatencies(latencies);
+
+    nsecs_t total = 0;
+    for (size_t i = 0; i < latencies.size(); i++) total += latencies[i];
+    printf("%-14s median %6lld us, mean %6lld us, p99 %6lld us\n", name,
+            ns2us(latencyPercentile(latencies, 50)),
+            ns2us(total / (nsecs_t)latencies.size()),
+            ns2us(latencyPercentile(latencies, 99)));
+    return 0;
+}
+
+}; // namespace android
+
+using namespace android;
+
+int main(int argc, char **argv) {
+    int iterations = 2000;
+    int rounds = 1000;
+
+    BenchOptions options;
+    options.addInt('n', "iterations", "calls per scenario (default 2000)",
+            &iterations, 1);
+    options.addInt('c', "rounds",
+            "rounds of the consistency check (default 1000)", &rounds, 0);
+    if (!options.parse(argc, argv)) return 1;
+
+    CameraMetadata info;
+    buildStaticInfo(&info);
+
+    Parameters params(/*cameraId*/0, CAMERA_FACING_BACK);
+    status_t res = params.initialize(&info);
+    if (res != OK) {
+        printf("Unable to initialize parameters: %s (%d)\n",
+                strerror(-res), res);
+        return 1;
+    }
+    const String8 initial = params.get();
+    int keyCount = 1;
+    for (const char *c = initial.string(); *c != '\0'; c++) {
+        if (*c == ';') keyCount++;
+    }
+    printf("%d keys, %d bytes flattened\n", keyCount, initial.length());
+
+    int failures = 0;
+    if (!checkIncrementalSet(params, rounds)) failures++;
+
+    Vector<String8> settings;
+
+    settings.push_back(initial);
+    failures += runScenario(&params, "unchanged", settings, iterations);
+
+    settings.clear();
+    settings.push_back(withValue(initial, CameraParameters::KEY_ZOOM, "1"));
+    settings.push_back(withValue(initial, CameraParameters::KEY_ZOOM, "2"));
+    failures += runScenario(&params, "zoom", settings, iterations);
+
+    settings.clear();
+    settings.push_back(withValue(initial, CameraParameters::KEY_FOCUS_AREAS,
+            "(-100,-100,100,100,1000)"));
+    settings.push_back(withValue(initial, CameraParameters::KEY_FOCUS_AREAS,
+            "(200,-300,400,-100,1000)"));
+    failures += runScenario(&params, "focus-areas", settings, iterations);
+
+    settings.clear();
+    for (int i = 0; i < 2; i++) {
+        String8 s = initial;
+        s = withValue(s, CameraParameters::KEY_ZOOM, i ? "3" : "4");
+        s = withValue(s, CameraParameters::KEY_FOCUS_AREAS,
+                i ? "(-100,-100,100,100,1000)" : "(0,0,200,200,1000)");
+        s = withValue(s, CameraParameters::KEY_METERING_AREAS,
+                i ? "(-100,-100,100,100,1000)" : "(0,0,200,200,1000)");
+        s = withValue(s, CameraParameters::KEY_EXPOSURE_COMPENSATION,
+                i ? "1" : "-1");
+        s = withValue(s, CameraParameters::KEY_EFFECT,
+                i ? CameraParameters::EFFECT_MONO :
+                    CameraParameters::EFFECT_SEPIA);
+        s = withValue(s, CameraParameters::KEY_WHITE_BALANCE,
+                i ? CameraParameters::WHITE_BALANCE_DAYLIGHT :
+                    CameraParameters::WHITE_BALANCE_CLOUDY_DAYLIGHT);
+        s = withValue(s, CameraParameters::KEY_JPEG_QUALITY, i ? "90" : "95");
+        s = withValue(s, CameraParameters::KEY_PICTURE_SIZE,
+                i ? "3264x2448" : "1920x1080");
+        settings.push_back(s);
+    }
+    failures += runScenario(&params, "many-keys", settings, iterations);
+
+    return failures == 0 ? 0 : 1;
+}
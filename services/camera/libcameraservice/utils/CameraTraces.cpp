@@ -23,16 +23,46 @@
 
 #include <utils/Mutex.h>
 #include <utils/List.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
 
 #include <utils/Log.h>
+#include <cutils/atomic.h>
 #include <cutils/trace.h>
 
+#include <string.h>
+#include <unistd.h>
+
 namespace android {
 namespace camera3 {
 
+// Number of frame events kept, about 1100 frames with a preview and a
+// recording stream. Must be a power of two.
+static const uint32_t kMaxFrameEvents = 8192;
+
+struct FrameEventData {
+    int32_t  cameraId;
+    int32_t  event;
+    int32_t  streamId;
+    uint32_t frameNumber;
+    nsecs_t  timestamp;
+};
+
+// One slot of the frame event ring. The sequence is 0 while the slot is being
+// written, and the event's index plus one once the data is complete.
+struct FrameEventRecord {
+    volatile int32_t sequence;
+    FrameEventData   data;
+};
+
 struct CameraTracesImpl {
     Mutex                    tracesLock;
     List<ProcessCallStack>   pcsList;
+
+    // Zero-initialized along with the rest of gImpl; only accessed with
+    // atomics, never under tracesLock
+    volatile int32_t         frameEventCount;
+    FrameEventRecord         frameEvents[kMaxFrameEvents];
 }; // class CameraTraces::Impl;
 
 static CameraTracesImpl gImpl;
@@ -64,6 +94,219 @@ void CameraTraces::saveTrace() {
     ATRACE_END();
 }
 
+void CameraTraces::logFrameEvent(int cameraId, FrameEvent event,
+        uint32_t frameNumber, int streamId, nsecs_t timestamp) {
+    if (timestamp == 0) {
+        timestamp = systemTime();
+    }
+
+    // Claim the next slot, and mark it invalid before overwriting it, so
+    // readers never take a half-written event for a complete one
+    uint32_t index = android_atomic_inc(&sImpl.frameEventCount);
+    FrameEventRecord &record =
+            sImpl.frameEvents[index & (kMaxFrameEvents - 1)];
+    android_atomic_acquire_store(0, &record.sequence);
+
+    record.data.cameraId = cameraId;
+    record.data.event = event;
+    record.data.streamId = streamId;
+    record.data.frameNumber = frameNumber;
+    record.data.timestamp = timestamp;
+
+    android_atomic_release_store(index + 1, &record.sequence);
+}
+
+// Copies the complete events out of the ring, oldest first. Events being
+// written or overwritten while copying are left out.
+static void copyFrameEvents(const CameraTracesImpl &impl,
+        Vector<FrameEventData> *events) {
+    uint32_t end = android_atomic_acquire_load(&impl.frameEventCount);
+    uint32_t count = (end < kMaxFrameEvents) ? end : kMaxFrameEvents;
+
+    events->setCapacity(count);
+    for (uint32_t index = end - count; index != end; index++) {
+        const FrameEventRecord &record =
+                impl.frameEvents[index & (kMaxFrameEvents - 1)];
+        int32_t sequence = android_atomic_acquire_load(&record.sequence);
+        if (sequence != (int32_t)(index + 1)) continue;
+
+        FrameEventData data = record.data;
+        if (android_atomic_release_load(&record.sequence) != sequence) continue;
+
+        events->push_back(data);
+    }
+}
+
+// When each event happened for one frame, 0 if it wasn't seen
+struct FrameTimes {
+    nsecs_t                  times[CameraTraces::FRAME_EVENT_COUNT];
+    // FRAME_BUFFER_RETURNED times, by stream ID
+    KeyedVector<int, nsecs_t> bufferTimes;
+
+    FrameTimes() {
+        memset(times, 0, sizeof(times));
+    }
+};
+
+// Groups events by camera (upper 32 bits of the key) and frame number
+static void collectFrames(const Vector<FrameEventData> &events,
+        KeyedVector<int64_t, FrameTimes> *frames) {
+    for (size_t i = 0; i < events.size(); i++) {
+        const FrameEventData &e = events[i];
+        int64_t key = ((int64_t)e.cameraId << 32) | e.frameNumber;
+
+        // Frame numbers start over when a device is reopened; a new request
+        // always replaces what was there
+        ssize_t idx = frames->indexOfKey(key);
+        if (idx < 0 || e.event == CameraTraces::FRAME_REQUEST_QUEUED) {
+            idx = frames->replaceValueFor(key, FrameTimes());
+        }
+
+        FrameTimes &frame = frames->editValueAt(idx);
+        if (e.event == CameraTraces::FRAME_BUFFER_RETURNED) {
+            frame.bufferTimes.replaceValueFor(e.streamId, e.timestamp);
+        } else if (e.event >= 0 && e.event < CameraTraces::FRAME_EVENT_COUNT) {
+            frame.times[e.event] = e.timestamp;
+        }
+    }
+}
+
+// The pipeline stages that get a histogram and a systrace slice. Per-stream
+// buffer latencies are measured from FRAME_REQUEST_SENT as well.
+struct FrameStage {
+    const char               *name;
+    CameraTraces::FrameEvent from;
+    CameraTraces::FrameEvent to;
+};
+
+static const FrameStage kFrameStages[] = {
+    { "queued to sent",      CameraTraces::FRAME_REQUEST_QUEUED,
+                             CameraTraces::FRAME_REQUEST_SENT },
+    { "sent to shutter",     CameraTraces::FRAME_REQUEST_SENT,
+                             CameraTraces::FRAME_SHUTTER },
+    { "sent to result",      CameraTraces::FRAME_REQUEST_SENT,
+                             CameraTraces::FRAME_RESULT },
+    { "result to delivered", CameraTraces::FRAME_RESULT,
+                             CameraTraces::FRAME_RESULT_DELIVERED },
+    { "queued to delivered", CameraTraces::FRAME_REQUEST_QUEUED,
+                             CameraTraces::FRAME_RESULT_DELIVERED },
+};
+static const size_t kNumFrameStages =
+        sizeof(kFrameStages) / sizeof(kFrameStages[0]);
+
+// Upper bounds of the histogram buckets, in ms; the last bucket is open
+static const int kBucketLimitsMs[] = { 1, 2, 4, 8, 16, 33, 66, 133, 266 };
+static const size_t kNumBuckets =
+        sizeof(kBucketLimitsMs) / sizeof(kBucketLimitsMs[0]) + 1;
+
+struct LatencyHistogram {
+    size_t  count;
+    nsecs_t total;
+    nsecs_t max;
+    size_t  buckets[kNumBuckets];
+
+    LatencyHistogram() :
+            count(0),
+            total(0),
+            max(0) {
+        memset(buckets, 0, sizeof(buckets));
+    }
+
+    void add(nsecs_t latency) {
+        count++;
+        total += latency;
+        if (latency > max) max = latency;
+
+        size_t i = 0;
+        while (i < kNumBuckets - 1 && latency >= ms2ns(kBucketLimitsMs[i])) {
+            i++;
+        }
+        buckets[i]++;
+    }
+
+    void appendTo(String8 *lines, const char *name) const {
+        if (count == 0) return;
+        lines->appendFormat("      %s: %d frames, average %lld us, "
+                "max %lld us\n", name, count, ns2us(total / count),
+                ns2us(max));
+        lines->append("       ");
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            if (i < kNumBuckets - 1) {
+                lines->appendFormat(" <%dms:", kBucketLimitsMs[i]);
+            } else {
+                lines->appendFormat(" >=%dms:", kBucketLimitsMs[i - 1]);
+            }
+            lines->appendFormat(" %d", buckets[i]);
+        }
+        lines->append("\n");
+    }
+};
+
+struct CameraLatencies {
+    LatencyHistogram                   stages[kNumFrameStages];
+    // Sent to buffer returned, by stream ID
+    KeyedVector<int, LatencyHistogram> streams;
+};
+
+static void dumpFrameLatencies(const CameraTracesImpl &impl, int fd) {
+    Vector<FrameEventData> events;
+    copyFrameEvents(impl, &events);
+
+    KeyedVector<int64_t, FrameTimes> frames;
+    collectFrames(events, &frames);
+
+    KeyedVector<int, CameraLatencies> cameras;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const FrameTimes &frame = frames.valueAt(i);
+        int cameraId = (int)(frames.keyAt(i) >> 32);
+
+        ssize_t idx = cameras.indexOfKey(cameraId);
+        if (idx < 0) idx = cameras.add(cameraId, CameraLatencies());
+        CameraLatencies &latencies = cameras.editValueAt(idx);
+
+        for (size_t s = 0; s < kNumFrameStages; s++) {
+            nsecs_t from = frame.times[kFrameStages[s].from];
+            nsecs_t to = frame.times[kFrameStages[s].to];
+            if (from != 0 && to != 0) {
+                latencies.stages[s].add(to - from);
+            }
+        }
+
+        nsecs_t sent = frame.times[CameraTraces::FRAME_REQUEST_SENT];
+        if (sent == 0) continue;
+        for (size_t b = 0; b < frame.bufferTimes.size(); b++) {
+            int streamId = frame.bufferTimes.keyAt(b);
+            idx = latencies.streams.indexOfKey(streamId);
+            if (idx < 0) {
+                idx = latencies.streams.add(streamId, LatencyHistogram());
+            }
+            latencies.streams.editValueAt(idx).add(
+                    frame.bufferTimes.valueAt(b) - sent);
+        }
+    }
+
+    String8 lines = String8::format("Camera frame latency (%d events, "
+            "%d frames):\n", events.size(), frames.size());
+    if (cameras.isEmpty()) {
+        lines.append("  No frame events logged.\n");
+    }
+    for (size_t i = 0; i < cameras.size(); i++) {
+        const CameraLatencies &latencies = cameras.valueAt(i);
+        lines.appendFormat("  Camera %d:\n", cameras.keyAt(i));
+        lines.append("    Per stage:\n");
+        for (size_t s = 0; s < kNumFrameStages; s++) {
+            latencies.stages[s].appendTo(&lines, kFrameStages[s].name);
+        }
+        lines.append("    Sent to buffer returned, per stream:\n");
+        for (size_t s = 0; s < latencies.streams.size(); s++) {
+            String8 name = String8::format("stream %d",
+                    latencies.streams.keyAt(s));
+            latencies.streams.valueAt(s).appendTo(&lines, name.string());
+        }
+    }
+    write(fd, lines.string(), lines.size());
+}
+
 status_t CameraTraces::dump(int fd, const Vector<String16> &args __attribute__((unused))) {
     ALOGV("%s: fd = %d", __FUNCTION__, fd);
     Mutex::Autolock al(sImpl.tracesLock);
@@ -87,6 +330,85 @@ status_t CameraTraces::dump(int fd, const Vector<String16> &args __attribute__((
         pcs.dump(fd, DUMP_INDENT);
     }
 
+    write(fd, "\n", 1);
+    dumpFrameLatencies(sImpl, fd);
+
+    return OK;
+}
+
+struct TraceLine {
+    nsecs_t timestamp;
+    String8 text;
+};
+
+static int compareTraceLines(const TraceLine *a, const TraceLine *b) {
+    return (a->timestamp > b->timestamp) - (a->timestamp < b->timestamp);
+}
+
+// Adds the begin and end of an async slice, as written by ATRACE_ASYNC_BEGIN
+// and ATRACE_ASYNC_END
+static void addTraceSlice(Vector<TraceLine> *lines, const String8 &name,
+        uint32_t cookie, nsecs_t begin, nsecs_t end) {
+    static const pid_t pid = getpid();
+    const char *format = "<...>-%d [000] ...1 %lld.%06lld: "
+            "tracing_mark_write: %c|%d|%s|%u\n";
+
+    TraceLine line;
+    line.timestamp = begin;
+    line.text = String8::format(format, pid, begin / 1000000000LL,
+            ns2us(begin) % 1000000LL, 'S', pid, name.string(), cookie);
+    lines->push_back(line);
+
+    line.timestamp = end;
+    line.text = String8::format(format, pid, end / 1000000000LL,
+            ns2us(end) % 1000000LL, 'F', pid, name.string(), cookie);
+    lines->push_back(line);
+}
+
+status_t CameraTraces::dumpFrameTrace(int fd) {
+    ALOGV("%s: fd = %d", __FUNCTION__, fd);
+    if (fd < 0) {
+        ALOGW("%s: Negative FD (%d)", __FUNCTION__, fd);
+        return BAD_VALUE;
+    }
+
+    Vector<FrameEventData> events;
+    copyFrameEvents(sImpl, &events);
+
+    KeyedVector<int64_t, FrameTimes> frames;
+    collectFrames(events, &frames);
+
+    Vector<TraceLine> lines;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const FrameTimes &frame = frames.valueAt(i);
+        int cameraId = (int)(frames.keyAt(i) >> 32);
+        uint32_t frameNumber = (uint32_t)frames.keyAt(i);
+
+        for (size_t s = 0; s < kNumFrameStages; s++) {
+            nsecs_t from = frame.times[kFrameStages[s].from];
+            nsecs_t to = frame.times[kFrameStages[s].to];
+            if (from != 0 && to != 0) {
+                addTraceSlice(&lines, String8::format("Camera %d %s",
+                        cameraId, kFrameStages[s].name), frameNumber,
+                        from, to);
+            }
+        }
+
+        nsecs_t sent = frame.times[FRAME_REQUEST_SENT];
+        if (sent == 0) continue;
+        for (size_t b = 0; b < frame.bufferTimes.size(); b++) {
+            addTraceSlice(&lines, String8::format("Camera %d stream %d",
+                    cameraId, frame.bufferTimes.keyAt(b)), frameNumber,
+                    sent, frame.bufferTimes.valueAt(b));
+        }
+    }
+    lines.sort(compareTraceLines);
+
+    fdprintf(fd, "# tracer: nop\n#\n");
+    for (size_t i = 0; i < lines.size(); i++) {
+        write(fd, lines[i].text.string(), lines[i].text.size());
+    }
+
     return OK;
 }
 
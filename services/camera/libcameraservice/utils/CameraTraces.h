@@ -19,6 +19,7 @@
 
 #include <utils/Errors.h>
 #include <utils/String16.h>
+#include <utils/Timers.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -26,9 +27,44 @@ namespace camera3 {
 
 class CameraTracesImpl;
 
-// Collect a list of the process's stack traces
+// Collect a list of the process's stack traces, and a log of per-frame
+// capture pipeline events
 class CameraTraces {
 public:
+    // Points in a capture request's life, in the order they normally happen.
+    // Camera3Device logs all but the last, which FrameProcessorBase logs for
+    // api1 and api2 clients alike. HAL2 devices only get delivery events.
+    // HAL1 devices (CameraClient) have no capture requests and log nothing.
+    enum FrameEvent {
+        // The request was queued for the HAL; for repeating requests, when
+        // the request thread picked up the repeating list
+        FRAME_REQUEST_QUEUED = 0,
+        // The request was passed to the HAL
+        FRAME_REQUEST_SENT,
+        // The HAL's shutter notification arrived
+        FRAME_SHUTTER,
+        // The final result metadata arrived from the HAL
+        FRAME_RESULT,
+        // A filled buffer for one output stream came back from the HAL
+        FRAME_BUFFER_RETURNED,
+        // The result metadata was passed to the client's listeners
+        FRAME_RESULT_DELIVERED,
+
+        FRAME_EVENT_COUNT
+    };
+
+    /**
+     * Record that a frame reached the given point. Lock-free and safe to call
+     * from any thread, including HAL callbacks. Only the most recent
+     * events are kept; older ones are overwritten.
+     *
+     * <p>streamId is only meaningful for FRAME_BUFFER_RETURNED. A timestamp of
+     * 0 means now, in the SYSTEM_TIME_MONOTONIC base.</p>
+     */
+    static void     logFrameEvent(int cameraId, FrameEvent event,
+                                  uint32_t frameNumber, int streamId = -1,
+                                  nsecs_t timestamp = 0);
+
     /**
      * Save the current stack trace for each thread in the process. At most
      * MAX_TRACES will be saved, after which the oldest traces will be discarded.
@@ -38,12 +74,21 @@ public:
     static void     saveTrace();
 
     /**
-     * Prints all saved traces to the specified file descriptor.
+     * Prints all saved traces to the specified file descriptor, followed by
+     * latency histograms built from the frame event log, per pipeline stage
+     * and per output stream.
      *
      * <p>Each line is indented by DUMP_INDENT spaces.</p>
      */
     static status_t dump(int fd, const Vector<String16>& args);
 
+    /**
+     * Prints the frame event log as ftrace text, with one async slice per
+     * pipeline stage of each frame, which systrace can load with --from-file.
+     * Used by "dumpsys media.camera --frame-trace".
+     */
+    static status_t dumpFrameTrace(int fd);
+
 private:
     enum {
         // Don't collect more than 100 traces. Discard oldest.